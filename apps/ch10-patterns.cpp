@@ -15,15 +15,8 @@
 using namespace ratrac;
 using namespace std;
 
-int main(int argc, char *argv[]) {
-  App app("patterns", "tests the use of patterns.");
-  if (!app.parse(argc - 1, (const char **)argv + 1))
-    app.error("command line arguments parsing failed.");
-  if (app.verbose())
-    cout << app.parameters() << '\n';
-
-  World world;
-
+// Build the scene, unless it is loaded from the scene cache.
+void build_world(World &world) {
   // The floor.
   Plane *floor = new Plane();
   floor->transform(Matrix::rotation_y(-M_PI / 2));
@@ -74,14 +67,29 @@ int main(int argc, char *argv[]) {
 
   // The light source is white, shining from above and to the left:
   world.lights().push_back(LightPoint(Point(-10, 10, -10), Color::WHITE()));
+}
+
+int main(int argc, char *argv[]) {
+  App app("patterns", "tests the use of patterns.");
+  if (!app.parse(argc - 1, (const char **)argv + 1))
+    app.error("command line arguments parsing failed.");
+  if (app.verbose())
+    cout << app.parameters() << '\n';
+
+  World world;
+  if (!app.load_scene(world)) {
+    build_world(world);
+    app.save_scene(world);
+  }
 
   // Camera camera(100, 50, M_PI / 3.);
   Camera camera(app.width(), app.height(), M_PI / 3.);
   camera.transform(
       view_transform(Point(0, 1.5, -5), Point(0, 1, 0), Vector(0, 1, 0)));
+  camera.packet_size(app.packet_width(), app.packet_height());
 
   // Render the world to a canvas.
-  Canvas C = camera.render(world, app.verbose());
+  Canvas C = camera.render(world, app.verbose(), app.threads());
 
   // Save the scene.
   app.save(C);
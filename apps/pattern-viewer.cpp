@@ -112,9 +112,10 @@ int main(int argc, char *argv[]) {
   Camera camera(app.width(), app.height(), M_PI / 3.);
   camera.transform(
       view_transform(Point(0, 1.5, -5), Point(0, 1, 0), Vector(0, 1, 0)));
+  camera.packet_size(app.packet_width(), app.packet_height());
 
   // Render the world to a canvas.
-  Canvas C = camera.render(world, app.verbose());
+  Canvas C = camera.render(world, app.verbose(), app.threads());
 
   // Save the scene.
   app.save(C);
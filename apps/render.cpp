@@ -0,0 +1,88 @@
+#include "ratrac/App.h"
+#include "ratrac/Camera.h"
+#include "ratrac/Canvas.h"
+#include "ratrac/Scene.h"
+#include "ratrac/StopWatch.h"
+
+#include <iostream>
+#include <string>
+
+using namespace ratrac;
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  // The canvas size defaults to the one of the scene's camera.
+  App app("render", "renders a scene description.", 0, 0);
+  string sceneFilename;
+  Accelerator accelerator = Accelerator::BVH;
+  bool wavefront = false;
+  app.addOptionWithValue({"--scene", "-s"}, "S",
+                         "Render the scene description S",
+                         [&](const string &s) {
+                           sceneFilename = s;
+                           return true;
+                         });
+  app.addOptionWithValue({"--accelerator"}, "A",
+                         "Accelerate the intersections with A, bvh (default), "
+                         "wide-bvh or grid",
+                         [&](const string &s) {
+                           if (s == "bvh")
+                             accelerator = Accelerator::BVH;
+                           else if (s == "wide-bvh")
+                             accelerator = Accelerator::WIDE_BVH;
+                           else if (s == "grid")
+                             accelerator = Accelerator::GRID;
+                           else
+                             return false;
+                           return true;
+                         });
+  app.addOption({"--wavefront"},
+                "Render in wavefront mode, with the shadow rays sorted",
+                [&]() {
+                  wavefront = true;
+                  return true;
+                });
+  if (!app.parse(argc - 1, (const char **)argv + 1))
+    app.error("command line arguments parsing failed.");
+  if (sceneFilename.empty())
+    app.error("no scene description, use --scene.");
+  if (app.verbose())
+    cout << "Scene: " << sceneFilename << '\n' << app.parameters() << '\n';
+
+  Scene scene;
+  string error;
+  if (!read_scene(sceneFilename, scene, &error))
+    app.error(error);
+  if (!scene.camera)
+    app.error(sceneFilename + " has no camera.");
+  scene.world.accelerator(accelerator);
+
+  // Build the world's acceleration structure, with all threads.
+  {
+    AutoStopWatch watch("Acceleration structure build", cout, !app.verbose());
+    scene.world.prepare(app.threads());
+  }
+  if (app.verbose()) {
+    if (const BVH *bvh = scene.world.bvh())
+      cout << *bvh << '\n';
+    if (const WideBVH *wide_bvh = scene.world.wide_bvh())
+      cout << *wide_bvh << '\n';
+    if (const Grid *grid = scene.world.grid())
+      cout << *grid << '\n';
+  }
+
+  Camera camera(app.width() ? app.width() : scene.camera->hsize(),
+                app.height() ? app.height() : scene.camera->vsize(),
+                scene.camera->field_of_view());
+  camera.transform(scene.camera->transform());
+  camera.packet_size(app.packet_width(), app.packet_height());
+  camera.wavefront(wavefront);
+
+  // Render the world to a canvas.
+  Canvas C = camera.render(scene.world, app.verbose(), app.threads());
+
+  // Save the scene.
+  app.save(C);
+
+  return 0;
+}
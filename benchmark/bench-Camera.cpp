@@ -0,0 +1,209 @@
+#include "ratrac/Camera.h"
+#include "ratrac/Canvas.h"
+#include "ratrac/Color.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Light.h"
+#include "ratrac/Material.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Patterns.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+using ratrac::Camera;
+using ratrac::Canvas;
+using ratrac::Color;
+using ratrac::Intersection;
+using ratrac::Material;
+using ratrac::Matrix;
+using ratrac::PacketHits;
+using ratrac::Plane;
+using ratrac::RayPacket;
+using ratrac::Sphere;
+using ratrac::World;
+
+namespace {
+// The scenes of the ch7-scene and ch10-patterns applications, rendered at
+// 320x240 with packets of state.range(0) x state.range(1) pixels, 1x1 being
+// the single ray tracing.
+const unsigned WIDTH = 320;
+const unsigned HEIGHT = 240;
+
+Sphere *newSphere(const Matrix &transform, const Material &m) {
+  Sphere *s = new Sphere();
+  s->transform(transform);
+  s->material(m);
+  return s;
+}
+
+Material newMaterial(const Color &color, ratrac::RayTracerColorType diffuse,
+                     ratrac::RayTracerColorType specular) {
+  Material m;
+  m.color(color);
+  m.diffuse(diffuse);
+  m.specular(specular);
+  return m;
+}
+
+World getScene() {
+  World world;
+  const Material wall = newMaterial(Color(1, 0.9, 0.9), 0.9, 0);
+  world.append(newSphere(Matrix::scaling(10, 0.01, 10), wall));
+  world.append(newSphere(Matrix::translation(0, 0, 5) *
+                             Matrix::rotation_y(-M_PI / 4.) *
+                             Matrix::rotation_x(M_PI / 2.) *
+                             Matrix::scaling(10, 0.01, 10),
+                         wall));
+  world.append(newSphere(Matrix::translation(0, 0, 5) *
+                             Matrix::rotation_y(M_PI / 4.) *
+                             Matrix::rotation_x(M_PI / 2.) *
+                             Matrix::scaling(10, 0.01, 10),
+                         wall));
+  world.append(newSphere(Matrix::translation(-0.5, 1, 0.5),
+                         newMaterial(Color(0.1, 1, 0.5), 0.7, 0.3)));
+  world.append(newSphere(Matrix::translation(1.5, 0.5, -0.5) *
+                             Matrix::scaling(0.5, 0.5, 0.5),
+                         newMaterial(Color(0.5, 1, 0.1), 0.7, 0.3)));
+  world.append(newSphere(Matrix::translation(-1.5, 0.33, -0.75) *
+                             Matrix::scaling(0.33, 0.33, 0.33),
+                         newMaterial(Color(1, 0.8, 0.1), 0.7, 0.3)));
+  world.lights().push_back(
+      ratrac::LightPoint(ratrac::Point(-10, 10, -10), Color::WHITE()));
+  return world;
+}
+
+World getPatterns() {
+  World world;
+  Plane *floor = new Plane();
+  floor->transform(Matrix::rotation_y(-M_PI / 2));
+  Material m;
+  m.pattern(ratrac::Ring(Color(0.25, 0.25, 0.25), Color(0.8, 0.8, 0.8),
+                         Matrix::scaling(0.5, 0.5, 0.5)));
+  m.specular(0);
+  floor->material(m);
+  world.append(floor);
+
+  Material m2 = newMaterial(Color::WHITE(), 0.7, 0.3);
+  m2.pattern(ratrac::Stripes(Color(0.1, 0.8, 0.1), Color(0.5, 0.8, 0.5),
+                             Matrix::scaling(0.15, 0.15, 0.15) *
+                                 Matrix::rotation_z(-M_PI / 8) *
+                                 Matrix::rotation_y(-M_PI / 3)));
+  world.append(newSphere(Matrix::translation(-1.0, 1.0, 2.0) *
+                             Matrix::rotation_y(-M_PI / 2),
+                         m2));
+  Material m3 = newMaterial(Color::WHITE(), 0.7, 0.3);
+  m3.pattern(ratrac::Gradient(Color::RED(), Color(1, 1, 0)));
+  world.append(newSphere(Matrix::translation(1.5, 0.5, -0.5) *
+                             Matrix::scaling(0.5, 0.5, 0.5),
+                         m3));
+  Material m4 = newMaterial(Color(1, 0.8, 0.1), 0.7, 0.3);
+  m4.pattern(ratrac::ColorCheckers(Color(0.05, 0.25, 0.05),
+                                   Color(0.5, 0.8, 0.5),
+                                   Matrix::scaling(0.5, 0.1, 0.1)));
+  world.append(newSphere(Matrix::translation(-1.5, 0.33, -0.75) *
+                             Matrix::scaling(0.33, 0.33, 0.33),
+                         m4));
+  world.lights().push_back(
+      ratrac::LightPoint(ratrac::Point(-10, 10, -10), Color::WHITE()));
+  return world;
+}
+
+Camera getCamera(benchmark::State &state) {
+  Camera camera(WIDTH, HEIGHT, M_PI / 3.);
+  camera.transform(ratrac::view_transform(
+      ratrac::Point(0, 1.5, -5), ratrac::Point(0, 1, 0),
+      ratrac::Vector(0, 1, 0)));
+  camera.packet_size(state.range(0), state.range(1));
+  return camera;
+}
+
+template <World (*getWorld)()>
+void BM_Camera_Render(benchmark::State &state) {
+  const World world = getWorld();
+  const Camera camera = getCamera(state);
+  for (auto _ : state) {
+    Canvas image = camera.render(world, /* verbose: */ false);
+    benchmark::DoNotOptimize(image);
+  }
+  state.SetItemsProcessed(state.iterations() * WIDTH * HEIGHT);
+}
+
+// Only the primary rays closest hits, i.e. what the packets speed up, without
+// the shading.
+template <World (*getWorld)()>
+void BM_Camera_PrimaryHits(benchmark::State &state) {
+  const World world = getWorld();
+  const Camera camera = getCamera(state);
+  const unsigned pw = camera.packet_width();
+  const unsigned ph = camera.packet_height();
+  for (auto _ : state) {
+    for (unsigned y = 0; y < HEIGHT; y += ph)
+      for (unsigned x = 0; x < WIDTH; x += pw) {
+        if (pw * ph == 1) {
+          Intersection hit = world.closest_hit(camera.ray_for_pixel(x, y));
+          benchmark::DoNotOptimize(hit);
+          continue;
+        }
+        RayPacket rays = camera.rays_for_pixels(x, y, pw, ph);
+        PacketHits hits = world.closest_hit(rays, RayPacket::mask(pw * ph));
+        benchmark::DoNotOptimize(hits);
+      }
+  }
+  state.SetItemsProcessed(state.iterations() * WIDTH * HEIGHT);
+}
+
+// A sparse cloud of state.range(0) particles lit by 2 lights, seen from inside
+// the cloud, rendered in the default mode or, when state.range(1) is 1, in
+// wavefront mode. Most shadow rays cross a large part of the cloud, and those
+// of the large clouds thrash the caches when traced in pixel order.
+void BM_Camera_RenderParticles(benchmark::State &state) {
+  World world;
+  const unsigned n = state.range(0);
+  const ratrac::RayTracerDataType side = 4 * std::cbrt(n);
+  for (unsigned i = 0; i < n; i++) {
+    ratrac::RayTracerDataType x, y, z, r;
+    ratrac::getRandomData(x, y, z, r);
+    // Random data is in [-1000:1000].
+    world.append(newSphere(
+        Matrix::translation(x * side / 2000, y * side / 2000,
+                            z * side / 2000) *
+            Matrix::scaling(0.2 + r / 10000, 0.2 + r / 10000,
+                            0.2 + r / 10000),
+        newMaterial(Color(1, 0.8, 0.1), 0.7, 0.3)));
+  }
+  world.lights().push_back(ratrac::LightPoint(
+      ratrac::Point(-side, side, -side), Color(0.5, 0.5, 0.5)));
+  world.lights().push_back(ratrac::LightPoint(
+      ratrac::Point(side, side, side / 2), Color(0.5, 0.5, 0.5)));
+  world.prepare();
+
+  Camera camera(WIDTH, HEIGHT, M_PI / 3.);
+  camera.transform(ratrac::view_transform(ratrac::Point(0, 0, -side / 4),
+                                          ratrac::Point(0, 0, side / 2),
+                                          ratrac::Vector(0, 1, 0)));
+  camera.wavefront(state.range(1));
+  for (auto _ : state) {
+    Canvas image = camera.render(world, /* verbose: */ false);
+    benchmark::DoNotOptimize(image);
+  }
+  state.SetItemsProcessed(state.iterations() * WIDTH * HEIGHT);
+}
+
+void PacketSizes(benchmark::Benchmark *b) {
+  b->Args({1, 1})->Args({2, 2})->Args({4, 2})->Unit(benchmark::kMillisecond);
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_Camera_Render, getScene)->Apply(PacketSizes);
+BENCHMARK_TEMPLATE(BM_Camera_Render, getPatterns)->Apply(PacketSizes);
+BENCHMARK_TEMPLATE(BM_Camera_PrimaryHits, getScene)->Apply(PacketSizes);
+BENCHMARK_TEMPLATE(BM_Camera_PrimaryHits, getPatterns)->Apply(PacketSizes);
+BENCHMARK(BM_Camera_RenderParticles)
+    ->ArgsProduct({{1000, 1000000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
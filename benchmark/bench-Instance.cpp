@@ -0,0 +1,98 @@
+#include "ratrac/Instance.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+using ratrac::Instance;
+using ratrac::Intersection;
+using ratrac::Matrix;
+using ratrac::Point;
+using ratrac::Ray;
+using ratrac::RayTracerDataType;
+using ratrac::TriangleMesh;
+using ratrac::Tuple;
+using ratrac::World;
+
+namespace {
+// A forest of state.range(0) x state.range(0) instances of a bumpy mesh of
+// 2 x 50 x 50 triangles, each rotated and scaled differently, which random
+// rays are shot at from above.
+const unsigned NUM_RAYS = 1024;
+const unsigned GRID = 50;
+
+std::shared_ptr<TriangleMesh> getMesh() {
+  std::vector<Tuple> vertices;
+  for (unsigned j = 0; j <= GRID; j++)
+    for (unsigned i = 0; i <= GRID; i++)
+      vertices.push_back(Point(RayTracerDataType(i) / GRID,
+                               0.1 * ratrac::getRandomData() / (1000 * GRID),
+                               RayTracerDataType(j) / GRID));
+  std::vector<unsigned> indices;
+  for (unsigned j = 0; j < GRID; j++)
+    for (unsigned i = 0; i < GRID; i++) {
+      const unsigned v = j * (GRID + 1) + i;
+      indices.insert(indices.end(), {v, v + 1, v + GRID + 2});
+      indices.insert(indices.end(), {v, v + GRID + 2, v + GRID + 1});
+    }
+  return std::make_shared<TriangleMesh>(vertices, indices);
+}
+
+World getWorld(const std::shared_ptr<TriangleMesh> &mesh, unsigned n) {
+  World world;
+  for (unsigned i = 0; i < n; i++)
+    for (unsigned j = 0; j < n; j++)
+      world.append(new Instance(
+          mesh, Matrix::translation(i, 0, j) * Matrix::rotation_x(0.3) *
+                    Matrix::rotation_y(0.1 * ((i + j) % 10)) *
+                    Matrix::scaling(0.6 + 0.02 * (i % 10), 1, 0.5)));
+  // Build the world's acceleration structure.
+  world.bvh();
+  return world;
+}
+
+std::vector<Ray> getRays(unsigned n) {
+  std::vector<Ray> rays;
+  const Tuple from = Point(0.5 * n, 2 * n, -1.0 * n);
+  for (unsigned i = 0; i < NUM_RAYS; i++) {
+    RayTracerDataType x, z;
+    ratrac::getRandomData(x, z);
+    // Random data is in [-1000:1000].
+    const Tuple to = Point((x + 1000) * n / 2000, 0, (z + 1000) * n / 2000);
+    rays.push_back(Ray(from, normalize(to - from)));
+  }
+  return rays;
+}
+
+void BM_Instance_Build(benchmark::State &state) {
+  const std::shared_ptr<TriangleMesh> mesh = getMesh();
+  for (auto _ : state) {
+    World world = getWorld(mesh, state.range(0));
+    benchmark::DoNotOptimize(world);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(0));
+}
+
+void BM_Instance_ClosestHit(benchmark::State &state) {
+  const World world = getWorld(getMesh(), state.range(0));
+  const std::vector<Ray> rays = getRays(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Intersection hit = world.closest_hit(rays[i++ % NUM_RAYS]);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+BENCHMARK(BM_Instance_Build)->Arg(10)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Instance_ClosestHit)->Arg(10)->Arg(100);
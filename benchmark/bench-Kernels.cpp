@@ -0,0 +1,114 @@
+#include "ratrac/Kernels.h"
+#include "bench-ratrac.h"
+#include "ratrac/Color.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/SIMD.h"
+#include "ratrac/Tuple.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+using ratrac::Color;
+using ratrac::ISA;
+using ratrac::Kernels;
+using ratrac::Matrix;
+using ratrac::Ray;
+using ratrac::RayTracerDataType;
+using ratrac::Tuple;
+using ratrac::getRandomData;
+
+namespace {
+// The kernels are benchmarked for each instruction set, with state.range(0)
+// being the ISA. The inputs are generated upfront, as pausing the timers
+// would cost more than the kernels themselves.
+const unsigned NUM_INPUTS = 256;
+
+const Kernels *getKernels(benchmark::State &state) {
+  const ISA isa = static_cast<ISA>(state.range(0));
+  const Kernels *k = ratrac::get_kernels(isa);
+  if (!k)
+    state.SkipWithError("Instruction set not available");
+  else
+    state.SetLabel(ratrac::name(isa));
+  return k;
+}
+
+std::vector<Ray> getRandomRays() {
+  std::vector<Ray> rays;
+  for (unsigned i = 0; i < NUM_INPUTS; i++) {
+    RayTracerDataType x, y, z, dx, dy, dz;
+    getRandomData(x, y, z, dx, dy, dz);
+    rays.push_back(Ray(ratrac::Point(x, y, z),
+                       ratrac::normalize(ratrac::Vector(dx, dy, dz))));
+  }
+  return rays;
+}
+
+void BM_Kernels_TransformRay(benchmark::State &state) {
+  const Kernels *k = getKernels(state);
+  if (!k)
+    return;
+  const std::vector<Ray> rays = getRandomRays();
+  const Matrix M = inverse(
+      Matrix::scaling(2, 3, 4).rotate_x(0.5).rotate_y(1.2).translate(1, 2, 3));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Ray r = k->transform_ray(rays[i++ % NUM_INPUTS], M);
+    benchmark::DoNotOptimize(r);
+  }
+}
+
+// The sphere intersection is inlined in its callers rather than dispatched,
+// so it is benchmarked once.
+void BM_Kernels_IntersectSphere(benchmark::State &state) {
+  // Rays from random points towards the neighborhood of the sphere, so that
+  // both hits and misses are benchmarked.
+  std::vector<Ray> rays;
+  for (const Ray &r : getRandomRays())
+    rays.push_back(Ray(r.origin(), ratrac::normalize(r.direction() * 0.001 -
+                                                     r.origin())));
+  const Tuple center = ratrac::Point(0, 0, 0);
+  unsigned i = 0;
+  for (auto _ : state) {
+    RayTracerDataType t1 = 0, t2 = 0;
+    const Ray &r = rays[i++ % NUM_INPUTS];
+    bool hit = ratrac::simd::scalar::intersect_sphere(
+        r.origin().data(), r.direction().data(), center.data(),
+        RayTracerDataType(1), t1, t2);
+    benchmark::DoNotOptimize(hit);
+    benchmark::DoNotOptimize(t1);
+    benchmark::DoNotOptimize(t2);
+  }
+}
+
+void BM_Kernels_AccumulateColors(benchmark::State &state) {
+  const Kernels *k = getKernels(state);
+  if (!k)
+    return;
+  // A row of a 1024 pixels wide canvas.
+  const size_t count = 1024;
+  std::vector<Color> src, dst(count);
+  for (size_t i = 0; i < count; i++) {
+    RayTracerDataType r, g, b;
+    getRandomData(r, g, b);
+    src.push_back(Color(r, g, b));
+  }
+  for (auto _ : state) {
+    k->accumulate_colors(dst.data(), src.data(), count);
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+void ISAs(benchmark::Benchmark *b) {
+  for (ISA isa : {ISA::SCALAR, ISA::SSE2, ISA::AVX2, ISA::AVX512})
+    b->Arg(static_cast<int>(isa));
+}
+} // namespace
+
+BENCHMARK(BM_Kernels_TransformRay)->Apply(ISAs);
+BENCHMARK(BM_Kernels_IntersectSphere);
+BENCHMARK(BM_Kernels_AccumulateColors)->Apply(ISAs);
@@ -1,9 +1,13 @@
 #include "ratrac/Matrix.h"
 #include "bench-ratrac.h"
+#include "ratrac/SIMD.h"
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using ratrac::Matrix;
+using ratrac::Tuple;
 using ratrac::getRandomData;
 
 namespace {
@@ -147,6 +151,113 @@ void BM_Matrix_Shear(benchmark::State &state) {
     benchmark::DoNotOptimize(M);
   }
 }
+
+// ================================================================
+// Matrix inversion benchmarking. The matrices are generated upfront, as
+// pausing the timers would cost more than the inversions themselves.
+const unsigned NUM_MATRICES = 256;
+
+std::vector<Matrix> getRandomMatrices() {
+  std::vector<Matrix> matrices;
+  for (unsigned i = 0; i < NUM_MATRICES; i++) {
+    Matrix M(4, 4);
+    for (unsigned row = 0; row < 4; row++)
+      for (unsigned col = 0; col < 4; col++)
+        M.set(row, col, getRandomData());
+    matrices.push_back(M);
+  }
+  return matrices;
+}
+
+std::vector<Matrix> getRandomAffineMatrices() {
+  std::vector<Matrix> matrices;
+  for (unsigned i = 0; i < NUM_MATRICES; i++) {
+    Matrix::DataType x, y, z, a, b, c;
+    getRandomData(x, y, z, a, b, c);
+    matrices.push_back(Matrix::identity()
+                           .rotate_x(a)
+                           .rotate_y(b)
+                           .rotate_z(c)
+                           .scale(1.0 + x * x, 1.0 + y * y, 1.0 + z * z)
+                           .translate(x, y, z));
+  }
+  return matrices;
+}
+
+void BM_Matrix_Determinant(benchmark::State &state) {
+  const std::vector<Matrix> matrices = getRandomMatrices();
+  unsigned i = 0;
+  for (auto _ : state) {
+    Matrix::DataType det = matrices[i++ % NUM_MATRICES].determinant();
+    benchmark::DoNotOptimize(det);
+  }
+}
+
+template <Matrix &(Matrix::*Inverse)()>
+void BM_Matrix_Inverse(benchmark::State &state,
+                       const std::vector<Matrix> &matrices) {
+  unsigned i = 0;
+  for (auto _ : state) {
+    Matrix M = matrices[i++ % NUM_MATRICES];
+    (M.*Inverse)();
+    benchmark::DoNotOptimize(M);
+  }
+}
+
+void BM_Matrix_Inverse_Cofactors(benchmark::State &state) {
+  BM_Matrix_Inverse<&Matrix::inverse_cofactors>(state, getRandomMatrices());
+}
+
+void BM_Matrix_Inverse_4x4(benchmark::State &state) {
+  BM_Matrix_Inverse<&Matrix::inverse_4x4>(state, getRandomMatrices());
+}
+
+void BM_Matrix_Inverse_Affine_Cofactors(benchmark::State &state) {
+  BM_Matrix_Inverse<&Matrix::inverse_cofactors>(state,
+                                                getRandomAffineMatrices());
+}
+
+void BM_Matrix_Inverse_Affine_4x4(benchmark::State &state) {
+  BM_Matrix_Inverse<&Matrix::inverse_4x4>(state, getRandomAffineMatrices());
+}
+
+void BM_Matrix_Inverse_Affine(benchmark::State &state) {
+  BM_Matrix_Inverse<&Matrix::inverse_affine>(state, getRandomAffineMatrices());
+}
+
+// ================================================================
+// Matrix x Tuple benchmarking: the scalar kernel against the one selected at
+// compile time.
+template <class KernelTy>
+void BM_Matrix_Tuple_Product(benchmark::State &state, KernelTy kernel) {
+  const std::vector<Matrix> matrices = getRandomAffineMatrices();
+  std::vector<Tuple> tuples;
+  for (unsigned i = 0; i < NUM_MATRICES; i++) {
+    Matrix::DataType x, y, z, w;
+    getRandomData(x, y, z, w);
+    tuples.push_back(Tuple(x, y, z, w));
+  }
+  unsigned i = 0;
+  for (auto _ : state) {
+    Tuple T = kernel(matrices[i % NUM_MATRICES], tuples[i % NUM_MATRICES]);
+    benchmark::DoNotOptimize(T);
+    i++;
+  }
+  state.SetLabel(ratrac::simd::native::name());
+}
+
+void BM_Matrix_Tuple_Product_Scalar(benchmark::State &state) {
+  BM_Matrix_Tuple_Product(state, [](const Matrix &M, const Tuple &T) {
+    Tuple R;
+    ratrac::simd::scalar::matvec4(M.data(), T.data(), R.data());
+    return R;
+  });
+}
+
+void BM_Matrix_Tuple_Product_Native(benchmark::State &state) {
+  BM_Matrix_Tuple_Product(state,
+                          [](const Matrix &M, const Tuple &T) { return M * T; });
+}
 } // namespace
 
 BENCHMARK(BM_Matrix_Identity);
@@ -165,3 +276,17 @@ BENCHMARK(BM_Matrix_Rotate_X);
 BENCHMARK(BM_Matrix_Rotate_Y);
 BENCHMARK(BM_Matrix_Rotate_Z);
 BENCHMARK(BM_Matrix_Shear);
+
+// ================================================================
+// Matrix inversion benchmarking.
+BENCHMARK(BM_Matrix_Determinant);
+BENCHMARK(BM_Matrix_Inverse_Cofactors);
+BENCHMARK(BM_Matrix_Inverse_4x4);
+BENCHMARK(BM_Matrix_Inverse_Affine_Cofactors);
+BENCHMARK(BM_Matrix_Inverse_Affine_4x4);
+BENCHMARK(BM_Matrix_Inverse_Affine);
+
+// ================================================================
+// Matrix x Tuple benchmarking.
+BENCHMARK(BM_Matrix_Tuple_Product_Scalar);
+BENCHMARK(BM_Matrix_Tuple_Product_Native);
@@ -0,0 +1,97 @@
+#include "ratrac/OBJ.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using ratrac::OBJMesh;
+
+namespace {
+// A bumpy N x N grid of quads, each split in 2 faces, with vertex normals:
+// about 1M vertices and 2M triangles, 80MB of text.
+const unsigned N = 1000;
+
+const std::string &getOBJText() {
+  static const std::string text = [] {
+    std::ostringstream os;
+    os.precision(6);
+    for (unsigned j = 0; j <= N; j++)
+      for (unsigned i = 0; i <= N; i++)
+        os << "v " << double(i) / N << ' '
+           << 0.001 * ratrac::getRandomData() / N << ' ' << double(j) / N
+           << '\n';
+    for (unsigned j = 0; j <= N; j++)
+      for (unsigned i = 0; i <= N; i++)
+        os << "vn " << 0.01 * (i % 7) << " 1 " << 0.01 * (j % 5) << '\n';
+    for (unsigned j = 0; j < N; j++)
+      for (unsigned i = 0; i < N; i++) {
+        const unsigned v = j * (N + 1) + i + 1;
+        os << "f " << v << "//" << v << ' ' << v + 1 << "//" << v + 1 << ' '
+           << v + N + 2 << "//" << v + N + 2 << '\n';
+        os << "f " << v << "//" << v << ' ' << v + N + 2 << "//" << v + N + 2
+           << ' ' << v + N + 1 << "//" << v + N + 1 << '\n';
+      }
+    return os.str();
+  }();
+  return text;
+}
+
+// The OBJ text, written once to a temporary file which is removed at exit.
+const std::string &getOBJFile() {
+  struct File {
+    File()
+        : name((std::filesystem::temp_directory_path() / "ratrac-bench.obj")
+                   .string()) {
+      std::ofstream os(name, std::ios::binary);
+      os << getOBJText();
+    }
+    ~File() { std::remove(name.c_str()); }
+    std::string name;
+  };
+  static const File file;
+  return file.name;
+}
+
+unsigned getThreads(const benchmark::State &state) {
+  return state.range(0) ? state.range(0)
+                        : std::max(1U, std::thread::hardware_concurrency());
+}
+
+void BM_OBJ_Parse(benchmark::State &state) {
+  const std::string &text = getOBJText();
+  const unsigned threads = getThreads(state);
+  for (auto _ : state) {
+    OBJMesh mesh;
+    if (!ratrac::parse_obj(text.data(), text.data() + text.size(), mesh,
+                           threads))
+      state.SkipWithError("OBJ parsing failed");
+    benchmark::DoNotOptimize(mesh);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+  state.SetItemsProcessed(state.iterations() * 2 * N * N);
+}
+
+void BM_OBJ_Read(benchmark::State &state) {
+  const std::string &filename = getOBJFile();
+  const unsigned threads = getThreads(state);
+  for (auto _ : state) {
+    OBJMesh mesh;
+    if (!ratrac::read_obj(filename, mesh, threads))
+      state.SkipWithError("OBJ reading failed");
+    benchmark::DoNotOptimize(mesh);
+  }
+  state.SetBytesProcessed(state.iterations() * getOBJText().size());
+  state.SetItemsProcessed(state.iterations() * 2 * N * N);
+}
+} // namespace
+
+// Argument 0 uses all the hardware threads.
+BENCHMARK(BM_OBJ_Parse)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_OBJ_Read)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
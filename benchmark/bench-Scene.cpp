@@ -0,0 +1,73 @@
+#include "ratrac/Scene.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+
+using ratrac::Scene;
+
+namespace {
+// A camera, a light, a floor and N spheres, each with its own transform and
+// a material which extends one of a few definitions: about 20MB of text.
+const unsigned N = 100000;
+
+const std::string &getSceneText() {
+  static const std::string text = [] {
+    std::ostringstream os;
+    os.precision(6);
+    os << "- add: camera\n"
+          "  width: 320\n"
+          "  height: 240\n"
+          "  field-of-view: 1.0471975511965976\n"
+          "  from: [0, 50, -500]\n"
+          "  to: [0, 0, 0]\n"
+          "  up: [0, 1, 0]\n"
+          "- add: light\n"
+          "  at: [-10, 100, -10]\n"
+          "  intensity: [1, 1, 1]\n"
+          "- add: plane\n"
+          "  material:\n"
+          "    pattern:\n"
+          "      type: checkers\n"
+          "      colors: [[1, 1, 1], [0, 0, 0]]\n";
+    const char *patterns[] = {"stripes", "gradient", "rings",
+                              "radial-gradient"};
+    for (unsigned i = 0; i < 4; i++)
+      os << "- define: material-" << i << "\n"
+         << "  value:\n"
+            "    diffuse: 0.7\n"
+            "    specular: 0.3\n"
+            "    pattern:\n"
+            "      type: "
+         << patterns[i] << "\n"
+         << "      colors: [[0.1, 0.8, 0.1], [0.5, 0.8, 0.5]]\n"
+            "      transform: [[scale, 0.15, 0.15, 0.15]]\n";
+    for (unsigned i = 0; i < N; i++)
+      os << "- add: sphere\n"
+         << "  material: material-" << i % 4 << "\n"
+         << "  transform:\n"
+         << "    - [scale, " << 0.2 + 0.001 * (i % 100) << ", 0.3, 0.4]\n"
+         << "    - [rotate-y, " << 0.0001 * i << "]\n"
+         << "    - [translate, " << 0.01 * ratrac::getRandomData() * (i % 300)
+         << ", 1, " << double(i / 300) << "]\n";
+    return os.str();
+  }();
+  return text;
+}
+
+void BM_Scene_Parse(benchmark::State &state) {
+  const std::string &text = getSceneText();
+  for (auto _ : state) {
+    Scene scene;
+    if (!ratrac::parse_scene(text.data(), text.data() + text.size(), scene))
+      state.SkipWithError("Scene parsing failed");
+    benchmark::DoNotOptimize(scene);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+  state.SetItemsProcessed(state.iterations() * N);
+}
+} // namespace
+
+BENCHMARK(BM_Scene_Parse)->Unit(benchmark::kMillisecond);
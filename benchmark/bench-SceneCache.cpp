@@ -0,0 +1,88 @@
+#include "ratrac/Matrix.h"
+#include "ratrac/SceneCache.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using ratrac::Matrix;
+using ratrac::Plane;
+using ratrac::Point;
+using ratrac::RayTracerDataType;
+using ratrac::Sphere;
+using ratrac::TriangleMesh;
+using ratrac::Tuple;
+using ratrac::World;
+
+namespace {
+// The scene is a floor, state.range(0) x state.range(0) rotated and scaled
+// spheres, and a bumpy mesh of 2 x state.range(0)^2 triangles. Setting it up
+// procedurally, including the BVH builds, is compared to loading it from its
+// scene cache.
+World getWorld(unsigned n) {
+  World world;
+  world.append(new Plane());
+  for (unsigned i = 0; i < n; i++)
+    for (unsigned j = 0; j < n; j++) {
+      Sphere *s = new Sphere();
+      s->transform(Matrix::translation(i, 1, j) * Matrix::rotation_y(0.1 * i) *
+                   Matrix::scaling(0.2, 0.1 + 0.01 * (j % 10), 0.3));
+      world.append(s);
+    }
+
+  std::vector<Tuple> vertices;
+  for (unsigned j = 0; j <= n; j++)
+    for (unsigned i = 0; i <= n; i++)
+      vertices.push_back(
+          Point(i, 0.001 * ratrac::getRandomData(), RayTracerDataType(j)));
+  std::vector<unsigned> indices;
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned i = 0; i < n; i++) {
+      const unsigned v = j * (n + 1) + i;
+      indices.insert(indices.end(),
+                     {v, v + 1, v + n + 2, v, v + n + 2, v + n + 1});
+    }
+  world.append(new TriangleMesh(std::move(vertices), std::move(indices)));
+
+  // Build the world's acceleration structure.
+  world.bvh();
+  return world;
+}
+
+void BM_Scene_Build(benchmark::State &state) {
+  for (auto _ : state) {
+    World world = getWorld(state.range(0));
+    benchmark::DoNotOptimize(world);
+  }
+}
+
+void BM_Scene_LoadCache(benchmark::State &state) {
+  const std::string filename =
+      (std::filesystem::temp_directory_path() / "ratrac-bench.cache").string();
+  if (!ratrac::save_scene(getWorld(state.range(0)), filename)) {
+    state.SkipWithError("The scene cache could not be saved");
+    return;
+  }
+  for (auto _ : state) {
+    World world;
+    if (!ratrac::load_scene(world, filename))
+      state.SkipWithError("The scene cache could not be loaded");
+    benchmark::DoNotOptimize(world);
+  }
+  std::remove(filename.c_str());
+}
+} // namespace
+
+BENCHMARK(BM_Scene_Build)->Arg(100)->Arg(300)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Scene_LoadCache)
+    ->Arg(100)
+    ->Arg(300)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,79 @@
+#include "ratrac/Intersections.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/Tuple.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <limits>
+#include <vector>
+
+using ratrac::Intersection;
+using ratrac::Point;
+using ratrac::Ray;
+using ratrac::RayTracerDataType;
+using ratrac::TriangleMesh;
+using ratrac::Tuple;
+
+namespace {
+// The meshes are bumpy state.range(0) x state.range(0) grids of quads, split
+// in 2 faces each, over [0:1]x[0:1], which random rays are shot at from above.
+const unsigned NUM_RAYS = 1024;
+
+TriangleMesh getGrid(unsigned n) {
+  std::vector<Tuple> vertices;
+  for (unsigned j = 0; j <= n; j++)
+    for (unsigned i = 0; i <= n; i++)
+      vertices.push_back(
+          Point(RayTracerDataType(i) / n,
+                0.1 * ratrac::getRandomData() / (1000 * n),
+                RayTracerDataType(j) / n));
+  std::vector<unsigned> indices;
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned i = 0; i < n; i++) {
+      const unsigned v = j * (n + 1) + i;
+      indices.insert(indices.end(), {v, v + 1, v + n + 2});
+      indices.insert(indices.end(), {v, v + n + 2, v + n + 1});
+    }
+  return TriangleMesh(vertices, indices);
+}
+
+std::vector<Ray> getRays() {
+  std::vector<Ray> rays;
+  const Tuple from = Point(0.5, 2, -1);
+  for (unsigned i = 0; i < NUM_RAYS; i++) {
+    RayTracerDataType x, z;
+    ratrac::getRandomData(x, z);
+    // Random data is in [-1000:1000].
+    const Tuple to = Point((x + 1000) / 2000, 0, (z + 1000) / 2000);
+    rays.push_back(Ray(from, normalize(to - from)));
+  }
+  return rays;
+}
+
+void BM_TriangleMesh_Build(benchmark::State &state) {
+  for (auto _ : state) {
+    TriangleMesh mesh = getGrid(state.range(0));
+    benchmark::DoNotOptimize(mesh);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * state.range(0) *
+                          state.range(0));
+}
+
+void BM_TriangleMesh_ClosestHit(benchmark::State &state) {
+  const TriangleMesh mesh = getGrid(state.range(0));
+  const std::vector<Ray> rays = getRays();
+  unsigned i = 0;
+  for (auto _ : state) {
+    Intersection hit(std::numeric_limits<RayTracerDataType>::infinity(),
+                     nullptr);
+    mesh.closest_hit(rays[i++ % NUM_RAYS], hit);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+BENCHMARK(BM_TriangleMesh_Build)->Arg(10)->Arg(100);
+BENCHMARK(BM_TriangleMesh_ClosestHit)->Arg(10)->Arg(100)->Arg(1000);
@@ -1,11 +1,15 @@
 #include "ratrac/Tuple.h"
 #include "bench-ratrac.h"
+#include "ratrac/SIMD.h"
 #include "ratrac/ratrac.h"
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using ratrac::RayTracerDataType;
 using ratrac::Tuple;
+namespace simd = ratrac::simd;
 
 namespace {
 Tuple getRandomTuple() {
@@ -120,6 +124,51 @@ void BM_Tuple_Reflect2(benchmark::State &state) {
   }
 }
 
+// ================================================================
+// Vector kernels benchmarking: the scalar kernels against the ones selected
+// at compile time. The tuples are generated upfront, as pausing the timers
+// would cost more than the kernels themselves.
+const unsigned NUM_TUPLES = 256;
+
+std::vector<Tuple> getRandomTuples() {
+  std::vector<Tuple> tuples;
+  for (unsigned i = 0; i < NUM_TUPLES; i++)
+    tuples.push_back(getRandomTuple());
+  return tuples;
+}
+
+template <class KernelTy>
+void BM_Tuple_Kernel(benchmark::State &state, KernelTy kernel) {
+  const std::vector<Tuple> tuples = getRandomTuples();
+  unsigned i = 0;
+  for (auto _ : state) {
+    Tuple T = tuples[i % NUM_TUPLES];
+    kernel(T, tuples[(i + 1) % NUM_TUPLES]);
+    benchmark::DoNotOptimize(T);
+    i++;
+  }
+  state.SetLabel(simd::native::name());
+}
+
+void BM_Tuple_Add_Scalar(benchmark::State &state) {
+  BM_Tuple_Kernel(state, [](Tuple &a, const Tuple &b) {
+    simd::scalar::add4(a.data(), b.data());
+  });
+}
+
+void BM_Tuple_Add_Native(benchmark::State &state) {
+  BM_Tuple_Kernel(state, [](Tuple &a, const Tuple &b) { a += b; });
+}
+
+void BM_Tuple_Scale_Scalar(benchmark::State &state) {
+  BM_Tuple_Kernel(state, [](Tuple &a, const Tuple &b) {
+    simd::scalar::mul4(a.data(), b.x());
+  });
+}
+
+void BM_Tuple_Scale_Native(benchmark::State &state) {
+  BM_Tuple_Kernel(state, [](Tuple &a, const Tuple &b) { a *= b.x(); });
+}
 } // namespace
 
 BENCHMARK(BM_Tuple_Magnitude);
@@ -132,4 +181,11 @@ BENCHMARK(BM_Tuple_Magnitude2);
 BENCHMARK(BM_Tuple_Normalize2);
 BENCHMARK(BM_Tuple_Dot2);
 BENCHMARK(BM_Tuple_Cross2);
-BENCHMARK(BM_Tuple_Reflect2);
\ No newline at end of file
+BENCHMARK(BM_Tuple_Reflect2);
+
+// ================================================================
+// Vector kernels benchmarking.
+BENCHMARK(BM_Tuple_Add_Scalar);
+BENCHMARK(BM_Tuple_Add_Native);
+BENCHMARK(BM_Tuple_Scale_Scalar);
+BENCHMARK(BM_Tuple_Scale_Native);
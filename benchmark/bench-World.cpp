@@ -0,0 +1,241 @@
+#include "ratrac/Intersections.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/ShapeArrays.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+#include "bench-ratrac.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using ratrac::Accelerator;
+using ratrac::Intersection;
+using ratrac::Matrix;
+using ratrac::Plane;
+using ratrac::Ray;
+using ratrac::RayTracerDataType;
+using ratrac::ShapeArrays;
+using ratrac::Sphere;
+using ratrac::World;
+
+namespace {
+// The queries are benchmarked on a floor plane with a grid of state.range(0) x
+// state.range(0) spheres over it, of various sizes and scales. Worlds of 4x4
+// spheres or more use a BVH. The rays are shot from above the grid, towards
+// random points of the floor.
+const unsigned NUM_RAYS = 1024;
+
+World getWorld(unsigned n, std::vector<Sphere *> *spheres = nullptr) {
+  World world;
+  Plane *floor = new Plane();
+  floor->transform(Matrix::translation(0, -1, 0));
+  world.append(floor);
+  for (unsigned i = 0; i < n; i++)
+    for (unsigned j = 0; j < n; j++) {
+      Sphere *s = new Sphere();
+      const RayTracerDataType r = 0.3 + 0.1 * ((i + 2 * j) % 5);
+      s->transform(Matrix::translation(2 * i, 0, 2 * j) *
+                   Matrix::scaling(r, (i + j) % 2 ? r : 0.5 * r, r));
+      world.append(s);
+      if (spheres)
+        spheres->push_back(s);
+    }
+  return world;
+}
+
+std::vector<Ray> getRays(unsigned n) {
+  std::vector<Ray> rays;
+  const ratrac::Tuple from = ratrac::Point(n - 1, 2 * n, -2.0 * n);
+  for (unsigned i = 0; i < NUM_RAYS; i++) {
+    RayTracerDataType x, z;
+    ratrac::getRandomData(x, z);
+    // Random data is in [-1000:1000].
+    const ratrac::Tuple to =
+        ratrac::Point((x + 1000) * n / 1000 - 1, -1, (z + 1000) * n / 1000 - 1);
+    rays.push_back(Ray(from, normalize(to - from)));
+  }
+  return rays;
+}
+
+void BM_World_ClosestHit(benchmark::State &state) {
+  const World world = getWorld(state.range(0));
+  const std::vector<Ray> rays = getRays(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Intersection hit = world.closest_hit(rays[i++ % NUM_RAYS]);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_World_Occluded(benchmark::State &state) {
+  const World world = getWorld(state.range(0));
+  const std::vector<Ray> rays = getRays(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    bool occluded = world.occluded(rays[i++ % NUM_RAYS], 1000);
+    benchmark::DoNotOptimize(occluded);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// An animation frame where one sphere in a hundred moves: the acceleration
+// structure is either refitted or rebuilt, then queried once.
+template <bool Refit> void BM_World_Animate(benchmark::State &state) {
+  std::vector<Sphere *> spheres;
+  World world = getWorld(state.range(0), &spheres);
+  const std::vector<Ray> rays = getRays(state.range(0));
+  const Matrix up = Matrix::translation(0, 0.01, 0);
+  unsigned i = 0, frame = 0;
+  for (auto _ : state) {
+    std::vector<unsigned> moved;
+    for (unsigned s = frame++ % 100; s < spheres.size(); s += 100) {
+      spheres[s]->transform(up * spheres[s]->transform());
+      // The floor is object 0.
+      moved.push_back(s + 1);
+    }
+    if (Refit)
+      world.refit(moved);
+    else
+      world.invalidate();
+    Intersection hit = world.closest_hit(rays[i++ % NUM_RAYS]);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_World_Refit(benchmark::State &state) {
+  BM_World_Animate<true>(state);
+}
+
+void BM_World_Rebuild(benchmark::State &state) {
+  BM_World_Animate<false>(state);
+}
+
+// A cloud of state.range(0) particles: spheres of similar sizes, evenly
+// distributed in a cube whose size grows with their number, so that their
+// density is constant. The rays are shot from a corner of the cube towards
+// random points of the opposite faces.
+World getParticles(unsigned n, Accelerator accelerator) {
+  World world;
+  world.accelerator(accelerator);
+  const RayTracerDataType side = 4 * std::cbrt(RayTracerDataType(n));
+  for (unsigned i = 0; i < n; i++) {
+    RayTracerDataType x, y, z, r;
+    ratrac::getRandomData(x, y, z, r);
+    Sphere *s = new Sphere();
+    // Random data is in [-1000:1000].
+    s->transform(Matrix::translation(x * side / 2000, y * side / 2000,
+                                     z * side / 2000) *
+                 Matrix::scaling(0.5 + r / 4000, 0.5 + r / 4000,
+                                 0.5 + r / 4000));
+    world.append(s);
+  }
+  return world;
+}
+
+std::vector<Ray> getParticleRays(unsigned n) {
+  std::vector<Ray> rays;
+  const RayTracerDataType side = 4 * std::cbrt(RayTracerDataType(n));
+  const ratrac::Tuple from = ratrac::Point(-side, -side, -side);
+  for (unsigned i = 0; i < NUM_RAYS; i++) {
+    RayTracerDataType u, v;
+    ratrac::getRandomData(u, v);
+    const RayTracerDataType s = side / 2, a = u * s / 1000, b = v * s / 1000;
+    const ratrac::Tuple to = i % 3 == 0   ? ratrac::Point(s, a, b)
+                             : i % 3 == 1 ? ratrac::Point(a, s, b)
+                                          : ratrac::Point(a, b, s);
+    rays.push_back(Ray(from, normalize(to - from)));
+  }
+  return rays;
+}
+
+template <Accelerator A> void BM_Particles_Build(benchmark::State &state) {
+  World world = getParticles(state.range(0), A);
+  for (auto _ : state) {
+    world.invalidate();
+    if (A == Accelerator::BVH)
+      benchmark::DoNotOptimize(world.bvh());
+    else
+      benchmark::DoNotOptimize(world.grid());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The BVH build of state.range(0) particles, with state.range(1) threads.
+void BM_Particles_ParallelBuild(benchmark::State &state) {
+  World world = getParticles(state.range(0), Accelerator::BVH);
+  for (auto _ : state) {
+    world.invalidate();
+    world.prepare(state.range(1));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <Accelerator A>
+void BM_Particles_ClosestHit(benchmark::State &state) {
+  const World world = getParticles(state.range(0), A);
+  // Build the world's acceleration structure.
+  world.closest_hit(Ray(ratrac::Point(0, 0, 0), ratrac::Vector(0, 0, 1)));
+  const std::vector<Ray> rays = getParticleRays(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Intersection hit = world.closest_hit(rays[i++ % NUM_RAYS]);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// The brute force reference: all particles are tested, though in the tight
+// loops of ShapeArrays.
+void BM_Particles_ClosestHit_BruteForce(benchmark::State &state) {
+  const World world = getParticles(state.range(0), Accelerator::BVH);
+  std::vector<const ratrac::Shape *> shapes;
+  for (const auto &o : world.objects())
+    shapes.push_back(o.get());
+  const ShapeArrays arrays(shapes);
+  const std::vector<Ray> rays = getParticleRays(state.range(0));
+  unsigned i = 0;
+  for (auto _ : state) {
+    Intersection hit(std::numeric_limits<RayTracerDataType>::infinity(),
+                     nullptr);
+    arrays.closest_hit(rays[i++ % NUM_RAYS], hit);
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+BENCHMARK(BM_World_ClosestHit)->Arg(2)->Arg(3)->Arg(10)->Arg(30);
+BENCHMARK(BM_World_Occluded)->Arg(2)->Arg(3)->Arg(10)->Arg(30);
+BENCHMARK(BM_World_Refit)->Arg(10)->Arg(30)->Arg(100);
+BENCHMARK(BM_World_Rebuild)->Arg(10)->Arg(30)->Arg(100);
+BENCHMARK_TEMPLATE(BM_Particles_Build, Accelerator::BVH)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Particles_Build, Accelerator::GRID)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Particles_ParallelBuild)
+    ->ArgsProduct({{100000, 1000000}, {1, 2, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Particles_ClosestHit_BruteForce)->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Particles_ClosestHit, Accelerator::BVH)
+    ->Arg(1000)
+    ->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Particles_ClosestHit, Accelerator::WIDE_BVH)
+    ->Arg(1000)
+    ->Arg(100000);
+BENCHMARK_TEMPLATE(BM_Particles_ClosestHit, Accelerator::GRID)
+    ->Arg(1000)
+    ->Arg(100000);
@@ -7,6 +7,8 @@
 
 namespace ratrac {
 
+class World;
+
 /** Provide a common ground for all our ratrac applications as they are all
  * using the same options to set canvas size, verbosity, ....
  *
@@ -17,6 +19,9 @@ namespace ratrac {
  *   --height=H, -h H      Set canvas height to H
  *   --output=F, -o F      Save output to filename F
  *   --format=T, -f T      Save output in image format T: PPM or PNG (if support built in)
+ *   --threads=N, -j N     Render with N threads (0: one per hardware thread)
+ *   --packet=WxH, -p WxH  Trace primary rays in packets of WxH pixels
+ *   --cache=F, -c F       Load the scene from cache F, or save it there
  */
 class App : public ArgParse {
 public:
@@ -41,6 +46,21 @@ public:
   size_t width() const { return m_width; }
   size_t height() const { return m_height; }
 
+  unsigned threads() const { return m_threads; }
+
+  unsigned packet_width() const { return m_packet_width; }
+  unsigned packet_height() const { return m_packet_height; }
+
+  /** The scene cache file, empty if none was given. */
+  const std::string &cacheFilename() const { return m_cacheFilename; }
+
+  /** Load world from the scene cache. Returns false if there is no cache, or
+   * if it could not be loaded (e.g. it does not exist yet): the application
+   * then builds its world, and saves it with save_scene. */
+  bool load_scene(World &world) const;
+  /** Save world to the scene cache, if there is one. */
+  void save_scene(const World &world) const;
+
   std::string parameters() const;
 
   void save(const Canvas &C) const;
@@ -50,6 +70,10 @@ private:
   OutputFormat m_outputFormat;
   size_t m_width;
   size_t m_height;
+  unsigned m_threads;
+  unsigned m_packet_width;
+  unsigned m_packet_height;
+  std::string m_cacheFilename;
   unsigned m_verbosity;
 };
 
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <cassert>
+#include <limits>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace ratrac {
+
+/** A bounding volume hierarchy over a set of primitives, each of them being
+ * described by its bounding box. The hierarchy is built top-down, with the
+ * split planes chosen with a binned surface area heuristic (SAH). The build
+ * can run in parallel: the top levels are split with parallel binning and
+ * partitioning, and the subtrees below them are built as parallel tasks.
+ *
+ * The BVH only knows about primitive indices, so it can be used over a
+ * World's shapes as well as over any other set of boxes.
+ */
+class BVH {
+public:
+  typedef RayTracerDataType DataType;
+
+  /** Nodes are stored in depth first order: the left child of an interior
+   * node immediately follows it, and offset is the index of its right child.
+   * For leaves, offset is the index of their first primitive in indices().
+   *
+   * Nodes take 32 bytes, 2 per cache line: their box is stored in single
+   * precision, rounded outwards so that it still contains the boxes it was
+   * fitted to. Interior nodes record the axis they were split along, their
+   * left child holding the primitives with the lower centroids, so that the
+   * traversals can visit the child nearer to the ray origin first.
+   */
+  struct Node {
+    float min[3];
+    float max[3];
+    unsigned offset;
+    unsigned count : 30; // Number of primitives, 0 for interior nodes.
+    unsigned axis : 2;
+
+    Node() : Node(BoundingBox(), 0, 0) {}
+    Node(const BoundingBox &b, unsigned offset, unsigned count,
+         unsigned axis = 0)
+        : min(), max(), offset(offset), count(count), axis(axis) {
+      box(b);
+    }
+
+    bool is_leaf() const { return count != 0; }
+
+    BoundingBox box() const {
+      return BoundingBox(Point(min[0], min[1], min[2]),
+                         Point(max[0], max[1], max[2]));
+    }
+    /** Set this node's box to the smallest single precision box containing
+     * b. */
+    void box(const BoundingBox &b);
+
+    /** Slab test, as BoundingBox::intersects(const SlabRay &, ...). */
+    bool intersects(const SlabRay &r, DataType tmin, DataType tmax) const {
+      for (unsigned i = 0; i < 3; i++) {
+        const DataType t0 =
+            (DataType(r.sign[i] ? max[i] : min[i]) - r.origin[i]) *
+            r.inv_direction[i];
+        const DataType t1 =
+            (DataType(r.sign[i] ? min[i] : max[i]) - r.origin[i]) *
+            r.inv_direction[i];
+        // Written so that NaNs (0 * inf) leave the interval unchanged.
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmax < tmin)
+          return false;
+      }
+      return true;
+    }
+
+    /** Packet slab test, as BoundingBox::intersects(const SlabPacket &, ...).
+     */
+    unsigned intersects(const SlabPacket &r, DataType tmin,
+                        const DataType *tmax, unsigned mask) const {
+      DataType lmin[RayPacket::SIZE], lmax[RayPacket::SIZE];
+      for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+        lmin[l] = tmin;
+        lmax[l] = tmax[l];
+      }
+      for (unsigned i = 0; i < 3; i++) {
+        const DataType lo = min[i];
+        const DataType hi = max[i];
+        for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+          const DataType inv = r.inv_direction[i][l];
+          const DataType tlo = (lo - r.origin[i][l]) * inv;
+          const DataType thi = (hi - r.origin[i][l]) * inv;
+          const DataType t0 = inv < 0 ? thi : tlo;
+          const DataType t1 = inv < 0 ? tlo : thi;
+          lmin[l] = t0 > lmin[l] ? t0 : lmin[l];
+          lmax[l] = t1 < lmax[l] ? t1 : lmax[l];
+        }
+      }
+      bool hit[RayPacket::SIZE];
+      for (unsigned l = 0; l < RayPacket::SIZE; l++)
+        hit[l] = !(lmax[l] < lmin[l]);
+      unsigned result = 0;
+      for (unsigned l = 0; l < RayPacket::SIZE; l++)
+        result |= unsigned(hit[l]) << l;
+      return result & mask;
+    }
+  };
+
+  static constexpr unsigned MAX_LEAF_SIZE = 4;
+  static constexpr unsigned MAX_DEPTH = 64;
+
+  BVH() : m_nodes(), m_indices(), m_parents(), m_leaves() {}
+
+  /** Build a BVH over the primitives whose bounding boxes are in boxes, with
+   * threads parallel workers. The tree is the same whatever the number of
+   * threads. */
+  explicit BVH(const std::vector<BoundingBox> &boxes, unsigned threads = 1);
+
+  /** Adopt the nodes and primitive indices of a BVH built earlier, e.g. one
+   * saved in a scene cache. They are used as is, without any check. */
+  BVH(std::vector<Node> nodes, std::vector<unsigned> indices)
+      : m_nodes(std::move(nodes)), m_indices(std::move(indices)), m_parents(),
+        m_leaves() {}
+
+  /** Number of primitives in this BVH. */
+  size_t size() const { return m_indices.size(); }
+  bool empty() const { return m_indices.empty(); }
+
+  const std::vector<Node> &nodes() const { return m_nodes; }
+  const std::vector<unsigned> &indices() const { return m_indices; }
+
+  /** Returns the bounding box of all primitives. */
+  BoundingBox bounds() const {
+    return m_nodes.empty() ? BoundingBox() : m_nodes[0].box();
+  }
+
+  /** Call visit(primitive) for each primitive whose box is hit by ray r for
+   * some t in [tmin:tmax]. The visitor returns true to stop the traversal.
+   * tmax is re-read for each node, so a visitor looking for the closest hit
+   * can shrink it as it finds intersections: the children are visited in the
+   * direction of the ray along their parent's split axis, the nearer first,
+   * so that the farther ones are more often culled. */
+  template <class VisitorTy>
+  void traverse(const Ray &r, DataType tmin, const DataType &tmax,
+                VisitorTy visit) const {
+    if (m_nodes.empty())
+      return;
+
+    const SlabRay sr(r);
+    unsigned stack[MAX_DEPTH];
+    unsigned top = 0;
+    stack[top++] = 0;
+    while (top) {
+      const unsigned n = stack[--top];
+      const Node &node = m_nodes[n];
+      if (!node.intersects(sr, tmin, tmax))
+        continue;
+      if (node.is_leaf()) {
+        for (unsigned i = node.offset; i < node.offset + node.count; i++)
+          if (visit(m_indices[i]))
+            return;
+      } else {
+        assert(top + 2 <= MAX_DEPTH && "BVH is too deep");
+        const bool backwards = sr.sign[node.axis];
+        stack[top++] = backwards ? n + 1 : node.offset;
+        stack[top++] = backwards ? node.offset : n + 1;
+      }
+    }
+  }
+
+  /** Packet traversal: call visit(primitive, lanes) for each primitive whose
+   * box is hit by some lane of r in mask, for t in [tmin:tmax[lane]], with the
+   * mask of those lanes. Each lane sees the same sequence of primitives as a
+   * single ray traversal of its ray would, and tmax is re-read for each node:
+   * the lanes going in opposite directions along a node's split axis visit
+   * its children separately, each in their own order.
+   */
+  template <class VisitorTy>
+  void traverse(const RayPacket &r, DataType tmin, const DataType *tmax,
+                unsigned mask, VisitorTy visit) const {
+    if (m_nodes.empty() || !mask)
+      return;
+
+    const SlabPacket sp(r);
+    unsigned backwards[3] = {0, 0, 0};
+    for (unsigned a = 0; a < 3; a++)
+      for (unsigned l = 0; l < RayPacket::SIZE; l++)
+        backwards[a] |= unsigned(sp.inv_direction[a][l] < 0) << l;
+
+    // Each level of the tree leaves at most 3 entries on the stack.
+    struct Entry {
+      unsigned node;
+      unsigned mask;
+    } stack[3 * MAX_DEPTH + 1];
+    unsigned top = 0;
+    stack[top++] = {0, mask};
+    while (top) {
+      const Entry e = stack[--top];
+      const Node &node = m_nodes[e.node];
+      const unsigned lanes = node.intersects(sp, tmin, tmax, e.mask);
+      if (!lanes)
+        continue;
+      if (node.is_leaf()) {
+        for (unsigned i = node.offset; i < node.offset + node.count; i++)
+          visit(m_indices[i], lanes);
+      } else {
+        assert(top + 4 <= 3 * MAX_DEPTH + 1 && "BVH is too deep");
+        const unsigned back = lanes & backwards[node.axis];
+        const unsigned forth = lanes & ~back;
+        if (forth) {
+          stack[top++] = {node.offset, forth};
+          stack[top++] = {e.node + 1, forth};
+        }
+        if (back) {
+          stack[top++] = {e.node + 1, back};
+          stack[top++] = {node.offset, back};
+        }
+      }
+    }
+  }
+
+  /** Refit the nodes' boxes to boxes, the primitives' new bounding boxes,
+   * keeping the tree as it is: this is linear in the number of nodes, much
+   * cheaper than a rebuild, but the tree gets worse as the primitives move
+   * away from where it was built. */
+  void refit(const std::vector<BoundingBox> &boxes);
+
+  /** Same, when only the primitives in moved have a new box: only their
+   * leaves and the ancestors whose box changes are refitted, which costs
+   * O(depth) per moved primitive. The first partial refit records each
+   * node's parent. */
+  void refit(const std::vector<BoundingBox> &boxes,
+             const std::vector<unsigned> &moved);
+
+  /** Returns the depth of the tree. */
+  unsigned depth() const;
+
+  /** Returns the SAH cost of the tree, relative to the cost of intersecting
+   * a primitive: it increases as refits degrade the tree. */
+  DataType cost() const;
+
+private:
+  BoundingBox fit(unsigned node, const std::vector<BoundingBox> &boxes) const;
+
+  std::vector<Node> m_nodes;
+  std::vector<unsigned> m_indices;
+  // For the partial refits: the parent of each node, and the leaf of each
+  // primitive.
+  std::vector<unsigned> m_parents;
+  std::vector<unsigned> m_leaves;
+};
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::BVH &bvh);
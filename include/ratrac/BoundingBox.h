@@ -0,0 +1,211 @@
+#pragma once
+
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+#include <string>
+
+namespace ratrac {
+
+/** A ray prepared for slab tests against many boxes: the inverse of its
+ * direction and the direction signs are precomputed once. */
+struct SlabRay {
+  typedef Tuple::DataType DataType;
+
+  explicit SlabRay(const Ray &r)
+      : origin(r.origin()),
+        inv_direction(Vector(DataType(1) / r.direction().x(),
+                             DataType(1) / r.direction().y(),
+                             DataType(1) / r.direction().z())),
+        sign{inv_direction.x() < 0, inv_direction.y() < 0,
+             inv_direction.z() < 0} {}
+
+  Tuple origin;
+  Tuple inv_direction;
+  bool sign[3];
+};
+
+/** The lanes of a RayPacket prepared for slab tests, as SlabRay does for a
+ * single ray. The direction signs are not stored: the packet slab test
+ * computes the distances to both planes anyway, and picks them with the sign
+ * of inv_direction. */
+struct SlabPacket {
+  typedef RayPacket::DataType DataType;
+
+  explicit SlabPacket(const RayPacket &r) {
+    for (unsigned c = 0; c < 3; c++)
+      for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+        origin[c][i] = r.origin[c][i];
+        inv_direction[c][i] = DataType(1) / r.direction[c][i];
+      }
+  }
+
+  // Indexed by axis first, then by lane.
+  alignas(64) DataType origin[3][RayPacket::SIZE];
+  alignas(64) DataType inv_direction[3][RayPacket::SIZE];
+};
+
+/** An axis aligned bounding box, described by its min and max corners. A
+ * default constructed box is empty, and boxes can be infinite in some
+ * directions, e.g. for planes. */
+class BoundingBox {
+public:
+  typedef RayTracerDataType DataType;
+
+  /** Create an empty box. */
+  BoundingBox()
+      : m_min(Point(infinity(), infinity(), infinity())),
+        m_max(Point(-infinity(), -infinity(), -infinity())) {}
+  BoundingBox(const Tuple &min, const Tuple &max) : m_min(min), m_max(max) {}
+
+  /** Get a box covering all the space. */
+  static BoundingBox infinite() {
+    return BoundingBox(Point(-infinity(), -infinity(), -infinity()),
+                       Point(infinity(), infinity(), infinity()));
+  }
+
+  const Tuple &min() const { return m_min; }
+  const Tuple &max() const { return m_max; }
+
+  bool empty() const {
+    return m_min.x() > m_max.x() || m_min.y() > m_max.y() ||
+           m_min.z() > m_max.z();
+  }
+
+  bool is_finite() const {
+    for (unsigned i = 0; i < 3; i++)
+      if (!std::isfinite(m_min[i]) || !std::isfinite(m_max[i]))
+        return false;
+    return true;
+  }
+
+  bool operator==(const BoundingBox &rhs) const {
+    return m_min == rhs.m_min && m_max == rhs.m_max;
+  }
+  bool operator!=(const BoundingBox &rhs) const { return !(*this == rhs); }
+
+  /** Grow this box so it contains point. */
+  BoundingBox &add(const Tuple &point) {
+    for (unsigned i = 0; i < 3; i++) {
+      m_min[i] = std::min(m_min[i], point[i]);
+      m_max[i] = std::max(m_max[i], point[i]);
+    }
+    return *this;
+  }
+
+  /** Grow this box so it contains box. */
+  BoundingBox &add(const BoundingBox &box) {
+    for (unsigned i = 0; i < 3; i++) {
+      m_min[i] = std::min(m_min[i], box.m_min[i]);
+      m_max[i] = std::max(m_max[i], box.m_max[i]);
+    }
+    return *this;
+  }
+
+  bool contains(const Tuple &point) const {
+    for (unsigned i = 0; i < 3; i++)
+      if (point[i] < m_min[i] || point[i] > m_max[i])
+        return false;
+    return true;
+  }
+
+  Tuple centroid() const {
+    return Point((m_min.x() + m_max.x()) / 2, (m_min.y() + m_max.y()) / 2,
+                 (m_min.z() + m_max.z()) / 2);
+  }
+
+  Tuple extent() const { return m_max - m_min; }
+
+  /** Returns the index (0: x, 1: y, 2: z) of the longest axis of this box. */
+  unsigned longest_axis() const {
+    Tuple e = extent();
+    if (e.x() >= e.y() && e.x() >= e.z())
+      return 0;
+    return e.y() >= e.z() ? 1 : 2;
+  }
+
+  DataType surface_area() const {
+    if (empty())
+      return DataType();
+    Tuple e = extent();
+    return 2 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+  }
+
+  /** Slab test: does ray r cross this box for some t in [tmin:tmax] ? */
+  bool intersects(const SlabRay &r, DataType tmin, DataType tmax) const {
+    for (unsigned i = 0; i < 3; i++) {
+      DataType t0 = ((r.sign[i] ? m_max : m_min)[i] - r.origin[i]) *
+                    r.inv_direction[i];
+      DataType t1 = ((r.sign[i] ? m_min : m_max)[i] - r.origin[i]) *
+                    r.inv_direction[i];
+      // Written so that NaNs (0 * inf) leave the interval unchanged.
+      tmin = t0 > tmin ? t0 : tmin;
+      tmax = t1 < tmax ? t1 : tmax;
+      if (tmax < tmin)
+        return false;
+    }
+    return true;
+  }
+
+  bool intersects(const Ray &r, DataType tmin, DataType tmax) const {
+    return intersects(SlabRay(r), tmin, tmax);
+  }
+
+  /** Slab test of the lanes of r in mask, each lane i over [tmin:tmax[i]].
+   * Returns the mask of the lanes crossing this box, with the same results as
+   * the single ray test. */
+  unsigned intersects(const SlabPacket &r, DataType tmin, const DataType *tmax,
+                      unsigned mask) const {
+    // The interval shrinks monotonically, so checking it once all 3 slabs
+    // are done is the same as the single ray test early exits. The loops
+    // over the lanes are vectorized.
+    DataType lmin[RayPacket::SIZE], lmax[RayPacket::SIZE];
+    for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+      lmin[l] = tmin;
+      lmax[l] = tmax[l];
+    }
+    for (unsigned i = 0; i < 3; i++) {
+      const DataType lo = m_min[i];
+      const DataType hi = m_max[i];
+      for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+        const DataType inv = r.inv_direction[i][l];
+        const DataType tlo = (lo - r.origin[i][l]) * inv;
+        const DataType thi = (hi - r.origin[i][l]) * inv;
+        const DataType t0 = inv < 0 ? thi : tlo;
+        const DataType t1 = inv < 0 ? tlo : thi;
+        lmin[l] = t0 > lmin[l] ? t0 : lmin[l];
+        lmax[l] = t1 < lmax[l] ? t1 : lmax[l];
+      }
+    }
+    bool hit[RayPacket::SIZE];
+    for (unsigned l = 0; l < RayPacket::SIZE; l++)
+      hit[l] = !(lmax[l] < lmin[l]);
+    unsigned result = 0;
+    for (unsigned l = 0; l < RayPacket::SIZE; l++)
+      result |= unsigned(hit[l]) << l;
+    return result & mask;
+  }
+
+  /** Returns the box containing this box transformed by M. Boxes which are not
+   * finite are conservatively transformed to an infinite box. */
+  BoundingBox transform(const Matrix &M) const;
+
+  explicit operator std::string() const;
+
+private:
+  static constexpr DataType infinity() {
+    return std::numeric_limits<DataType>::infinity();
+  }
+
+  Tuple m_min;
+  Tuple m_max;
+};
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::BoundingBox &B);
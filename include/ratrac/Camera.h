@@ -3,16 +3,27 @@
 #include "ratrac/Canvas.h"
 #include "ratrac/Matrix.h"
 #include "ratrac/Ray.h"
+#include "ratrac/Scheduler.h"
 #include "ratrac/Transformable.h"
 #include "ratrac/Tuple.h"
 #include "ratrac/World.h"
 #include "ratrac/ratrac.h"
 
+#include <cassert>
+
 namespace ratrac {
 Matrix view_transform(const Tuple &from, const Tuple &to, const Tuple &up);
 
 class Camera : public Transformable {
 public:
+  typedef RayTracerDataType DataType;
+
+  static const unsigned TILE_SIZE = 16;
+
+  /** Size of the tiles rendered in wavefront mode, whose pixels go through
+   * each stage together. */
+  static const unsigned WAVEFRONT_TILE_SIZE = 64;
+
   Camera(unsigned hsize, unsigned vsize, RayTracerDataType fov);
 
   unsigned hsize() const { return m_hsize; }
@@ -22,11 +33,75 @@ public:
 
   Ray ray_for_pixel(unsigned px, unsigned py) const;
 
-  Canvas render(const World &w, bool verbose) const;
+  /** Returns the rays for the block of width x height pixels starting at
+   * (px, py), with width * height <= RayPacket::SIZE: lane dy * width + dx
+   * gets ray_for_pixel(px + dx, py + dy), bit for bit. The lanes past the
+   * block get the rays of the pixels which follow it. */
+  RayPacket rays_for_pixels(unsigned px, unsigned py, unsigned width,
+                            unsigned height) const;
+
+  /** Store the direction of the primary ray of each pixel (x[i], y[i]), for
+   * i in [0:n[, in direction[0:4][i], component by component: it is the
+   * direction of ray_for_pixel, bit for bit. All primary rays start at
+   * origin(). */
+  void directions_for_pixels(const DataType *x, const DataType *y, size_t n,
+                             DataType *const direction[4]) const;
+  const Tuple &origin() const { return m_origin; }
+
+  /** Primary rays are traced in packets of width x height neighbouring
+   * pixels, which must fit in a RayPacket. 1x1 packets trace each ray on its
+   * own. The image does not depend on the packet size, only the rendering
+   * speed does. */
+  Camera &packet_size(unsigned width, unsigned height) {
+    assert(width >= 1 && height >= 1 && width * height <= RayPacket::SIZE &&
+           "Packet does not fit in a RayPacket");
+    m_packet_width = width;
+    m_packet_height = height;
+    return *this;
+  }
+  unsigned packet_width() const { return m_packet_width; }
+  unsigned packet_height() const { return m_packet_height; }
+
+  /** In wavefront mode, the canvas is rendered by WAVEFRONT_TILE_SIZE x
+   * WAVEFRONT_TILE_SIZE tiles, each going through the stages of a Wavefront
+   * pipeline: all the primary hits of a tile are collected first, then,
+   * light by light, their shadow rays are sorted by direction octant and
+   * origin cell, and traced in that order, so that consecutive shadow rays
+   * visit the same parts of the acceleration structure. This pays off for
+   * large scenes, which do not fit in the caches. The image is the same as in
+   * the default, pixel by pixel, mode. */
+  Camera &wavefront(bool enable) {
+    m_wavefront = enable;
+    return *this;
+  }
+  bool wavefront() const { return m_wavefront; }
+
+  /** Render world w to a canvas. When threads is greater than 1, the canvas
+   * is split in TILE_SIZE x TILE_SIZE tiles, or WAVEFRONT_TILE_SIZE ones in
+   * wavefront mode, which are rendered concurrently by a pool of threads
+   * workers. Each pixel is computed exactly as in the serial path, so the
+   * resulting image is identical whatever the number of threads. The
+   * acceleration structure of w is built before the rendering starts: w must
+   * not be modified until it returns (see World::invalidate). */
+  Canvas render(const World &w, bool verbose, unsigned threads = 1) const;
+
+  /** Render world w to a canvas, with the tiles executed by scheduler. The
+   * scheduler statistics (steals, busy time) are available after the
+   * rendering for inspection. */
+  Canvas render(const World &w, TaskScheduler &scheduler, bool verbose) const;
 
   void update() { m_origin = inverse_transform(Point(0, 0, 0)); }
 
 private:
+  /** Render the pixels in [x0:x1[ x [y0:y1[ to image. */
+  void render_tile(const World &w, Canvas &image, unsigned x0, unsigned y0,
+                   unsigned x1, unsigned y1) const;
+
+  /** Returns the size of the tiles, for the current mode. */
+  unsigned tile_size() const {
+    return m_wavefront ? WAVEFRONT_TILE_SIZE : TILE_SIZE;
+  }
+
   Tuple m_origin;
   unsigned m_hsize;
   unsigned m_vsize;
@@ -34,6 +109,9 @@ private:
   RayTracerDataType m_half_width;
   RayTracerDataType m_half_height;
   RayTracerDataType m_pixel_size;
+  unsigned m_packet_width;
+  unsigned m_packet_height;
+  bool m_wavefront;
 };
 
 } // namespace ratrac
@@ -49,6 +49,10 @@ public:
     return m_color[ALPHA_idx];
   }
 
+  /** Direct access to the RGBA components, for the vector kernels. */
+  ColorType *data() noexcept { return m_color; }
+  constexpr const ColorType *data() const noexcept { return m_color; }
+
   // Operators
   // =========
 
@@ -64,6 +68,15 @@ public:
     return !operator==(rhs);
   }
 
+  /** Whether each channel is within epsilon of rhs's, for the colors which are
+   * not as accurate as operator== requires. */
+  constexpr bool close_to(const Color &rhs, ColorType epsilon) const noexcept {
+    return close_to_equal(red(), rhs.red(), epsilon) &&
+           close_to_equal(green(), rhs.green(), epsilon) &&
+           close_to_equal(blue(), rhs.blue(), epsilon) &&
+           close_to_equal(alpha(), rhs.alpha(), epsilon);
+  }
+
   // operations
 
   Color &operator+=(const Color &rhs) {
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace ratrac {
+
+/** A uniform grid over a set of primitives, each of them being described by
+ * its bounding box, as an alternative to the BVH for dense scenes of evenly
+ * distributed primitives of similar sizes (e.g. particles): it is built in
+ * linear time, in 2 passes over the boxes, and traversed cell by cell along
+ * the ray with a 3D-DDA.
+ *
+ * The resolution is chosen from the number of primitives and the bounds: the
+ * cells are cubes (as far as the bounds allow), about DENSITY times as many as
+ * the primitives, with at most MAX_RESOLUTION cells along each axis. The
+ * cells reference the primitives whose boxes overlap them, in contiguous
+ * ranges of a single index buffer.
+ *
+ * As the BVH, the grid only knows about primitive indices.
+ */
+class Grid {
+public:
+  typedef RayTracerDataType DataType;
+
+  static constexpr unsigned MAX_RESOLUTION = 256;
+  static constexpr DataType DENSITY = 2;
+
+  Grid()
+      : m_bounds(), m_resolution{0, 0, 0}, m_cell_size(), m_inv_cell_size(),
+        m_cells(), m_indices(), m_size(0) {}
+
+  /** Build a grid over the primitives whose bounding boxes are in boxes.
+   * The boxes must be finite. */
+  explicit Grid(const std::vector<BoundingBox> &boxes);
+
+  /** Number of primitives in this grid. */
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  /** Returns the bounding box of all primitives. */
+  const BoundingBox &bounds() const { return m_bounds; }
+
+  /** Number of cells along axis. */
+  unsigned resolution(unsigned axis) const { return m_resolution[axis]; }
+  unsigned num_cells() const {
+    return m_resolution[0] * m_resolution[1] * m_resolution[2];
+  }
+
+  /** Number of primitive references: a primitive is referenced by each cell
+   * its box overlaps. */
+  size_t num_references() const { return m_indices.size(); }
+
+  /** Call visit(primitive) for the primitives of each cell crossed by ray r
+   * for some t in [tmin:tmax], in the order the ray crosses the cells. The
+   * visitor returns true to stop the traversal. A primitive overlapping
+   * several cells is visited once per cell. tmax is re-read for each cell, so
+   * a visitor looking for the closest hit can shrink it as it finds
+   * intersections: the traversal stops at the first cell beyond it. */
+  template <class VisitorTy>
+  void traverse(const Ray &r, DataType tmin, const DataType &tmax,
+                VisitorTy visit) const {
+    if (m_indices.empty())
+      return;
+
+    // Clip [tmin:tmax] to the grid bounds, as the slab test does.
+    const SlabRay sr(r);
+    DataType t0 = tmin, t1 = tmax;
+    for (unsigned a = 0; a < 3; a++) {
+      DataType near = ((sr.sign[a] ? m_bounds.max() : m_bounds.min())[a] -
+                       sr.origin[a]) *
+                      sr.inv_direction[a];
+      DataType far = ((sr.sign[a] ? m_bounds.min() : m_bounds.max())[a] -
+                      sr.origin[a]) *
+                     sr.inv_direction[a];
+      t0 = near > t0 ? near : t0;
+      t1 = far < t1 ? far : t1;
+      if (t1 < t0)
+        return;
+    }
+
+    // The cell at t0, the steps along each axis, and the distances to the
+    // next cell boundary along each axis.
+    int cell[3], step[3], end[3];
+    DataType t_next[3], t_delta[3];
+    for (unsigned a = 0; a < 3; a++) {
+      const DataType o = r.origin()[a], d = r.direction()[a];
+      cell[a] = cell_of(d == 0 ? o : o + t0 * d, a);
+      if (d > 0) {
+        step[a] = 1;
+        end[a] = m_resolution[a];
+        t_next[a] = (plane(cell[a] + 1, a) - o) / d;
+        t_delta[a] = m_cell_size[a] / d;
+      } else if (d < 0) {
+        step[a] = -1;
+        end[a] = -1;
+        t_next[a] = (plane(cell[a], a) - o) / d;
+        t_delta[a] = -m_cell_size[a] / d;
+      } else {
+        step[a] = 0;
+        end[a] = -1;
+        t_next[a] = std::numeric_limits<DataType>::infinity();
+        t_delta[a] = std::numeric_limits<DataType>::infinity();
+      }
+    }
+
+    while (true) {
+      const unsigned c = (cell[2] * m_resolution[1] + cell[1]) *
+                             m_resolution[0] +
+                         cell[0];
+      for (unsigned i = m_cells[c]; i < m_cells[c + 1]; i++)
+        if (visit(m_indices[i]))
+          return;
+
+      // Step to the next cell along the axis whose boundary is the closest.
+      const unsigned a = t_next[0] < t_next[1]
+                             ? (t_next[0] < t_next[2] ? 0 : 2)
+                             : (t_next[1] < t_next[2] ? 1 : 2);
+      if (t_next[a] > t1 || t_next[a] > tmax)
+        return;
+      cell[a] += step[a];
+      if (cell[a] == end[a])
+        return;
+      t_next[a] += t_delta[a];
+    }
+  }
+
+private:
+  /** Returns the cell of coordinate x along axis, clamped to the grid. */
+  int cell_of(DataType x, unsigned axis) const {
+    const DataType c = (x - m_bounds.min()[axis]) * m_inv_cell_size[axis];
+    if (!(c > 0))
+      return 0;
+    return c >= m_resolution[axis] ? m_resolution[axis] - 1 : int(c);
+  }
+
+  /** Returns the coordinate along axis of the boundary before cell. */
+  DataType plane(int cell, unsigned axis) const {
+    return m_bounds.min()[axis] + cell * m_cell_size[axis];
+  }
+
+  BoundingBox m_bounds;
+  unsigned m_resolution[3];
+  DataType m_cell_size[3];
+  DataType m_inv_cell_size[3];
+  // The primitives of cell c are m_indices[m_cells[c]:m_cells[c + 1][, the
+  // cells being numbered x first, then y, then z.
+  std::vector<unsigned> m_cells;
+  std::vector<unsigned> m_indices;
+  size_t m_size;
+};
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::Grid &grid);
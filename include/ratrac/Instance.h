@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <memory>
+#include <string>
+
+namespace ratrac {
+
+/** An instance of a prototype shape, which many instances share: only the
+ * instance's transform and material are its own, so that a mesh can be
+ * placed a million times for the cost of a million transforms.
+ *
+ * The instance's transform applies on top of the prototype's: the object
+ * space of the instance is the world space of the prototype, whose world
+ * space queries it uses. The prototype is usually not in the world itself,
+ * but it can be, as can instances of instances. The intersections found
+ * through an instance refer to the instance, so that it is the instance's
+ * material and transform which shade them.
+ *
+ * The instances shade with their prototype's material, unless they are given
+ * one of their own, e.g. with material(const Material &): as material copies
+ * clone their pattern, the instances only allocate one when asked to.
+ */
+class Instance : public Shape {
+public:
+  explicit Instance(std::shared_ptr<const Shape> prototype);
+  Instance(std::shared_ptr<const Shape> prototype, const Matrix &transform);
+
+  Instance(const Instance &) = default;
+  Instance(Instance &&) = default;
+
+  Instance &operator=(const Instance &) = default;
+  Instance &operator=(Instance &&) = default;
+
+  const Shape &prototype() const { return *m_prototype; }
+  const std::shared_ptr<const Shape> &shared_prototype() const {
+    return m_prototype;
+  }
+
+  /** Returns true if this instance has a material of its own, rather than
+   * its prototype's. */
+  bool has_own_material() const { return m_own_material; }
+
+  using Shape::material;
+  virtual const Material &material() const override {
+    return m_own_material ? Shape::material() : m_prototype->material();
+  }
+  /** Returns this instance's own material, which starts as a copy of the
+   * prototype's. */
+  virtual Material &material() override;
+
+  virtual Intersections local_intersect(const Ray &r) const override;
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override;
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override;
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const override;
+
+  virtual Tuple local_normal_at(const Tuple &local_point) const override {
+    return m_prototype->normal_at(local_point);
+  }
+  virtual Tuple local_normal_at(const Tuple &local_point,
+                                const Intersection &hit) const override {
+    return m_prototype->normal_at(local_point, hit);
+  }
+
+  virtual BoundingBox bounds() const override {
+    return m_prototype->world_bounds();
+  }
+
+  virtual explicit operator std::string() const override;
+
+private:
+  std::shared_ptr<const Shape> m_prototype;
+  bool m_own_material;
+};
+
+} // namespace ratrac
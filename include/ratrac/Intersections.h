@@ -1,26 +1,39 @@
 #pragma once
 
 #include "ratrac/Color.h"
+#include "ratrac/Ray.h"
 #include "ratrac/Tuple.h"
 #include "ratrac/ratrac.h"
 
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include <vector>
 
 namespace ratrac {
 
-class Ray;
 class Shape;
 class World;
 
+/** An intersection of a ray with object, at t. For the shapes made of
+ * triangles, the hit face and the barycentric coordinates (u, v) of the hit on
+ * it are recorded as well, for the shading: they do not take part in the
+ * comparisons. */
 struct Intersection {
-  constexpr Intersection() noexcept : t(RayTracerDataType()), object(nullptr) {}
+  constexpr Intersection() noexcept
+      : t(RayTracerDataType()), object(nullptr), u(RayTracerDataType()),
+        v(RayTracerDataType()), face(0) {}
   constexpr Intersection(const Intersection &) noexcept = default;
   constexpr Intersection(RayTracerDataType t, const Shape *object) noexcept
-      : t(t), object(object) {}
+      : t(t), object(object), u(RayTracerDataType()), v(RayTracerDataType()),
+        face(0) {}
   constexpr Intersection(RayTracerDataType t, const Shape &object) noexcept
-      : t(t), object(&object) {}
+      : t(t), object(&object), u(RayTracerDataType()), v(RayTracerDataType()),
+        face(0) {}
+  constexpr Intersection(RayTracerDataType t, const Shape *object,
+                         unsigned face, RayTracerDataType u,
+                         RayTracerDataType v) noexcept
+      : t(t), object(object), u(u), v(v), face(face) {}
 
   Intersection &operator=(const Intersection &) = default;
 
@@ -37,6 +50,45 @@ struct Intersection {
 
   RayTracerDataType t;
   const Shape *object;
+  RayTracerDataType u;
+  RayTracerDataType v;
+  unsigned face;
+};
+
+/** The closest hits of the lanes of a RayPacket, in structure of arrays form:
+ * lane i hits object[i] at t[i], and misses everything while object[i] is
+ * null. u[i], v[i] and face[i] are only meaningful for the shapes which set
+ * them, see Intersection. */
+struct PacketHits {
+  PacketHits() {
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      t[i] = std::numeric_limits<RayTracerDataType>::infinity();
+      object[i] = nullptr;
+      u[i] = RayTracerDataType();
+      v[i] = RayTracerDataType();
+      face[i] = 0;
+    }
+  }
+
+  Intersection hit(unsigned lane) const {
+    assert(lane < RayPacket::SIZE && "Out of bound access to PacketHits lane");
+    return Intersection(t[lane], object[lane], face[lane], u[lane], v[lane]);
+  }
+
+  void set(unsigned lane, const Intersection &x) {
+    assert(lane < RayPacket::SIZE && "Out of bound access to PacketHits lane");
+    t[lane] = x.t;
+    object[lane] = x.object;
+    u[lane] = x.u;
+    v[lane] = x.v;
+    face[lane] = x.face;
+  }
+
+  RayTracerDataType t[RayPacket::SIZE];
+  const Shape *object[RayPacket::SIZE];
+  RayTracerDataType u[RayPacket::SIZE];
+  RayTracerDataType v[RayPacket::SIZE];
+  unsigned face[RayPacket::SIZE];
 };
 
 class Intersections {
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ratrac/ratrac.h"
+
+#include <cstddef>
+
+namespace ratrac {
+
+class Color;
+class Matrix;
+class Ray;
+class Tuple;
+struct RayPacket;
+
+/** The instruction sets the hot kernels are compiled for, from the narrowest
+ * to the widest. */
+enum class ISA { SCALAR, SSE2, AVX2, AVX512 };
+
+/** Returns the name of isa, e.g. "avx2". */
+const char *name(ISA isa);
+
+/** Returns the widest instruction set supported by both this ratrac build and
+ * the CPU it runs on. */
+ISA detect_isa();
+
+/** Kernels is a table of the hot math kernels which are worth running with the
+ * widest instruction set available, whatever the compiler targets.
+ *
+ * ratrac is built for a baseline CPU, and each kernel is also compiled for
+ * wider instruction sets. The table for the CPU running ratrac is selected
+ * once, at startup, and all the versions produce bit identical results.
+ *
+ * Only kernels doing enough work to amortize the indirect call are here: the
+ * Tuple and Matrix operators stay inline, with the instruction set selected at
+ * compile time (see ratrac/SIMD.h).
+ */
+struct Kernels {
+  ISA isa;
+
+  /** Returns ray transformed by M. */
+  Ray (*transform_ray)(const Ray &ray, const Matrix &M);
+
+  /** Returns all the lanes of rays transformed by M. */
+  RayPacket (*transform_packet)(const RayPacket &rays, const Matrix &M);
+
+  /** simd::scalar::intersect_sphere for all the lanes of rays, with the roots
+   * of lane i in t1[i] and t2[i]. Lanes which miss the sphere get
+   * t1[i] = t2[i] = -1. */
+  void (*intersect_sphere_packet)(const RayPacket &rays, const Tuple &center,
+                                  RayTracerDataType radius,
+                                  RayTracerDataType *t1,
+                                  RayTracerDataType *t2);
+
+  /** dst[i] += src[i] for the count Colors in dst and src. As with
+   * Color::operator+=, only the red, green and blue channels are added. The
+   * wavefront pipeline sums its lights' contributions with it; shade_hit,
+   * which has a single color to sum into, keeps Color::operator+=. */
+  void (*accumulate_colors)(Color *dst, const Color *src, size_t count);
+
+  /** Slab test of a ray against the 4 boxes of a WideBVH node, as
+   * simd::scalar::slab4: [t0[i]:t1[i]] is clipped to box i, and the mask of
+   * the boxes hit is returned. */
+  unsigned (*slab4)(const float *const near[3], const float *const far[3],
+                    const RayTracerDataType *origin,
+                    const RayTracerDataType *inv_direction,
+                    RayTracerDataType *t0, RayTracerDataType *t1);
+};
+
+/** Returns the kernels for isa, or nullptr if ratrac was not built for isa or
+ * if the CPU does not support it. */
+const Kernels *get_kernels(ISA isa);
+
+/** Returns the kernels for the widest instruction set available. */
+inline const Kernels &kernels() {
+  static const Kernels &active = *get_kernels(detect_isa());
+  return active;
+}
+
+} // namespace ratrac
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ratrac {
+
+/** A read only view of a file's content, memory mapped where available (it
+ * is read into a buffer on Windows). The content is not NUL terminated. */
+class MappedFile {
+public:
+  MappedFile() : m_data(nullptr), m_size(0), m_mapped(false), m_buffer() {}
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  /** Map filename, replacing any previously mapped file. Returns false if it
+   * can not be read. */
+  bool open(const std::string &filename);
+  void close();
+
+  const char *begin() const { return m_data; }
+  const char *end() const { return m_data + m_size; }
+  size_t size() const { return m_size; }
+
+private:
+  const char *m_data;
+  size_t m_size;
+  bool m_mapped;
+  std::vector<char> m_buffer;
+};
+
+} // namespace ratrac
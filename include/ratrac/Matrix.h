@@ -5,14 +5,17 @@
 
 #include <cassert>
 #include <cmath>
-#include <cstring>
 #include <initializer_list>
 #include <ostream>
 #include <tuple>
+#include <type_traits>
 
 namespace ratrac {
 
-/** Square matrices of  size 2x2, 3x3 or 4x4. */
+/** Square matrices of  size 2x2, 3x3 or 4x4.
+ *
+ * The elements are stored inline, so matrices never touch the allocator:
+ * they are trivially copyable and can be built at compile time. */
 class Matrix {
   static const unsigned NR = 4;       // Maximum number of rows.
   static const unsigned NC = 4;       // Maximum number of columns.
@@ -28,63 +31,49 @@ public:
   // ============
 
   Matrix() = delete;
-  Matrix(const Matrix &M)
-      : m_Matrix(new DataType[NE]), m_Rows(M.m_Rows), m_Columns(M.m_Columns) {
-    assert(m_Matrix && "Allocation error");
-    std::memcpy(m_Matrix, M.m_Matrix, NE * sizeof(DataType));
-  }
+  constexpr Matrix(const Matrix &M) = default;
+  constexpr Matrix(Matrix &&M) = default;
 
-  Matrix(Matrix &&M)
-      : m_Matrix(M.m_Matrix), m_Rows(M.m_Rows), m_Columns(M.m_Columns) {
-    M.m_Matrix = nullptr;
-    M.m_Rows = 0;
-    M.m_Columns = 0;
+  constexpr Matrix(std::initializer_list<std::initializer_list<DataType>> il)
+      : m_Matrix{}, m_Rows(0), m_Columns(0) {
+    *this = il;
   }
 
-  Matrix(std::initializer_list<std::initializer_list<DataType>> il);
-
-  /** Allocate a rows x columns uninitialized Matrix. */
-  Matrix(unsigned rows, unsigned columns)
-      : m_Matrix(new DataType[NE]), m_Rows(rows), m_Columns(columns) {
-    assert(m_Matrix && "Allocation error");
-  }
-  /** Allocate a rows x columns Val initialized Matrix. */
-  Matrix(unsigned rows, unsigned columns, DataType Val)
-      : m_Matrix(new DataType[NE]), m_Rows(rows), m_Columns(columns) {
-    assert(m_Matrix && "Allocation error");
+  /** Create a rows x columns zero initialized Matrix. */
+  constexpr Matrix(unsigned rows, unsigned columns)
+      : m_Matrix{}, m_Rows(rows), m_Columns(columns) {}
+  /** Create a rows x columns Val initialized Matrix. */
+  constexpr Matrix(unsigned rows, unsigned columns, DataType Val)
+      : m_Matrix{}, m_Rows(rows), m_Columns(columns) {
     for (unsigned row = 0; row < rows; row++)
       for (unsigned col = 0; col < columns; col++)
         set(row, col, Val);
   }
 
-  Matrix &operator=(const Matrix &M) {
-    if (!m_Matrix)
-      m_Matrix = new DataType[NE];
-    assert(m_Matrix && "Allocation error");
-    std::memcpy(m_Matrix, M.m_Matrix, NE * sizeof(DataType));
-    m_Rows = M.m_Rows;
-    m_Columns = M.m_Columns;
-    return *this;
-  }
-
-  Matrix &operator=(Matrix &&M) {
-    if (m_Matrix)
-      delete[] m_Matrix;
-    m_Matrix = M.m_Matrix;
-    m_Rows = M.m_Rows;
-    m_Columns = M.m_Columns;
-    M.m_Matrix = nullptr;
-    M.m_Rows = 0;
-    M.m_Columns = 0;
+  constexpr Matrix &operator=(const Matrix &M) = default;
+  constexpr Matrix &operator=(Matrix &&M) = default;
+
+  constexpr Matrix &
+  operator=(std::initializer_list<std::initializer_list<DataType>> il) {
+    assert(il.size() <= NR && "Number of rows must be < NR");
+    m_Rows = il.size();
+    m_Columns = 0;
+    unsigned row = 0;
+    for (const std::initializer_list<DataType> &r : il) {
+      assert(r.size() <= NC && "Number of columns must be < NC");
+      m_Columns = r.size() > m_Columns ? r.size() : m_Columns;
+      unsigned col = 0;
+      for (const DataType &v : r)
+        set(row, col++, v);
+      row++;
+    }
     return *this;
   }
 
-  Matrix &operator=(std::initializer_list<std::initializer_list<DataType>> il);
-
-  ~Matrix() { delete[] m_Matrix; }
+  ~Matrix() = default;
 
   /** Get the identity Matrix */
-  static Matrix identity() noexcept {
+  static constexpr Matrix identity() noexcept {
     Matrix M(NR, NC, DataType());
     for (unsigned i = 0; i < NR; i++)
       M.set(i, i, 1.);
@@ -93,7 +82,8 @@ public:
 
   // Chapter 4 transformations
   // =========================
-  static Matrix translation(DataType x, DataType y, DataType z) noexcept {
+  static constexpr Matrix translation(DataType x, DataType y,
+                                     DataType z) noexcept {
     Matrix result = Matrix::identity();
     result.set(0, 3, x);
     result.set(1, 3, y);
@@ -102,7 +92,7 @@ public:
   }
 
   /** Refer at the top of p49 for visual explanations. */
-  static Matrix scaling(DataType x, DataType y, DataType z) noexcept {
+  static constexpr Matrix scaling(DataType x, DataType y, DataType z) noexcept {
     Matrix result = Matrix::identity();
     result.set(0, 0, x);
     result.set(1, 1, y);
@@ -141,8 +131,9 @@ public:
 
   /** Function that moves points proportionally to an axis. See image p51 for
    * more information.*/
-  static Matrix shearing(DataType Xy, DataType Xz, DataType Yx, DataType Yz,
-                         DataType Zx, DataType Zy) noexcept {
+  static constexpr Matrix shearing(DataType Xy, DataType Xz, DataType Yx,
+                                  DataType Yz, DataType Zx,
+                                  DataType Zy) noexcept {
     Matrix result = Matrix::identity();
     result.set(0, 1, Xy);
     result.set(0, 2, Xz);
@@ -181,8 +172,50 @@ public:
   /** Transpose this matrix in place. */
   Matrix &transpose();
 
-  /** Invert this Matrix in place. */
-  Matrix &inverse();
+  /** Is this a 4x4 affine transformation, i.e. with a last row of
+   * {0, 0, 0, 1} ? */
+  constexpr bool is_affine() const {
+    return m_Rows == 4 && m_Columns == 4 && at(3, 0) == 0 && at(3, 1) == 0 &&
+           at(3, 2) == 0 && at(3, 3) == 1;
+  }
+
+  /** Is this a uniform scaling followed by a translation, i.e. an affine
+   * transformation whose linear part is scale times the identity, with a non
+   * zero scale ? If so, the scale factor is stored in scale. */
+  bool is_uniform_scaling_translation(DataType &scale) const {
+    if (!is_affine())
+      return false;
+    const DataType s = at(0, 0);
+    if (s == 0 || at(1, 1) != s || at(2, 2) != s)
+      return false;
+    if (at(0, 1) != 0 || at(0, 2) != 0 || at(1, 0) != 0 || at(1, 2) != 0 ||
+        at(2, 0) != 0 || at(2, 1) != 0)
+      return false;
+    scale = s;
+    return true;
+  }
+
+  /** Invert this Matrix in place, with the fastest method applicable to its
+   * shape and content. */
+  Matrix &inverse() {
+    if (is_affine())
+      return inverse_affine();
+    if (m_Rows == 4 && m_Columns == 4)
+      return inverse_4x4();
+    return inverse_cofactors();
+  }
+
+  /** Invert this Matrix in place, from its cofactors. This works on all
+   * matrix shapes, but is slow. */
+  Matrix &inverse_cofactors();
+
+  /** Invert this 4x4 Matrix in place, with a closed form expression of its
+   * cofactors built on the 2x2 sub-determinants. */
+  Matrix &inverse_4x4();
+
+  /** Invert this affine Matrix in place: the inverse of the 3x3 linear part
+   * is computed directly, and the translation is transformed by it. */
+  Matrix &inverse_affine();
 
   // Accessors
   // =========
@@ -198,11 +231,14 @@ public:
   /** Returns the Matrix number of columns. */
   constexpr unsigned columns() const { return m_Columns; }
 
+  /** Direct access to the elements, stored in row major order with a stride
+   * of 4 whatever the shape, for the vector kernels. */
+  constexpr const DataType *data() const { return m_Matrix; }
+
   /** Returns the corresponding value(float). */
   constexpr DataType operator()(unsigned row, unsigned column) const {
     assert(row < m_Rows && "Out of bound row access");
     assert(column < m_Columns && "Out of bound column access");
-    assert(m_Matrix && "Nowhere to get the data from");
     return m_Matrix[row * NC + column];
   }
   /** Returns the corresponding value(float). */
@@ -218,7 +254,20 @@ public:
 
   explicit operator std::string() const;
 
-  Matrix &operator*=(const Matrix &rhs);
+  constexpr Matrix &operator*=(const Matrix &rhs) {
+    assert(columns() == rhs.rows() && "Matrices must have compatible shapes");
+    Matrix M(rows(), rhs.columns());
+    for (unsigned row = 0; row < rows(); row++)
+      for (unsigned col = 0; col < rhs.columns(); col++) {
+        DataType acc = DataType();
+        for (unsigned it = 0; it < columns(); it++)
+          acc += at(row, it) * rhs.at(it, col);
+        M.set(row, col, acc);
+      }
+
+    *this = M;
+    return *this;
+  }
 
   // Editors
   // =======
@@ -226,7 +275,6 @@ public:
   constexpr Matrix &set(unsigned row, unsigned column, DataType value) {
     assert(row < m_Rows && "Out of bound row access");
     assert(column < m_Columns && "Out of bound column access");
-    assert(m_Matrix && "Nowhere to get the data from");
     m_Matrix[row * NC + column] = value;
     return *this;
   }
@@ -237,35 +285,35 @@ public:
   Matrix &rotate_x(DataType radians) noexcept {
     Matrix T = rotation_x(radians);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
   Matrix &rotate_y(DataType radians) noexcept {
     Matrix T = rotation_y(radians);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
   Matrix &rotate_z(DataType radians) noexcept {
     Matrix T = rotation_z(radians);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
   Matrix &scale(DataType x, DataType y, DataType z) noexcept {
     Matrix T = scaling(x, y, z);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
   Matrix &translate(DataType x, DataType y, DataType z) noexcept {
     Matrix T = translation(x, y, z);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
@@ -273,20 +321,23 @@ public:
                 DataType Zy) noexcept {
     Matrix T = shearing(Xy, Xz, Yx, Yz, Zx, Zy);
     T *= *this;
-    *this = std::move(T);
+    *this = T;
     return *this;
   }
 
 private:
-  DataType *m_Matrix;
+  DataType m_Matrix[NE];
   unsigned m_Rows;
   unsigned m_Columns;
 };
 
+static_assert(std::is_trivially_copyable<Matrix>::value,
+              "Matrix must be trivially copyable.");
+
 // Other operators
 // ===============
 
-inline Matrix operator*(const Matrix &lhs, const Matrix &rhs) {
+inline constexpr Matrix operator*(const Matrix &lhs, const Matrix &rhs) {
   Matrix tmp = lhs;
   tmp *= rhs;
   return tmp;
@@ -296,6 +347,10 @@ inline Tuple operator*(const Matrix &lhs, const Tuple &rhs) {
   Tuple T;
   assert(lhs.rows() == lhs.columns() && lhs.rows() == rhs.size() &&
          "Incompatible number of rows and columns.");
+  if (lhs.rows() == 4) {
+    simd::native::matvec4(lhs.data(), rhs.data(), T.data());
+    return T;
+  }
   for (unsigned row = 0; row < lhs.rows(); row++) {
     Matrix::DataType acc = Matrix::DataType();
     for (unsigned col = 0; col < lhs.columns(); col++)
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace ratrac {
+
+/** Parse the decimal number in [p:end[: an optional sign, digits with an
+ * optional decimal point, and an optional exponent. Returns the end of the
+ * number, or nullptr if there is none at p.
+ *
+ * This is the parser of the text file loaders: it does not depend on the C
+ * locale, and it does not need a NUL terminated string. The numbers with up
+ * to 19 significant digits and a small exponent, i.e. those the exporters
+ * write, are converted directly. The others go through strtod, in the "C"
+ * locale. The result is correctly rounded in both cases.
+ */
+const char *parse_number(const char *p, const char *end, double &value);
+
+} // namespace ratrac
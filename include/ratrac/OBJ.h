@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ratrac/Tuple.h"
+
+#include <string>
+#include <vector>
+
+namespace ratrac {
+
+class TriangleMesh;
+class World;
+
+/** The geometry of a Wavefront OBJ file, ready to be moved into a
+ * TriangleMesh. normals is empty, or has one normal per vertex. */
+struct OBJMesh {
+  OBJMesh() : vertices(), indices(), normals() {}
+
+  unsigned num_faces() const { return indices.size() / 3; }
+
+  std::vector<Tuple> vertices;
+  std::vector<unsigned> indices;
+  std::vector<Tuple> normals;
+};
+
+/** Parse the OBJ text in [begin:end[ to mesh, with threads parallel workers.
+ *
+ * The vertices (v), vertex normals (vn) and faces (f) are read, the other
+ * statements (texture coordinates, groups, materials, ...) are ignored.
+ * Polygons are triangulated as fans, and negative (relative) indices are
+ * supported. The normals are kept only if all the faces refer to normals;
+ * vertices used with different normals are then duplicated, as the meshes
+ * have a normal per vertex.
+ *
+ * The text is split in chunks at line boundaries, which are parsed
+ * concurrently, directly from the buffer: nothing is allocated per line, and
+ * the numbers are parsed by hand, whatever the C locale is.
+ *
+ * Returns false on malformed input, with an error message in error if it is
+ * not null. */
+bool parse_obj(const char *begin, const char *end, OBJMesh &mesh,
+               unsigned threads = 1, std::string *error = nullptr);
+
+/** Memory map filename and parse it with parse_obj. */
+bool read_obj(const std::string &filename, OBJMesh &mesh, unsigned threads = 1,
+              std::string *error = nullptr);
+
+/** Read filename and append it to world as a TriangleMesh. Returns the mesh,
+ * which world owns, or nullptr if the file could not be read. */
+TriangleMesh *load_obj(World &world, const std::string &filename,
+                       unsigned threads = 1, std::string *error = nullptr);
+
+} // namespace ratrac
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "ratrac/Kernels.h"
 #include "ratrac/Matrix.h"
 #include "ratrac/Tuple.h"
 #include "ratrac/ratrac.h"
 
+#include <cassert>
 #include <ostream>
 
 namespace ratrac {
@@ -29,7 +31,52 @@ constexpr Tuple position(const Ray &ray, DataTy t) noexcept {
 }
 
 inline Ray transform(const Ray &ray, const Matrix &mat) {
-  return Ray(mat * ray.origin(), mat * ray.direction());
+  return kernels().transform_ray(ray, mat);
+}
+
+/** A packet of up to SIZE coherent rays, e.g. the primary rays of a block of
+ * neighbouring pixels, stored as a structure of arrays so that each component
+ * of all the lanes can be processed with vector instructions. Operations on
+ * packets take a lane mask: lane i is active when bit i is set.
+ */
+struct RayPacket {
+  typedef Tuple::DataType DataType;
+  static constexpr unsigned SIZE = 8;
+
+  /** The lanes are left uninitialized: packets are filled all at once by
+   * the kernels producing them. */
+  RayPacket() {}
+
+  /** Returns the mask with all the first count lanes active. */
+  static constexpr unsigned mask(unsigned count) {
+    return count >= SIZE ? (1U << SIZE) - 1 : (1U << count) - 1;
+  }
+
+  void set(unsigned lane, const Ray &r) {
+    assert(lane < SIZE && "Out of bound access to RayPacket lane");
+    for (unsigned c = 0; c < 4; c++) {
+      origin[c][lane] = r.origin()[c];
+      direction[c][lane] = r.direction()[c];
+    }
+  }
+
+  Ray ray(unsigned lane) const {
+    assert(lane < SIZE && "Out of bound access to RayPacket lane");
+    return Ray(Tuple(origin[0][lane], origin[1][lane], origin[2][lane],
+                     origin[3][lane]),
+               Tuple(direction[0][lane], direction[1][lane],
+                     direction[2][lane], direction[3][lane]));
+  }
+
+  // Indexed by component first, then by lane.
+  alignas(64) DataType origin[4][SIZE];
+  alignas(64) DataType direction[4][SIZE];
+};
+
+/** Transform all lanes of rays by mat: each lane is bit identical to what
+ * transform(Ray, Matrix) computes for it. */
+inline RayPacket transform(const RayPacket &rays, const Matrix &mat) {
+  return kernels().transform_packet(rays, mat);
 }
 
 } // namespace ratrac
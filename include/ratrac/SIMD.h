@@ -0,0 +1,615 @@
+#pragma once
+
+// Vector kernels used by the Tuple, Matrix and Color hot paths.
+//
+// The kernels operate on groups of 4 values, i.e. a Tuple, a Matrix row, a
+// Color or the 4 children of a wide BVH node, and come in several flavors,
+// each in its own namespace:
+//  - scalar: plain C++ loops, always available and usable in constant
+//    expressions,
+//  - sse2: 2 doubles or 4 floats per operation,
+//  - avx2: 4 doubles or 8 floats per operation. The Tuple kernels stay on 128
+//    bits vectors: Tuples are often written just before being operated on,
+//    and 256 bits loads can not be forwarded from narrower stores, which
+//    costs more than the extra instruction,
+//  - avx512: 8 doubles or 16 floats per operation, for the kernels working on
+//    several Tuples or Colors at once.
+// simd::native is the best flavor the compiler targets, unless RATRAC_NO_SIMD
+// is defined. It is selected at compile time, with the RATRAC_SIMD cmake
+// option, and is what the inline Tuple and Matrix operators use. The avx2 and
+// avx512 flavors are also compiled with function target attributes when the
+// compiler does not target them, so that ratrac/Kernels.h can pick them at
+// runtime on the CPUs supporting them.
+//
+// All flavors perform the same floating point operations in the same order,
+// so they produce bit identical results: picking one or the other only
+// changes the speed. This is why there is no vector dot4: summing the
+// products in order leaves nothing to gain over the scalar loop.
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#if !defined(RATRAC_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RATRAC_SIMD_SSE2 1
+#endif
+
+#if defined(__AVX2__)
+#define RATRAC_SIMD_AVX2 1
+#define RATRAC_TARGET_AVX2
+#elif defined(RATRAC_SIMD_SSE2) && defined(__GNUC__)
+#define RATRAC_SIMD_AVX2 1
+#define RATRAC_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(RATRAC_SIMD_SSE2) && defined(_MSC_VER)
+#define RATRAC_SIMD_AVX2 1
+#define RATRAC_TARGET_AVX2
+#endif
+
+#if defined(__AVX512F__)
+#define RATRAC_SIMD_AVX512 1
+#define RATRAC_TARGET_AVX512
+#elif defined(RATRAC_SIMD_AVX2) && defined(__GNUC__)
+#define RATRAC_SIMD_AVX512 1
+#define RATRAC_TARGET_AVX512 __attribute__((target("avx2,avx512f")))
+#elif defined(RATRAC_SIMD_AVX2) && defined(_MSC_VER)
+#define RATRAC_SIMD_AVX512 1
+#define RATRAC_TARGET_AVX512
+#endif
+#endif
+
+// The kernel bodies shared by several flavors must be inlined in each of them,
+// to get compiled for their instruction set.
+#if defined(__GNUC__)
+#define RATRAC_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define RATRAC_ALWAYS_INLINE __forceinline
+#else
+#define RATRAC_ALWAYS_INLINE inline
+#endif
+
+#if defined(RATRAC_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(RATRAC_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace ratrac {
+namespace simd {
+
+/** Returns true when evaluated in a constant expression, where the intrinsics
+ * can not be used. Compilers which can not tell conservatively get the scalar
+ * kernels. */
+constexpr bool is_constant_evaluated() noexcept {
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+  return __builtin_is_constant_evaluated();
+#else
+  return true;
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1925
+  return __builtin_is_constant_evaluated();
+#else
+  return true;
+#endif
+}
+
+namespace scalar {
+inline const char *name() { return "scalar"; }
+
+/** a[i] += b[i] */
+template <class DataTy> constexpr void add4(DataTy *a, const DataTy *b) {
+  for (unsigned i = 0; i < 4; i++)
+    a[i] += b[i];
+}
+
+/** a[i] -= b[i] */
+template <class DataTy> constexpr void sub4(DataTy *a, const DataTy *b) {
+  for (unsigned i = 0; i < 4; i++)
+    a[i] -= b[i];
+}
+
+/** a[i] *= s */
+template <class DataTy> constexpr void mul4(DataTy *a, DataTy s) {
+  for (unsigned i = 0; i < 4; i++)
+    a[i] *= s;
+}
+
+/** a[i] /= s */
+template <class DataTy> constexpr void div4(DataTy *a, DataTy s) {
+  for (unsigned i = 0; i < 4; i++)
+    a[i] /= s;
+}
+
+/** Returns the sum of a[i] * b[i], accumulated from i = 0 to 3. */
+template <class DataTy>
+constexpr DataTy dot4(const DataTy *a, const DataTy *b) {
+  DataTy result = DataTy();
+  for (unsigned i = 0; i < 4; i++)
+    result += a[i] * b[i];
+  return result;
+}
+
+/** r = M * v, with M a row major 4x4 matrix. r must not alias v. */
+template <class DataTy>
+constexpr void matvec4(const DataTy *M, const DataTy *v, DataTy *r) {
+  for (unsigned row = 0; row < 4; row++)
+    r[row] = dot4(&M[4 * row], v);
+}
+
+/** ra = M * a and rb = M * b, with M a row major 4x4 matrix. ra and rb must
+ * not alias a or b. */
+template <class DataTy>
+constexpr void matvec4x2(const DataTy *M, const DataTy *a, const DataTy *b,
+                         DataTy *ra, DataTy *rb) {
+  matvec4(M, a, ra);
+  matvec4(M, b, rb);
+}
+
+/** dst[i] += src[i] for the first 3 of every 4 values, for count groups of 4
+ * values: this accumulates RGBA colors, leaving their alpha unchanged. */
+template <class DataTy>
+constexpr void add_rgb(DataTy *dst, const DataTy *src, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    for (unsigned c = 0; c < 3; c++)
+      dst[4 * i + c] += src[4 * i + c];
+}
+
+/** Slab test of a ray against 4 single precision boxes, stored axis by axis:
+ * near[a][i] and far[a][i] are the planes of box i the ray enters and leaves
+ * the slab of axis a by, given the ray's direction, and origin[a] and
+ * inv_direction[a] are the ray's. [t0[i]:t1[i]] is clipped to box i, and the
+ * mask of the boxes whose interval is not empty is returned. NaNs (0 * inf)
+ * leave the intervals unchanged, as with BoundingBox::intersects. */
+template <class DataTy>
+constexpr unsigned slab4(const float *const near[3], const float *const far[3],
+                         const DataTy *origin, const DataTy *inv_direction,
+                         DataTy *t0, DataTy *t1) {
+  for (unsigned a = 0; a < 3; a++)
+    for (unsigned i = 0; i < 4; i++) {
+      const DataTy tn = (DataTy(near[a][i]) - origin[a]) * inv_direction[a];
+      const DataTy tf = (DataTy(far[a][i]) - origin[a]) * inv_direction[a];
+      t0[i] = tn > t0[i] ? tn : t0[i];
+      t1[i] = tf < t1[i] ? tf : t1[i];
+    }
+  unsigned mask = 0;
+  for (unsigned i = 0; i < 4; i++)
+    mask |= unsigned(!(t1[i] < t0[i])) << i;
+  return mask;
+}
+
+/** Returns the discriminant of the quadratic a * t^2 + b * t + cc of a sphere
+ * of squared radius rr, for a ray of direction d starting at s from the
+ * center. In single precision, b * b and 4 * a * cc are nearly equal whenever
+ * both roots are close, e.g. with the thin flattened spheres the scenes use
+ * for floors and walls, and their difference loses most of its digits: it is
+ * computed instead as 4 * a * (rr - |l|^2), l being the vector from the center
+ * to the point of the ray closest to it, which does not cancel. Double
+ * precision keeps the historical formula. */
+template <class DataTy>
+RATRAC_ALWAYS_INLINE DataTy sphere_discriminant(DataTy a, DataTy b, DataTy cc,
+                                                DataTy rr, const DataTy s[4],
+                                                const DataTy d[4]) {
+  if (std::is_same<DataTy, double>::value)
+    return b * b - DataTy(4) * a * cc;
+
+  const DataTy k = b / (DataTy(2) * a);
+  const DataTy l0 = s[0] - k * d[0], l1 = s[1] - k * d[1],
+               l2 = s[2] - k * d[2], l3 = s[3] - k * d[3];
+  DataTy ll = DataTy();
+  ll += l0 * l0;
+  ll += l1 * l1;
+  ll += l2 * l2;
+  ll += l3 * l3;
+  return DataTy(4) * a * (rr - ll);
+}
+
+/** Intersects the ray starting at o along direction d with the sphere of
+ * radius radius centered at c. Returns false if the sphere is missed,
+ * and true with the 2 roots t1 <= t2 otherwise. There is no vector flavor:
+ * the few dependent operations of a single ray leave nothing to gain, and
+ * intersect_sphere_packet in ratrac/Kernels.h vectorizes across rays instead.
+ */
+template <class DataTy>
+RATRAC_ALWAYS_INLINE bool intersect_sphere(const DataTy *o, const DataTy *d,
+                                           const DataTy *c, DataTy radius,
+                                           DataTy &t1, DataTy &t2) {
+  // This is Sphere's historical computation, with the dot products spelled
+  // out: the compiler would otherwise vectorize them with wide loads of s
+  // right after its narrower stores, which stalls on store forwarding.
+  const DataTy s0 = o[0] - c[0], s1 = o[1] - c[1], s2 = o[2] - c[2],
+               s3 = o[3] - c[3];
+  DataTy a = DataTy();
+  a += d[0] * d[0];
+  a += d[1] * d[1];
+  a += d[2] * d[2];
+  a += d[3] * d[3];
+  DataTy b = DataTy();
+  b += d[0] * s0;
+  b += d[1] * s1;
+  b += d[2] * s2;
+  b += d[3] * s3;
+  b *= DataTy(2);
+  DataTy cc = DataTy();
+  cc += s0 * s0;
+  cc += s1 * s1;
+  cc += s2 * s2;
+  cc += s3 * s3;
+  const DataTy rr = radius * radius;
+  cc -= rr;
+  const DataTy s[4] = {s0, s1, s2, s3};
+  const DataTy discriminant = sphere_discriminant(a, b, cc, rr, s, d);
+  if (discriminant < 0.0)
+    return false;
+
+  t1 = (-b - std::sqrt(discriminant)) / (DataTy(2) * a);
+  t2 = (-b + std::sqrt(discriminant)) / (DataTy(2) * a);
+  return true;
+}
+} // namespace scalar
+
+#if defined(RATRAC_SIMD_SSE2)
+namespace sse2 {
+inline const char *name() { return "sse2"; }
+
+using scalar::add4;
+using scalar::add_rgb;
+using scalar::div4;
+using scalar::dot4;
+using scalar::matvec4;
+using scalar::matvec4x2;
+using scalar::mul4;
+using scalar::slab4;
+using scalar::sub4;
+
+inline void add4(double *a, const double *b) {
+  _mm_storeu_pd(a, _mm_add_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+  _mm_storeu_pd(a + 2, _mm_add_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+}
+
+inline void sub4(double *a, const double *b) {
+  _mm_storeu_pd(a, _mm_sub_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+  _mm_storeu_pd(a + 2, _mm_sub_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+}
+
+inline void mul4(double *a, double s) {
+  const __m128d vs = _mm_set1_pd(s);
+  _mm_storeu_pd(a, _mm_mul_pd(_mm_loadu_pd(a), vs));
+  _mm_storeu_pd(a + 2, _mm_mul_pd(_mm_loadu_pd(a + 2), vs));
+}
+
+inline void div4(double *a, double s) {
+  const __m128d vs = _mm_set1_pd(s);
+  _mm_storeu_pd(a, _mm_div_pd(_mm_loadu_pd(a), vs));
+  _mm_storeu_pd(a + 2, _mm_div_pd(_mm_loadu_pd(a + 2), vs));
+}
+
+inline void matvec4(const double *M, const double *v, double *r) {
+  // Each half of the result is accumulated column by column, so that every
+  // row gets the same sequence of additions than with the scalar kernel.
+  for (unsigned half = 0; half < 2; half++) {
+    const double *r0 = &M[8 * half];
+    const double *r1 = r0 + 4;
+    const __m128d r0_01 = _mm_loadu_pd(r0), r1_01 = _mm_loadu_pd(r1);
+    const __m128d r0_23 = _mm_loadu_pd(r0 + 2), r1_23 = _mm_loadu_pd(r1 + 2);
+    __m128d acc = _mm_setzero_pd();
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_unpacklo_pd(r0_01, r1_01),
+                                     _mm_set1_pd(v[0])));
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_unpackhi_pd(r0_01, r1_01),
+                                     _mm_set1_pd(v[1])));
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_unpacklo_pd(r0_23, r1_23),
+                                     _mm_set1_pd(v[2])));
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_unpackhi_pd(r0_23, r1_23),
+                                     _mm_set1_pd(v[3])));
+    _mm_storeu_pd(&r[2 * half], acc);
+  }
+}
+
+inline void matvec4x2(const double *M, const double *a, const double *b,
+                      double *ra, double *rb) {
+  matvec4(M, a, ra);
+  matvec4(M, b, rb);
+}
+
+inline void add4(float *a, const float *b) {
+  _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+}
+
+inline void sub4(float *a, const float *b) {
+  _mm_storeu_ps(a, _mm_sub_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+}
+
+inline void mul4(float *a, float s) {
+  _mm_storeu_ps(a, _mm_mul_ps(_mm_loadu_ps(a), _mm_set1_ps(s)));
+}
+
+inline void div4(float *a, float s) {
+  _mm_storeu_ps(a, _mm_div_ps(_mm_loadu_ps(a), _mm_set1_ps(s)));
+}
+
+/** Load the 4 columns of the row major 4x4 matrix M. */
+inline void load_columns4(const float *M, __m128 c[4]) {
+  c[0] = _mm_loadu_ps(M);
+  c[1] = _mm_loadu_ps(M + 4);
+  c[2] = _mm_loadu_ps(M + 8);
+  c[3] = _mm_loadu_ps(M + 12);
+  _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+}
+
+inline void matvec4(const float *M, const float *v, float *r) {
+  // Accumulate M column by column so that every row gets the same sequence
+  // of additions than with the scalar kernel.
+  __m128 c[4];
+  load_columns4(M, c);
+  __m128 acc = _mm_setzero_ps();
+  for (unsigned col = 0; col < 4; col++)
+    acc = _mm_add_ps(acc, _mm_mul_ps(c[col], _mm_set1_ps(v[col])));
+  _mm_storeu_ps(r, acc);
+}
+
+inline void matvec4x2(const float *M, const float *a, const float *b,
+                      float *ra, float *rb) {
+  __m128 c[4];
+  load_columns4(M, c);
+  __m128 acc_a = _mm_setzero_ps();
+  __m128 acc_b = _mm_setzero_ps();
+  for (unsigned col = 0; col < 4; col++) {
+    acc_a = _mm_add_ps(acc_a, _mm_mul_ps(c[col], _mm_set1_ps(a[col])));
+    acc_b = _mm_add_ps(acc_b, _mm_mul_ps(c[col], _mm_set1_ps(b[col])));
+  }
+  _mm_storeu_ps(ra, acc_a);
+  _mm_storeu_ps(rb, acc_b);
+}
+
+inline void add_rgb(float *dst, const float *src, size_t count) {
+  const __m128 alpha = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+  for (size_t i = 0; i < count; i++) {
+    const __m128 d = _mm_loadu_ps(&dst[4 * i]);
+    const __m128 sum = _mm_add_ps(d, _mm_loadu_ps(&src[4 * i]));
+    _mm_storeu_ps(&dst[4 * i], _mm_or_ps(_mm_andnot_ps(alpha, sum),
+                                         _mm_and_ps(alpha, d)));
+  }
+}
+
+// max(a, b) is a > b ? a : b and min(a, b) is a < b ? a : b, as with the
+// scalar kernel, and !(t1 < t0) is the not less than comparison.
+inline unsigned slab4(const float *const near[3], const float *const far[3],
+                      const float *origin, const float *inv_direction,
+                      float *t0, float *t1) {
+  __m128 vt0 = _mm_loadu_ps(t0), vt1 = _mm_loadu_ps(t1);
+  for (unsigned a = 0; a < 3; a++) {
+    const __m128 o = _mm_set1_ps(origin[a]);
+    const __m128 inv = _mm_set1_ps(inv_direction[a]);
+    const __m128 tn = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near[a]), o), inv);
+    const __m128 tf = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far[a]), o), inv);
+    vt0 = _mm_max_ps(tn, vt0);
+    vt1 = _mm_min_ps(tf, vt1);
+  }
+  _mm_storeu_ps(t0, vt0);
+  _mm_storeu_ps(t1, vt1);
+  return _mm_movemask_ps(_mm_cmpnlt_ps(vt1, vt0));
+}
+
+inline unsigned slab4(const float *const near[3], const float *const far[3],
+                      const double *origin, const double *inv_direction,
+                      double *t0, double *t1) {
+  // The boxes are processed 2 by 2.
+  unsigned mask = 0;
+  for (unsigned half = 0; half < 2; half++) {
+    __m128d vt0 = _mm_loadu_pd(&t0[2 * half]);
+    __m128d vt1 = _mm_loadu_pd(&t1[2 * half]);
+    for (unsigned a = 0; a < 3; a++) {
+      const __m128d o = _mm_set1_pd(origin[a]);
+      const __m128d inv = _mm_set1_pd(inv_direction[a]);
+      __m128 n = _mm_loadu_ps(near[a]), f = _mm_loadu_ps(far[a]);
+      if (half) {
+        n = _mm_movehl_ps(n, n);
+        f = _mm_movehl_ps(f, f);
+      }
+      const __m128d tn = _mm_mul_pd(_mm_sub_pd(_mm_cvtps_pd(n), o), inv);
+      const __m128d tf = _mm_mul_pd(_mm_sub_pd(_mm_cvtps_pd(f), o), inv);
+      vt0 = _mm_max_pd(tn, vt0);
+      vt1 = _mm_min_pd(tf, vt1);
+    }
+    _mm_storeu_pd(&t0[2 * half], vt0);
+    _mm_storeu_pd(&t1[2 * half], vt1);
+    mask |= unsigned(_mm_movemask_pd(_mm_cmpnlt_pd(vt1, vt0))) << (2 * half);
+  }
+  return mask;
+}
+} // namespace sse2
+#endif
+
+#if defined(RATRAC_SIMD_AVX2)
+namespace avx2 {
+inline const char *name() { return "avx2"; }
+
+using scalar::add_rgb;
+using scalar::dot4;
+using scalar::matvec4;
+using scalar::matvec4x2;
+using sse2::add4;
+using sse2::div4;
+using sse2::mul4;
+using sse2::sub4;
+
+/** Load the 4 columns of the row major 4x4 matrix M. */
+RATRAC_TARGET_AVX2 inline void load_columns4(const double *M, __m256d c[4]) {
+  const __m256d r0 = _mm256_loadu_pd(M), r1 = _mm256_loadu_pd(M + 4);
+  const __m256d r2 = _mm256_loadu_pd(M + 8), r3 = _mm256_loadu_pd(M + 12);
+  const __m256d t0 = _mm256_unpacklo_pd(r0, r1); // m00 m10 m02 m12
+  const __m256d t1 = _mm256_unpackhi_pd(r0, r1); // m01 m11 m03 m13
+  const __m256d t2 = _mm256_unpacklo_pd(r2, r3); // m20 m30 m22 m32
+  const __m256d t3 = _mm256_unpackhi_pd(r2, r3); // m21 m31 m23 m33
+  c[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+  c[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+  c[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+  c[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+RATRAC_TARGET_AVX2 inline void matvec4(const double *M, const double *v,
+                                       double *r) {
+  // Accumulate M column by column so that every row gets the same sequence
+  // of additions than with the scalar kernel.
+  __m256d c[4];
+  load_columns4(M, c);
+  __m256d acc = _mm256_setzero_pd();
+  for (unsigned col = 0; col < 4; col++)
+    acc = _mm256_add_pd(acc, _mm256_mul_pd(c[col], _mm256_set1_pd(v[col])));
+  _mm256_storeu_pd(r, acc);
+}
+
+RATRAC_TARGET_AVX2 inline void matvec4x2(const double *M, const double *a,
+                                         const double *b, double *ra,
+                                         double *rb) {
+  __m256d c[4];
+  load_columns4(M, c);
+  __m256d acc_a = _mm256_setzero_pd();
+  __m256d acc_b = _mm256_setzero_pd();
+  for (unsigned col = 0; col < 4; col++) {
+    acc_a = _mm256_add_pd(acc_a, _mm256_mul_pd(c[col], _mm256_set1_pd(a[col])));
+    acc_b = _mm256_add_pd(acc_b, _mm256_mul_pd(c[col], _mm256_set1_pd(b[col])));
+  }
+  _mm256_storeu_pd(ra, acc_a);
+  _mm256_storeu_pd(rb, acc_b);
+}
+
+RATRAC_TARGET_AVX2 inline void matvec4(const float *M, const float *v,
+                                       float *r) {
+  sse2::matvec4(M, v, r);
+}
+
+RATRAC_TARGET_AVX2 inline void matvec4x2(const float *M, const float *a,
+                                         const float *b, float *ra, float *rb) {
+  // Both products are accumulated at once, M's columns being duplicated in
+  // the low and high halves of the vectors.
+  __m128 c[4];
+  sse2::load_columns4(M, c);
+  __m256 acc = _mm256_setzero_ps();
+  for (unsigned col = 0; col < 4; col++)
+    acc = _mm256_add_ps(
+        acc, _mm256_mul_ps(_mm256_set_m128(c[col], c[col]),
+                           _mm256_set_m128(_mm_set1_ps(b[col]),
+                                           _mm_set1_ps(a[col]))));
+  _mm_storeu_ps(ra, _mm256_castps256_ps128(acc));
+  _mm_storeu_ps(rb, _mm256_extractf128_ps(acc, 1));
+}
+
+RATRAC_TARGET_AVX2 inline void add_rgb(float *dst, const float *src,
+                                       size_t count) {
+  const __m256 alpha =
+      _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0));
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m256 d = _mm256_loadu_ps(&dst[4 * i]);
+    const __m256 sum = _mm256_add_ps(d, _mm256_loadu_ps(&src[4 * i]));
+    _mm256_storeu_ps(&dst[4 * i], _mm256_blendv_ps(sum, d, alpha));
+  }
+  sse2::add_rgb(&dst[4 * i], &src[4 * i], count - i);
+}
+
+RATRAC_TARGET_AVX2 inline unsigned
+slab4(const float *const near[3], const float *const far[3],
+      const float *origin, const float *inv_direction, float *t0, float *t1) {
+  return sse2::slab4(near, far, origin, inv_direction, t0, t1);
+}
+
+RATRAC_TARGET_AVX2 inline unsigned
+slab4(const float *const near[3], const float *const far[3],
+      const double *origin, const double *inv_direction, double *t0,
+      double *t1) {
+  __m256d vt0 = _mm256_loadu_pd(t0), vt1 = _mm256_loadu_pd(t1);
+  for (unsigned a = 0; a < 3; a++) {
+    const __m256d o = _mm256_set1_pd(origin[a]);
+    const __m256d inv = _mm256_set1_pd(inv_direction[a]);
+    const __m256d tn = _mm256_mul_pd(
+        _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(near[a])), o), inv);
+    const __m256d tf = _mm256_mul_pd(
+        _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(far[a])), o), inv);
+    vt0 = _mm256_max_pd(tn, vt0);
+    vt1 = _mm256_min_pd(tf, vt1);
+  }
+  _mm256_storeu_pd(t0, vt0);
+  _mm256_storeu_pd(t1, vt1);
+  return _mm256_movemask_pd(_mm256_cmp_pd(vt1, vt0, _CMP_NLT_UQ));
+}
+} // namespace avx2
+#endif
+
+#if defined(RATRAC_SIMD_AVX512)
+namespace avx512 {
+inline const char *name() { return "avx512"; }
+
+using avx2::add4;
+using avx2::div4;
+using avx2::dot4;
+using avx2::matvec4;
+using avx2::mul4;
+using avx2::slab4;
+using avx2::sub4;
+using scalar::add_rgb;
+using scalar::matvec4x2;
+
+RATRAC_TARGET_AVX512 inline void matvec4x2(const double *M, const double *a,
+                                           const double *b, double *ra,
+                                           double *rb) {
+  // Both products are accumulated at once, M's columns being duplicated in
+  // the low and high halves of the vectors. The masked intrinsics are used
+  // because the plain ones trigger spurious -Wuninitialized warnings with
+  // some gcc versions.
+  __m256d c[4];
+  avx2::load_columns4(M, c);
+  __m512d acc = _mm512_setzero_pd();
+  for (unsigned col = 0; col < 4; col++) {
+    const __m512d cc =
+        _mm512_mask_broadcast_f64x4(_mm512_setzero_pd(), 0xFF, c[col]);
+    const __m512d ab = _mm512_mask_blend_pd(0xF0, _mm512_set1_pd(a[col]),
+                                            _mm512_set1_pd(b[col]));
+    acc = _mm512_add_pd(acc, _mm512_mul_pd(cc, ab));
+  }
+  _mm256_storeu_pd(
+      ra, _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, acc, 0));
+  _mm256_storeu_pd(
+      rb, _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, acc, 1));
+}
+
+RATRAC_TARGET_AVX512 inline void matvec4x2(const float *M, const float *a,
+                                           const float *b, float *ra,
+                                           float *rb) {
+  avx2::matvec4x2(M, a, b, ra, rb);
+}
+
+RATRAC_TARGET_AVX512 inline void add_rgb(float *dst, const float *src,
+                                         size_t count) {
+  // Colors are processed 4 by 4, with the tail handled with masked loads and
+  // stores. The alpha values are masked out of the stores.
+  const __mmask16 rgb = 0x7777;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m512 sum = _mm512_add_ps(_mm512_loadu_ps(&dst[4 * i]),
+                                     _mm512_loadu_ps(&src[4 * i]));
+    _mm512_mask_storeu_ps(&dst[4 * i], rgb, sum);
+  }
+  if (i < count) {
+    const __mmask16 tail = (__mmask16)((1u << (4 * (count - i))) - 1);
+    const __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(tail, &dst[4 * i]),
+                                     _mm512_maskz_loadu_ps(tail, &src[4 * i]));
+    _mm512_mask_storeu_ps(&dst[4 * i], tail & rgb, sum);
+  }
+}
+} // namespace avx512
+#endif
+
+#if defined(__AVX512F__) && defined(RATRAC_SIMD_AVX512)
+namespace native = avx512;
+#elif defined(__AVX2__) && defined(RATRAC_SIMD_AVX2)
+namespace native = avx2;
+#elif defined(RATRAC_SIMD_SSE2)
+namespace native = sse2;
+#else
+namespace native = scalar;
+#endif
+
+} // namespace simd
+} // namespace ratrac
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ratrac/Camera.h"
+#include "ratrac/World.h"
+
+#include <memory>
+#include <string>
+
+namespace ratrac {
+
+/** A scene read from a scene description: the world, and the camera to
+ * render it with, if the description has one. */
+struct Scene {
+  Scene() : world(), camera() {}
+
+  World world;
+  std::unique_ptr<Camera> camera;
+};
+
+/** Parse the scene description in [begin:end[ to scene.
+ *
+ * The descriptions use the YAML subset of "The Ray Tracer Challenge" scene
+ * files: a sequence of items, which add a camera, a light or a shape to the
+ * scene, or define a material or a transform to be used by name later on:
+ *
+ *   - add: camera
+ *     width: 320
+ *     height: 240
+ *     field-of-view: 1.0471975511965976
+ *     from: [0, 1.5, -5]
+ *     to: [0, 1, 0]
+ *     up: [0, 1, 0]
+ *   - add: light
+ *     at: [-10, 10, -10]
+ *     intensity: [1, 1, 1]
+ *   - define: green
+ *     value:
+ *       color: [0.1, 0.8, 0.1]
+ *       pattern:
+ *         type: stripes
+ *         colors: [[0.1, 0.8, 0.1], [0.5, 0.8, 0.5]]
+ *         transform: [[scale, 0.15, 0.15, 0.15]]
+ *   - add: sphere
+ *     material: green
+ *     transform:
+ *       - [rotate-y, -1.5707963267948966]
+ *       - [translate, -1, 1, 2]
+ *
+ * The shapes are sphere, plane, triangle (with p1, p2 and p3) and obj (with
+ * the Wavefront OBJ file, relative to the description). The patterns are
+ * stripes, gradient, rings, checkers and radial-gradient with 2 colors,
+ * checkers and blend with 2 patterns. The transforms are lists of translate,
+ * scale, rotate-x, rotate-y, rotate-z and shear operations, or of defined
+ * transforms, in the order they apply. A material definition can extend a
+ * previous one. A shape definition, whose value is a shape as an add item
+ * describes it, is a prototype: adding it by name adds an Instance of it,
+ * which shares its geometry, on top of which it applies its own transform
+ * and material.
+ *
+ * The YAML subset has block and flow sequences and mappings, plain and quoted
+ * (without escapes) scalars and comments. The description is parsed one
+ * top-level item at a time, directly from the buffer: only the current item
+ * and the definitions are kept, and the numbers are parsed with
+ * parse_number, whatever the C locale is.
+ *
+ * Returns false on malformed descriptions, with an error message in error if
+ * it is not null. */
+bool parse_scene(const char *begin, const char *end, Scene &scene,
+                 std::string *error = nullptr);
+
+/** Memory map filename and parse it with parse_scene. */
+bool read_scene(const std::string &filename, Scene &scene,
+                std::string *error = nullptr);
+
+} // namespace ratrac
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ratrac {
+
+class World;
+
+/** The version of the scene cache format, to be bumped whenever the layout
+ * of the cache, or of one of the types it stores in binary, changes. */
+constexpr uint32_t SCENE_CACHE_VERSION = 4;
+
+/** Save world, fully built, to the binary scene cache filename.
+ *
+ * The cache stores the lights, and for each object its type, transform and
+ * inverse transform, material (with its patterns) and geometry, followed by
+ * the world's BVH. The prototypes of the instances are saved once, and
+ * shared again when loaded. The matrices, vertex and index buffers and BVH
+ * nodes are stored as they are in memory, so that loading them is a plain
+ * copy: a cache is only valid for builds with the same precision and byte
+ * order, and the same SCENE_CACHE_VERSION, which its header records.
+ *
+ * Only the shape and pattern types of this library can be saved. Returns
+ * false if world has others, or if filename can not be written, with an
+ * error message in error if it is not null. */
+bool save_scene(const World &world, const std::string &filename,
+                std::string *error = nullptr);
+
+/** Replace world's lights and objects with those of the scene cache filename,
+ * which is memory mapped. Nothing is recomputed: the transforms come with
+ * their inverse, and the meshes and the world with their BVH.
+ *
+ * Returns false, leaving world untouched, if filename can not be read, or is
+ * not a valid cache for this build, with an error message in error if it is
+ * not null. */
+bool load_scene(World &world, const std::string &filename,
+                std::string *error = nullptr);
+
+} // namespace ratrac
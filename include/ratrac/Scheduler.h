@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace ratrac {
+
+/** TaskScheduler runs tasks on a pool of workers with work stealing.
+ *
+ * Each worker owns a deque of tasks. A worker pops tasks from the back of its
+ * own deque and, once it is empty, steals tasks from the front of the other
+ * workers' deques, so that uneven workloads get balanced at runtime. The
+ * calling thread of run() acts as worker 0.
+ */
+class TaskScheduler {
+public:
+  /** A Task gets the index of the worker executing it, so it can push
+   * more tasks to its own deque. */
+  using Task = std::function<void(unsigned worker)>;
+
+  /** Counters collected for each worker during run(). */
+  struct WorkerStats {
+    WorkerStats() : tasks(0), steals(0), busy(0.0) {}
+    size_t tasks;  // Number of tasks executed.
+    size_t steals; // Number of tasks stolen from other workers.
+    double busy;   // Time spent executing tasks, in seconds.
+  };
+
+  explicit TaskScheduler(unsigned workers);
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  unsigned workers() const { return m_workers.size(); }
+
+  /** Queue task on worker's deque. It is safe to push tasks from a running
+   * task. */
+  void push(unsigned worker, Task task);
+
+  /** Execute all queued tasks, returning when they are all completed. */
+  void run();
+
+  const WorkerStats &stats(unsigned worker) const;
+
+  size_t total_steals() const;
+
+private:
+  struct Worker {
+    Worker() : lock(), tasks(), stats() {}
+    std::mutex lock;
+    std::deque<Task> tasks;
+    WorkerStats stats;
+  };
+
+  bool pop(unsigned worker, Task &task);
+  bool steal(unsigned thief, Task &task);
+  void work(unsigned worker);
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  // Number of tasks pushed and not yet completed.
+  std::atomic<size_t> m_pending;
+};
+
+} // namespace ratrac
+
+/** Outputs the per worker counters, one line per worker. */
+std::ostream &operator<<(std::ostream &os, const ratrac::TaskScheduler &S);
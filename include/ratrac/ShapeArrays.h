@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <vector>
+
+namespace ratrac {
+
+/** A compact copy of the geometry of a set of shapes, for the intersection
+ * queries. The shapes are grouped by type, and what the intersections need
+ * (inverse transforms, world bounds, ...) is packed in contiguous arrays, so
+ * that each type is intersected in a tight loop, without chasing a pointer to
+ * each shape nor making a virtual call. The shapes themselves are only
+ * referenced, for the intersection results and the shading.
+ *
+ * The primitives are numbered in storage order: the planes first, then the
+ * spheres, then the shapes of the other types, which go through the Shape
+ * virtual interface. Within each type, the order of the shapes is kept.
+ *
+ * The arrays are a snapshot: they must be rebuilt when shapes are added or
+ * removed, and updated when shapes are transformed.
+ */
+class ShapeArrays {
+public:
+  typedef RayTracerDataType DataType;
+
+  ShapeArrays()
+      : m_shapes(), m_bounds(), m_inverse_transforms(), m_spheres(),
+        m_planes_end(0), m_spheres_end(0) {}
+
+  /** Snapshot shapes. If primitives is not null, it is set to the primitive
+   * of each shape, in the order of shapes. */
+  explicit ShapeArrays(const std::vector<const Shape *> &shapes,
+                       std::vector<unsigned> *primitives = nullptr);
+
+  /** Number of primitives. */
+  unsigned size() const { return m_shapes.size(); }
+  bool empty() const { return m_shapes.empty(); }
+
+  unsigned num_planes() const { return m_planes_end; }
+  unsigned num_spheres() const { return m_spheres_end - m_planes_end; }
+  unsigned num_others() const { return size() - m_spheres_end; }
+
+  const Shape *shape(unsigned prim) const { return m_shapes[prim]; }
+  const BoundingBox &bounds(unsigned prim) const { return m_bounds[prim]; }
+  const std::vector<BoundingBox> &bounds() const { return m_bounds; }
+
+  /** Take a new snapshot of the geometry of primitive prim, after its shape
+   * has been transformed. */
+  void update(unsigned prim);
+
+  /** Queries on primitive prim, as Shape's: used for the BVH leaves, whose
+   * boxes have already been tested. */
+  void closest_hit(unsigned prim, const Ray &r, Intersection &hit) const;
+  void closest_hit(unsigned prim, const RayPacket &rays, unsigned mask,
+                   PacketHits &hits) const;
+  bool occludes(unsigned prim, const Ray &r, DataType max_t) const;
+
+  /** Queries on all primitives, as World's: the bounded primitives whose box
+   * is missed are skipped before transforming the ray. */
+  void intersect(const Ray &r, Intersections &xs) const;
+  void closest_hit(const Ray &r, Intersection &hit) const;
+  void closest_hit(const RayPacket &rays, unsigned mask,
+                   PacketHits &hits) const;
+  bool occluded(const Ray &r, DataType max_t) const;
+
+private:
+  // The geometry of a sphere, in world space for the spheres which are
+  // intersected in world space, in object space otherwise.
+  struct SphereGeometry {
+    Tuple center;
+    DataType radius;
+    bool world_space;
+  };
+
+  const SphereGeometry &sphere(unsigned prim) const {
+    return m_spheres[prim - m_planes_end];
+  }
+
+  void sphere_closest_hit(unsigned prim, const Ray &r, Intersection &hit) const;
+  void sphere_closest_hit(unsigned prim, const RayPacket &rays, unsigned mask,
+                          PacketHits &hits) const;
+  bool sphere_occludes(unsigned prim, const Ray &r, DataType max_t) const;
+  void plane_closest_hit(unsigned prim, const Ray &r, Intersection &hit) const;
+  void plane_closest_hit(unsigned prim, const RayPacket &rays, unsigned mask,
+                         PacketHits &hits) const;
+  bool plane_occludes(unsigned prim, const Ray &r, DataType max_t) const;
+
+  std::vector<const Shape *> m_shapes;
+  std::vector<BoundingBox> m_bounds;
+  // The inverse transforms of the planes and spheres.
+  std::vector<Matrix> m_inverse_transforms;
+  // The spheres, from the first sphere primitive.
+  std::vector<SphereGeometry> m_spheres;
+  unsigned m_planes_end;
+  unsigned m_spheres_end;
+};
+
+} // namespace ratrac
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ratrac/BoundingBox.h"
 #include "ratrac/Color.h"
 #include "ratrac/Intersections.h"
 #include "ratrac/Material.h"
@@ -8,6 +9,7 @@
 #include "ratrac/Tuple.h"
 #include "ratrac/ratrac.h"
 
+#include <limits>
 #include <ostream>
 #include <string>
 
@@ -16,57 +18,132 @@ class Shape : public Transformable {
 public:
   Shape()
       : Transformable(), m_transposed_inverted_transform(Matrix::identity()),
-        m_material() {}
+        m_material(), m_world_bounds(BoundingBox::infinite()) {}
   virtual ~Shape();
 
   bool operator==(const Shape &rhs) const {
-    return this->Transformable::operator==(rhs) && m_material == rhs.m_material;
+    return this->Transformable::operator==(rhs) && material() == rhs.material();
   }
   bool operator!=(const Shape &rhs) const { return !(*this == rhs); }
 
-  const Material &material() const { return m_material; }
-  Material &material() { return m_material; }
+  /** The material shading this shape. Shapes can override the accessors to
+   * shade with a material they do not own, e.g. instances with their
+   * prototype's: the non const accessor must then return a material of their
+   * own. */
+  virtual const Material &material() const { return m_material; }
+  virtual Material &material() { return m_material; }
 
   Shape &material(const Material &m) {
-    m_material = m;
+    material() = m;
     return *this;
   }
 
-  Intersections intersect(const Ray &world_ray) const {
+  /** The world space queries transform the ray to object space, and defer to
+   * the local_* queries. Shapes can override them with a path skipping the
+   * ray transformation. */
+  virtual Intersections intersect(const Ray &world_ray) const {
     Ray local_ray = ratrac::transform(world_ray, inverse_transform());
     return local_intersect(local_ray);
   }
 
+  /** Occlusion query: is there an intersection with t in [0:max_t[ ? */
+  virtual bool occludes(const Ray &world_ray, RayTracerDataType max_t) const {
+    Ray local_ray = ratrac::transform(world_ray, inverse_transform());
+    return local_occludes(local_ray, max_t);
+  }
+
+  /** Closest hit query: if there is an intersection with t in [0:hit.t[,
+   * update hit with the closest one and return true. */
+  virtual bool closest_hit(const Ray &world_ray, Intersection &hit) const {
+    Ray local_ray = ratrac::transform(world_ray, inverse_transform());
+    return local_closest_hit(local_ray, hit);
+  }
+
+  /** Packet closest hit query: closest_hit for each lane of world_rays in
+   * mask, updating the corresponding lane of hits. */
+  virtual void closest_hit(const RayPacket &world_rays, unsigned mask,
+                           PacketHits &hits) const {
+    RayPacket local_rays = ratrac::transform(world_rays, inverse_transform());
+    local_closest_hit(local_rays, mask, hits);
+  }
+
   Color at(const Tuple &world_point) const {
     Tuple object_point = inverse_transform(world_point);
-    return m_material.at(object_point);
+    return material().at(object_point);
   }
 
   Tuple normal_at(const Tuple &world_point) const {
     Tuple local_point = inverse_transform(world_point);
-    Tuple local_normal = local_normal_at(local_point);
-    Tuple world_normal = m_transposed_inverted_transform * local_normal;
-    world_normal[3] = 0;
-    return world_normal.normalize();
+    return world_normal(local_normal_at(local_point));
+  }
+
+  /** Returns the normal at world_point, which intersection hit found. */
+  Tuple normal_at(const Tuple &world_point, const Intersection &hit) const {
+    Tuple local_point = inverse_transform(world_point);
+    return world_normal(local_normal_at(local_point, hit));
   }
 
   virtual Intersections local_intersect(const Ray &ray) const = 0;
   virtual Tuple local_normal_at(const Tuple &point) const = 0;
 
+  /** Shapes whose normal depends on where they were hit, rather than on the
+   * point only, e.g. the triangles with interpolated normals, override this.
+   */
+  virtual Tuple local_normal_at(const Tuple &point,
+                                const Intersection &hit) const {
+    return local_normal_at(point);
+  }
+
+  /** Shapes should override this with an early exit, allocation free, test.
+   * The default implementation looks at all local_intersect results. */
+  virtual bool local_occludes(const Ray &ray, RayTracerDataType max_t) const;
+  virtual bool local_closest_hit(const Ray &ray, Intersection &hit) const;
+
+  /** Shapes should override this with a kernel testing all the lanes at once.
+   * The default implementation calls local_closest_hit on each lane. */
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const;
+
+  /** Returns this shape's bounding box, in object space. Shapes which do not
+   * know their extent are unbounded. */
+  virtual BoundingBox bounds() const { return BoundingBox::infinite(); }
+
+  /** Returns this shape's bounding box, in world space. It is cached and
+   * recomputed each time the shape is transformed: shapes with bounds must
+   * call update() from their constructor. */
+  const BoundingBox &world_bounds() const { return m_world_bounds; }
+
   virtual explicit operator std::string() const { return std::string(); }
 
   void update() override {
     m_transposed_inverted_transform = transpose(inverse_transform());
+    m_world_bounds = bounds().transform(transform());
   }
 
 private:
+  Tuple world_normal(const Tuple &local_normal) const {
+    Tuple world_normal = m_transposed_inverted_transform * local_normal;
+    world_normal[3] = 0;
+    return world_normal.normalize();
+  }
+
   Matrix m_transposed_inverted_transform;
   Material m_material;
+  BoundingBox m_world_bounds;
 };
 
+/** A sphere. Spheres which are only scaled uniformly and translated are
+ * still spheres in world space: their world space center and radius are
+ * cached, and the rays are intersected with them directly, without being
+ * transformed. Classes derived from Sphere which override the local_* queries
+ * must override the world space queries too. */
 class Sphere : public Shape {
 public:
-  Sphere() : Shape(), m_center(Point(0, 0, 0)), m_radius(1.0) {}
+  Sphere()
+      : Shape(), m_center(Point(0, 0, 0)), m_radius(1.0), m_world_space(false),
+        m_world_center(m_center), m_world_radius(m_radius) {
+    update();
+  }
 
   Sphere(const Sphere &) = default;
   Sphere(Sphere &&) = default;
@@ -77,13 +154,33 @@ public:
   const Tuple &center() const { return m_center; }
   const RayTracerDataType &radius() const { return m_radius; }
 
+  /** Is this sphere intersected in world space ? If so, world_center() and
+   * world_radius() are its center and radius in world space. */
+  bool world_space() const { return m_world_space; }
+  const Tuple &world_center() const { return m_world_center; }
+  RayTracerDataType world_radius() const { return m_world_radius; }
+
   bool operator==(const Sphere &rhs) const {
     return Shape::operator==(rhs) && m_center == rhs.m_center &&
            m_radius == rhs.m_radius;
   }
   bool operator!=(const Sphere &rhs) const { return !(*this == rhs); }
 
+  virtual Intersections intersect(const Ray &world_ray) const override;
+  virtual bool occludes(const Ray &world_ray,
+                        RayTracerDataType max_t) const override;
+  virtual bool closest_hit(const Ray &world_ray,
+                           Intersection &hit) const override;
+  virtual void closest_hit(const RayPacket &world_rays, unsigned mask,
+                           PacketHits &hits) const override;
+
   virtual Intersections local_intersect(const Ray &r) const override;
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override;
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override;
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const override;
 
   virtual Tuple local_normal_at(const Tuple &local_point) const override {
     return Vector(local_point.x() - m_center.x(),
@@ -91,17 +188,42 @@ public:
                   local_point.z() - m_center.z());
   }
 
+  virtual BoundingBox bounds() const override {
+    return BoundingBox(
+        Point(m_center.x() - m_radius, m_center.y() - m_radius,
+              m_center.z() - m_radius),
+        Point(m_center.x() + m_radius, m_center.y() + m_radius,
+              m_center.z() + m_radius));
+  }
+
   virtual explicit operator std::string() const override;
 
+  void update() override;
+
 private:
+  // The queries on the sphere of the given center and radius, in the space
+  // of the ray.
+  Intersections intersect_at(const Ray &r, const Tuple &center,
+                             RayTracerDataType radius) const;
+  bool occludes_at(const Ray &r, const Tuple &center, RayTracerDataType radius,
+                   RayTracerDataType max_t) const;
+  bool closest_hit_at(const Ray &r, const Tuple &center,
+                      RayTracerDataType radius, Intersection &hit) const;
+  void closest_hit_at(const RayPacket &rays, const Tuple &center,
+                      RayTracerDataType radius, unsigned mask,
+                      PacketHits &hits) const;
+
   Tuple m_center;
   RayTracerDataType m_radius;
+  bool m_world_space;
+  Tuple m_world_center;
+  RayTracerDataType m_world_radius;
 };
 
 // An XZ plane.
 class Plane : public Shape {
 public:
-  Plane() : Shape() {}
+  Plane() : Shape() { update(); }
 
   Plane(const Plane &) = default;
   Plane(Plane &&) = default;
@@ -113,11 +235,22 @@ public:
   bool operator!=(const Plane &rhs) const { return false; }
 
   virtual Intersections local_intersect(const Ray &r) const override;
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override;
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override;
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const override;
 
   virtual Tuple local_normal_at(const Tuple &local_point) const override {
     return Vector(0, 1, 0);
   }
 
+  virtual BoundingBox bounds() const override {
+    RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+    return BoundingBox(Point(-inf, 0, -inf), Point(inf, 0, inf));
+  }
+
   virtual explicit operator std::string() const override;
 };
 
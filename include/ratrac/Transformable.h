@@ -52,6 +52,15 @@ public:
     return *this;
   }
 
+  /** Set the transform to M, whose inverse is known to be inverse, e.g.
+   * because it was saved along with it: this skips the inversion. */
+  Transformable &transform(const Matrix &M, const Matrix &inverse) {
+    m_transform = M;
+    m_inverted_transform = inverse;
+    update();
+    return *this;
+  }
+
   Tuple transform(const Tuple &point) const { return m_transform * point; }
   Tuple inverse_transform(const Tuple &point) const {
     return m_inverted_transform * point;
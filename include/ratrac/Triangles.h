@@ -0,0 +1,179 @@
+#pragma once
+
+#include "ratrac/BVH.h"
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/ratrac.h"
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace ratrac {
+
+/** Möller–Trumbore intersection of ray r with the triangle with vertex p1 and
+ * edges e1 = p2 - p1 and e2 = p3 - p1. Returns true if the triangle is hit,
+ * with t and the barycentric coordinates (u, v) of the hit, the hit point
+ * being p1 + u * e1 + v * e2.
+ *
+ * The operations are spelled out, in the order the packet version of the mesh
+ * intersection uses, so that both give the same results. */
+inline bool intersect_triangle(const Ray &r, const Tuple &p1, const Tuple &e1,
+                               const Tuple &e2, Tuple::DataType &t,
+                               Tuple::DataType &u, Tuple::DataType &v) {
+  typedef Tuple::DataType DataType;
+  const Tuple &o = r.origin();
+  const Tuple &d = r.direction();
+  const DataType c0 = d[1] * e2[2] - d[2] * e2[1];
+  const DataType c1 = d[2] * e2[0] - d[0] * e2[2];
+  const DataType c2 = d[0] * e2[1] - d[1] * e2[0];
+  const DataType det = e1[0] * c0 + e1[1] * c1 + e1[2] * c2;
+  // The ray is parallel to the triangle. The determinant scales with the
+  // triangle's area, so only an exact 0 is rejected: meshes have tiny
+  // triangles.
+  if (det == 0)
+    return false;
+
+  const DataType f = DataType(1) / det;
+  const DataType s0 = o[0] - p1[0], s1 = o[1] - p1[1], s2 = o[2] - p1[2];
+  u = f * (s0 * c0 + s1 * c1 + s2 * c2);
+  if (u < 0 || u > 1)
+    return false;
+
+  const DataType q0 = s1 * e1[2] - s2 * e1[1];
+  const DataType q1 = s2 * e1[0] - s0 * e1[2];
+  const DataType q2 = s0 * e1[1] - s1 * e1[0];
+  v = f * (d[0] * q0 + d[1] * q1 + d[2] * q2);
+  if (v < 0 || u + v > 1)
+    return false;
+
+  t = f * (e2[0] * q0 + e2[1] * q1 + e2[2] * q2);
+  return true;
+}
+
+/** A single triangle. Triangles have a flat normal, unless normals are given
+ * for their vertices, in which case the normal is interpolated between them
+ * (smooth triangles). Use a TriangleMesh for anything but a few triangles. */
+class Triangle : public Shape {
+public:
+  Triangle(const Tuple &p1, const Tuple &p2, const Tuple &p3);
+  Triangle(const Tuple &p1, const Tuple &p2, const Tuple &p3, const Tuple &n1,
+           const Tuple &n2, const Tuple &n3);
+
+  const Tuple &p1() const { return m_p[0]; }
+  const Tuple &p2() const { return m_p[1]; }
+  const Tuple &p3() const { return m_p[2]; }
+  const Tuple &e1() const { return m_e1; }
+  const Tuple &e2() const { return m_e2; }
+  /** The flat normal, in object space. */
+  const Tuple &normal() const { return m_normal; }
+
+  bool smooth() const { return m_smooth; }
+  const Tuple &n1() const { return m_n[0]; }
+  const Tuple &n2() const { return m_n[1]; }
+  const Tuple &n3() const { return m_n[2]; }
+
+  virtual Intersections local_intersect(const Ray &r) const override;
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override;
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override;
+
+  virtual Tuple local_normal_at(const Tuple &local_point) const override {
+    return m_normal;
+  }
+  virtual Tuple local_normal_at(const Tuple &local_point,
+                                const Intersection &hit) const override;
+
+  virtual BoundingBox bounds() const override;
+
+  virtual explicit operator std::string() const override;
+
+private:
+  Tuple m_p[3];
+  Tuple m_e1;
+  Tuple m_e2;
+  Tuple m_normal;
+  Tuple m_n[3];
+  bool m_smooth;
+};
+
+/** A mesh of triangles, as a single shape: the vertices, the optional vertex
+ * normals and the faces are stored in contiguous buffers, the faces being
+ * triplets of indices in the vertex buffer. The mesh has a single transform
+ * and material, and its own BVH over its faces, so that the meshes with
+ * millions of faces are intersected in logarithmic time.
+ *
+ * Meshes with vertex normals are smooth: the normal is interpolated between
+ * the normals of the vertices of the hit face. The others have the flat
+ * normals of their faces.
+ */
+class TriangleMesh : public Shape {
+public:
+  /** Create a mesh of vertices, whose faces are the vertex index triplets of
+   * indices. normals is either empty, or has a normal for each vertex. The
+   * BVH over the faces is built with threads parallel workers. */
+  TriangleMesh(std::vector<Tuple> vertices, std::vector<unsigned> indices,
+               std::vector<Tuple> normals = std::vector<Tuple>(),
+               unsigned threads = 1);
+  /** Same, with the BVH over the faces already built, e.g. loaded from a
+   * scene cache. */
+  TriangleMesh(std::vector<Tuple> vertices, std::vector<unsigned> indices,
+               std::vector<Tuple> normals, BVH bvh);
+
+  unsigned num_vertices() const { return m_vertices.size(); }
+  unsigned num_faces() const { return m_indices.size() / 3; }
+  bool smooth() const { return !m_normals.empty(); }
+
+  const std::vector<Tuple> &vertices() const { return m_vertices; }
+  const std::vector<unsigned> &indices() const { return m_indices; }
+  const std::vector<Tuple> &normals() const { return m_normals; }
+
+  /** Returns vertex k (0, 1 or 2) of face. */
+  const Tuple &vertex(unsigned face, unsigned k) const {
+    assert(face < num_faces() && k < 3 && "Out of bounds face vertex access");
+    return m_vertices[m_indices[3 * face + k]];
+  }
+
+  /** Returns the flat normal of face, in object space. */
+  Tuple face_normal(unsigned face) const;
+
+  const BVH &bvh() const { return m_bvh; }
+
+  virtual Intersections local_intersect(const Ray &r) const override;
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override;
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override;
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const override;
+
+  /** Without the hit, the face containing local_point has to be searched
+   * for, which is slow: the normal_at queries with the hit are the fast path.
+   */
+  virtual Tuple local_normal_at(const Tuple &local_point) const override;
+  virtual Tuple local_normal_at(const Tuple &local_point,
+                                const Intersection &hit) const override;
+
+  virtual BoundingBox bounds() const override { return m_bvh.bounds(); }
+
+  virtual explicit operator std::string() const override;
+
+private:
+  bool intersect_face(unsigned face, const Ray &r, Tuple::DataType &t,
+                      Tuple::DataType &u, Tuple::DataType &v) const {
+    const Tuple &p1 = vertex(face, 0);
+    return intersect_triangle(r, p1, vertex(face, 1) - p1,
+                              vertex(face, 2) - p1, t, u, v);
+  }
+
+  std::vector<Tuple> m_vertices;
+  std::vector<unsigned> m_indices;
+  std::vector<Tuple> m_normals;
+  BVH m_bvh;
+};
+
+} // namespace ratrac
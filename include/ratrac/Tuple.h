@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ratrac/SIMD.h"
 #include "ratrac/ratrac.h"
 
 #include <cassert>
@@ -64,15 +65,14 @@ public:
 
   constexpr size_t size() const noexcept { return 4; }
 
+  /** Direct access to the 4 components, for the vector kernels. */
+  constexpr DataType *data() noexcept { return m_tuple; }
+  constexpr const DataType *data() const noexcept { return m_tuple; }
+
   // Advanced vectors properties
   // ===========================
 
-  DataType magnitude() const {
-    DataType result = DataType();
-    for (size_t i = 0; i < NC; i++)
-      result += m_tuple[i] * m_tuple[i];
-    return std::sqrt(result);
-  }
+  DataType magnitude() const { return std::sqrt(dot(*this)); }
 
   Tuple &normalize() {
     *this /= magnitude();
@@ -93,23 +93,31 @@ public:
   // operations
 
   constexpr Tuple &operator+=(const Tuple &rhs) noexcept {
-    for (size_t i = 0; i < NC; i++)
-      m_tuple[i] += rhs.m_tuple[i];
+    if (simd::is_constant_evaluated())
+      simd::scalar::add4(m_tuple, rhs.m_tuple);
+    else
+      simd::native::add4(m_tuple, rhs.m_tuple);
     return *this;
   }
   constexpr Tuple &operator-=(const Tuple &rhs) noexcept {
-    for (size_t i = 0; i < NC; i++)
-      m_tuple[i] -= rhs.m_tuple[i];
+    if (simd::is_constant_evaluated())
+      simd::scalar::sub4(m_tuple, rhs.m_tuple);
+    else
+      simd::native::sub4(m_tuple, rhs.m_tuple);
     return *this;
   }
   constexpr Tuple &operator*=(DataType rhs) noexcept {
-    for (size_t i = 0; i < NC; i++)
-      m_tuple[i] *= rhs;
+    if (simd::is_constant_evaluated())
+      simd::scalar::mul4(m_tuple, rhs);
+    else
+      simd::native::mul4(m_tuple, rhs);
     return *this;
   }
   constexpr Tuple &operator/=(DataType rhs) noexcept {
-    for (size_t i = 0; i < NC; i++)
-      m_tuple[i] /= rhs;
+    if (simd::is_constant_evaluated())
+      simd::scalar::div4(m_tuple, rhs);
+    else
+      simd::native::div4(m_tuple, rhs);
     return *this;
   }
 
@@ -120,10 +128,9 @@ public:
   // Advanced operations
 
   constexpr DataType dot(const Tuple &rhs) const noexcept {
-    DataType result = DataType();
-    for (size_t i = 0; i < NC; i++)
-      result += m_tuple[i] * rhs.m_tuple[i];
-    return result;
+    if (simd::is_constant_evaluated())
+      return simd::scalar::dot4(m_tuple, rhs.m_tuple);
+    return simd::native::dot4(m_tuple, rhs.m_tuple);
   }
 
   constexpr Tuple cross(const Tuple &rhs) const noexcept {
@@ -137,7 +144,7 @@ public:
 
   constexpr Tuple reflect(const Tuple &normal) const noexcept {
     Tuple n = normal;
-    n *= 2.0 * dot(normal);
+    n *= DataType(2) * dot(normal);
     Tuple tmp(*this);
     tmp -= n;
     return tmp;
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "ratrac/Camera.h"
+#include "ratrac/Canvas.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Ray.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+#include "ratrac/ratrac.h"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ratrac {
+
+/** A queue of rays, stored as a structure of arrays, so that the stages
+ * processing them go through each component of all the rays with vector
+ * instructions. Each ray comes with its maximum distance, and an id telling
+ * the stage consuming the queue what the ray was spawned for (e.g. its
+ * pixel). */
+class RayQueue {
+public:
+  typedef Tuple::DataType DataType;
+
+  RayQueue() : m_origin(), m_direction(), m_tmax(), m_id() {}
+
+  size_t size() const { return m_id.size(); }
+  bool empty() const { return m_id.empty(); }
+
+  void clear() { resize(0); }
+  void reserve(size_t n);
+
+  /** Resize the queue to n rays. The rays added are to be filled through the
+   * component arrays. */
+  void resize(size_t n);
+
+  void push(const Ray &r, DataType tmax, unsigned id) {
+    for (unsigned c = 0; c < 4; c++) {
+      m_origin[c].push_back(r.origin()[c]);
+      m_direction[c].push_back(r.direction()[c]);
+    }
+    m_tmax.push_back(tmax);
+    m_id.push_back(id);
+  }
+
+  Ray ray(size_t i) const {
+    assert(i < size() && "Out of bound access to RayQueue");
+    return Ray(Tuple(m_origin[0][i], m_origin[1][i], m_origin[2][i],
+                     m_origin[3][i]),
+               Tuple(m_direction[0][i], m_direction[1][i], m_direction[2][i],
+                     m_direction[3][i]));
+  }
+
+  /** Returns the count rays starting at i, with count <= RayPacket::SIZE, as
+   * a packet. The lanes past count get ray i. */
+  RayPacket packet(size_t i, unsigned count) const;
+
+  // The component arrays, indexed by ray.
+  const DataType *origin(unsigned c) const { return m_origin[c].data(); }
+  const DataType *direction(unsigned c) const { return m_direction[c].data(); }
+  const DataType *tmax() const { return m_tmax.data(); }
+  const unsigned *id() const { return m_id.data(); }
+  DataType *origin(unsigned c) { return m_origin[c].data(); }
+  DataType *direction(unsigned c) { return m_direction[c].data(); }
+  DataType *tmax() { return m_tmax.data(); }
+  unsigned *id() { return m_id.data(); }
+
+private:
+  std::vector<DataType> m_origin[4];
+  std::vector<DataType> m_direction[4];
+  std::vector<DataType> m_tmax;
+  std::vector<unsigned> m_id;
+};
+
+/** The staged rendering pipeline of the camera's wavefront mode. Instead of
+ * following the rays of each pixel from the camera to the lights, as
+ * color_at does, a block of pixels goes through 5 stages, each of them
+ * processing all the rays of the block before the next one starts:
+ *  - generate: the primary rays of all pixels, in the camera's packet order,
+ *  - intersect: their closest hits, by packets of the camera's packet size,
+ *  - shade: the surface computations of the hits, and the shadow rays from
+ *    each hit to each light,
+ *  - shadow_test: the occlusion of the shadow rays, which are traced light
+ *    by light, sorted by direction octant and origin cell, so that
+ *    consecutive rays, traced one by one, traverse the same nodes of the
+ *    acceleration structure,
+ *  - accumulate: the lights' contributions, summed into the pixels with the
+ *    runtime-dispatched accumulate_colors kernel.
+ *
+ * Each stage is a tight loop over a queue, with its own working set, instead
+ * of the mix of workloads of the recursive flow. The stages compute what
+ * color_at computes, in the same order, so the image is the same, bit for
+ * bit. A pipeline reuses its queues from one block to the next: concurrent
+ * renderings use one pipeline per thread.
+ */
+class Wavefront {
+public:
+  typedef Tuple::DataType DataType;
+
+  Wavefront(const Camera &camera, const World &world)
+      : m_camera(camera), m_world(world), m_x(), m_y(), m_primary(), m_hits(),
+        m_surfaces(), m_pixels(), m_shadow(), m_order(), m_shadowed(),
+        m_contributions(), m_colors() {}
+
+  /** Render the pixels in [x0:x1[ x [y0:y1[ to image, stage by stage. */
+  void render(Canvas &image, unsigned x0, unsigned y0, unsigned x1,
+              unsigned y1) {
+    generate(x0, y0, x1, y1);
+    intersect();
+    shade();
+    shadow_test();
+    accumulate(image);
+  }
+
+  /** The stages, in order, each consuming the queues of the previous one. */
+  void generate(unsigned x0, unsigned y0, unsigned x1, unsigned y1);
+  void intersect();
+  void shade();
+  void shadow_test();
+  void accumulate(Canvas &image);
+
+  /** The primary rays, whose ids are the pixels' y * hsize + x. */
+  const RayQueue &primary_rays() const { return m_primary; }
+
+  /** The closest hit of each primary ray. */
+  const std::vector<Intersection> &hits() const { return m_hits; }
+
+  /** The surfaces hit, with their pixel ids, in the primary rays' order. */
+  const std::vector<Computations> &surfaces() const { return m_surfaces; }
+  const std::vector<unsigned> &pixels() const { return m_pixels; }
+
+  /** The shadow rays, light by light: the ray from surface s to light i is
+   * at i * surfaces().size() + s, with s as its id, and shadowed() tells, at
+   * the same index, whether surface s is in the shadow of light i. */
+  const RayQueue &shadow_rays() const { return m_shadow; }
+  const std::vector<char> &shadowed() const { return m_shadowed; }
+
+private:
+  const Camera &m_camera;
+  const World &m_world;
+  // The coordinates of the primary rays' pixels.
+  std::vector<DataType> m_x;
+  std::vector<DataType> m_y;
+  RayQueue m_primary;
+  std::vector<Intersection> m_hits;
+  std::vector<Computations> m_surfaces;
+  std::vector<unsigned> m_pixels;
+  RayQueue m_shadow;
+  // The sort keys of the shadow rays, with their indices.
+  std::vector<std::pair<uint32_t, unsigned>> m_order;
+  std::vector<char> m_shadowed;
+  // The contribution of one light to each surface, and their sums.
+  std::vector<Color> m_contributions;
+  std::vector<Color> m_colors;
+};
+
+} // namespace ratrac
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "ratrac/BVH.h"
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/Ray.h"
+#include "ratrac/ratrac.h"
+
+#include <cassert>
+#include <ostream>
+#include <vector>
+
+namespace ratrac {
+
+/** A 4-wide BVH, collapsed from a binary BVH: each node has up to 4 children,
+ * whose boxes are stored together, axis by axis, so that a ray is tested
+ * against all of them at once with the slab4 kernel (see Kernels).
+ *
+ * The collapse keeps the leaves of the binary BVH, and fills each node by
+ * replacing its child with the largest box by that child's children, until
+ * it has 4 children or only leaves. The boxes are the single precision boxes
+ * of the binary nodes. A node takes 2 cache lines, and there are about 3
+ * times fewer nodes than in the binary BVH, hence fewer and more useful
+ * memory accesses per ray.
+ *
+ * As the BVH, the wide BVH only knows about primitive indices.
+ */
+class WideBVH {
+public:
+  typedef RayTracerDataType DataType;
+
+  static constexpr unsigned WIDTH = 4;
+  static constexpr unsigned NO_CHILD = ~0U;
+
+  /** A node, whose children are in slots [0:WIDTH[. An interior child is the
+   * node at index child, and a leaf child has count primitives, at
+   * indices()[child:child + count[. Unused slots have NO_CHILD as child and
+   * an empty box, which no ray crosses. */
+  struct alignas(64) Node {
+    float min[3][WIDTH];
+    float max[3][WIDTH];
+    unsigned child[WIDTH];
+    unsigned count[WIDTH]; // 0 for interior children and unused slots.
+  };
+
+  WideBVH() : m_nodes(), m_indices(), m_parents(), m_leaves() {}
+
+  /** Collapse bvh into a wide BVH over the same primitives. */
+  explicit WideBVH(const BVH &bvh);
+
+  /** Number of primitives in this BVH. */
+  size_t size() const { return m_indices.size(); }
+  bool empty() const { return m_indices.empty(); }
+
+  const std::vector<Node> &nodes() const { return m_nodes; }
+  const std::vector<unsigned> &indices() const { return m_indices; }
+
+  /** Returns the bounding box of all primitives. */
+  BoundingBox bounds() const;
+
+  /** Returns the depth of the tree. */
+  unsigned depth() const;
+
+  /** Refit the children's boxes to boxes, the primitives' new bounding
+   * boxes, when only the primitives in moved have a new box, as
+   * BVH::refit(boxes, moved) does: the tree is kept as it is, and only the
+   * leaf slots of the moved primitives, and the slots above them whose box
+   * changes, are refitted. The first refit records each node's parent. */
+  void refit(const std::vector<BoundingBox> &boxes,
+             const std::vector<unsigned> &moved);
+
+  /** Call visit(primitive) for each primitive whose box is hit by ray r for
+   * some t in [tmin:tmax]. The visitor returns true to stop the traversal.
+   * The children of a node are visited from the nearest to the farthest
+   * along the ray, and tmax is re-read for each of them, so a visitor
+   * looking for the closest hit can shrink it as it finds intersections:
+   * the children beyond it are then skipped. */
+  template <class VisitorTy>
+  void traverse(const Ray &r, DataType tmin, const DataType &tmax,
+                VisitorTy visit) const {
+    if (m_nodes.empty())
+      return;
+
+    const auto slab4 = kernels().slab4;
+    const SlabRay sr(r);
+    const DataType origin[3] = {sr.origin[0], sr.origin[1], sr.origin[2]};
+    const DataType inv_direction[3] = {
+        sr.inv_direction[0], sr.inv_direction[1], sr.inv_direction[2]};
+    // The children to visit, with the distance at which the ray enters their
+    // box. Each level of the tree leaves at most WIDTH - 1 entries on the
+    // stack.
+    struct Entry {
+      unsigned child;
+      unsigned count;
+      DataType t;
+    } stack[(WIDTH - 1) * BVH::MAX_DEPTH + 1];
+    unsigned top = 0;
+    stack[top++] = {0, 0, tmin};
+    while (top) {
+      const Entry e = stack[--top];
+      if (e.t > tmax)
+        continue;
+      if (e.count) {
+        for (unsigned i = e.child; i < e.child + e.count; i++)
+          if (visit(m_indices[i]))
+            return;
+        continue;
+      }
+
+      const Node &node = m_nodes[e.child];
+      const float *near[3], *far[3];
+      for (unsigned a = 0; a < 3; a++) {
+        near[a] = sr.sign[a] ? node.max[a] : node.min[a];
+        far[a] = sr.sign[a] ? node.min[a] : node.max[a];
+      }
+      DataType t0[WIDTH], t1[WIDTH];
+      for (unsigned i = 0; i < WIDTH; i++) {
+        t0[i] = tmin;
+        t1[i] = tmax;
+      }
+      const unsigned hits = slab4(near, far, origin, inv_direction, t0, t1);
+
+      // Sort the children hit from the farthest to the nearest, and push
+      // them in that order, so that the nearest is visited first.
+      unsigned order[WIDTH], n = 0;
+      for (unsigned i = 0; i < WIDTH; i++) {
+        if (!(hits & (1U << i)))
+          continue;
+        unsigned j = n++;
+        for (; j > 0 && t0[order[j - 1]] < t0[i]; j--)
+          order[j] = order[j - 1];
+        order[j] = i;
+      }
+      assert(top + n <= (WIDTH - 1) * BVH::MAX_DEPTH + 1 &&
+             "WideBVH is too deep");
+      for (unsigned j = 0; j < n; j++)
+        stack[top++] = {node.child[order[j]], node.count[order[j]],
+                        t0[order[j]]};
+    }
+  }
+
+private:
+  unsigned collapse(const BVH &bvh, unsigned node);
+  bool fit(unsigned node, unsigned slot,
+           const std::vector<BoundingBox> &boxes);
+
+  std::vector<Node> m_nodes;
+  std::vector<unsigned> m_indices;
+  // For the refits: the parent of each node, and the leaf slot of each
+  // primitive, as node * WIDTH + slot.
+  std::vector<unsigned> m_parents;
+  std::vector<unsigned> m_leaves;
+};
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::WideBVH &bvh);
@@ -1,30 +1,55 @@
 #pragma once
 
+#include "ratrac/BVH.h"
+#include "ratrac/Grid.h"
 #include "ratrac/Light.h"
 #include "ratrac/Ray.h"
+#include "ratrac/ShapeArrays.h"
 #include "ratrac/Shapes.h"
+#include "ratrac/WideBVH.h"
 #include "ratrac/ratrac.h"
 
+#include <atomic>
 #include <cassert>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <vector>
 
 namespace ratrac {
+/** The acceleration structures a World can use over its bounded objects: a
+ * BVH, the default, a 4-wide BVH collapsed from it, which is traversed with
+ * fewer memory accesses, or a uniform grid, which is cheaper to build and
+ * traverse for dense scenes of evenly distributed objects of similar sizes.
+ * The packet queries traverse the wide BVH and the grid one lane at a time.
+ */
+enum class Accelerator { BVH, WIDE_BVH, GRID };
+
 class World {
 public:
-  World() : m_lights(), m_objects() {}
-  World(const World &) = default;
-  World(World &&) = default;
+  /** Number of objects from which World::intersect uses an acceleration
+   * structure (a BVH or a grid) instead of testing all objects. */
+  static constexpr unsigned BVH_THRESHOLD = 16;
+
+  World()
+      : m_lights(), m_objects(), m_accelerator(Accelerator::BVH), m_accel(),
+        m_accel_ready(nullptr), m_accel_lock(new std::mutex()) {}
+  World(const World &) = delete;
+  World(World &&other);
 
-  World &operator=(const World &) = default;
-  World &operator=(World &&) = default;
+  World &operator=(const World &) = delete;
+  World &operator=(World &&rhs);
 
   const std::vector<LightPoint> &lights() const { return m_lights; }
   const std::vector<std::unique_ptr<Shape>> &objects() const { return m_objects; }
 
+  // The mutable accessors to the objects invalidate the acceleration
+  // structure, as the objects may get modified through them.
   std::vector<LightPoint> &lights() { return m_lights; }
-  std::vector<std::unique_ptr<Shape>> &objects() { return m_objects; }
+  std::vector<std::unique_ptr<Shape>> &objects() {
+    invalidate();
+    return m_objects;
+  }
 
   LightPoint *light(unsigned i) {
     assert(i < m_lights.size());
@@ -32,6 +57,7 @@ public:
   }
   Shape *object(unsigned i) {
     assert(i < m_objects.size());
+    invalidate();
     return m_objects[i].get();
   }
 
@@ -47,17 +73,127 @@ public:
   // Add Shape s to our World, taking ownership of the pointer.
   World &append(Shape *s) {
     m_objects.push_back(std::unique_ptr<Shape>(s));
+    invalidate();
     return *this;
   }
 
   Intersections intersect(const Ray &r) const;
 
+  /** Closest hit query: returns the intersection with the smallest t >= 0, or
+   * an intersection with a null object if the ray hits nothing. Only the
+   * running minimum is kept: this does not allocate memory. */
+  Intersection closest_hit(const Ray &r) const;
+
+  /** Packet closest hit query: closest_hit for each lane of rays in mask.
+   * The objects are tested in the same order as for a single ray, so the hit
+   * of each lane is exactly the one closest_hit returns for its ray. */
+  PacketHits closest_hit(const RayPacket &rays, unsigned mask) const;
+
+  /** Occlusion query: is there any intersection with t in [0:max_t[ ? This
+   * returns as soon as one is found, and does not allocate memory. */
+  bool occluded(const Ray &r, RayTracerDataType max_t) const;
+
+  /** The acceleration structure is built lazily, on the first intersection,
+   * and rebuilt when objects are added or accessed through the mutable
+   * accessors. Shapes which are modified (e.g. transformed) through pointers
+   * obtained before the world has been intersected require an explicit
+   * invalidation.
+   *
+   * The rebuild frees the previous structure, which concurrent intersections
+   * may still be traversing: a world must not be modified, or invalidated,
+   * while it is intersected, e.g. during Camera::render. The lazy build is
+   * safe, but Camera::render prepares the world before it starts. */
+  void invalidate() { m_accel_ready = nullptr; }
+
+  /** Update the acceleration structure after the objects whose indices are in
+   * moved have been transformed, through pointers obtained earlier (e.g.
+   * from append), for animations where only a few objects move per frame.
+   *
+   * Instead of a rebuild, only the moved objects' snapshots are updated, and
+   * only the BVH boxes above them are refitted, so that the cost is O(depth)
+   * per moved object. The meshes' own BVHs are in object space, so they are
+   * left untouched. The tree itself is kept, so it degrades as the objects
+   * move away from where they were when it was built (see BVH::cost): an
+   * invalidation rebuilds it. Objects which become unbounded, or bounded,
+   * require a rebuild, which is then done on the next intersection, as does
+   * any move for worlds using a grid, whose build is linear anyway. The wide
+   * BVHs are refitted the same way, keeping the tree they were collapsed to.
+   * As for the objects' transforms, this must not run concurrently with
+   * intersections. */
+  void refit(const std::vector<unsigned> &moved);
+
+  /** The acceleration structure to use: selecting one invalidates the
+   * current one. */
+  Accelerator accelerator() const { return m_accelerator; }
+  void accelerator(Accelerator accelerator) {
+    m_accelerator = accelerator;
+    invalidate();
+  }
+
+  /** Returns the BVH used to accelerate intersections, building it if needed,
+   * or nullptr if the world is too small to need one, or uses a grid. For
+   * worlds using a wide BVH, this is the BVH it was collapsed from. */
+  const BVH *bvh() const;
+
+  /** Same, for the wide BVH used when the accelerator is
+   * Accelerator::WIDE_BVH. */
+  const WideBVH *wide_bvh() const;
+
+  /** Same, for the grid used when the accelerator is Accelerator::GRID. */
+  const Grid *grid() const;
+
+  /** Build the acceleration structure now, with threads parallel workers,
+   * instead of on the first intersection, which builds it sequentially. */
+  void prepare(unsigned threads = 1) const;
+
+  /** Build the acceleration structure now, adopting bvh instead of building
+   * one, e.g. the BVH a scene cache saved along with the objects. Returns
+   * false, leaving the structure to be built lazily, if bvh can not be the
+   * BVH of this world's objects, or if the world uses a grid. Worlds using
+   * a wide BVH collapse bvh. */
+  bool accelerate(BVH bvh);
+
   // Get a default World, with a light and some objects.
   static World get_default();
 
 private:
+  /** The acceleration structure: the objects' geometry packed by type (see
+   * ShapeArrays) and, for worlds of BVH_THRESHOLD objects or more, a BVH or a
+   * grid over the bounded objects: worlds using a wide BVH have both the
+   * BVH and the wide BVH collapsed from it. Without either, shapes has all the
+   * objects. With one, shapes has the unbounded objects (e.g. planes), which
+   * are always tested, and BVH or grid primitive i is primitive i of bounded.
+   * Slot i is where object i is, for the refits. */
+  struct Slot {
+    unsigned prim;
+    bool bounded;
+  };
+  struct Acceleration {
+    ShapeArrays shapes;
+    ShapeArrays bounded;
+    BVH bvh;
+    WideBVH wide_bvh;
+    Grid grid;
+    bool has_bvh;
+    bool has_wide_bvh;
+    bool has_grid;
+    size_t num_objects;
+    std::vector<Slot> slots;
+  };
+
+  const Acceleration *acceleration() const;
+  std::unique_ptr<Acceleration> build_acceleration(BVH *bvh,
+                                                  unsigned threads = 1) const;
+
   std::vector<LightPoint> m_lights;
   std::vector<std::unique_ptr<Shape>> m_objects;
+  Accelerator m_accelerator;
+  // Intersections can happen concurrently, from different threads, so the
+  // lazy construction of the acceleration structure is protected by a lock.
+  // Modifications can not happen concurrently with them (see invalidate).
+  mutable std::unique_ptr<Acceleration> m_accel;
+  mutable std::atomic<const Acceleration *> m_accel_ready;
+  mutable std::unique_ptr<std::mutex> m_accel_lock;
 };
 
 } // namespace ratrac
@@ -4,7 +4,13 @@
 
 namespace ratrac {
 
+// The scalar type of the geometry: the ratrac-float library is built with
+// RATRAC_USES_FLOAT defined, for single precision renders.
+#if defined(RATRAC_USES_FLOAT)
+using RayTracerDataType = float;
+#else
 using RayTracerDataType = double;
+#endif
 using RayTracerColorType = float;
 
 // Cap a component to [0:MaxValue]
@@ -21,9 +27,26 @@ template <class DataTy> inline constexpr DataTy EPSILON() noexcept {
   return DataTy(0.00001);
 }
 
+/** How far along the surface normal a hit point is moved before casting
+ * shadow rays from it, so that rounding errors do not make the surface
+ * shadow itself (acne). It must stay well above the rounding errors of
+ * DataTy at the scale of the scenes, so single precision needs a larger offset
+ * than EPSILON: 0.001 is enough for scenes spanning a thousand units. */
+template <class DataTy> inline constexpr DataTy SURFACE_OFFSET() noexcept {
+  return EPSILON<DataTy>();
+}
+template <> inline constexpr float SURFACE_OFFSET<float>() noexcept {
+  return 0.001f;
+}
+
 template <class DataTy>
 inline constexpr bool close_to_equal(DataTy a, DataTy b) {
   return std::fabs(a - b) < EPSILON<DataTy>();
 }
 
+template <class DataTy>
+inline constexpr bool close_to_equal(DataTy a, DataTy b, DataTy epsilon) {
+  return std::fabs(a - b) < epsilon;
+}
+
 } // namespace ratrac
@@ -1,10 +1,17 @@
 #include "ratrac/App.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/Ray.h"
+#include "ratrac/SceneCache.h"
+#include "ratrac/World.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using std::cout;
 using std::ofstream;
@@ -18,7 +25,8 @@ App::App(const string &programName, const string &description, size_t width,
          size_t height)
     : ArgParse(programName, description),
       m_outputFilename(programName + ".ppm"), m_outputFormat(App::PPM),
-      m_width(width), m_height(height), m_verbosity(0) {
+      m_width(width), m_height(height), m_threads(1), m_packet_width(4),
+      m_packet_height(2), m_cacheFilename(), m_verbosity(0) {
   addOption({"--help", "-?"}, "Display this help message.", [&]() {
     cout << help() << '\n';
     exit(EXIT_SUCCESS);
@@ -64,11 +72,80 @@ App::App(const string &programName, const string &description, size_t width,
 #endif
         return false;
       });
+
+  addOptionWithValue(
+      {"--threads", "-j"}, "N",
+      "Render with N threads (0: one per hardware thread)",
+      [&](const string &s) {
+        // Parsed as signed, so that negative counts are rejected instead of
+        // wrapping around to huge ones.
+        char *end;
+        const long n = std::strtol(s.c_str(), &end, 10);
+        if (s.empty() || *end != '\0' || n < 0 ||
+            n > long(std::numeric_limits<unsigned>::max()))
+          return false;
+        m_threads = n ? unsigned(n)
+                      : std::max(1U, std::thread::hardware_concurrency());
+        return true;
+      });
+
+  addOptionWithValue(
+      {"--packet", "-p"}, "WxH",
+      "Trace primary rays in packets of WxH pixels (1x1: no packets)",
+      [&](const string &s) {
+        size_t pos;
+        unsigned w = stoul(s, &pos, 10);
+        if (pos >= s.size() || s[pos] != 'x')
+          return false;
+        unsigned h = stoul(s.substr(pos + 1), nullptr, 10);
+        if (w == 0 || h == 0 || w * h > RayPacket::SIZE)
+          return false;
+        m_packet_width = w;
+        m_packet_height = h;
+        return true;
+      });
+
+  addOptionWithValue(
+      {"--cache", "-c"}, "F",
+      "Load the scene from the binary cache F if it exists, or save it there",
+      [&](const string &s) {
+        m_cacheFilename = s;
+        return true;
+      });
+}
+
+bool App::load_scene(World &world) const {
+  if (m_cacheFilename.empty())
+    return false;
+  string error;
+  if (!ratrac::load_scene(world, m_cacheFilename, &error)) {
+    if (verbose())
+      cout << "Scene cache not loaded: " << error << '\n';
+    return false;
+  }
+  if (verbose())
+    cout << "Scene loaded from " << m_cacheFilename << '\n';
+  return true;
+}
+
+void App::save_scene(const World &world) const {
+  if (m_cacheFilename.empty())
+    return;
+  string error;
+  if (!ratrac::save_scene(world, m_cacheFilename, &error))
+    std::cerr << "Scene cache not saved: " << error << '\n';
+  else if (verbose())
+    cout << "Scene saved to " << m_cacheFilename << '\n';
 }
 
 string App::parameters() const {
   ostringstream os;
   os << "Canvas size: " << width() << 'x' << height() << '\n';
+  os << "Threads: " << threads() << '\n';
+  os << "Packet size: " << packet_width() << 'x' << packet_height() << '\n';
+  if (!cacheFilename().empty())
+    os << "Scene cache: " << cacheFilename() << '\n';
+  os << "Instruction set: " << name(kernels().isa) << '\n';
   os << "Ouput file: " << outputFilename() << " (";
   switch (outputFormat()) {
   case App::PPM:
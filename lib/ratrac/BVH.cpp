@@ -0,0 +1,562 @@
+#include "ratrac/BVH.h"
+#include "ratrac/Scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace ratrac {
+
+namespace {
+typedef BVH::DataType DataType;
+typedef BVH::Node Node;
+
+// Number of bins used to evaluate the SAH along each axis.
+const unsigned NUM_BINS = 12;
+// Relative costs of traversing a node and of intersecting a primitive.
+const DataType TRAVERSAL_COST = 1.0;
+const DataType INTERSECTION_COST = 1.0;
+// The nodes of PARALLEL_SIZE primitives or more are split one level at a
+// time, the binning and the partitioning of all the nodes of a level being
+// done in parallel, by chunks of CHUNK_SIZE primitives. The smaller nodes are
+// then built as independent tasks, each with the sequential build. The
+// parallel partitions are stable, unlike the sequential ones, and none of
+// this depends on the number of threads: neither does the tree.
+const unsigned PARALLEL_SIZE = 1U << 14;
+const unsigned CHUNK_SIZE = 1U << 12;
+// The offset of the node slots which are not used (see Builder).
+const unsigned NO_NODE = ~0U;
+
+struct Primitive {
+  BoundingBox box;
+  Tuple centroid;
+  unsigned index;
+};
+
+/** The box of a set of primitives, and the box of their centroids. */
+struct Bounds {
+  BoundingBox box;
+  BoundingBox centroids;
+
+  void add(const Primitive &p) {
+    box.add(p.box);
+    centroids.add(p.centroid);
+  }
+  void add(const Bounds &b) {
+    box.add(b.box);
+    centroids.add(b.centroids);
+  }
+};
+
+/** The SAH bins of a set of primitives, along each axis. */
+struct Bins {
+  BoundingBox boxes[3][NUM_BINS];
+  unsigned counts[3][NUM_BINS] = {};
+
+  void add(const Bins &b) {
+    for (unsigned axis = 0; axis < 3; axis++)
+      for (unsigned i = 0; i < NUM_BINS; i++) {
+        boxes[axis][i].add(b.boxes[axis][i]);
+        counts[axis][i] += b.counts[axis][i];
+      }
+  }
+};
+
+/** Returns the bin of centroid along axis, for primitives whose centroids are
+ * in centroids. */
+inline unsigned bin_of(const Tuple &centroid, unsigned axis,
+                       const BoundingBox &centroids) {
+  const DataType cmin = centroids.min()[axis];
+  const DataType cextent = centroids.max()[axis] - cmin;
+  unsigned b = NUM_BINS * ((centroid[axis] - cmin) / cextent);
+  return std::min(b, NUM_BINS - 1);
+}
+
+inline bool has_extent(const BoundingBox &centroids, unsigned axis) {
+  return centroids.max()[axis] - centroids.min()[axis] > DataType();
+}
+
+/** Add the primitives in [first:last[ to bins, along the axes where their
+ * centroids, in centroids, are spread. */
+void bin(const Primitive *first, const Primitive *last,
+         const BoundingBox &centroids, Bins &bins) {
+  for (unsigned axis = 0; axis < 3; axis++) {
+    if (!has_extent(centroids, axis))
+      continue;
+    for (const Primitive *p = first; p != last; ++p) {
+      const unsigned b = bin_of(p->centroid, axis, centroids);
+      bins.counts[axis][b]++;
+      bins.boxes[axis][b].add(p->box);
+    }
+  }
+}
+
+/** A split: the primitives in the bins before bin along axis go left. Its
+ * cost is infinite if there is no valid split. */
+struct Split {
+  unsigned axis;
+  unsigned bin;
+  DataType cost;
+
+  bool valid() const {
+    return cost != std::numeric_limits<DataType>::infinity();
+  }
+};
+
+/** Find the best split with the binned SAH, over all 3 axis. */
+Split best_split(const Bins &bins, const BoundingBox &centroids) {
+  Split best = {0, 0, std::numeric_limits<DataType>::infinity()};
+  for (unsigned axis = 0; axis < 3; axis++) {
+    if (!has_extent(centroids, axis))
+      continue;
+
+    // Sweep from the right to get the area and count of the right side of
+    // each split, then from the left to evaluate the split costs.
+    DataType right_areas[NUM_BINS];
+    unsigned right_counts[NUM_BINS];
+    BoundingBox acc;
+    unsigned acc_count = 0;
+    for (unsigned b = NUM_BINS - 1; b > 0; b--) {
+      acc.add(bins.boxes[axis][b]);
+      acc_count += bins.counts[axis][b];
+      right_areas[b] = acc.surface_area();
+      right_counts[b] = acc_count;
+    }
+    acc = BoundingBox();
+    acc_count = 0;
+    for (unsigned b = 0; b < NUM_BINS - 1; b++) {
+      acc.add(bins.boxes[axis][b]);
+      acc_count += bins.counts[axis][b];
+      if (acc_count == 0 || right_counts[b + 1] == 0)
+        continue;
+      DataType cost = acc.surface_area() * acc_count +
+                      right_areas[b + 1] * right_counts[b + 1];
+      if (cost < best.cost)
+        best = {axis, b + 1, cost};
+    }
+  }
+  return best;
+}
+
+/** Is a node of count primitives in box better off as a leaf than split ? */
+bool leaf_is_better(const Split &split, unsigned count,
+                    const BoundingBox &box) {
+  const DataType area = box.surface_area();
+  const DataType leaf_cost = INTERSECTION_COST * count;
+  const DataType split_cost =
+      TRAVERSAL_COST +
+      (area > DataType() ? INTERSECTION_COST * split.cost / area : leaf_cost);
+  return count <= BVH::MAX_LEAF_SIZE && leaf_cost <= split_cost;
+}
+
+/** Builder builds the nodes in slots: the node of a subtree of count
+ * primitives starting at primitive begin is given the 2 * count - 1 slots
+ * from slot, its left child, of left_count primitives, being at slot + 1, and
+ * its right child at slot + 2 * left_count. The subtrees can so be built
+ * independently, and the slots are in depth first order: once the unused ones
+ * are removed, the nodes are where the BVH expects them. The primitives of a
+ * leaf starting at primitive begin are at begin in the indices. */
+class Builder {
+public:
+  Builder(const std::vector<BoundingBox> &boxes, unsigned threads,
+          std::vector<Node> &nodes, std::vector<unsigned> &indices);
+
+  void build();
+
+private:
+  // A node to build, whose primitives are in m_buffer instead of m_prims if
+  // in_buffer is set.
+  struct Task {
+    unsigned begin;
+    unsigned end;
+    unsigned depth;
+    unsigned slot;
+    Bounds bounds;
+    bool in_buffer;
+  };
+
+  // The primitives in [begin:end[ of a node being split in parallel.
+  struct Chunk {
+    unsigned task;
+    unsigned begin;
+    unsigned end;
+    Bins bins;
+    unsigned left;  // Where its primitives going left go.
+    unsigned right; // Where its primitives going right go.
+    Bounds left_bounds;
+    Bounds right_bounds;
+  };
+
+  void split_levels(std::vector<Task> &tasks);
+  void build(unsigned begin, unsigned end, unsigned depth, unsigned slot);
+  void make_leaf(unsigned slot, unsigned begin, unsigned end,
+                 const BoundingBox &box);
+  void compact();
+
+  /** Run task(i) for i in [0:count[, in parallel if there are threads. */
+  template <class TaskTy> void parallel_for(size_t count, TaskTy task);
+
+  std::vector<Primitive> m_prims;
+  std::vector<Primitive> m_buffer;
+  std::vector<Node> &m_nodes;
+  std::vector<unsigned> &m_indices;
+  std::unique_ptr<TaskScheduler> m_scheduler;
+};
+
+Builder::Builder(const std::vector<BoundingBox> &boxes, unsigned threads,
+                 std::vector<Node> &nodes, std::vector<unsigned> &indices)
+    : m_prims(boxes.size()), m_buffer(), m_nodes(nodes), m_indices(indices),
+      m_scheduler(threads > 1 ? new TaskScheduler(threads) : nullptr) {
+  parallel_for((boxes.size() + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](size_t c) {
+    const size_t end = std::min<size_t>(boxes.size(), (c + 1) * CHUNK_SIZE);
+    for (size_t i = c * CHUNK_SIZE; i < end; i++)
+      m_prims[i] = {boxes[i], boxes[i].centroid(), unsigned(i)};
+  });
+  m_nodes.assign(2 * boxes.size() - 1, Node(BoundingBox(), NO_NODE, 0));
+  m_indices.resize(boxes.size());
+}
+
+template <class TaskTy>
+void Builder::parallel_for(size_t count, TaskTy task) {
+  if (!m_scheduler || count <= 1) {
+    for (size_t i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+  const unsigned workers = m_scheduler->workers();
+  for (size_t i = 0; i < count; i++)
+    m_scheduler->push(i * workers / count, [&task, i](unsigned) { task(i); });
+  m_scheduler->run();
+}
+
+void Builder::build() {
+  std::vector<Task> tasks;
+  if (m_prims.size() >= PARALLEL_SIZE) {
+    m_buffer.resize(m_prims.size());
+    split_levels(tasks);
+  } else
+    tasks.push_back({0, unsigned(m_prims.size()), 0, 0, Bounds(), false});
+
+  // The biggest subtrees first, so that the small ones balance the workers.
+  std::sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+    return a.end - a.begin > b.end - b.begin;
+  });
+  parallel_for(tasks.size(), [&](size_t i) {
+    const Task &t = tasks[i];
+    if (t.in_buffer)
+      std::copy(&m_buffer[0] + t.begin, &m_buffer[0] + t.end,
+                &m_prims[0] + t.begin);
+    build(t.begin, t.end, t.depth, t.slot);
+  });
+  m_buffer = std::vector<Primitive>();
+  compact();
+}
+
+/** Split the nodes of PARALLEL_SIZE primitives or more, a level at a time,
+ * leaving the smaller ones in tasks. */
+void Builder::split_levels(std::vector<Task> &tasks) {
+  std::vector<Task> level(1, {0, unsigned(m_prims.size()), 0, 0, Bounds(),
+                              false});
+  std::vector<Bounds> chunk_bounds((m_prims.size() + CHUNK_SIZE - 1) /
+                                   CHUNK_SIZE);
+  parallel_for(chunk_bounds.size(), [&](size_t c) {
+    const size_t end = std::min<size_t>(m_prims.size(), (c + 1) * CHUNK_SIZE);
+    for (size_t i = c * CHUNK_SIZE; i < end; i++)
+      chunk_bounds[c].add(m_prims[i]);
+  });
+  for (const Bounds &b : chunk_bounds)
+    level[0].bounds.add(b);
+
+  std::vector<Chunk> chunks;
+  std::vector<Split> splits;
+  while (!level.empty()) {
+    chunks.clear();
+    for (unsigned t = 0; t < level.size(); t++)
+      for (unsigned b = level[t].begin; b < level[t].end; b += CHUNK_SIZE) {
+        chunks.emplace_back();
+        chunks.back().task = t;
+        chunks.back().begin = b;
+        chunks.back().end = std::min(level[t].end, b + CHUNK_SIZE);
+      }
+    parallel_for(chunks.size(), [&](size_t c) {
+      Chunk &chunk = chunks[c];
+      const Task &t = level[chunk.task];
+      const Primitive *prims = t.in_buffer ? &m_buffer[0] : &m_prims[0];
+      bin(prims + chunk.begin, prims + chunk.end, t.bounds.centroids,
+          chunk.bins);
+    });
+
+    // Find the splits, and where each chunk's primitives go. The nodes
+    // without a split are left to the sequential build.
+    splits.assign(level.size(), Split());
+    for (unsigned c = 0, t = 0; t < level.size(); t++) {
+      const unsigned first = c;
+      Bins bins;
+      for (; c < chunks.size() && chunks[c].task == t; c++)
+        bins.add(chunks[c].bins);
+      Split &split = splits[t];
+      split = best_split(bins, level[t].bounds.centroids);
+      if (level[t].depth + 2 >= BVH::MAX_DEPTH)
+        split.cost = std::numeric_limits<DataType>::infinity();
+      if (!split.valid()) {
+        tasks.push_back(level[t]);
+        continue;
+      }
+      unsigned left = level[t].begin, right = left;
+      for (unsigned b = 0; b < split.bin; b++)
+        right += bins.counts[split.axis][b];
+      for (unsigned i = first; i < c; i++) {
+        chunks[i].left = left;
+        chunks[i].right = right;
+        const unsigned *counts = chunks[i].bins.counts[split.axis];
+        for (unsigned b = 0; b < NUM_BINS; b++)
+          (b < split.bin ? left : right) += counts[b];
+      }
+    }
+
+    parallel_for(chunks.size(), [&](size_t c) {
+      Chunk &chunk = chunks[c];
+      const Task &t = level[chunk.task];
+      const Split &split = splits[chunk.task];
+      if (!split.valid())
+        return;
+      const Primitive *src = t.in_buffer ? &m_buffer[0] : &m_prims[0];
+      Primitive *dst = t.in_buffer ? &m_prims[0] : &m_buffer[0];
+      for (unsigned i = chunk.begin; i < chunk.end; i++) {
+        const Primitive &p = src[i];
+        if (bin_of(p.centroid, split.axis, t.bounds.centroids) < split.bin) {
+          dst[chunk.left++] = p;
+          chunk.left_bounds.add(p);
+        } else {
+          dst[chunk.right++] = p;
+          chunk.right_bounds.add(p);
+        }
+      }
+    });
+
+    // Make the split nodes, and queue their children.
+    std::vector<Task> next;
+    for (unsigned c = 0, t = 0; t < level.size(); t++) {
+      const unsigned first = c;
+      while (c < chunks.size() && chunks[c].task == t)
+        c++;
+      if (!splits[t].valid())
+        continue;
+
+      const Task &task = level[t];
+      Task left = {task.begin, task.begin, task.depth + 1, task.slot + 1,
+                   Bounds(), !task.in_buffer};
+      Task right = left;
+      for (unsigned i = first; i < c; i++) {
+        left.end = std::max(left.end, chunks[i].left);
+        left.bounds.add(chunks[i].left_bounds);
+        right.bounds.add(chunks[i].right_bounds);
+      }
+      right.begin = left.end;
+      right.end = task.end;
+      right.slot = task.slot + 2 * (left.end - left.begin);
+      m_nodes[task.slot] =
+          Node(task.bounds.box, right.slot, 0, splits[t].axis);
+      for (const Task &child : {left, right})
+        (child.end - child.begin >= PARALLEL_SIZE ? next : tasks)
+            .push_back(child);
+    }
+    level.swap(next);
+  }
+}
+
+void Builder::make_leaf(unsigned slot, unsigned begin, unsigned end,
+                        const BoundingBox &box) {
+  m_nodes[slot] = Node(box, begin, end - begin);
+  for (unsigned i = begin; i < end; i++)
+    m_indices[i] = m_prims[i].index;
+}
+
+void Builder::build(unsigned begin, unsigned end, unsigned depth,
+                    unsigned slot) {
+  Bounds bounds;
+  for (unsigned i = begin; i < end; i++)
+    bounds.add(m_prims[i]);
+
+  const unsigned count = end - begin;
+  if (count == 1 || depth + 2 >= BVH::MAX_DEPTH)
+    return make_leaf(slot, begin, end, bounds.box);
+
+  Bins bins;
+  bin(&m_prims[0] + begin, &m_prims[0] + end, bounds.centroids, bins);
+  const Split split = best_split(bins, bounds.centroids);
+  unsigned mid, axis = 0;
+  if (!split.valid()) {
+    // All centroids are at the same place: no meaningful split exists, so
+    // just split in two halves when there are too many primitives.
+    if (count <= BVH::MAX_LEAF_SIZE)
+      return make_leaf(slot, begin, end, bounds.box);
+    mid = begin + count / 2;
+  } else {
+    if (leaf_is_better(split, count, bounds.box))
+      return make_leaf(slot, begin, end, bounds.box);
+    Primitive *p = std::partition(
+        &m_prims[0] + begin, &m_prims[0] + end, [&](const Primitive &prim) {
+          return bin_of(prim.centroid, split.axis, bounds.centroids) <
+                 split.bin;
+        });
+    mid = p - &m_prims[0];
+    axis = split.axis;
+  }
+
+  const unsigned right = slot + 2 * (mid - begin);
+  m_nodes[slot] = Node(bounds.box, right, 0, axis);
+  build(begin, mid, depth + 1, slot + 1);
+  build(mid, end, depth + 1, right);
+}
+
+/** Remove the unused slots. The nodes only move towards the front, so this
+ * is done in place. */
+void Builder::compact() {
+  std::vector<unsigned> moved(m_nodes.size());
+  unsigned used = 0;
+  for (unsigned i = 0; i < m_nodes.size(); i++)
+    if (m_nodes[i].offset != NO_NODE)
+      moved[i] = used++;
+  for (unsigned i = 0; i < m_nodes.size(); i++) {
+    if (m_nodes[i].offset == NO_NODE)
+      continue;
+    Node node = m_nodes[i];
+    if (!node.is_leaf())
+      node.offset = moved[node.offset];
+    m_nodes[moved[i]] = node;
+  }
+  m_nodes.resize(used);
+}
+
+/** Returns x rounded to a float, towards -infinity if down, towards
+ * +infinity otherwise. */
+float round_to_float(DataType x, bool down) {
+  const float f = float(x);
+  if (down ? f > x : f < x)
+    return std::nextafter(f, (down ? -1 : 1) *
+                                 std::numeric_limits<float>::infinity());
+  return f;
+}
+} // namespace
+
+static_assert(sizeof(BVH::Node) == 32, "BVH nodes should take 32 bytes");
+
+void BVH::Node::box(const BoundingBox &b) {
+  for (unsigned i = 0; i < 3; i++) {
+    min[i] = round_to_float(b.min()[i], true);
+    max[i] = round_to_float(b.max()[i], false);
+  }
+}
+
+BVH::BVH(const std::vector<BoundingBox> &boxes, unsigned threads)
+    : m_nodes(), m_indices(), m_parents(), m_leaves() {
+  if (boxes.empty())
+    return;
+
+  Builder(boxes, threads, m_nodes, m_indices).build();
+}
+
+/** Returns the box of node, from the boxes of its primitives for a leaf, or
+ * from the boxes of its children. */
+BoundingBox BVH::fit(unsigned node,
+                     const std::vector<BoundingBox> &boxes) const {
+  const Node &n = m_nodes[node];
+  BoundingBox box;
+  if (n.is_leaf()) {
+    for (unsigned i = n.offset; i < n.offset + n.count; i++)
+      box.add(boxes[m_indices[i]]);
+  } else {
+    box.add(m_nodes[node + 1].box());
+    box.add(m_nodes[n.offset].box());
+  }
+  return box;
+}
+
+void BVH::refit(const std::vector<BoundingBox> &boxes) {
+  assert(boxes.size() == size() && "Refitting to a different primitive set");
+  // The children come after their parent: a reverse sweep refits them first.
+  for (unsigned i = m_nodes.size(); i-- > 0;)
+    m_nodes[i].box(fit(i, boxes));
+}
+
+void BVH::refit(const std::vector<BoundingBox> &boxes,
+                const std::vector<unsigned> &moved) {
+  assert(boxes.size() == size() && "Refitting to a different primitive set");
+  if (m_nodes.empty())
+    return;
+
+  if (m_parents.size() != m_nodes.size()) {
+    m_parents.assign(m_nodes.size(), 0);
+    m_leaves.assign(size(), 0);
+    for (unsigned i = 0; i < m_nodes.size(); i++) {
+      const Node &node = m_nodes[i];
+      if (node.is_leaf()) {
+        for (unsigned j = node.offset; j < node.offset + node.count; j++)
+          m_leaves[m_indices[j]] = i;
+      } else {
+        m_parents[i + 1] = i;
+        m_parents[node.offset] = i;
+      }
+    }
+  }
+
+  // Walk up from each moved primitive's leaf, up to the first node whose box
+  // does not change: the nodes above it already enclose it.
+  for (unsigned prim : moved) {
+    assert(prim < size() && "Out of bounds primitive");
+    unsigned node = m_leaves[prim];
+    while (true) {
+      const BoundingBox box = m_nodes[node].box();
+      m_nodes[node].box(fit(node, boxes));
+      if (m_nodes[node].box() == box)
+        break;
+      if (node == 0)
+        break;
+      node = m_parents[node];
+    }
+  }
+}
+
+BVH::DataType BVH::cost() const {
+  if (m_nodes.empty())
+    return DataType();
+
+  const DataType root_area = m_nodes[0].box().surface_area();
+  if (root_area <= DataType())
+    return INTERSECTION_COST * size();
+  DataType cost = DataType();
+  for (const Node &node : m_nodes)
+    cost += node.box().surface_area() / root_area *
+            (node.is_leaf() ? INTERSECTION_COST * node.count : TRAVERSAL_COST);
+  return cost;
+}
+
+unsigned BVH::depth() const {
+  if (m_nodes.empty())
+    return 0;
+
+  unsigned max_depth = 0;
+  std::vector<std::pair<unsigned, unsigned>> stack = {{0, 1}};
+  while (!stack.empty()) {
+    auto p = stack.back();
+    stack.pop_back();
+    max_depth = std::max(max_depth, p.second);
+    const Node &node = m_nodes[p.first];
+    if (!node.is_leaf()) {
+      stack.push_back({p.first + 1, p.second + 1});
+      stack.push_back({node.offset, p.second + 1});
+    }
+  }
+  return max_depth;
+}
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::BVH &bvh) {
+  os << "BVH { primitives: " << bvh.size() << ", nodes: " << bvh.nodes().size()
+     << ", depth: " << bvh.depth() << ", cost: " << bvh.cost()
+     << ", bounds: " << bvh.bounds() << "}";
+  return os;
+}
@@ -0,0 +1,35 @@
+#include "ratrac/BoundingBox.h"
+
+#include <sstream>
+
+namespace ratrac {
+
+BoundingBox BoundingBox::transform(const Matrix &M) const {
+  if (empty())
+    return BoundingBox();
+  if (!is_finite())
+    return BoundingBox::infinite();
+
+  // Transform the 8 corners and get the box containing them all.
+  BoundingBox result;
+  for (unsigned i = 0; i < 8; i++) {
+    Tuple corner = Point(i & 1 ? m_max.x() : m_min.x(),
+                         i & 2 ? m_max.y() : m_min.y(),
+                         i & 4 ? m_max.z() : m_min.z());
+    result.add(M * corner);
+  }
+  return result;
+}
+
+BoundingBox::operator std::string() const {
+  std::ostringstream os;
+  os << "BoundingBox { min: " << m_min << ", max: " << m_max << "}";
+  return os.str();
+}
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::BoundingBox &B) {
+  os << std::string(B);
+  return os;
+}
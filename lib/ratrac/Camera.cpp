@@ -1,16 +1,23 @@
 #include "ratrac/Camera.h"
 #include "ratrac/Intersections.h"
 #include "ratrac/ProgressBar.h"
+#include "ratrac/Wavefront.h"
 #include "ratrac/ratrac.h"
 
+#include <algorithm>
+#include <cassert>
+#include <atomic>
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 namespace ratrac {
 
 Camera::Camera(unsigned hsize, unsigned vsize, RayTracerDataType fov)
     : Transformable(), m_origin(Point(0, 0, 0)), m_hsize(hsize), m_vsize(vsize),
-      m_fov(fov), m_half_width(), m_half_height(), m_pixel_size() {
+      m_fov(fov), m_half_width(), m_half_height(), m_pixel_size(),
+      m_packet_width(4), m_packet_height(2), m_wavefront(false) {
   RayTracerDataType half_view = std::tan(m_fov / 2.0);
   RayTracerDataType aspect =
       RayTracerDataType(m_hsize) / RayTracerDataType(m_vsize);
@@ -26,8 +33,8 @@ Camera::Camera(unsigned hsize, unsigned vsize, RayTracerDataType fov)
 
 Ray Camera::ray_for_pixel(unsigned px, unsigned py) const {
   // the offset from the edge of the canvas to the pixel's center.
-  RayTracerDataType xoffset = (RayTracerDataType(px) + 0.5) * m_pixel_size;
-  RayTracerDataType yoffset = (RayTracerDataType(py) + 0.5) * m_pixel_size;
+  RayTracerDataType xoffset = (RayTracerDataType(px) + RayTracerDataType(0.5)) * m_pixel_size;
+  RayTracerDataType yoffset = (RayTracerDataType(py) + RayTracerDataType(0.5)) * m_pixel_size;
 
   // The untransformed coordinates of the pixel in world space.
   // (remember that the camera looks toward -z, so +x is to the *left*.)
@@ -43,16 +50,182 @@ Ray Camera::ray_for_pixel(unsigned px, unsigned py) const {
   return Ray(m_origin, direction);
 }
 
-Canvas Camera::render(const World &world, bool verbose) const {
+RayPacket Camera::rays_for_pixels(unsigned px, unsigned py, unsigned width,
+                                  unsigned height) const {
+  assert(width * height <= RayPacket::SIZE && "Block does not fit in packet");
+  typedef RayPacket::DataType DataType;
+  DataType x[RayPacket::SIZE], y[RayPacket::SIZE];
+  for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+    x[l] = DataType(px + l % width);
+    y[l] = DataType(py + l / width);
+  }
+
+  RayPacket rays;
+  DataType *const direction[4] = {rays.direction[0], rays.direction[1],
+                                  rays.direction[2], rays.direction[3]};
+  directions_for_pixels(x, y, RayPacket::SIZE, direction);
+  for (unsigned r = 0; r < 4; r++)
+    for (unsigned l = 0; l < RayPacket::SIZE; l++)
+      rays.origin[r][l] = m_origin[r];
+  return rays;
+}
+
+void Camera::directions_for_pixels(const DataType *x, const DataType *y,
+                                   size_t n,
+                                   DataType *const direction[4]) const {
+  // ray_for_pixel, with the Tuple and Matrix operations spelled out in the
+  // same order, for all pixels at once.
+  const DataType *M = inverse_transform().data();
+  const DataType *o = m_origin.data();
+  for (size_t i = 0; i < n; i++) {
+    const DataType world_x =
+        m_half_width - (x[i] + DataType(0.5)) * m_pixel_size;
+    const DataType world_y =
+        m_half_height - (y[i] + DataType(0.5)) * m_pixel_size;
+    DataType d[4];
+    for (unsigned r = 0; r < 4; r++) {
+      DataType pixel = DataType();
+      pixel += M[4 * r + 0] * world_x;
+      pixel += M[4 * r + 1] * world_y;
+      pixel += M[4 * r + 2] * DataType(-1.0);
+      pixel += M[4 * r + 3] * DataType(1.0);
+      d[r] = pixel - o[r];
+    }
+    DataType magnitude = DataType();
+    for (unsigned r = 0; r < 4; r++)
+      magnitude += d[r] * d[r];
+    magnitude = std::sqrt(magnitude);
+    for (unsigned r = 0; r < 4; r++)
+      direction[r][i] = d[r] / magnitude;
+  }
+}
+
+void Camera::render_tile(const World &world, Canvas &image, unsigned x0,
+                         unsigned y0, unsigned x1, unsigned y1) const {
+  if (m_packet_width * m_packet_height == 1) {
+    for (unsigned y = y0; y < y1; y++)
+      for (unsigned x = x0; x < x1; x++) {
+        Ray ray = ray_for_pixel(x, y);
+        image.at(x, y) = color_at(world, ray);
+      }
+    return;
+  }
+
+  // Trace the primary rays by packets, clipped to the tile, then shade each
+  // pixel as color_at would.
+  for (unsigned y = y0; y < y1; y += m_packet_height)
+    for (unsigned x = x0; x < x1; x += m_packet_width) {
+      const unsigned w = std::min(m_packet_width, x1 - x);
+      const unsigned h = std::min(m_packet_height, y1 - y);
+      const RayPacket rays =
+          rays_for_pixels(x, y, m_packet_width, m_packet_height);
+      unsigned mask = 0;
+      for (unsigned dy = 0; dy < h; dy++)
+        mask |= RayPacket::mask(w) << (dy * m_packet_width);
+
+      const PacketHits hits = world.closest_hit(rays, mask);
+      for (unsigned dy = 0; dy < h; dy++)
+        for (unsigned dx = 0; dx < w; dx++) {
+          const unsigned lane = dy * m_packet_width + dx;
+          if (!hits.object[lane]) {
+            image.at(x + dx, y + dy) = Color::BLACK();
+            continue;
+          }
+          Computations comps(hits.hit(lane), rays.ray(lane));
+          image.at(x + dx, y + dy) = shade_hit(world, comps);
+        }
+    }
+}
+
+Canvas Camera::render(const World &world, bool verbose,
+                      unsigned threads) const {
+  if (threads > 1) {
+    TaskScheduler scheduler(threads);
+    Canvas image = render(world, scheduler, verbose);
+    if (verbose)
+      std::cout << scheduler;
+    return image;
+  }
+
+  world.prepare();
   Canvas image(m_hsize, m_vsize);
   TimedProgressBar PB("Camera::render", m_vsize * m_hsize, std::cout, !verbose);
-  for (unsigned y = 0; y < m_vsize; y++) {
-    for (unsigned x = 0; x < m_hsize; x++) {
-      Ray ray = ray_for_pixel(x, y);
-      image.at(x, y) = color_at(world, ray);
-      PB.incr();
+  if (m_wavefront) {
+    // A single pipeline renders all the tiles, reusing its queues.
+    Wavefront wavefront(*this, world);
+    for (unsigned y = 0; y < m_vsize; y += WAVEFRONT_TILE_SIZE) {
+      unsigned y1 = std::min(y + WAVEFRONT_TILE_SIZE, m_vsize);
+      for (unsigned x = 0; x < m_hsize; x += WAVEFRONT_TILE_SIZE)
+        wavefront.render(image, x, y,
+                         std::min(x + WAVEFRONT_TILE_SIZE, m_hsize), y1);
+      PB.incr(m_hsize * (y1 - y));
     }
+    return image;
+  }
+
+  for (unsigned y = 0; y < m_vsize; y += m_packet_height) {
+    unsigned y1 = std::min(y + m_packet_height, m_vsize);
+    render_tile(world, image, 0, y, m_hsize, y1);
+    PB.incr(m_hsize * (y1 - y));
+  }
+
+  return image;
+}
+
+Canvas Camera::render(const World &world, TaskScheduler &scheduler,
+                      bool verbose) const {
+  // Build the acceleration structure upfront, with all the workers, rather
+  // than on the first intersection.
+  world.prepare(scheduler.workers());
+  Canvas image(m_hsize, m_vsize);
+  TimedProgressBar PB("Camera::render", m_vsize * m_hsize, std::cout, !verbose);
+
+  // Workers write directly to their own, disjoint, pixels of the canvas: no
+  // locking is needed. The progress bar is not thread safe, so only worker 0,
+  // i.e. the calling thread, reports progress.
+  std::atomic<size_t> pixels_done(0);
+  size_t reported = 0;
+  const unsigned tile_size = this->tile_size();
+  // In wavefront mode, each worker has its own pipeline, whose queues are
+  // reused from one tile to the next. The pipelines are allocated one by one,
+  // so that the workers do not write to the same cache lines.
+  std::vector<std::unique_ptr<Wavefront>> wavefronts;
+  if (m_wavefront)
+    for (unsigned i = 0; i < scheduler.workers(); i++)
+      wavefronts.emplace_back(new Wavefront(*this, world));
+  auto tile_task = [&, this](unsigned x0, unsigned y0) {
+    return [&, this, x0, y0](unsigned worker) {
+      unsigned x1 = std::min(x0 + tile_size, m_hsize);
+      unsigned y1 = std::min(y0 + tile_size, m_vsize);
+      if (m_wavefront)
+        wavefronts[worker]->render(image, x0, y0, x1, y1);
+      else
+        render_tile(world, image, x0, y0, x1, y1);
+      size_t done = pixels_done += (x1 - x0) * (y1 - y0);
+      if (worker == 0) {
+        PB.incr(done - reported);
+        reported = done;
+      }
+    };
+  };
+
+  // Give each worker a contiguous band of tiles, in scanline order, and let
+  // work stealing balance the load when some bands are more costly than
+  // others.
+  const unsigned tiles_x = (m_hsize + tile_size - 1) / tile_size;
+  const unsigned tiles_y = (m_vsize + tile_size - 1) / tile_size;
+  const unsigned num_tiles = tiles_x * tiles_y;
+  const unsigned workers = scheduler.workers();
+  for (unsigned tile = 0; tile < num_tiles; tile++) {
+    // Tiles are pushed in reverse order as workers pop tasks from the back of
+    // their deque.
+    unsigned t = num_tiles - 1 - tile;
+    unsigned worker = std::min(workers - 1, unsigned(t * workers / num_tiles));
+    scheduler.push(worker, tile_task((t % tiles_x) * tile_size,
+                                     (t / tiles_x) * tile_size));
   }
+  scheduler.run();
+  PB.incr(pixels_done - reported);
 
   return image;
 }
@@ -0,0 +1,80 @@
+#include "ratrac/Grid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace ratrac {
+
+Grid::Grid(const std::vector<BoundingBox> &boxes)
+    : m_bounds(), m_resolution{1, 1, 1}, m_cell_size(), m_inv_cell_size(),
+      m_cells(), m_indices(), m_size(boxes.size()) {
+  if (boxes.empty()) {
+    m_resolution[0] = m_resolution[1] = m_resolution[2] = 0;
+    return;
+  }
+
+  for (const BoundingBox &box : boxes) {
+    assert(box.is_finite() && "Grid primitives must be bounded");
+    m_bounds.add(box);
+  }
+
+  // Cubic cells, DENSITY times as many as the primitives: the flat axes are
+  // given the thickness of the thinnest cells for the volume estimate, and a
+  // single cell.
+  const Tuple extent = m_bounds.max() - m_bounds.min();
+  const DataType max_extent =
+      std::max(extent.x(), std::max(extent.y(), extent.z()));
+  if (max_extent > DataType()) {
+    DataType volume = 1;
+    for (unsigned a = 0; a < 3; a++)
+      volume *= std::max(extent[a], max_extent / MAX_RESOLUTION);
+    const DataType cells_per_unit =
+        std::cbrt(DENSITY * DataType(boxes.size()) / volume);
+    for (unsigned a = 0; a < 3; a++) {
+      const DataType n = std::round(extent[a] * cells_per_unit);
+      m_resolution[a] = n < 1 ? 1
+                              : n > MAX_RESOLUTION ? MAX_RESOLUTION
+                                                   : unsigned(n);
+    }
+  }
+  for (unsigned a = 0; a < 3; a++) {
+    m_cell_size[a] = extent[a] / m_resolution[a];
+    m_inv_cell_size[a] =
+        extent[a] > DataType() ? m_resolution[a] / extent[a] : DataType();
+  }
+
+  // Count the references of each cell, turn the counts into offsets, then
+  // fill the cells.
+  auto for_each_cell = [&](const BoundingBox &box, auto f) {
+    int lo[3], hi[3];
+    for (unsigned a = 0; a < 3; a++) {
+      lo[a] = cell_of(box.min()[a], a);
+      hi[a] = cell_of(box.max()[a], a);
+    }
+    for (int z = lo[2]; z <= hi[2]; z++)
+      for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+          f((z * m_resolution[1] + y) * m_resolution[0] + x);
+  };
+  m_cells.assign(num_cells() + 1, 0);
+  for (const BoundingBox &box : boxes)
+    for_each_cell(box, [&](unsigned c) { m_cells[c + 1]++; });
+  for (unsigned c = 0; c < num_cells(); c++)
+    m_cells[c + 1] += m_cells[c];
+
+  m_indices.resize(m_cells.back());
+  std::vector<unsigned> next(m_cells.begin(), m_cells.end() - 1);
+  for (unsigned i = 0; i < boxes.size(); i++)
+    for_each_cell(boxes[i], [&](unsigned c) { m_indices[next[c]++] = i; });
+}
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::Grid &grid) {
+  os << "Grid { primitives: " << grid.size() << ", resolution: "
+     << grid.resolution(0) << "x" << grid.resolution(1) << "x"
+     << grid.resolution(2) << ", references: " << grid.num_references()
+     << ", bounds: " << grid.bounds() << "}";
+  return os;
+}
@@ -0,0 +1,70 @@
+#include "ratrac/Instance.h"
+
+#include <cassert>
+#include <sstream>
+#include <utility>
+
+namespace ratrac {
+
+Instance::Instance(std::shared_ptr<const Shape> prototype)
+    : Shape(), m_prototype(std::move(prototype)), m_own_material(false) {
+  assert(m_prototype && "An instance needs a prototype");
+  update();
+}
+
+Instance::Instance(std::shared_ptr<const Shape> prototype,
+                   const Matrix &transform)
+    : Shape(), m_prototype(std::move(prototype)), m_own_material(false) {
+  assert(m_prototype && "An instance needs a prototype");
+  this->transform(transform);
+}
+
+Material &Instance::material() {
+  if (!m_own_material) {
+    Shape::material() = m_prototype->material();
+    m_own_material = true;
+  }
+  return Shape::material();
+}
+
+Intersections Instance::local_intersect(const Ray &r) const {
+  Intersections xs = m_prototype->intersect(r);
+  for (Intersection &x : xs)
+    x.object = this;
+  return xs;
+}
+
+bool Instance::local_occludes(const Ray &r, RayTracerDataType max_t) const {
+  return m_prototype->occludes(r, max_t);
+}
+
+bool Instance::local_closest_hit(const Ray &r, Intersection &hit) const {
+  if (!m_prototype->closest_hit(r, hit))
+    return false;
+  hit.object = this;
+  return true;
+}
+
+void Instance::local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const {
+  // The lanes the prototype hit are those whose closest hit got closer.
+  RayTracerDataType t[RayPacket::SIZE];
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    t[i] = hits.t[i];
+  m_prototype->closest_hit(rays, mask, hits);
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    if ((mask & (1U << i)) && hits.t[i] < t[i])
+      hits.object[i] = this;
+}
+
+Instance::operator std::string() const {
+  std::ostringstream os;
+  os << "Instance {";
+  os << " prototype: " << prototype();
+  os << ", transform: " << transform();
+  os << ", material: " << material();
+  os << "}";
+  return os.str();
+}
+
+} // namespace ratrac
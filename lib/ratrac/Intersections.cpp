@@ -12,12 +12,13 @@ namespace ratrac {
 
 Computations::Computations(const Intersection &x, const Ray &ray)
     : t(x.t), object(x.object), point(position(ray, x.t)), over_point(),
-      eyev(-ray.direction()), normalv(object->normal_at(point)), inside(false) {
+      eyev(-ray.direction()), normalv(object->normal_at(point, x)),
+      inside(false) {
   if (dot(normalv, eyev) < 0.0) {
     inside = true;
     normalv = -normalv;
   }
-  over_point = point + normalv * EPSILON<Tuple::DataType>();
+  over_point = point + normalv * SURFACE_OFFSET<Tuple::DataType>();
 }
 
 Color shade_hit(const World &world, const Computations &comps) {
@@ -31,15 +32,11 @@ Color shade_hit(const World &world, const Computations &comps) {
 }
 
 Color color_at(const World &world, const Ray &ray) {
-  Intersections xs = world.intersect(ray);
-  if (xs.empty())
+  Intersection hit = world.closest_hit(ray);
+  if (!hit.object)
     return Color::BLACK();
 
-  Intersections::const_iterator i = xs.hit();
-  if (i == xs.end())
-    return Color::BLACK();
-
-  Computations comps(*i, ray);
+  Computations comps(hit, ray);
   return shade_hit(world, comps);
 }
 
@@ -48,13 +45,6 @@ bool is_shadowed(const World &world, const Tuple &point, unsigned i) {
   Tuple::DataType distance = magnitude(v);
   Tuple direction = normalize(v);
 
-  Ray r = Ray(point, direction);
-  Intersections intersections = world.intersect(r);
-
-  Intersections::const_iterator h = intersections.hit();
-  if (h != intersections.end() && h->t < distance)
-    return true;
-
-  return false;
+  return world.occluded(Ray(point, direction), distance);
 }
 } // namespace ratrac
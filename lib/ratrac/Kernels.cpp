@@ -0,0 +1,327 @@
+#include "ratrac/Kernels.h"
+#include "ratrac/Color.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/SIMD.h"
+#include "ratrac/Tuple.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+namespace ratrac {
+
+namespace {
+static_assert(sizeof(Color) == 4 * sizeof(Color::ColorType),
+              "Colors arrays are accessed as arrays of RGBA values.");
+
+// The kernel bodies common to all instruction sets: they get inlined, and
+// compiled for each instruction set, in the versions below.
+
+// The packet kernels process one ray per lane, with the same operations as
+// their single ray counterparts. They are written as loops over the lanes,
+// which the compiler vectorizes for each instruction set.
+RATRAC_ALWAYS_INLINE RayPacket transform_packet_impl(const RayPacket &rays,
+                                                     const Matrix &M) {
+  // Same operation order as simd::scalar::matvec4.
+  typedef RayPacket::DataType DataType;
+  const DataType *m = M.data();
+  RayPacket result;
+  for (unsigned row = 0; row < 4; row++)
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      DataType o = DataType();
+      DataType d = DataType();
+      for (unsigned col = 0; col < 4; col++) {
+        o += m[4 * row + col] * rays.origin[col][i];
+        d += m[4 * row + col] * rays.direction[col][i];
+      }
+      result.origin[row][i] = o;
+      result.direction[row][i] = d;
+    }
+  return result;
+}
+
+RATRAC_ALWAYS_INLINE void
+intersect_sphere_packet_impl(const RayPacket &r, const Tuple &center,
+                             RayTracerDataType radius, RayTracerDataType *t1,
+                             RayTracerDataType *t2) {
+  // Same operation order as simd::scalar::intersect_sphere. The roots go to
+  // local arrays first: t1 and t2 could otherwise alias rays, which would
+  // prevent the vectorization.
+  typedef RayPacket::DataType DataType;
+  const DataType *c = center.data();
+  const DataType rr = radius * radius;
+  DataType roots1[RayPacket::SIZE], roots2[RayPacket::SIZE];
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    const DataType s0 = r.origin[0][i] - c[0], s1 = r.origin[1][i] - c[1],
+                   s2 = r.origin[2][i] - c[2], s3 = r.origin[3][i] - c[3];
+    const DataType d0 = r.direction[0][i], d1 = r.direction[1][i],
+                   d2 = r.direction[2][i], d3 = r.direction[3][i];
+    DataType a = DataType();
+    a += d0 * d0;
+    a += d1 * d1;
+    a += d2 * d2;
+    a += d3 * d3;
+    DataType b = DataType();
+    b += d0 * s0;
+    b += d1 * s1;
+    b += d2 * s2;
+    b += d3 * s3;
+    b *= DataType(2);
+    DataType cc = DataType();
+    cc += s0 * s0;
+    cc += s1 * s1;
+    cc += s2 * s2;
+    cc += s3 * s3;
+    cc -= rr;
+    const DataType s[4] = {s0, s1, s2, s3}, d[4] = {d0, d1, d2, d3};
+    const DataType discriminant =
+        simd::scalar::sphere_discriminant(a, b, cc, rr, s, d);
+    const DataType sq = std::sqrt(discriminant);
+    const DataType root1 = (-b - sq) / (DataType(2) * a);
+    const DataType root2 = (-b + sq) / (DataType(2) * a);
+    const bool miss = discriminant < 0.0;
+    roots1[i] = miss ? DataType(-1) : root1;
+    roots2[i] = miss ? DataType(-1) : root2;
+  }
+  std::copy(roots1, roots1 + RayPacket::SIZE, t1);
+  std::copy(roots2, roots2 + RayPacket::SIZE, t2);
+}
+
+// Scalar kernels.
+// ===============
+Ray transform_ray_scalar(const Ray &ray, const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  Tuple origin, direction;
+  simd::scalar::matvec4x2(M.data(), ray.origin().data(),
+                          ray.direction().data(), origin.data(),
+                          direction.data());
+  return Ray(origin, direction);
+}
+
+RayPacket transform_packet_scalar(const RayPacket &rays, const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  return transform_packet_impl(rays, M);
+}
+
+void intersect_sphere_packet_scalar(const RayPacket &rays,
+                                    const Tuple &center,
+                                    RayTracerDataType radius,
+                                    RayTracerDataType *t1,
+                                    RayTracerDataType *t2) {
+  intersect_sphere_packet_impl(rays, center, radius, t1, t2);
+}
+
+void accumulate_colors_scalar(Color *dst, const Color *src, size_t count) {
+  simd::scalar::add_rgb(dst->data(), src->data(), count);
+}
+
+unsigned slab4_scalar(const float *const near[3], const float *const far[3],
+                      const RayTracerDataType *origin,
+                      const RayTracerDataType *inv_direction,
+                      RayTracerDataType *t0, RayTracerDataType *t1) {
+  return simd::scalar::slab4(near, far, origin, inv_direction, t0, t1);
+}
+
+const Kernels scalar_kernels = {
+    ISA::SCALAR, transform_ray_scalar, transform_packet_scalar,
+    intersect_sphere_packet_scalar, accumulate_colors_scalar, slab4_scalar};
+
+#if defined(RATRAC_SIMD_SSE2)
+// SSE2 kernels.
+// =============
+Ray transform_ray_sse2(const Ray &ray, const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  Tuple origin, direction;
+  simd::sse2::matvec4x2(M.data(), ray.origin().data(), ray.direction().data(),
+                        origin.data(), direction.data());
+  return Ray(origin, direction);
+}
+
+RayPacket transform_packet_sse2(const RayPacket &rays, const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  return transform_packet_impl(rays, M);
+}
+
+void intersect_sphere_packet_sse2(const RayPacket &rays,
+                                  const Tuple &center,
+                                  RayTracerDataType radius,
+                                  RayTracerDataType *t1,
+                                  RayTracerDataType *t2) {
+  intersect_sphere_packet_impl(rays, center, radius, t1, t2);
+}
+
+void accumulate_colors_sse2(Color *dst, const Color *src, size_t count) {
+  simd::sse2::add_rgb(dst->data(), src->data(), count);
+}
+
+unsigned slab4_sse2(const float *const near[3], const float *const far[3],
+                    const RayTracerDataType *origin,
+                    const RayTracerDataType *inv_direction,
+                    RayTracerDataType *t0, RayTracerDataType *t1) {
+  return simd::sse2::slab4(near, far, origin, inv_direction, t0, t1);
+}
+
+const Kernels sse2_kernels = {
+    ISA::SSE2, transform_ray_sse2, transform_packet_sse2,
+    intersect_sphere_packet_sse2, accumulate_colors_sse2, slab4_sse2};
+#endif
+
+#if defined(RATRAC_SIMD_AVX2)
+// AVX2 kernels.
+// =============
+RATRAC_TARGET_AVX2 Ray transform_ray_avx2(const Ray &ray, const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  Tuple origin, direction;
+  simd::avx2::matvec4x2(M.data(), ray.origin().data(), ray.direction().data(),
+                        origin.data(), direction.data());
+  return Ray(origin, direction);
+}
+
+RATRAC_TARGET_AVX2 RayPacket transform_packet_avx2(const RayPacket &rays,
+                                                   const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  return transform_packet_impl(rays, M);
+}
+
+RATRAC_TARGET_AVX2 void intersect_sphere_packet_avx2(const RayPacket &rays,
+                                                     const Tuple &center,
+                                                     RayTracerDataType radius,
+                                                     RayTracerDataType *t1,
+                                                     RayTracerDataType *t2) {
+  intersect_sphere_packet_impl(rays, center, radius, t1, t2);
+}
+
+RATRAC_TARGET_AVX2 void accumulate_colors_avx2(Color *dst, const Color *src,
+                                               size_t count) {
+  simd::avx2::add_rgb(dst->data(), src->data(), count);
+}
+
+RATRAC_TARGET_AVX2 unsigned
+slab4_avx2(const float *const near[3], const float *const far[3],
+           const RayTracerDataType *origin,
+           const RayTracerDataType *inv_direction,
+           RayTracerDataType *t0, RayTracerDataType *t1) {
+  return simd::avx2::slab4(near, far, origin, inv_direction, t0, t1);
+}
+
+const Kernels avx2_kernels = {
+    ISA::AVX2, transform_ray_avx2, transform_packet_avx2,
+    intersect_sphere_packet_avx2, accumulate_colors_avx2, slab4_avx2};
+#endif
+
+#if defined(RATRAC_SIMD_AVX512)
+// AVX512 kernels.
+// ===============
+RATRAC_TARGET_AVX512 Ray transform_ray_avx512(const Ray &ray,
+                                              const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  Tuple origin, direction;
+  simd::avx512::matvec4x2(M.data(), ray.origin().data(),
+                          ray.direction().data(), origin.data(),
+                          direction.data());
+  return Ray(origin, direction);
+}
+
+RATRAC_TARGET_AVX512 RayPacket transform_packet_avx512(const RayPacket &rays,
+                                                       const Matrix &M) {
+  assert(M.rows() == 4 && M.columns() == 4 && "Expecting a 4x4 matrix");
+  return transform_packet_impl(rays, M);
+}
+
+RATRAC_TARGET_AVX512 void
+intersect_sphere_packet_avx512(const RayPacket &rays, const Tuple &center,
+                               RayTracerDataType radius, RayTracerDataType *t1,
+                               RayTracerDataType *t2) {
+  intersect_sphere_packet_impl(rays, center, radius, t1, t2);
+}
+
+RATRAC_TARGET_AVX512 void accumulate_colors_avx512(Color *dst,
+                                                   const Color *src,
+                                                   size_t count) {
+  simd::avx512::add_rgb(dst->data(), src->data(), count);
+}
+
+RATRAC_TARGET_AVX512 unsigned
+slab4_avx512(const float *const near[3], const float *const far[3],
+             const RayTracerDataType *origin,
+             const RayTracerDataType *inv_direction,
+             RayTracerDataType *t0, RayTracerDataType *t1) {
+  return simd::avx512::slab4(near, far, origin, inv_direction, t0, t1);
+}
+
+const Kernels avx512_kernels = {
+    ISA::AVX512, transform_ray_avx512, transform_packet_avx512,
+    intersect_sphere_packet_avx512, accumulate_colors_avx512, slab4_avx512};
+#endif
+} // namespace
+
+const char *name(ISA isa) {
+  switch (isa) {
+  case ISA::SCALAR:
+    return "scalar";
+  case ISA::SSE2:
+    return "sse2";
+  case ISA::AVX2:
+    return "avx2";
+  case ISA::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+ISA detect_isa() {
+#if defined(RATRAC_SIMD_SSE2) && defined(__GNUC__) &&                        \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+#if defined(RATRAC_SIMD_AVX512)
+  if (__builtin_cpu_supports("avx512f"))
+    return ISA::AVX512;
+#endif
+#if defined(RATRAC_SIMD_AVX2)
+  if (__builtin_cpu_supports("avx2"))
+    return ISA::AVX2;
+#endif
+  return ISA::SSE2;
+#elif defined(RATRAC_SIMD_AVX512) && defined(__AVX512F__)
+  return ISA::AVX512;
+#elif defined(RATRAC_SIMD_AVX2) && defined(__AVX2__)
+  return ISA::AVX2;
+#elif defined(RATRAC_SIMD_SSE2)
+  return ISA::SSE2;
+#else
+  return ISA::SCALAR;
+#endif
+}
+
+const Kernels *get_kernels(ISA isa) {
+  if (static_cast<unsigned>(isa) > static_cast<unsigned>(detect_isa()))
+    return nullptr;
+
+  switch (isa) {
+  case ISA::SCALAR:
+    return &scalar_kernels;
+  case ISA::SSE2:
+#if defined(RATRAC_SIMD_SSE2)
+    return &sse2_kernels;
+#else
+    return nullptr;
+#endif
+  case ISA::AVX2:
+#if defined(RATRAC_SIMD_AVX2)
+    return &avx2_kernels;
+#else
+    return nullptr;
+#endif
+  case ISA::AVX512:
+#if defined(RATRAC_SIMD_AVX512)
+    return &avx512_kernels;
+#else
+    return nullptr;
+#endif
+  }
+  return nullptr;
+}
+
+} // namespace ratrac
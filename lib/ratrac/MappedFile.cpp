@@ -0,0 +1,58 @@
+#include "ratrac/MappedFile.h"
+
+#include <fstream>
+#include <iterator>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ratrac {
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+#if !defined(_WIN32)
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok && st.st_size > 0) {
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = data != MAP_FAILED;
+    if (ok) {
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+      m_data = static_cast<const char *>(data);
+      m_size = st.st_size;
+      m_mapped = true;
+    }
+  }
+  ::close(fd);
+  return ok;
+#else
+  std::ifstream is(filename, std::ios::binary);
+  if (!is)
+    return false;
+  m_buffer.assign(std::istreambuf_iterator<char>(is),
+                  std::istreambuf_iterator<char>());
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  return true;
+#endif
+}
+
+void MappedFile::close() {
+#if !defined(_WIN32)
+  if (m_mapped)
+    munmap(const_cast<char *>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+  m_buffer.clear();
+}
+
+} // namespace ratrac
@@ -6,46 +6,6 @@
 
 namespace ratrac {
 
-Matrix::Matrix(std::initializer_list<std::initializer_list<DataType>> il)
-    : m_Matrix(new DataType[NE]), m_Rows(0), m_Columns(0) {
-  assert(m_Matrix && "Allocation error");
-  assert(il.size() <= NR && "Number of rows must be < NR");
-  m_Rows = il.size();
-  unsigned row = 0;
-  for (typename std::initializer_list<std::initializer_list<DataType>>::iterator
-           itr = il.begin();
-       itr != il.end(); row++, itr++) {
-    assert(itr->size() <= NR && "Number of rows must be < NR");
-    m_Columns = itr->size() > m_Columns ? itr->size() : m_Columns;
-    unsigned col = 0;
-    for (typename std::initializer_list<DataType>::iterator itc = itr->begin();
-         itc != itr->end(); col++, itc++)
-      set(row, col, *itc);
-  }
-}
-
-Matrix &
-Matrix::operator=(std::initializer_list<std::initializer_list<DataType>> il) {
-  if (!m_Matrix)
-    m_Matrix = new DataType[NE];
-  assert(m_Matrix && "Allocation error");
-  m_Columns = 0;
-  assert(il.size() <= NR && "Number of rows must be < NR");
-  m_Rows = il.size();
-  unsigned row = 0;
-  for (typename std::initializer_list<std::initializer_list<DataType>>::iterator
-           itr = il.begin();
-       itr != il.end(); row++, itr++) {
-    assert(itr->size() <= NR && "Number of rows must be < NR");
-    m_Columns = itr->size() > m_Columns ? itr->size() : m_Columns;
-    unsigned col = 0;
-    for (typename std::initializer_list<DataType>::iterator itc = itr->begin();
-         itc != itr->end(); col++, itc++)
-      set(row, col, *itc);
-  }
-  return *this;
-}
-
 Matrix::DataType Matrix::determinant() const {
   assert(m_Rows == m_Columns && "Only square matrices are supported");
   assert(m_Rows <= NR && "Number of rows higher than supported");
@@ -53,9 +13,25 @@ Matrix::DataType Matrix::determinant() const {
   if (shape() == std::tuple<int, int>(2, 2))
     return at(0, 0) * at(1, 1) - at(0, 1) * at(1, 0);
 
+  if (shape() == std::tuple<int, int>(4, 4)) {
+    // Laplace expansion along the first 2 rows, with 2x2 sub-determinants.
+    const DataType s0 = at(0, 0) * at(1, 1) - at(1, 0) * at(0, 1);
+    const DataType s1 = at(0, 0) * at(1, 2) - at(1, 0) * at(0, 2);
+    const DataType s2 = at(0, 0) * at(1, 3) - at(1, 0) * at(0, 3);
+    const DataType s3 = at(0, 1) * at(1, 2) - at(1, 1) * at(0, 2);
+    const DataType s4 = at(0, 1) * at(1, 3) - at(1, 1) * at(0, 3);
+    const DataType s5 = at(0, 2) * at(1, 3) - at(1, 2) * at(0, 3);
+    const DataType c5 = at(2, 2) * at(3, 3) - at(3, 2) * at(2, 3);
+    const DataType c4 = at(2, 1) * at(3, 3) - at(3, 1) * at(2, 3);
+    const DataType c3 = at(2, 1) * at(3, 2) - at(3, 1) * at(2, 2);
+    const DataType c2 = at(2, 0) * at(3, 3) - at(3, 0) * at(2, 3);
+    const DataType c1 = at(2, 0) * at(3, 2) - at(3, 0) * at(2, 2);
+    const DataType c0 = at(2, 0) * at(3, 1) - at(3, 0) * at(2, 1);
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  }
+
   DataType result = DataType();
-  if (shape() == std::tuple<int, int>(4, 4) ||
-      shape() == std::tuple<int, int>(3, 3))
+  if (shape() == std::tuple<int, int>(3, 3))
     for (unsigned col = 0; col < columns(); col++)
       result += at(0, col) * cofactor(0, col);
 
@@ -87,11 +63,11 @@ Matrix &Matrix::transpose() {
     for (unsigned col = 0; col < columns(); col++)
       M.set(col, row, at(row, col));
 
-  *this = std::move(M);
+  *this = M;
   return *this;
 }
 
-Matrix &Matrix::inverse() {
+Matrix &Matrix::inverse_cofactors() {
   Matrix::DataType det = determinant();
   assert(det != 0.0 && "Matrix is not invertible.");
   Matrix M2(columns(), rows());
@@ -101,15 +77,88 @@ Matrix &Matrix::inverse() {
         M2.set(col, row, cofactor(row, col) / det);
   }
 
-  *this = std::move(M2);
+  *this = M2;
+  return *this;
+}
+
+Matrix &Matrix::inverse_4x4() {
+  assert((shape() == std::tuple<int, int>(4, 4)) && "Expecting a 4x4 matrix");
+  const DataType s0 = at(0, 0) * at(1, 1) - at(1, 0) * at(0, 1);
+  const DataType s1 = at(0, 0) * at(1, 2) - at(1, 0) * at(0, 2);
+  const DataType s2 = at(0, 0) * at(1, 3) - at(1, 0) * at(0, 3);
+  const DataType s3 = at(0, 1) * at(1, 2) - at(1, 1) * at(0, 2);
+  const DataType s4 = at(0, 1) * at(1, 3) - at(1, 1) * at(0, 3);
+  const DataType s5 = at(0, 2) * at(1, 3) - at(1, 2) * at(0, 3);
+  const DataType c5 = at(2, 2) * at(3, 3) - at(3, 2) * at(2, 3);
+  const DataType c4 = at(2, 1) * at(3, 3) - at(3, 1) * at(2, 3);
+  const DataType c3 = at(2, 1) * at(3, 2) - at(3, 1) * at(2, 2);
+  const DataType c2 = at(2, 0) * at(3, 3) - at(3, 0) * at(2, 3);
+  const DataType c1 = at(2, 0) * at(3, 2) - at(3, 0) * at(2, 2);
+  const DataType c0 = at(2, 0) * at(3, 1) - at(3, 0) * at(2, 1);
+  const DataType det =
+      s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  assert(det != 0.0 && "Matrix is not invertible.");
+
+  Matrix M(4, 4);
+  if (det != 0.0) { // Matrix is invertible
+    M.set(0, 0, (at(1, 1) * c5 - at(1, 2) * c4 + at(1, 3) * c3) / det);
+    M.set(0, 1, (-at(0, 1) * c5 + at(0, 2) * c4 - at(0, 3) * c3) / det);
+    M.set(0, 2, (at(3, 1) * s5 - at(3, 2) * s4 + at(3, 3) * s3) / det);
+    M.set(0, 3, (-at(2, 1) * s5 + at(2, 2) * s4 - at(2, 3) * s3) / det);
+    M.set(1, 0, (-at(1, 0) * c5 + at(1, 2) * c2 - at(1, 3) * c1) / det);
+    M.set(1, 1, (at(0, 0) * c5 - at(0, 2) * c2 + at(0, 3) * c1) / det);
+    M.set(1, 2, (-at(3, 0) * s5 + at(3, 2) * s2 - at(3, 3) * s1) / det);
+    M.set(1, 3, (at(2, 0) * s5 - at(2, 2) * s2 + at(2, 3) * s1) / det);
+    M.set(2, 0, (at(1, 0) * c4 - at(1, 1) * c2 + at(1, 3) * c0) / det);
+    M.set(2, 1, (-at(0, 0) * c4 + at(0, 1) * c2 - at(0, 3) * c0) / det);
+    M.set(2, 2, (at(3, 0) * s4 - at(3, 1) * s2 + at(3, 3) * s0) / det);
+    M.set(2, 3, (-at(2, 0) * s4 + at(2, 1) * s2 - at(2, 3) * s0) / det);
+    M.set(3, 0, (-at(1, 0) * c3 + at(1, 1) * c1 - at(1, 2) * c0) / det);
+    M.set(3, 1, (at(0, 0) * c3 - at(0, 1) * c1 + at(0, 2) * c0) / det);
+    M.set(3, 2, (-at(3, 0) * s3 + at(3, 1) * s1 - at(3, 2) * s0) / det);
+    M.set(3, 3, (at(2, 0) * s3 - at(2, 1) * s1 + at(2, 2) * s0) / det);
+  }
+
+  *this = M;
+  return *this;
+}
+
+Matrix &Matrix::inverse_affine() {
+  assert(is_affine() && "Expecting an affine matrix");
+  // Inverse of the 3x3 linear part, from its adjugate.
+  const DataType i00 = at(1, 1) * at(2, 2) - at(1, 2) * at(2, 1);
+  const DataType i01 = at(0, 2) * at(2, 1) - at(0, 1) * at(2, 2);
+  const DataType i02 = at(0, 1) * at(1, 2) - at(0, 2) * at(1, 1);
+  const DataType i10 = at(1, 2) * at(2, 0) - at(1, 0) * at(2, 2);
+  const DataType i11 = at(0, 0) * at(2, 2) - at(0, 2) * at(2, 0);
+  const DataType i12 = at(0, 2) * at(1, 0) - at(0, 0) * at(1, 2);
+  const DataType i20 = at(1, 0) * at(2, 1) - at(1, 1) * at(2, 0);
+  const DataType i21 = at(0, 1) * at(2, 0) - at(0, 0) * at(2, 1);
+  const DataType i22 = at(0, 0) * at(1, 1) - at(0, 1) * at(1, 0);
+  const DataType det = at(0, 0) * i00 + at(0, 1) * i10 + at(0, 2) * i20;
+  assert(det != 0.0 && "Matrix is not invertible.");
+
+  Matrix M = Matrix::identity();
+  if (det != 0.0) { // Matrix is invertible
+    M.set(0, 0, i00 / det).set(0, 1, i01 / det).set(0, 2, i02 / det);
+    M.set(1, 0, i10 / det).set(1, 1, i11 / det).set(1, 2, i12 / det);
+    M.set(2, 0, i20 / det).set(2, 1, i21 / det).set(2, 2, i22 / det);
+    // The inverse translation is the opposite of the translation, transformed
+    // by the inverse linear part.
+    for (unsigned row = 0; row < 3; row++)
+      M.set(row, 3,
+            -(M.at(row, 0) * at(0, 3) + M.at(row, 1) * at(1, 3) +
+              M.at(row, 2) * at(2, 3)));
+  } else
+    M = Matrix(4, 4);
+
+  *this = M;
   return *this;
 }
 
 bool Matrix::operator==(const Matrix &rhs) const {
   if (m_Rows != rhs.m_Rows || m_Columns != rhs.m_Columns)
     return false;
-  if (m_Matrix == rhs.m_Matrix)
-    return true;
   for (unsigned row = 0; row < m_Rows; row++)
     for (unsigned column = 0; column < m_Columns; column++)
       if (at(row, column) != rhs.at(row, column))
@@ -146,21 +195,6 @@ Matrix::operator std::string() const {
   return os.str();
 }
 
-Matrix &Matrix::operator*=(const Matrix &rhs) {
-  assert(columns() == rhs.rows() && "Matrices must have compatible shapes");
-  Matrix M(rows(), columns());
-  for (unsigned row = 0; row < rows(); row++)
-    for (unsigned col = 0; col < rhs.columns(); col++) {
-      DataType acc = DataType();
-      for (unsigned it = 0; it < columns(); it++)
-        acc += at(row, it) * rhs.at(it, col);
-      M.set(row, col, acc);
-    }
-
-  *this = std::move(M);
-  return *this;
-}
-
 } // namespace ratrac
 
 std::ostream &operator<<(std::ostream &os, const ratrac::Matrix &M) {
@@ -0,0 +1,111 @@
+#include "ratrac/Numbers.h"
+
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+
+namespace ratrac {
+
+namespace {
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Exact powers of 10 in double precision.
+const double POWERS_OF_10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** strtod of [begin:end[, whatever the current locale is. */
+double strtod_c(const char *begin, const char *end) {
+  char buffer[128];
+  const size_t length = std::min<size_t>(end - begin, sizeof(buffer) - 1);
+  std::memcpy(buffer, begin, length);
+  buffer[length] = '\0';
+#if defined(_WIN32)
+  static const _locale_t c_locale = _create_locale(LC_ALL, "C");
+  return _strtod_l(buffer, nullptr, c_locale);
+#else
+  static const locale_t c_locale = newlocale(LC_ALL_MASK, "C", locale_t(0));
+  return strtod_l(buffer, nullptr, c_locale);
+#endif
+}
+} // namespace
+
+const char *parse_number(const char *p, const char *end, double &value) {
+  const char *begin = p;
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t significand = 0;
+  unsigned digits = 0;
+  int exponent = 0;
+  bool found = false;
+  bool truncated = false;
+  for (; p != end && is_digit(*p); p++) {
+    found = true;
+    if (digits < 19) {
+      significand = 10 * significand + (*p - '0');
+      digits += significand != 0;
+    } else {
+      truncated |= *p != '0';
+      exponent++;
+    }
+  }
+  if (p != end && *p == '.') {
+    for (p++; p != end && is_digit(*p); p++) {
+      found = true;
+      if (digits < 19) {
+        significand = 10 * significand + (*p - '0');
+        digits += significand != 0;
+        exponent--;
+      } else
+        truncated |= *p != '0';
+    }
+  }
+  if (!found)
+    return nullptr;
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negative_exponent = false;
+    if (q != end && (*q == '-' || *q == '+')) {
+      negative_exponent = *q == '-';
+      q++;
+    }
+    if (q == end || !is_digit(*q))
+      return nullptr;
+    int e = 0;
+    for (; q != end && is_digit(*q); q++)
+      e = std::min(10 * e + (*q - '0'), 100000);
+    exponent += negative_exponent ? -e : e;
+    p = q;
+  }
+
+  // When the significand and the power of 10 are both exact doubles, a single
+  // multiplication or division rounds correctly.
+  double v = double(significand);
+  if (significand == 0)
+    v = 0;
+  else if (!truncated && uint64_t(v) == significand && exponent >= -22 &&
+           exponent <= 22)
+    v = exponent >= 0 ? v * POWERS_OF_10[exponent]
+                      : v / POWERS_OF_10[-exponent];
+  else if (p - begin < 128)
+    v = std::fabs(strtod_c(begin, p));
+  else
+    v *= std::pow(10.0, exponent);
+  value = negative ? -v : v;
+  return p;
+}
+
+} // namespace ratrac
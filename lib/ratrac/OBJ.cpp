@@ -0,0 +1,359 @@
+#include "ratrac/OBJ.h"
+#include "ratrac/MappedFile.h"
+#include "ratrac/Numbers.h"
+#include "ratrac/Scheduler.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/World.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace ratrac {
+
+namespace {
+const unsigned NO_INDEX = std::numeric_limits<unsigned>::max();
+
+// Chunks smaller than this are not worth a task of their own.
+const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+// Lexing.
+// =======
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char *skip_blanks(const char *p, const char *end) {
+  while (p != end && is_blank(*p))
+    p++;
+  return p;
+}
+
+inline const char *end_of_line(const char *p, const char *end) {
+  const void *eol = std::memchr(p, '\n', end - p);
+  return eol ? static_cast<const char *>(eol) : end;
+}
+
+enum class Statement { VERTEX, NORMAL, FACE, OTHER };
+
+/** Returns the statement of the line at p, which is at its first non blank
+ * character, and moves p past the statement keyword. */
+inline Statement statement(const char *&p, const char *eol) {
+  const char *keyword = p;
+  while (p != eol && !is_blank(*p))
+    p++;
+  const size_t length = p - keyword;
+  if (length == 1 && keyword[0] == 'v')
+    return Statement::VERTEX;
+  if (length == 1 && keyword[0] == 'f')
+    return Statement::FACE;
+  if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+    return Statement::NORMAL;
+  return Statement::OTHER;
+}
+
+/** Parse the integer at p. Returns the end of the integer, or nullptr if
+ * there is none at p. */
+const char *parse_index(const char *p, const char *end, int64_t &value) {
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || !is_digit(*p))
+    return nullptr;
+  int64_t v = 0;
+  for (; p != end && is_digit(*p); p++)
+    v = std::min<int64_t>(10 * v + (*p - '0'), int64_t(1) << 40);
+  value = negative ? -v : v;
+  return p;
+}
+
+// Parsing.
+// ========
+
+/** A part of the file, parsed by a single task. The vertices and normals are
+ * counted first, so that each chunk knows where its own go in the mesh, and
+ * resolves the relative indices on its own. */
+struct Chunk {
+  Chunk(const char *begin, const char *end)
+      : begin(begin), end(end), num_vertices(0), num_normals(0),
+        vertex_offset(0), normal_offset(0), corners(), normal_corners(),
+        missing_normals(0), error_position(nullptr), error() {}
+
+  const char *begin;
+  const char *end;
+  size_t num_vertices;
+  size_t num_normals;
+  size_t vertex_offset;
+  size_t normal_offset;
+  // The vertex and normal indices of the triangles' corners, NO_INDEX for
+  // the corners without a normal.
+  std::vector<unsigned> corners;
+  std::vector<unsigned> normal_corners;
+  size_t missing_normals;
+  const char *error_position;
+  const char *error;
+
+  void count() {
+    for (const char *line = begin; line != end;) {
+      const char *eol = end_of_line(line, end);
+      const char *p = skip_blanks(line, eol);
+      switch (statement(p, eol)) {
+      case Statement::VERTEX:
+        num_vertices++;
+        break;
+      case Statement::NORMAL:
+        num_normals++;
+        break;
+      default:
+        break;
+      }
+      line = eol == end ? end : eol + 1;
+    }
+  }
+
+  bool fail(const char *position, const char *message) {
+    error_position = position;
+    error = message;
+    return false;
+  }
+
+  /** Parse the 3 coordinates at p, ignoring the optional fourth one. */
+  bool parse_coordinates(const char *p, const char *eol, double xyz[3]) {
+    for (unsigned i = 0; i < 3; i++) {
+      p = skip_blanks(p, eol);
+      const char *q = parse_number(p, eol, xyz[i]);
+      if (!q || (q != eol && !is_blank(*q)))
+        return fail(p, "expecting a number");
+      p = q;
+    }
+    return true;
+  }
+
+  /** Resolve OBJ index i, 1 based or relative to the count elements seen so
+   * far, to an index in [0:total[. */
+  static bool resolve(int64_t i, size_t count, size_t total, unsigned &index) {
+    const int64_t resolved = i > 0 ? i - 1 : int64_t(count) + i;
+    if (i == 0 || resolved < 0 || resolved >= int64_t(total))
+      return false;
+    index = unsigned(resolved);
+    return true;
+  }
+
+  /** Parse the chunk, storing the vertices and normals in their final place
+   * in vertices and normals. */
+  bool parse(std::vector<Tuple> &vertices, std::vector<Tuple> &normals) {
+    size_t vertex = vertex_offset;
+    size_t normal = normal_offset;
+    std::vector<unsigned> polygon, polygon_normals;
+    for (const char *line = begin; line != end;) {
+      const char *eol = end_of_line(line, end);
+      const char *p = skip_blanks(line, eol);
+      double xyz[3];
+      switch (statement(p, eol)) {
+      case Statement::VERTEX:
+        if (!parse_coordinates(p, eol, xyz))
+          return false;
+        vertices[vertex++] = Point(xyz[0], xyz[1], xyz[2]);
+        break;
+      case Statement::NORMAL:
+        if (!parse_coordinates(p, eol, xyz))
+          return false;
+        normals[normal++] = Vector(xyz[0], xyz[1], xyz[2]);
+        break;
+      case Statement::FACE:
+        polygon.clear();
+        polygon_normals.clear();
+        for (p = skip_blanks(p, eol); p != eol; p = skip_blanks(p, eol)) {
+          // v, v/vt, v//vn or v/vt/vn.
+          int64_t i;
+          const char *q = parse_index(p, eol, i);
+          unsigned v, n = NO_INDEX;
+          if (!q)
+            return fail(p, "expecting a vertex index");
+          if (!resolve(i, vertex, vertices.size(), v))
+            return fail(p, "vertex index out of range");
+          if (q != eol && *q == '/') {
+            q++;
+            if (q != eol && *q != '/' && !(q = parse_index(q, eol, i)))
+              return fail(p, "expecting a texture index");
+            if (q != eol && *q == '/') {
+              q++;
+              if (!(q = parse_index(q, eol, i)))
+                return fail(p, "expecting a normal index");
+              if (!resolve(i, normal, normals.size(), n))
+                return fail(p, "normal index out of range");
+            }
+          }
+          if (q != eol && !is_blank(*q))
+            return fail(p, "malformed face vertex");
+          polygon.push_back(v);
+          polygon_normals.push_back(n);
+          p = q;
+        }
+        if (polygon.size() < 3)
+          return fail(line, "faces need at least 3 vertices");
+        for (unsigned k = 1; k + 1 < polygon.size(); k++)
+          for (unsigned c : {0U, k, k + 1}) {
+            corners.push_back(polygon[c]);
+            normal_corners.push_back(polygon_normals[c]);
+            missing_normals += polygon_normals[c] == NO_INDEX;
+          }
+        break;
+      case Statement::OTHER:
+        break;
+      }
+      line = eol == end ? end : eol + 1;
+    }
+    return true;
+  }
+};
+
+/** Run task(i) for i in [0:count[, on threads workers. */
+template <class TaskTy>
+void run_tasks(unsigned threads, size_t count, TaskTy task) {
+  if (threads <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+  TaskScheduler scheduler(std::min<size_t>(threads, count));
+  for (size_t i = 0; i < count; i++)
+    scheduler.push(i * scheduler.workers() / count,
+                   [&task, i](unsigned) { task(i); });
+  scheduler.run();
+}
+
+/** Give each vertex the normal it is used with, duplicating the vertices used
+ * with different normals. */
+void assign_normals(OBJMesh &mesh, const std::vector<unsigned> &normal_corners,
+                    const std::vector<Tuple> &normals) {
+  std::vector<unsigned> vertex_normals(mesh.vertices.size(), NO_INDEX);
+  bool consistent = true;
+  for (size_t c = 0; c < mesh.indices.size() && consistent; c++) {
+    unsigned &n = vertex_normals[mesh.indices[c]];
+    if (n == NO_INDEX)
+      n = normal_corners[c];
+    consistent = n == normal_corners[c];
+  }
+
+  if (consistent) {
+    mesh.normals.resize(mesh.vertices.size(), Vector(0, 0, 0));
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+      if (vertex_normals[v] != NO_INDEX)
+        mesh.normals[v] = normals[vertex_normals[v]];
+    return;
+  }
+
+  std::unordered_map<uint64_t, unsigned> pairs;
+  std::vector<Tuple> vertices;
+  for (size_t c = 0; c < mesh.indices.size(); c++) {
+    const uint64_t key = (uint64_t(mesh.indices[c]) << 32) | normal_corners[c];
+    auto it = pairs.emplace(key, unsigned(vertices.size())).first;
+    if (it->second == vertices.size()) {
+      vertices.push_back(mesh.vertices[mesh.indices[c]]);
+      mesh.normals.push_back(normals[normal_corners[c]]);
+    }
+    mesh.indices[c] = it->second;
+  }
+  mesh.vertices = std::move(vertices);
+}
+} // namespace
+
+bool parse_obj(const char *begin, const char *end, OBJMesh &mesh,
+               unsigned threads, std::string *error) {
+  mesh = OBJMesh();
+
+  // Split the text in chunks of whole lines, a few per thread so that the
+  // work stealing can balance them.
+  const size_t size = end - begin;
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(threads > 1 ? 4 * threads : 1,
+                          size / MIN_CHUNK_SIZE));
+  std::vector<Chunk> chunks;
+  chunks.reserve(num_chunks);
+  for (const char *p = begin; p != end;) {
+    const char *q = begin + size * (chunks.size() + 1) / num_chunks;
+    q = q <= p ? p : q;
+    q = q == end ? end : std::min(end, end_of_line(q - 1, end) + 1);
+    chunks.emplace_back(p, q);
+    p = q;
+  }
+
+  run_tasks(threads, chunks.size(), [&](size_t c) { chunks[c].count(); });
+  size_t num_vertices = 0, num_normals = 0;
+  for (Chunk &chunk : chunks) {
+    chunk.vertex_offset = num_vertices;
+    chunk.normal_offset = num_normals;
+    num_vertices += chunk.num_vertices;
+    num_normals += chunk.num_normals;
+  }
+
+  std::vector<Tuple> normals(num_normals);
+  mesh.vertices.resize(num_vertices);
+  run_tasks(threads, chunks.size(),
+            [&](size_t c) { chunks[c].parse(mesh.vertices, normals); });
+
+  size_t num_corners = 0, missing_normals = 0;
+  for (const Chunk &chunk : chunks) {
+    if (chunk.error) {
+      if (error)
+        *error = "line " +
+                 std::to_string(1 + std::count(begin, chunk.error_position,
+                                               '\n')) +
+                 ": " + chunk.error;
+      mesh = OBJMesh();
+      return false;
+    }
+    num_corners += chunk.corners.size();
+    missing_normals += chunk.missing_normals;
+  }
+
+  // Gather the faces, and the normal indices if all faces have normals.
+  const bool with_normals = num_normals > 0 && missing_normals == 0;
+  std::vector<unsigned> normal_corners(with_normals ? num_corners : 0);
+  mesh.indices.resize(num_corners);
+  std::vector<size_t> offsets(chunks.size() + 1, 0);
+  for (size_t c = 0; c < chunks.size(); c++)
+    offsets[c + 1] = offsets[c] + chunks[c].corners.size();
+  run_tasks(threads, chunks.size(), [&](size_t c) {
+    std::copy(chunks[c].corners.begin(), chunks[c].corners.end(),
+              mesh.indices.begin() + offsets[c]);
+    if (with_normals)
+      std::copy(chunks[c].normal_corners.begin(),
+                chunks[c].normal_corners.end(),
+                normal_corners.begin() + offsets[c]);
+  });
+
+  if (with_normals)
+    assign_normals(mesh, normal_corners, normals);
+  return true;
+}
+
+bool read_obj(const std::string &filename, OBJMesh &mesh, unsigned threads,
+              std::string *error) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    if (error)
+      *error = "can not read " + filename;
+    return false;
+  }
+  return parse_obj(file.begin(), file.end(), mesh, threads, error);
+}
+
+TriangleMesh *load_obj(World &world, const std::string &filename,
+                       unsigned threads, std::string *error) {
+  OBJMesh obj;
+  if (!read_obj(filename, obj, threads, error))
+    return nullptr;
+  TriangleMesh *mesh =
+      new TriangleMesh(std::move(obj.vertices), std::move(obj.indices),
+                       std::move(obj.normals), threads);
+  world.append(mesh);
+  return mesh;
+}
+
+} // namespace ratrac
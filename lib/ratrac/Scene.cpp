@@ -0,0 +1,939 @@
+#include "ratrac/Scene.h"
+#include "ratrac/Color.h"
+#include "ratrac/Instance.h"
+#include "ratrac/Light.h"
+#include "ratrac/MappedFile.h"
+#include "ratrac/Material.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Numbers.h"
+#include "ratrac/OBJ.h"
+#include "ratrac/Patterns.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/Tuple.h"
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::unique_ptr;
+
+namespace ratrac {
+
+namespace {
+// A node of a YAML document. The nodes are stored in a flat vector, the
+// parents before their children, which are linked by their next index. The
+// keys and scalars are views of the text.
+struct Node {
+  enum Kind : uint8_t { SCALAR, SEQUENCE, MAPPING };
+
+  // Node 0, the root, is nobody's child.
+  static constexpr unsigned NONE = 0;
+
+  Node(Kind kind, unsigned line)
+      : kind(kind), line(line), key(), text(), first(NONE), next(NONE) {}
+
+  Kind kind;
+  unsigned line;
+  string_view key;  // The key of the mapping entries.
+  string_view text; // The value of the scalars.
+  unsigned first;   // The first child of the sequences and mappings.
+  unsigned next;    // The next child of the parent.
+};
+
+using Nodes = std::vector<Node>;
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// The YAML subset parser, which reads the top-level sequence one item at a
+// time.
+class Parser {
+public:
+  Parser(const char *begin, const char *end)
+      : error(nullptr), error_line(0), p(begin), end(end), line_start(begin),
+        line(1), indent(0), root_indent(0), started(false), done(false) {}
+
+  /** Parse the next item of the top-level sequence to nodes, the item being
+   * nodes[0]. Returns false at the end of the text, or on errors. */
+  bool next_item(Nodes &nodes) {
+    nodes.clear();
+    if (!started) {
+      started = true;
+      if (!content())
+        return false;
+      if (!sequence_item())
+        return fail("expecting a sequence of items");
+      root_indent = indent;
+    } else if (done || error)
+      return false;
+    else if (indent != root_indent || !sequence_item())
+      return fail("bad indentation");
+    unsigned item;
+    return sequence_entry(nodes, root_indent, item);
+  }
+
+  const char *error;
+  unsigned error_line;
+
+private:
+  bool fail(const char *message) { return fail(message, line); }
+  bool fail(const char *message, unsigned at_line) {
+    if (!error) {
+      error = message;
+      error_line = at_line;
+    }
+    return false;
+  }
+
+  unsigned add(Nodes &nodes, Node::Kind kind, unsigned at_line) {
+    nodes.emplace_back(kind, at_line);
+    return nodes.size() - 1;
+  }
+
+  void link(Nodes &nodes, unsigned parent, unsigned &last, unsigned child) {
+    if (last == Node::NONE)
+      nodes[parent].first = child;
+    else
+      nodes[last].next = child;
+    last = child;
+  }
+
+  // Skip the blanks, returning true if the line has no more content.
+  bool at_line_end() {
+    while (p != end && is_blank(*p))
+      p++;
+    return p == end || *p == '\n' || *p == '#';
+  }
+
+  // Move p to the first character of the current line with content, or of
+  // the next one, setting indent. Blank lines, comments and document markers
+  // are skipped. Returns false at the end of the text, or on errors.
+  bool content() {
+    for (;;) {
+      while (p != end && *p == ' ')
+        p++;
+      indent = p - line_start;
+      const char *q = p;
+      while (q != end && is_blank(*q))
+        q++;
+      const bool blank = q == end || *q == '\n' || *q == '#';
+      const bool marker =
+          indent == 0 && end - p >= 3 &&
+          (string_view(p, 3) == "---" || string_view(p, 3) == "...") &&
+          (end - p == 3 || is_blank(p[3]) || p[3] == '\n');
+      if (!blank && !marker) {
+        if (q != p)
+          return fail("tabs can not indent");
+        return true;
+      }
+      while (p != end && *p != '\n')
+        p++;
+      if (p == end) {
+        done = true;
+        return false;
+      }
+      p++;
+      line++;
+      line_start = p;
+    }
+  }
+
+  // Move to the next line with content, the current one having none left.
+  bool next_line() {
+    while (p != end && *p != '\n')
+      p++;
+    if (p == end) {
+      done = true;
+      return false;
+    }
+    p++;
+    line++;
+    line_start = p;
+    return content();
+  }
+
+  // Whether the block node started at column goes on with the current line.
+  bool more(unsigned column) {
+    if (done || error || indent < column)
+      return false;
+    if (indent > column)
+      return fail("bad indentation");
+    return true;
+  }
+
+  bool sequence_item() const {
+    return *p == '-' &&
+           (p + 1 == end || is_blank(p[1]) || p[1] == '\n' || p[1] == '#');
+  }
+
+  // Scan the quoted or plain scalar at p. Plain scalars end at the end of the
+  // line, at a comment, or at a ':' followed by a blank, and in flow context
+  // at a ',' or a closing bracket too. Their trailing blanks are dropped.
+  bool scalar(string_view &text, bool flow) {
+    if (*p == '"' || *p == '\'') {
+      const char quote = *p++;
+      const char *begin = p;
+      while (p != end && *p != quote && *p != '\n')
+        p++;
+      if (p == end || *p != quote)
+        return fail("unterminated string");
+      text = string_view(begin, p - begin);
+      p++;
+      return true;
+    }
+    const char *begin = p;
+    const char *last = p;
+    while (p != end && *p != '\n') {
+      const char c = *p;
+      if (c == ':' && (p + 1 == end || is_blank(p[1]) || p[1] == '\n' ||
+                       (flow && (p[1] == ',' || p[1] == ']' || p[1] == '}'))))
+        break;
+      if (c == '#' && p != begin && is_blank(p[-1]))
+        break;
+      if (flow && (c == ',' || c == ']' || c == '}'))
+        break;
+      p++;
+      if (!is_blank(c))
+        last = p;
+    }
+    text = string_view(begin, last - begin);
+    return true;
+  }
+
+  // Skip the blanks, line breaks and comments in flow nodes. Returns false at
+  // the end of the text.
+  bool flow_spaces() {
+    for (;;) {
+      while (p != end && is_blank(*p))
+        p++;
+      if (p == end)
+        return false;
+      if (*p == '#')
+        while (p != end && *p != '\n')
+          p++;
+      else if (*p == '\n') {
+        p++;
+        line++;
+        line_start = p;
+      } else
+        return true;
+    }
+  }
+
+  // Parse the flow sequence or mapping at p, up to its closing bracket.
+  bool flow(Nodes &nodes, unsigned &index) {
+    const bool mapping = *p == '{';
+    const char close = mapping ? '}' : ']';
+    index = add(nodes, mapping ? Node::MAPPING : Node::SEQUENCE, line);
+    unsigned last = Node::NONE;
+    p++;
+    for (;;) {
+      if (!flow_spaces())
+        return fail(mapping ? "unterminated flow mapping"
+                            : "unterminated flow sequence");
+      if (*p == close) {
+        p++;
+        return true;
+      }
+      string_view key;
+      if (mapping) {
+        if (*p == '[' || *p == '{' || !scalar(key, true) || p == end ||
+            *p != ':')
+          return fail("expecting a key");
+        p++;
+        if (!flow_spaces())
+          return fail("unterminated flow mapping");
+      }
+      unsigned child;
+      if (*p == '[' || *p == '{') {
+        if (!flow(nodes, child))
+          return false;
+      } else {
+        if (*p == ',' || *p == close)
+          return fail("expecting a value");
+        child = add(nodes, Node::SCALAR, line);
+        string_view text;
+        if (!scalar(text, true))
+          return false;
+        nodes[child].text = text;
+      }
+      nodes[child].key = key;
+      link(nodes, index, last, child);
+      if (!flow_spaces())
+        return fail(mapping ? "unterminated flow mapping"
+                            : "unterminated flow sequence");
+      if (*p == ',')
+        p++;
+      else if (*p != close)
+        return fail(mapping ? "expecting ',' or '}'" : "expecting ',' or ']'");
+    }
+  }
+
+  // Parse the scalar or flow node at p, which ends the line.
+  bool inline_node(Nodes &nodes, unsigned &index) {
+    if (*p == '[' || *p == '{') {
+      if (!flow(nodes, index))
+        return false;
+    } else {
+      index = add(nodes, Node::SCALAR, line);
+      string_view text;
+      if (!scalar(text, false))
+        return false;
+      if (p != end && *p == ':')
+        return fail("mappings must start on their own line");
+      nodes[index].text = text;
+    }
+    if (!at_line_end())
+      return fail("unexpected text");
+    next_line();
+    return !error;
+  }
+
+  // Parse the block node at p, with the lines which follow it.
+  bool block(Nodes &nodes, unsigned &index) {
+    const unsigned column = p - line_start;
+    if (sequence_item())
+      return block_sequence(nodes, column, index);
+    if (*p != '[' && *p != '{') {
+      // A mapping, if this is a key.
+      const char *start = p;
+      string_view text;
+      if (!scalar(text, false))
+        return false;
+      const bool key = p != end && *p == ':';
+      p = start;
+      if (key)
+        return block_mapping(nodes, column, index);
+    }
+    return inline_node(nodes, index);
+  }
+
+  // Parse the entry of the sequence item at p.
+  bool sequence_entry(Nodes &nodes, unsigned column, unsigned &index) {
+    const unsigned item_line = line;
+    p++;
+    if (at_line_end() && (!next_line() || indent <= column))
+      return fail("expecting a value", item_line);
+    return block(nodes, index);
+  }
+
+  bool block_sequence(Nodes &nodes, unsigned column, unsigned &index) {
+    index = add(nodes, Node::SEQUENCE, line);
+    unsigned last = Node::NONE;
+    do {
+      unsigned child;
+      if (!sequence_entry(nodes, column, child))
+        return false;
+      link(nodes, index, last, child);
+    } while (more(column) && sequence_item());
+    return !error;
+  }
+
+  bool block_mapping(Nodes &nodes, unsigned column, unsigned &index) {
+    index = add(nodes, Node::MAPPING, line);
+    unsigned last = Node::NONE;
+    do {
+      const unsigned key_line = line;
+      string_view key;
+      if (sequence_item() || *p == '[' || *p == '{' || !scalar(key, false) ||
+          p == end || *p != ':')
+        return fail("expecting a key");
+      p++;
+      unsigned child;
+      if (!at_line_end()) {
+        if (!inline_node(nodes, child))
+          return false;
+      } else if (next_line() &&
+                 (indent > column || (indent == column && sequence_item()))) {
+        if (!block(nodes, child))
+          return false;
+      } else {
+        if (error)
+          return false;
+        // An empty value.
+        child = add(nodes, Node::SCALAR, key_line);
+      }
+      nodes[child].key = key;
+      link(nodes, index, last, child);
+    } while (more(column));
+    return !error;
+  }
+
+  const char *p;
+  const char *end;
+  const char *line_start;
+  unsigned line;
+  unsigned indent;
+  unsigned root_indent;
+  bool started;
+  bool done;
+};
+
+// A named material, transform or shape: the shapes are the prototypes of
+// the instances which add them.
+struct Definition {
+  enum Kind { MATERIAL, TRANSFORM, SHAPE };
+
+  Definition(const Material &material)
+      : kind(MATERIAL), material(material), transform(Matrix::identity()),
+        shape() {}
+  Definition(const Matrix &transform)
+      : kind(TRANSFORM), material(), transform(transform), shape() {}
+  Definition(std::shared_ptr<const Shape> shape)
+      : kind(SHAPE), material(), transform(Matrix::identity()),
+        shape(std::move(shape)) {}
+
+  Kind kind;
+  Material material;
+  Matrix transform;
+  std::shared_ptr<const Shape> shape;
+};
+
+// Build the scene from the items of the description, one at a time.
+class Builder {
+public:
+  Builder(Scene &scene, const string &directory)
+      : error(), error_line(0), scene(scene), directory(directory), nodes(),
+        definitions(), factors() {}
+
+  /** Add the item in nodes[0] to the scene. */
+  bool item(const Nodes &item_nodes) {
+    nodes = &item_nodes;
+    const Node &item = (*nodes)[0];
+    if (item.kind != Node::MAPPING)
+      return fail(item, "expecting a mapping");
+    const Node &first = (*nodes)[item.first];
+    if (first.key == "add")
+      return add(item, first);
+    if (first.key == "define")
+      return define(item, first);
+    return fail(first, "expecting 'add' or 'define'");
+  }
+
+  string error;
+  unsigned error_line;
+
+private:
+  struct Field {
+    string_view key;
+    const Node **value;
+  };
+
+  bool fail(const Node &node, string message) {
+    error = std::move(message);
+    error_line = node.line;
+    return false;
+  }
+
+  static string quoted(string_view s) { return "'" + string(s) + "'"; }
+
+  // Set the fields to the values of their key in mapping, or to nullptr.
+  bool fields(const Node &mapping, std::initializer_list<Field> fields) {
+    for (const Field &field : fields)
+      *field.value = nullptr;
+    for (unsigned c = mapping.first; c != Node::NONE; c = (*nodes)[c].next) {
+      const Node &child = (*nodes)[c];
+      const Field *field = nullptr;
+      for (const Field &f : fields)
+        if (f.key == child.key)
+          field = &f;
+      if (!field)
+        return fail(child, "unknown key " + quoted(child.key));
+      if (*field->value)
+        return fail(child, "duplicate key " + quoted(child.key));
+      *field->value = &child;
+    }
+    return true;
+  }
+
+  bool require(const Node &mapping, const Node *value, string_view key) {
+    return value || fail(mapping, "missing key " + quoted(key));
+  }
+
+  bool number(const Node &node, double &value) {
+    if (node.kind == Node::SCALAR) {
+      const char *begin = node.text.data();
+      const char *end = begin + node.text.size();
+      if (begin != end && parse_number(begin, end, value) == end)
+        return true;
+    }
+    return fail(node, "expecting a number");
+  }
+
+  bool size(const Node &node, unsigned &value) {
+    double v;
+    if (!number(node, v))
+      return false;
+    if (v < 1 || v > 65536 || v != std::floor(v))
+      return fail(node, "expecting an image size");
+    value = unsigned(v);
+    return true;
+  }
+
+  bool triple(const Node &node, double v[3]) {
+    unsigned n = 0;
+    if (node.kind == Node::SEQUENCE)
+      for (unsigned c = node.first; c != Node::NONE; c = (*nodes)[c].next) {
+        if (n == 3)
+          return fail(node, "expecting [x, y, z]");
+        if (!number((*nodes)[c], v[n++]))
+          return false;
+      }
+    return n == 3 || fail(node, "expecting [x, y, z]");
+  }
+
+  bool point(const Node &node, Tuple &p) {
+    double v[3];
+    if (!triple(node, v))
+      return false;
+    p = Point(v[0], v[1], v[2]);
+    return true;
+  }
+
+  bool vector(const Node &node, Tuple &p) {
+    double v[3];
+    if (!triple(node, v))
+      return false;
+    p = Vector(v[0], v[1], v[2]);
+    return true;
+  }
+
+  bool color(const Node &node, Color &c) {
+    double v[3];
+    if (!triple(node, v))
+      return false;
+    c = Color(v[0], v[1], v[2]);
+    return true;
+  }
+
+  // The transforms are listed in the order they apply: the matrix is their
+  // product from the last one to the first one, evaluated from the left, as
+  // it would be written in C++.
+  bool transform(const Node &node, Matrix &M) {
+    if (node.kind != Node::SEQUENCE)
+      return fail(node, "expecting a list of transforms");
+    factors.clear();
+    for (unsigned c = node.first; c != Node::NONE; c = (*nodes)[c].next) {
+      const Node &op = (*nodes)[c];
+      if (op.kind == Node::SCALAR) {
+        const Definition *d = definition(op, Definition::TRANSFORM);
+        if (!d)
+          return false;
+        factors.push_back(d->transform);
+        continue;
+      }
+      if (op.kind != Node::SEQUENCE || op.first == Node::NONE ||
+          (*nodes)[op.first].kind != Node::SCALAR)
+        return fail(op, "expecting a transform");
+      const string_view name = (*nodes)[op.first].text;
+      double a[6];
+      unsigned n = 0;
+      for (unsigned i = (*nodes)[op.first].next; i != Node::NONE;
+           i = (*nodes)[i].next) {
+        if (n == 6)
+          return fail(op, "too many arguments to " + quoted(name));
+        if (!number((*nodes)[i], a[n++]))
+          return false;
+      }
+      unsigned expected;
+      if (name == "translate" || name == "scale")
+        expected = 3;
+      else if (name == "rotate-x" || name == "rotate-y" || name == "rotate-z")
+        expected = 1;
+      else if (name == "shear")
+        expected = 6;
+      else
+        return fail(op, "unknown transform " + quoted(name));
+      if (n != expected)
+        return fail(op, quoted(name) + " expects " + std::to_string(expected) +
+                            (expected == 1 ? " argument" : " arguments"));
+      if (name == "translate")
+        factors.push_back(Matrix::translation(a[0], a[1], a[2]));
+      else if (name == "scale")
+        factors.push_back(Matrix::scaling(a[0], a[1], a[2]));
+      else if (name == "rotate-x")
+        factors.push_back(Matrix::rotation_x(a[0]));
+      else if (name == "rotate-y")
+        factors.push_back(Matrix::rotation_y(a[0]));
+      else if (name == "rotate-z")
+        factors.push_back(Matrix::rotation_z(a[0]));
+      else
+        factors.push_back(
+            Matrix::shearing(a[0], a[1], a[2], a[3], a[4], a[5]));
+    }
+    if (factors.empty()) {
+      M = Matrix::identity();
+      return true;
+    }
+    M = factors.back();
+    for (size_t i = factors.size() - 1; i-- > 0;)
+      M = M * factors[i];
+    return true;
+  }
+
+  bool pattern(const Node &node, unique_ptr<Pattern> &result) {
+    if (node.kind != Node::MAPPING)
+      return fail(node, "expecting a pattern");
+    const Node *type, *colors, *patterns, *transform_node;
+    if (!fields(node, {{"type", &type},
+                       {"colors", &colors},
+                       {"patterns", &patterns},
+                       {"transform", &transform_node}}) ||
+        !require(node, type, "type"))
+      return false;
+
+    Matrix t = Matrix::identity();
+    if (transform_node && !transform(*transform_node, t))
+      return false;
+
+    if (type->kind != Node::SCALAR)
+      return fail(*type, "expecting a pattern type");
+    const string_view name = type->text;
+    const bool bicolor = name == "stripes" || name == "gradient" ||
+                         name == "rings" || name == "radial-gradient" ||
+                         (name == "checkers" && colors);
+    const bool bipattern = name == "blend" || (name == "checkers" && !colors);
+    if (!bicolor && !bipattern)
+      return fail(*type, "unknown pattern type " + quoted(name));
+
+    const Node *pair = bicolor ? colors : patterns;
+    if (!require(node, pair, bicolor ? "colors" : "patterns"))
+      return false;
+    if ((bicolor && patterns) || (bipattern && colors))
+      return fail(node, quoted(name) + " has either colors or patterns");
+    if (pair->kind != Node::SEQUENCE || pair->first == Node::NONE ||
+        (*nodes)[pair->first].next == Node::NONE ||
+        (*nodes)[(*nodes)[pair->first].next].next != Node::NONE)
+      return fail(*pair,
+                  bicolor ? "expecting 2 colors" : "expecting 2 patterns");
+    const Node &first = (*nodes)[pair->first];
+    const Node &second = (*nodes)[first.next];
+
+    if (bicolor) {
+      Color a, b;
+      if (!color(first, a) || !color(second, b))
+        return false;
+      if (name == "stripes")
+        result.reset(new Stripes(a, b, t));
+      else if (name == "gradient")
+        result.reset(new Gradient(a, b, t));
+      else if (name == "rings")
+        result.reset(new Ring(a, b, t));
+      else if (name == "radial-gradient")
+        result.reset(new RadialGradient(a, b, t));
+      else
+        result.reset(new ColorCheckers(a, b, t));
+      return true;
+    }
+
+    unique_ptr<Pattern> a, b;
+    if (!pattern(first, a) || !pattern(second, b))
+      return false;
+    if (name == "blend")
+      result.reset(new PatternBlender(a.release(), b.release(), t));
+    else
+      result.reset(new PatternCheckers(a.release(), b.release(), t));
+    return true;
+  }
+
+  // Update material with the properties in mapping.
+  bool material(const Node &mapping, Material &m) {
+    if (mapping.kind != Node::MAPPING)
+      return fail(mapping, "expecting a material");
+    for (unsigned c = mapping.first; c != Node::NONE; c = (*nodes)[c].next) {
+      const Node &property = (*nodes)[c];
+      const string_view key = property.key;
+      double value;
+      if (key == "color") {
+        Color color;
+        if (!this->color(property, color))
+          return false;
+        m.color(color);
+      } else if (key == "pattern") {
+        unique_ptr<Pattern> p;
+        if (!pattern(property, p))
+          return false;
+        m.pattern(p);
+      } else if (key == "ambient" || key == "diffuse" || key == "specular" ||
+                 key == "shininess" || key == "reflective" ||
+                 key == "transparency" || key == "refractive-index") {
+        if (!number(property, value))
+          return false;
+        if (key == "ambient")
+          m.ambient(value);
+        else if (key == "diffuse")
+          m.diffuse(value);
+        else if (key == "specular")
+          m.specular(value);
+        else if (key == "shininess")
+          m.shininess(value);
+        // The reflection and refraction properties of the book's scenes are
+        // not rendered, and ignored.
+      } else
+        return fail(property, "unknown key " + quoted(key));
+    }
+    return true;
+  }
+
+  // A material, by name or by properties.
+  bool object_material(const Node &node, Material &m) {
+    if (node.kind != Node::SCALAR)
+      return material(node, m);
+    const Definition *d = definition(node, Definition::MATERIAL);
+    if (!d)
+      return false;
+    m = d->material;
+    return true;
+  }
+
+  const Definition *definition(const Node &name, Definition::Kind kind) {
+    auto it = definitions.find(name.text);
+    if (it == definitions.end() || it->second.kind != kind) {
+      fail(name, string(kind == Definition::MATERIAL ? "unknown material "
+                                                     : "unknown transform ") +
+                     quoted(name.text));
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  bool define(const Node &item, const Node &name) {
+    const Node *item_kind, *extend, *value;
+    if (!fields(item, {{"define", &item_kind},
+                       {"extend", &extend},
+                       {"value", &value}}) ||
+        !require(item, value, "value"))
+      return false;
+    if (name.kind != Node::SCALAR || name.text.empty())
+      return fail(name, "expecting a name");
+    if (definitions.count(name.text))
+      return fail(name, quoted(name.text) + " is already defined");
+
+    if (value->kind == Node::SEQUENCE) {
+      if (extend)
+        return fail(*extend, "only materials can be extended");
+      Matrix M = Matrix::identity();
+      if (!transform(*value, M))
+        return false;
+      definitions.emplace(name.text, Definition(M));
+      return true;
+    }
+
+    if (value->kind == Node::MAPPING && (*nodes)[value->first].key == "add") {
+      if (extend)
+        return fail(*extend, "only materials can be extended");
+      unique_ptr<Shape> s;
+      if (!shape(*value, (*nodes)[value->first], s))
+        return false;
+      std::shared_ptr<const Shape> prototype(s.release());
+      definitions.emplace(name.text, Definition(std::move(prototype)));
+      return true;
+    }
+
+    Material m;
+    if (extend) {
+      if (extend->kind != Node::SCALAR)
+        return fail(*extend, "expecting a material");
+      const Definition *base = definition(*extend, Definition::MATERIAL);
+      if (!base)
+        return false;
+      m = base->material;
+    }
+    if (!material(*value, m))
+      return false;
+    definitions.emplace(name.text, Definition(m));
+    return true;
+  }
+
+  bool add(const Node &item, const Node &what) {
+    if (what.kind == Node::SCALAR && what.text == "camera")
+      return camera(item);
+    if (what.kind == Node::SCALAR && what.text == "light")
+      return light(item);
+    unique_ptr<Shape> s;
+    if (!shape(item, what, s))
+      return false;
+    scene.world.append(s.release());
+    return true;
+  }
+
+  bool camera(const Node &item) {
+    const Node *item_kind, *width, *height, *fov, *from, *to, *up;
+    if (!fields(item, {{"add", &item_kind},
+                       {"width", &width},
+                       {"height", &height},
+                       {"field-of-view", &fov},
+                       {"from", &from},
+                       {"to", &to},
+                       {"up", &up}}) ||
+        !require(item, width, "width") || !require(item, height, "height") ||
+        !require(item, fov, "field-of-view") || !require(item, from, "from") ||
+        !require(item, to, "to") || !require(item, up, "up"))
+      return false;
+    if (scene.camera)
+      return fail(item, "the scene already has a camera");
+    unsigned w, h;
+    double field_of_view;
+    Tuple from_point, to_point, up_vector;
+    if (!size(*width, w) || !size(*height, h) ||
+        !number(*fov, field_of_view) || !point(*from, from_point) ||
+        !point(*to, to_point) || !vector(*up, up_vector))
+      return false;
+    scene.camera.reset(new Camera(w, h, field_of_view));
+    scene.camera->transform(view_transform(from_point, to_point, up_vector));
+    return true;
+  }
+
+  bool light(const Node &item) {
+    const Node *item_kind, *at, *intensity;
+    if (!fields(item, {{"add", &item_kind},
+                       {"at", &at},
+                       {"intensity", &intensity}}) ||
+        !require(item, at, "at") || !require(item, intensity, "intensity"))
+      return false;
+    Tuple position;
+    Color color;
+    if (!point(*at, position) || !this->color(*intensity, color))
+      return false;
+    scene.world.lights().push_back(LightPoint(position, color));
+    return true;
+  }
+
+  // The shape described by item, whose kind is a shape type or the name of a
+  // shape definition, to add an instance of it.
+  bool shape(const Node &item, const Node &kind_node, unique_ptr<Shape> &s) {
+    const string_view kind = kind_node.text;
+    const bool builtin = kind == "sphere" || kind == "plane" ||
+                         kind == "triangle" || kind == "obj";
+    const Definition *prototype = nullptr;
+    if (kind_node.kind == Node::SCALAR && !builtin) {
+      auto it = definitions.find(kind);
+      if (it != definitions.end() && it->second.kind == Definition::SHAPE)
+        prototype = &it->second;
+    }
+    if (kind_node.kind != Node::SCALAR || (!builtin && !prototype))
+      return fail(kind_node, "unknown item " + quoted(kind));
+
+    const Node *item_kind, *material_node, *transform_node;
+    const Node *p1, *p2, *p3, *file;
+    if (!fields(item, {{"add", &item_kind},
+                       {"material", &material_node},
+                       {"transform", &transform_node},
+                       {"p1", &p1},
+                       {"p2", &p2},
+                       {"p3", &p3},
+                       {"file", &file}}))
+      return false;
+    const bool triangle = kind == "triangle";
+    const bool obj = kind == "obj";
+    if (triangle && (!require(item, p1, "p1") || !require(item, p2, "p2") ||
+                     !require(item, p3, "p3")))
+      return false;
+    if (obj && !require(item, file, "file"))
+      return false;
+    for (const Node *n : {p1, p2, p3})
+      if (n && !triangle)
+        return fail(*n, "unknown key " + quoted(n->key));
+    if (file && !obj)
+      return fail(*file, "unknown key " + quoted(file->key));
+
+    Matrix M = Matrix::identity();
+    if (transform_node && !transform(*transform_node, M))
+      return false;
+    Material m;
+    if (material_node && !object_material(*material_node, m))
+      return false;
+
+    if (prototype)
+      s.reset(new Instance(prototype->shape));
+    else if (triangle) {
+      Tuple a, b, c;
+      if (!point(*p1, a) || !point(*p2, b) || !point(*p3, c))
+        return false;
+      s.reset(new Triangle(a, b, c));
+    } else if (obj) {
+      if (file->kind != Node::SCALAR || file->text.empty())
+        return fail(*file, "expecting a file name");
+      std::filesystem::path path(file->text);
+      if (path.is_relative() && !directory.empty())
+        path = std::filesystem::path(directory) / path;
+      OBJMesh mesh;
+      string obj_error;
+      if (!read_obj(path.string(), mesh, 1, &obj_error))
+        return fail(*file, obj_error);
+      s.reset(new TriangleMesh(std::move(mesh.vertices),
+                               std::move(mesh.indices),
+                               std::move(mesh.normals)));
+    } else if (kind == "sphere")
+      s.reset(new Sphere());
+    else
+      s.reset(new Plane());
+
+    if (transform_node)
+      s->transform(M);
+    if (material_node)
+      s->material(m);
+    return true;
+  }
+
+  Scene &scene;
+  const string &directory;
+  const Nodes *nodes;
+  std::unordered_map<string_view, Definition> definitions;
+  std::vector<Matrix> factors;
+};
+
+bool parse(const char *begin, const char *end, Scene &scene,
+           const string &directory, string *error) {
+  Parser parser(begin, end);
+  Builder builder(scene, directory);
+  Nodes nodes;
+  while (parser.next_item(nodes))
+    if (!builder.item(nodes)) {
+      if (error)
+        *error = "line " + std::to_string(builder.error_line) + ": " +
+                 builder.error;
+      return false;
+    }
+  if (parser.error) {
+    if (error)
+      *error = "line " + std::to_string(parser.error_line) + ": " +
+               parser.error;
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+bool parse_scene(const char *begin, const char *end, Scene &scene,
+                 string *error) {
+  return parse(begin, end, scene, string(), error);
+}
+
+bool read_scene(const string &filename, Scene &scene, string *error) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    if (error)
+      *error = "can not read " + filename;
+    return false;
+  }
+  const string directory =
+      std::filesystem::path(filename).parent_path().string();
+  if (!parse(file.begin(), file.end(), scene, directory, error)) {
+    if (error)
+      *error = filename + ": " + *error;
+    return false;
+  }
+  return true;
+}
+
+} // namespace ratrac
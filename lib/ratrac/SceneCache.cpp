@@ -0,0 +1,508 @@
+#include "ratrac/SceneCache.h"
+#include "ratrac/BVH.h"
+#include "ratrac/Color.h"
+#include "ratrac/Instance.h"
+#include "ratrac/Light.h"
+#include "ratrac/MappedFile.h"
+#include "ratrac/Material.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Patterns.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/Tuple.h"
+#include "ratrac/World.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ratrac {
+
+namespace {
+// The cache starts with MAGIC, SCENE_CACHE_VERSION, the sizes of the data and
+// color types and BYTE_ORDER_MARK, which must all match this build's.
+const char MAGIC[8] = {'R', 'A', 'T', 'R', 'A', 'C', 'S', 'C'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+enum class ShapeType : uint32_t {
+  PLANE = 1,
+  SPHERE,
+  TRIANGLE,
+  TRIANGLE_MESH,
+  INSTANCE
+};
+
+enum class PatternType : uint32_t {
+  NONE = 0,
+  STRIPES,
+  GRADIENT,
+  RING,
+  COLOR_CHECKERS,
+  RADIAL_GRADIENT,
+  PATTERN_CHECKERS,
+  PATTERN_BLENDER
+};
+
+// Patterns and instances nest: this bounds the recursion on corrupted caches.
+const unsigned MAX_PATTERN_DEPTH = 32;
+const unsigned MAX_INSTANCE_DEPTH = 32;
+
+bool fail(std::string *error, const std::string &message) {
+  if (error)
+    *error = message;
+  return false;
+}
+
+/** Check that nodes and indices make a BVH which can be traversed safely: the
+ * children and primitives of each node are in bounds, the children come
+ * after their parent, the split axes are axes, and the tree is not deeper
+ * than what BVH builds. */
+bool valid_bvh(const std::vector<BVH::Node> &nodes,
+               const std::vector<unsigned> &indices) {
+  for (unsigned index : indices)
+    if (index >= indices.size())
+      return false;
+  if (nodes.empty())
+    return indices.empty();
+
+  std::vector<unsigned> depths(nodes.size(), 0);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const BVH::Node &node = nodes[i];
+    if (depths[i] + 2 > BVH::MAX_DEPTH)
+      return false;
+    if (node.is_leaf()) {
+      if (node.offset > indices.size() ||
+          node.count > indices.size() - node.offset)
+        return false;
+      continue;
+    }
+    if (node.offset <= i + 1 || node.offset >= nodes.size() || node.axis > 2)
+      return false;
+    depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+    depths[node.offset] = std::max(depths[node.offset], depths[i] + 1);
+  }
+  return true;
+}
+
+// Writing.
+// ========
+class Writer {
+public:
+  explicit Writer(std::ostream &os) : m_os(os), m_prototypes() {}
+
+  template <class Ty> void put(const Ty &value) {
+    static_assert(std::is_trivially_copyable<Ty>::value,
+                  "Only trivially copyable types can be saved as is");
+    m_os.write(reinterpret_cast<const char *>(&value), sizeof(Ty));
+  }
+
+  template <class Ty> void put(const std::vector<Ty> &values) {
+    static_assert(std::is_trivially_copyable<Ty>::value,
+                  "Only trivially copyable types can be saved as is");
+    put(uint64_t(values.size()));
+    m_os.write(reinterpret_cast<const char *>(values.data()),
+               values.size() * sizeof(Ty));
+  }
+
+  void put_transform(const Transformable &object) {
+    put(object.transform());
+    put(object.inverse_transform());
+  }
+
+  void put_bvh(const BVH &bvh) {
+    put(bvh.nodes());
+    put(bvh.indices());
+  }
+
+  bool put_pattern(const Pattern *pattern) {
+    if (!pattern) {
+      put(PatternType::NONE);
+      return true;
+    }
+
+    const std::type_info &type = typeid(*pattern);
+    PatternType tag;
+    if (type == typeid(Stripes))
+      tag = PatternType::STRIPES;
+    else if (type == typeid(Gradient))
+      tag = PatternType::GRADIENT;
+    else if (type == typeid(Ring))
+      tag = PatternType::RING;
+    else if (type == typeid(ColorCheckers))
+      tag = PatternType::COLOR_CHECKERS;
+    else if (type == typeid(RadialGradient))
+      tag = PatternType::RADIAL_GRADIENT;
+    else if (type == typeid(PatternCheckers))
+      tag = PatternType::PATTERN_CHECKERS;
+    else if (type == typeid(PatternBlender))
+      tag = PatternType::PATTERN_BLENDER;
+    else
+      return false;
+
+    put(tag);
+    put_transform(*pattern);
+    if (tag == PatternType::PATTERN_CHECKERS ||
+        tag == PatternType::PATTERN_BLENDER) {
+      const BiPattern *P = static_cast<const BiPattern *>(pattern);
+      return put_pattern(P->pattern1()) && put_pattern(P->pattern2());
+    }
+    const BiColorPattern *P = static_cast<const BiColorPattern *>(pattern);
+    put(P->color1());
+    put(P->color2());
+    return true;
+  }
+
+  bool put_material(const Material &material) {
+    put(material.color());
+    put(material.ambient());
+    put(material.diffuse());
+    put(material.specular());
+    put(material.shininess());
+    return put_pattern(material.pattern());
+  }
+
+  bool put_shape(const Shape &shape) {
+    const std::type_info &type = typeid(shape);
+    ShapeType tag;
+    if (type == typeid(Plane))
+      tag = ShapeType::PLANE;
+    else if (type == typeid(Sphere))
+      tag = ShapeType::SPHERE;
+    else if (type == typeid(Triangle))
+      tag = ShapeType::TRIANGLE;
+    else if (type == typeid(TriangleMesh))
+      tag = ShapeType::TRIANGLE_MESH;
+    else if (type == typeid(Instance))
+      tag = ShapeType::INSTANCE;
+    else
+      return false;
+
+    put(tag);
+    put_transform(shape);
+    if (!put_material(shape.material()))
+      return false;
+    switch (tag) {
+    case ShapeType::PLANE:
+    case ShapeType::SPHERE:
+      break;
+    case ShapeType::TRIANGLE: {
+      const Triangle &T = static_cast<const Triangle &>(shape);
+      for (const Tuple *p : {&T.p1(), &T.p2(), &T.p3(), &T.n1(), &T.n2(),
+                             &T.n3()})
+        put(*p);
+      put(uint32_t(T.smooth()));
+    } break;
+    case ShapeType::TRIANGLE_MESH: {
+      const TriangleMesh &M = static_cast<const TriangleMesh &>(shape);
+      put(M.vertices());
+      put(M.indices());
+      put(M.normals());
+      put_bvh(M.bvh());
+    } break;
+    case ShapeType::INSTANCE: {
+      // The prototypes are numbered in the order they are saved. A prototype
+      // is saved in full with the first of its instances, which numbers it
+      // with the number of prototypes saved so far: the next ones only refer
+      // to its number.
+      const Instance &I = static_cast<const Instance &>(shape);
+      put(uint32_t(I.has_own_material()));
+      const Shape *prototype = &I.prototype();
+      auto it = m_prototypes.find(prototype);
+      if (it != m_prototypes.end()) {
+        put(it->second);
+        break;
+      }
+      put(uint32_t(m_prototypes.size()));
+      if (!put_shape(*prototype))
+        return false;
+      const uint32_t id = m_prototypes.size();
+      m_prototypes.emplace(prototype, id);
+    } break;
+    }
+    return true;
+  }
+
+private:
+  std::ostream &m_os;
+  std::unordered_map<const Shape *, uint32_t> m_prototypes;
+};
+
+// Reading.
+// ========
+class Reader {
+public:
+  Reader(const char *begin, const char *end)
+      : m_p(begin), m_end(end), m_prototypes() {}
+
+  bool at_end() const { return m_p == m_end; }
+
+  template <class Ty> bool get(Ty &value) {
+    static_assert(std::is_trivially_copyable<Ty>::value,
+                  "Only trivially copyable types can be loaded as is");
+    if (size_t(m_end - m_p) < sizeof(Ty))
+      return false;
+    std::memcpy(&value, m_p, sizeof(Ty));
+    m_p += sizeof(Ty);
+    return true;
+  }
+
+  template <class Ty> bool get(std::vector<Ty> &values) {
+    static_assert(std::is_trivially_copyable<Ty>::value,
+                  "Only trivially copyable types can be loaded as is");
+    uint64_t count;
+    if (!get(count) || count > size_t(m_end - m_p) / sizeof(Ty))
+      return false;
+    values.resize(count);
+    std::memcpy(static_cast<void *>(values.data()), m_p, count * sizeof(Ty));
+    m_p += count * sizeof(Ty);
+    return true;
+  }
+
+  bool get_matrices(Matrix &M, Matrix &inverse) {
+    return get(M) && get(inverse) && M.rows() == 4 && M.columns() == 4 &&
+           inverse.rows() == 4 && inverse.columns() == 4;
+  }
+
+  bool get_bvh(BVH &bvh) {
+    std::vector<BVH::Node> nodes;
+    std::vector<unsigned> indices;
+    if (!get(nodes) || !get(indices) || !valid_bvh(nodes, indices))
+      return false;
+    bvh = BVH(std::move(nodes), std::move(indices));
+    return true;
+  }
+
+  bool get_pattern(std::unique_ptr<Pattern> &pattern, unsigned depth) {
+    PatternType tag;
+    if (!get(tag))
+      return false;
+    if (tag == PatternType::NONE) {
+      pattern.reset();
+      return true;
+    }
+
+    Matrix M = Matrix::identity(), inverse = Matrix::identity();
+    if (!get_matrices(M, inverse))
+      return false;
+    switch (tag) {
+    case PatternType::PATTERN_CHECKERS:
+    case PatternType::PATTERN_BLENDER: {
+      std::unique_ptr<Pattern> a, b;
+      if (depth >= MAX_PATTERN_DEPTH || !get_pattern(a, depth + 1) || !a ||
+          !get_pattern(b, depth + 1) || !b)
+        return false;
+      if (tag == PatternType::PATTERN_CHECKERS)
+        pattern.reset(new PatternCheckers(a.release(), b.release()));
+      else
+        pattern.reset(new PatternBlender(a.release(), b.release()));
+    } break;
+    default: {
+      Color a, b;
+      if (!get(a) || !get(b))
+        return false;
+      switch (tag) {
+      case PatternType::STRIPES:
+        pattern.reset(new Stripes(a, b));
+        break;
+      case PatternType::GRADIENT:
+        pattern.reset(new Gradient(a, b));
+        break;
+      case PatternType::RING:
+        pattern.reset(new Ring(a, b));
+        break;
+      case PatternType::COLOR_CHECKERS:
+        pattern.reset(new ColorCheckers(a, b));
+        break;
+      case PatternType::RADIAL_GRADIENT:
+        pattern.reset(new RadialGradient(a, b));
+        break;
+      default:
+        return false;
+      }
+    } break;
+    }
+    pattern->transform(M, inverse);
+    return true;
+  }
+
+  bool get_material(Material &material) {
+    Color color;
+    RayTracerColorType ambient, diffuse, specular, shininess;
+    std::unique_ptr<Pattern> pattern;
+    if (!get(color) || !get(ambient) || !get(diffuse) || !get(specular) ||
+        !get(shininess) || !get_pattern(pattern, 0))
+      return false;
+    material.color(color)
+        .ambient(ambient)
+        .diffuse(diffuse)
+        .specular(specular)
+        .shininess(shininess);
+    if (pattern)
+      material.pattern(pattern);
+    return true;
+  }
+
+  bool get_shape(std::unique_ptr<Shape> &shape, unsigned depth = 0) {
+    ShapeType tag;
+    Matrix M = Matrix::identity(), inverse = Matrix::identity();
+    Material material;
+    bool shared_material = false;
+    if (!get(tag) || !get_matrices(M, inverse) || !get_material(material))
+      return false;
+
+    switch (tag) {
+    case ShapeType::PLANE:
+      shape.reset(new Plane());
+      break;
+    case ShapeType::SPHERE:
+      shape.reset(new Sphere());
+      break;
+    case ShapeType::TRIANGLE: {
+      Tuple p[6];
+      uint32_t smooth;
+      for (Tuple &t : p)
+        if (!get(t))
+          return false;
+      if (!get(smooth))
+        return false;
+      if (smooth)
+        shape.reset(new Triangle(p[0], p[1], p[2], p[3], p[4], p[5]));
+      else
+        shape.reset(new Triangle(p[0], p[1], p[2]));
+    } break;
+    case ShapeType::TRIANGLE_MESH: {
+      std::vector<Tuple> vertices, normals;
+      std::vector<unsigned> indices;
+      BVH bvh;
+      if (!get(vertices) || !get(indices) || !get(normals) || !get_bvh(bvh))
+        return false;
+      if (indices.size() % 3 != 0 || bvh.size() != indices.size() / 3 ||
+          (!normals.empty() && normals.size() != vertices.size()))
+        return false;
+      for (unsigned index : indices)
+        if (index >= vertices.size())
+          return false;
+      shape.reset(new TriangleMesh(std::move(vertices), std::move(indices),
+                                   std::move(normals), std::move(bvh)));
+    } break;
+    case ShapeType::INSTANCE: {
+      uint32_t own_material, id;
+      if (!get(own_material) || !get(id) || id > m_prototypes.size())
+        return false;
+      // The material saved with the instances without one of their own is
+      // their prototype's, which they share again.
+      shared_material = !own_material;
+      if (id == m_prototypes.size()) {
+        std::unique_ptr<Shape> prototype;
+        if (depth >= MAX_INSTANCE_DEPTH || !get_shape(prototype, depth + 1))
+          return false;
+        // When the prototype is an instance, its own prototype got its
+        // number first.
+        id = m_prototypes.size();
+        m_prototypes.push_back(std::move(prototype));
+      }
+      shape.reset(new Instance(m_prototypes[id]));
+    } break;
+    default:
+      return false;
+    }
+    if (!shared_material)
+      shape->material() = std::move(material);
+    shape->transform(M, inverse);
+    return true;
+  }
+
+private:
+  const char *m_p;
+  const char *m_end;
+  std::vector<std::shared_ptr<const Shape>> m_prototypes;
+};
+} // namespace
+
+bool save_scene(const World &world, const std::string &filename,
+                std::string *error) {
+  std::ofstream os(filename, std::ios::binary);
+  if (!os)
+    return fail(error, "can not write " + filename);
+
+  Writer out(os);
+  out.put(MAGIC);
+  out.put(SCENE_CACHE_VERSION);
+  out.put(uint32_t(sizeof(RayTracerDataType)));
+  out.put(uint32_t(sizeof(RayTracerColorType)));
+  out.put(BYTE_ORDER_MARK);
+
+  out.put(world.lights());
+  out.put(uint64_t(world.objects().size()));
+  for (const auto &o : world.objects())
+    if (!out.put_shape(*o)) {
+      os.close();
+      std::remove(filename.c_str());
+      return fail(error, filename + ": can not save " + std::string(*o));
+    }
+
+  const BVH *bvh = world.bvh();
+  out.put(uint32_t(bvh != nullptr));
+  if (bvh)
+    out.put_bvh(*bvh);
+
+  os.close();
+  if (!os)
+    return fail(error, "can not write " + filename);
+  return true;
+}
+
+bool load_scene(World &world, const std::string &filename,
+                std::string *error) {
+  MappedFile file;
+  if (!file.open(filename))
+    return fail(error, "can not read " + filename);
+
+  Reader in(file.begin(), file.end());
+  char magic[sizeof(MAGIC)];
+  uint32_t version, data_size, color_size, byte_order_mark;
+  if (!in.get(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      !in.get(version))
+    return fail(error, filename + ": not a scene cache");
+  if (version != SCENE_CACHE_VERSION)
+    return fail(error, filename + ": unsupported scene cache version " +
+                           std::to_string(version));
+  if (!in.get(data_size) || !in.get(color_size) || !in.get(byte_order_mark) ||
+      data_size != sizeof(RayTracerDataType) ||
+      color_size != sizeof(RayTracerColorType) ||
+      byte_order_mark != BYTE_ORDER_MARK)
+    return fail(error, filename + ": scene cache saved with a different "
+                                  "precision or byte order");
+
+  const std::string corrupted = filename + ": corrupted scene cache";
+  World w;
+  uint64_t num_objects;
+  if (!in.get(w.lights()) || !in.get(num_objects))
+    return fail(error, corrupted);
+  for (uint64_t i = 0; i < num_objects; i++) {
+    std::unique_ptr<Shape> shape;
+    if (!in.get_shape(shape))
+      return fail(error, corrupted);
+    w.append(shape.release());
+  }
+
+  uint32_t has_bvh;
+  BVH bvh;
+  if (!in.get(has_bvh) || (has_bvh && !in.get_bvh(bvh)) || !in.at_end())
+    return fail(error, corrupted);
+  if (has_bvh && !w.accelerate(std::move(bvh)))
+    return fail(error, corrupted);
+
+  world = std::move(w);
+  return true;
+}
+
+} // namespace ratrac
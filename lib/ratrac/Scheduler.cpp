@@ -0,0 +1,108 @@
+#include "ratrac/Scheduler.h"
+#include "ratrac/StopWatch.h"
+
+#include <cassert>
+#include <iomanip>
+#include <thread>
+
+namespace ratrac {
+
+TaskScheduler::TaskScheduler(unsigned workers) : m_workers(), m_pending(0) {
+  assert(workers > 0 && "A scheduler needs at least one worker");
+  for (unsigned i = 0; i < workers; i++)
+    m_workers.emplace_back(new Worker());
+}
+
+void TaskScheduler::push(unsigned worker, Task task) {
+  assert(worker < m_workers.size() && "Out of bounds worker");
+  m_pending++;
+  std::lock_guard<std::mutex> guard(m_workers[worker]->lock);
+  m_workers[worker]->tasks.push_back(std::move(task));
+}
+
+bool TaskScheduler::pop(unsigned worker, Task &task) {
+  Worker &w = *m_workers[worker];
+  std::lock_guard<std::mutex> guard(w.lock);
+  if (w.tasks.empty())
+    return false;
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  return true;
+}
+
+bool TaskScheduler::steal(unsigned thief, Task &task) {
+  // Visit the victims in a round-robin fashion, starting with our neighbour,
+  // so that thieves do not all compete for the same deque.
+  for (unsigned i = 1; i < m_workers.size(); i++) {
+    Worker &victim = *m_workers[(thief + i) % m_workers.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::work(unsigned worker) {
+  WorkerStats &stats = m_workers[worker]->stats;
+  Task task;
+  while (m_pending > 0) {
+    if (!pop(worker, task)) {
+      if (!steal(worker, task)) {
+        // Some tasks are still running, and may push more work.
+        std::this_thread::yield();
+        continue;
+      }
+      stats.steals++;
+    }
+
+    StopWatch sw;
+    sw.start();
+    task(worker);
+    sw.stop();
+    stats.busy += sw.elapsed();
+    stats.tasks++;
+    m_pending--;
+  }
+}
+
+void TaskScheduler::run() {
+  for (auto &w : m_workers)
+    w->stats = WorkerStats();
+
+  std::vector<std::thread> threads;
+  threads.reserve(m_workers.size() - 1);
+  for (unsigned i = 1; i < m_workers.size(); i++)
+    threads.emplace_back(&TaskScheduler::work, this, i);
+  work(0);
+  for (auto &t : threads)
+    t.join();
+}
+
+const TaskScheduler::WorkerStats &TaskScheduler::stats(unsigned worker) const {
+  assert(worker < m_workers.size() && "Out of bounds worker");
+  return m_workers[worker]->stats;
+}
+
+size_t TaskScheduler::total_steals() const {
+  size_t steals = 0;
+  for (const auto &w : m_workers)
+    steals += w->stats.steals;
+  return steals;
+}
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::TaskScheduler &S) {
+  std::ios_base::fmtflags f(os.flags());
+  os << std::fixed << std::setprecision(3);
+  for (unsigned i = 0; i < S.workers(); i++) {
+    const ratrac::TaskScheduler::WorkerStats &stats = S.stats(i);
+    os << "worker " << i << ": " << stats.tasks << " tasks, " << stats.steals
+       << " steals, busy " << stats.busy << "s\n";
+  }
+  os.flags(f); // Restore flags.
+  return os;
+}
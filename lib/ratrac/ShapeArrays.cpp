@@ -0,0 +1,268 @@
+#include "ratrac/ShapeArrays.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/SIMD.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <typeinfo>
+
+namespace ratrac {
+
+ShapeArrays::ShapeArrays(const std::vector<const Shape *> &shapes,
+                         std::vector<unsigned> *primitives)
+    : m_shapes(), m_bounds(), m_inverse_transforms(), m_spheres(),
+      m_planes_end(0), m_spheres_end(0) {
+  // The exact types are checked: classes derived from Sphere or Plane may
+  // override their intersection methods.
+  enum Kind { PLANE, SPHERE, OTHER };
+  std::vector<Kind> kinds;
+  kinds.reserve(shapes.size());
+  std::vector<const Shape *> spheres, others;
+  m_shapes.reserve(shapes.size());
+  for (const Shape *s : shapes) {
+    if (typeid(*s) == typeid(Plane)) {
+      kinds.push_back(PLANE);
+      m_shapes.push_back(s);
+    } else if (typeid(*s) == typeid(Sphere)) {
+      kinds.push_back(SPHERE);
+      spheres.push_back(s);
+    } else {
+      kinds.push_back(OTHER);
+      others.push_back(s);
+    }
+  }
+  m_planes_end = m_shapes.size();
+  m_shapes.insert(m_shapes.end(), spheres.begin(), spheres.end());
+  m_spheres_end = m_shapes.size();
+  m_shapes.insert(m_shapes.end(), others.begin(), others.end());
+
+  if (primitives) {
+    unsigned next[3] = {0, m_planes_end, m_spheres_end};
+    primitives->clear();
+    primitives->reserve(shapes.size());
+    for (Kind kind : kinds)
+      primitives->push_back(next[kind]++);
+  }
+
+  m_bounds.resize(m_shapes.size());
+  m_inverse_transforms.resize(m_spheres_end, Matrix::identity());
+  m_spheres.resize(m_spheres_end - m_planes_end);
+  for (unsigned i = 0; i < m_shapes.size(); i++)
+    update(i);
+}
+
+void ShapeArrays::update(unsigned prim) {
+  assert(prim < size() && "Out of bounds primitive");
+  m_bounds[prim] = m_shapes[prim]->world_bounds();
+  if (prim < m_spheres_end)
+    m_inverse_transforms[prim] = m_shapes[prim]->inverse_transform();
+  if (prim >= m_planes_end && prim < m_spheres_end) {
+    const Sphere *sphere = static_cast<const Sphere *>(m_shapes[prim]);
+    if (sphere->world_space())
+      m_spheres[prim - m_planes_end] = {sphere->world_center(),
+                                        sphere->world_radius(), true};
+    else
+      m_spheres[prim - m_planes_end] = {sphere->center(), sphere->radius(),
+                                        false};
+  }
+}
+
+// The per type queries do the same computations as Sphere's and Plane's, with
+// their methods inlined.
+// =====================================================================
+inline void ShapeArrays::sphere_closest_hit(unsigned prim, const Ray &r,
+                                            Intersection &hit) const {
+  const SphereGeometry &s = sphere(prim);
+  const Ray local_ray =
+      s.world_space ? r : transform(r, m_inverse_transforms[prim]);
+  DataType t1, t2;
+  if (!simd::scalar::intersect_sphere(local_ray.origin().data(),
+                                      local_ray.direction().data(),
+                                      s.center.data(), s.radius, t1, t2))
+    return;
+  // t1 <= t2.
+  DataType t = t1 >= 0.0 ? t1 : t2;
+  if (t < 0.0 || t >= hit.t)
+    return;
+  hit = Intersection(t, m_shapes[prim]);
+}
+
+inline void ShapeArrays::sphere_closest_hit(unsigned prim,
+                                            const RayPacket &rays,
+                                            unsigned mask,
+                                            PacketHits &hits) const {
+  const SphereGeometry &s = sphere(prim);
+  DataType t1[RayPacket::SIZE], t2[RayPacket::SIZE];
+  if (s.world_space)
+    kernels().intersect_sphere_packet(rays, s.center, s.radius, t1, t2);
+  else
+    kernels().intersect_sphere_packet(
+        transform(rays, m_inverse_transforms[prim]), s.center, s.radius, t1,
+        t2);
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    if (!(mask & (1U << i)))
+      continue;
+    // Lanes missing the sphere have t1 = t2 = -1, and are skipped below.
+    DataType t = t1[i] >= 0.0 ? t1[i] : t2[i];
+    if (t < 0.0 || t >= hits.t[i])
+      continue;
+    hits.t[i] = t;
+    hits.object[i] = m_shapes[prim];
+  }
+}
+
+inline bool ShapeArrays::sphere_occludes(unsigned prim, const Ray &r,
+                                         DataType max_t) const {
+  const SphereGeometry &s = sphere(prim);
+  const Ray local_ray =
+      s.world_space ? r : transform(r, m_inverse_transforms[prim]);
+  DataType t1, t2;
+  if (!simd::scalar::intersect_sphere(local_ray.origin().data(),
+                                      local_ray.direction().data(),
+                                      s.center.data(), s.radius, t1, t2))
+    return false;
+  return (t1 >= 0.0 && t1 < max_t) || (t2 >= 0.0 && t2 < max_t);
+}
+
+inline void ShapeArrays::plane_closest_hit(unsigned prim, const Ray &r,
+                                           Intersection &hit) const {
+  const Ray local_ray = transform(r, m_inverse_transforms[prim]);
+  if (std::fabs(local_ray.direction().y()) < EPSILON<DataType>())
+    return;
+
+  DataType t = -local_ray.origin().y() / local_ray.direction().y();
+  if (t < 0.0 || t >= hit.t)
+    return;
+  hit = Intersection(t, m_shapes[prim]);
+}
+
+inline void ShapeArrays::plane_closest_hit(unsigned prim,
+                                           const RayPacket &rays,
+                                           unsigned mask,
+                                           PacketHits &hits) const {
+  const RayPacket local_rays = transform(rays, m_inverse_transforms[prim]);
+  const DataType *oy = local_rays.origin[1];
+  const DataType *dy = local_rays.direction[1];
+  DataType t[RayPacket::SIZE];
+  bool parallel[RayPacket::SIZE];
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    parallel[i] = std::fabs(dy[i]) < EPSILON<DataType>();
+    t[i] = -oy[i] / dy[i];
+  }
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    if (!(mask & (1U << i)) || parallel[i])
+      continue;
+    if (t[i] < 0.0 || t[i] >= hits.t[i])
+      continue;
+    hits.t[i] = t[i];
+    hits.object[i] = m_shapes[prim];
+  }
+}
+
+inline bool ShapeArrays::plane_occludes(unsigned prim, const Ray &r,
+                                        DataType max_t) const {
+  const Ray local_ray = transform(r, m_inverse_transforms[prim]);
+  if (std::fabs(local_ray.direction().y()) < EPSILON<DataType>())
+    return false;
+
+  DataType t = -local_ray.origin().y() / local_ray.direction().y();
+  return t >= 0.0 && t < max_t;
+}
+
+// Single primitive queries.
+// =========================
+void ShapeArrays::closest_hit(unsigned prim, const Ray &r,
+                              Intersection &hit) const {
+  if (prim < m_planes_end)
+    plane_closest_hit(prim, r, hit);
+  else if (prim < m_spheres_end)
+    sphere_closest_hit(prim, r, hit);
+  else
+    m_shapes[prim]->closest_hit(r, hit);
+}
+
+void ShapeArrays::closest_hit(unsigned prim, const RayPacket &rays,
+                              unsigned mask, PacketHits &hits) const {
+  if (prim < m_planes_end)
+    plane_closest_hit(prim, rays, mask, hits);
+  else if (prim < m_spheres_end)
+    sphere_closest_hit(prim, rays, mask, hits);
+  else
+    m_shapes[prim]->closest_hit(rays, mask, hits);
+}
+
+bool ShapeArrays::occludes(unsigned prim, const Ray &r, DataType max_t) const {
+  if (prim < m_planes_end)
+    return plane_occludes(prim, r, max_t);
+  if (prim < m_spheres_end)
+    return sphere_occludes(prim, r, max_t);
+  return m_shapes[prim]->occludes(r, max_t);
+}
+
+// All primitives queries, one loop per type.
+// ==========================================
+void ShapeArrays::intersect(const Ray &r, Intersections &xs) const {
+  // Intersect also returns the hits behind the ray origin, so the boxes are
+  // tested along the ray's whole line. It builds lists of intersections
+  // anyway, so the shapes are simply asked for them.
+  const SlabRay sr(r);
+  const DataType inf = std::numeric_limits<DataType>::infinity();
+  for (unsigned i = 0; i < size(); i++)
+    if (m_bounds[i].intersects(sr, -inf, inf))
+      xs.add(m_shapes[i]->intersect(r));
+}
+
+// The planes come first: they are cheap to test, and most often the closest
+// or an occluding hit. Their boxes are infinite in at least 2 directions, and
+// not worth testing.
+void ShapeArrays::closest_hit(const Ray &r, Intersection &hit) const {
+  for (unsigned i = 0; i < m_planes_end; i++)
+    plane_closest_hit(i, r, hit);
+  if (m_planes_end == size())
+    return;
+
+  const SlabRay sr(r);
+  for (unsigned i = m_planes_end; i < m_spheres_end; i++)
+    if (m_bounds[i].intersects(sr, 0, hit.t))
+      sphere_closest_hit(i, r, hit);
+  for (unsigned i = m_spheres_end; i < size(); i++)
+    if (m_bounds[i].intersects(sr, 0, hit.t))
+      m_shapes[i]->closest_hit(r, hit);
+}
+
+void ShapeArrays::closest_hit(const RayPacket &rays, unsigned mask,
+                              PacketHits &hits) const {
+  for (unsigned i = 0; i < m_planes_end; i++)
+    plane_closest_hit(i, rays, mask, hits);
+  if (m_planes_end == size())
+    return;
+
+  const SlabPacket sp(rays);
+  for (unsigned i = m_planes_end; i < m_spheres_end; i++)
+    if (unsigned lanes = m_bounds[i].intersects(sp, 0, hits.t, mask))
+      sphere_closest_hit(i, rays, lanes, hits);
+  for (unsigned i = m_spheres_end; i < size(); i++)
+    if (unsigned lanes = m_bounds[i].intersects(sp, 0, hits.t, mask))
+      m_shapes[i]->closest_hit(rays, lanes, hits);
+}
+
+bool ShapeArrays::occluded(const Ray &r, DataType max_t) const {
+  for (unsigned i = 0; i < m_planes_end; i++)
+    if (plane_occludes(i, r, max_t))
+      return true;
+  if (m_planes_end == size())
+    return false;
+
+  const SlabRay sr(r);
+  for (unsigned i = m_planes_end; i < m_spheres_end; i++)
+    if (m_bounds[i].intersects(sr, 0, max_t) && sphere_occludes(i, r, max_t))
+      return true;
+  for (unsigned i = m_spheres_end; i < size(); i++)
+    if (m_bounds[i].intersects(sr, 0, max_t) &&
+        m_shapes[i]->occludes(r, max_t))
+      return true;
+  return false;
+}
+
+} // namespace ratrac
@@ -1,5 +1,7 @@
 #include "ratrac/Shapes.h"
 #include "ratrac/Intersections.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/SIMD.h"
 #include "ratrac/ratrac.h"
 
 //#include <iomanip>
@@ -8,20 +10,140 @@
 namespace ratrac {
 Shape::~Shape() {}
 
-Intersections Sphere::local_intersect(const Ray &r) const {
-  Tuple sphere_to_ray = r.origin() - center();
-  Tuple::DataType a = dot(r.direction(), r.direction());
-  Tuple::DataType b = 2.0 * dot(r.direction(), sphere_to_ray);
-  Tuple::DataType c = dot(sphere_to_ray, sphere_to_ray) - 1.0;
-  Tuple::DataType discriminant = b * b - 4.0 * a * c;
-  if (discriminant < 0.0)
-    return Intersections();
+bool Shape::local_occludes(const Ray &r, RayTracerDataType max_t) const {
+  for (const Intersection &x : local_intersect(r))
+    if (x.t >= 0.0 && x.t < max_t)
+      return true;
+  return false;
+}
+
+bool Shape::local_closest_hit(const Ray &r, Intersection &hit) const {
+  bool found = false;
+  for (const Intersection &x : local_intersect(r))
+    if (x.t >= 0.0 && x.t < hit.t) {
+      hit = x;
+      found = true;
+    }
+  return found;
+}
+
+void Shape::local_closest_hit(const RayPacket &rays, unsigned mask,
+                              PacketHits &hits) const {
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    if (!(mask & (1U << i)))
+      continue;
+    Intersection hit = hits.hit(i);
+    if (local_closest_hit(rays.ray(i), hit))
+      hits.set(i, hit);
+  }
+}
+
+void Sphere::update() {
+  Shape::update();
+  RayTracerDataType scale;
+  m_world_space = transform().is_uniform_scaling_translation(scale);
+  if (m_world_space) {
+    m_world_center = transform(m_center);
+    m_world_radius = std::fabs(scale) * m_radius;
+  } else {
+    m_world_center = m_center;
+    m_world_radius = m_radius;
+  }
+}
 
-  Tuple::DataType t1 = (-b - sqrt(discriminant)) / (2.0 * a);
-  Tuple::DataType t2 = (-b + sqrt(discriminant)) / (2.0 * a);
+Intersections Sphere::intersect_at(const Ray &r, const Tuple &center,
+                                   RayTracerDataType radius) const {
+  Tuple::DataType t1, t2;
+  if (!simd::scalar::intersect_sphere(r.origin().data(), r.direction().data(),
+                                      center.data(), radius, t1, t2))
+    return Intersections();
   return Intersections(Intersection(t1, this), Intersection(t2, this));
 }
 
+bool Sphere::occludes_at(const Ray &r, const Tuple &center,
+                         RayTracerDataType radius,
+                         RayTracerDataType max_t) const {
+  Tuple::DataType t1, t2;
+  if (!simd::scalar::intersect_sphere(r.origin().data(), r.direction().data(),
+                                      center.data(), radius, t1, t2))
+    return false;
+  return (t1 >= 0.0 && t1 < max_t) || (t2 >= 0.0 && t2 < max_t);
+}
+
+bool Sphere::closest_hit_at(const Ray &r, const Tuple &center,
+                            RayTracerDataType radius, Intersection &hit) const {
+  Tuple::DataType t1, t2;
+  if (!simd::scalar::intersect_sphere(r.origin().data(), r.direction().data(),
+                                      center.data(), radius, t1, t2))
+    return false;
+  // t1 <= t2.
+  Tuple::DataType t = t1 >= 0.0 ? t1 : t2;
+  if (t < 0.0 || t >= hit.t)
+    return false;
+  hit = Intersection(t, this);
+  return true;
+}
+
+void Sphere::closest_hit_at(const RayPacket &rays, const Tuple &center,
+                            RayTracerDataType radius, unsigned mask,
+                            PacketHits &hits) const {
+  Tuple::DataType t1[RayPacket::SIZE], t2[RayPacket::SIZE];
+  kernels().intersect_sphere_packet(rays, center, radius, t1, t2);
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    if (!(mask & (1U << i)))
+      continue;
+    // Lanes missing the sphere have t1 = t2 = -1, and are skipped below.
+    Tuple::DataType t = t1[i] >= 0.0 ? t1[i] : t2[i];
+    if (t < 0.0 || t >= hits.t[i])
+      continue;
+    hits.t[i] = t;
+    hits.object[i] = this;
+  }
+}
+
+Intersections Sphere::intersect(const Ray &world_ray) const {
+  if (!m_world_space)
+    return Shape::intersect(world_ray);
+  return intersect_at(world_ray, m_world_center, m_world_radius);
+}
+
+bool Sphere::occludes(const Ray &world_ray, RayTracerDataType max_t) const {
+  if (!m_world_space)
+    return Shape::occludes(world_ray, max_t);
+  return occludes_at(world_ray, m_world_center, m_world_radius, max_t);
+}
+
+bool Sphere::closest_hit(const Ray &world_ray, Intersection &hit) const {
+  if (!m_world_space)
+    return Shape::closest_hit(world_ray, hit);
+  return closest_hit_at(world_ray, m_world_center, m_world_radius, hit);
+}
+
+void Sphere::closest_hit(const RayPacket &world_rays, unsigned mask,
+                         PacketHits &hits) const {
+  if (!m_world_space)
+    Shape::closest_hit(world_rays, mask, hits);
+  else
+    closest_hit_at(world_rays, m_world_center, m_world_radius, mask, hits);
+}
+
+Intersections Sphere::local_intersect(const Ray &r) const {
+  return intersect_at(r, m_center, m_radius);
+}
+
+bool Sphere::local_occludes(const Ray &r, RayTracerDataType max_t) const {
+  return occludes_at(r, m_center, m_radius, max_t);
+}
+
+bool Sphere::local_closest_hit(const Ray &r, Intersection &hit) const {
+  return closest_hit_at(r, m_center, m_radius, hit);
+}
+
+void Sphere::local_closest_hit(const RayPacket &rays, unsigned mask,
+                               PacketHits &hits) const {
+  closest_hit_at(rays, m_center, m_radius, mask, hits);
+}
+
 Sphere::operator std::string() const {
   std::ostringstream os;
   os << "Sphere {";
@@ -42,6 +164,45 @@ Intersections Plane::local_intersect(const Ray &r) const {
   return Intersections(Intersection(t, this));
 }
 
+bool Plane::local_occludes(const Ray &r, RayTracerDataType max_t) const {
+  if (std::fabs(r.direction().y()) < EPSILON<Tuple::DataType>())
+    return false;
+
+  Tuple::DataType t = -r.origin().y() / r.direction().y();
+  return t >= 0.0 && t < max_t;
+}
+
+bool Plane::local_closest_hit(const Ray &r, Intersection &hit) const {
+  if (std::fabs(r.direction().y()) < EPSILON<Tuple::DataType>())
+    return false;
+
+  Tuple::DataType t = -r.origin().y() / r.direction().y();
+  if (t < 0.0 || t >= hit.t)
+    return false;
+  hit = Intersection(t, this);
+  return true;
+}
+
+void Plane::local_closest_hit(const RayPacket &rays, unsigned mask,
+                              PacketHits &hits) const {
+  const Tuple::DataType *oy = rays.origin[1];
+  const Tuple::DataType *dy = rays.direction[1];
+  Tuple::DataType t[RayPacket::SIZE];
+  bool parallel[RayPacket::SIZE];
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    parallel[i] = std::fabs(dy[i]) < EPSILON<Tuple::DataType>();
+    t[i] = -oy[i] / dy[i];
+  }
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    if (!(mask & (1U << i)) || parallel[i])
+      continue;
+    if (t[i] < 0.0 || t[i] >= hits.t[i])
+      continue;
+    hits.t[i] = t[i];
+    hits.object[i] = this;
+  }
+}
+
 Plane::operator std::string() const {
   std::ostringstream os;
   os << "Plane {";
@@ -0,0 +1,254 @@
+#include "ratrac/Triangles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+namespace ratrac {
+
+// Triangle.
+// =========
+Triangle::Triangle(const Tuple &p1, const Tuple &p2, const Tuple &p3)
+    : Shape(), m_p{p1, p2, p3}, m_e1(p2 - p1), m_e2(p3 - p1),
+      m_normal(normalize(cross(m_e2, m_e1))), m_n{m_normal, m_normal, m_normal},
+      m_smooth(false) {
+  update();
+}
+
+Triangle::Triangle(const Tuple &p1, const Tuple &p2, const Tuple &p3,
+                   const Tuple &n1, const Tuple &n2, const Tuple &n3)
+    : Shape(), m_p{p1, p2, p3}, m_e1(p2 - p1), m_e2(p3 - p1),
+      m_normal(normalize(cross(m_e2, m_e1))), m_n{n1, n2, n3}, m_smooth(true) {
+  update();
+}
+
+Intersections Triangle::local_intersect(const Ray &r) const {
+  Tuple::DataType t, u, v;
+  if (!intersect_triangle(r, p1(), m_e1, m_e2, t, u, v))
+    return Intersections();
+  return Intersections(Intersection(t, this, 0, u, v));
+}
+
+bool Triangle::local_occludes(const Ray &r, RayTracerDataType max_t) const {
+  Tuple::DataType t, u, v;
+  if (!intersect_triangle(r, p1(), m_e1, m_e2, t, u, v))
+    return false;
+  return t >= 0.0 && t < max_t;
+}
+
+bool Triangle::local_closest_hit(const Ray &r, Intersection &hit) const {
+  Tuple::DataType t, u, v;
+  if (!intersect_triangle(r, p1(), m_e1, m_e2, t, u, v))
+    return false;
+  if (t < 0.0 || t >= hit.t)
+    return false;
+  hit = Intersection(t, this, 0, u, v);
+  return true;
+}
+
+Tuple Triangle::local_normal_at(const Tuple &local_point,
+                                const Intersection &hit) const {
+  if (!m_smooth)
+    return m_normal;
+  return n2() * hit.u + n3() * hit.v + n1() * (1 - hit.u - hit.v);
+}
+
+BoundingBox Triangle::bounds() const {
+  BoundingBox box;
+  return box.add(p1()).add(p2()).add(p3());
+}
+
+Triangle::operator std::string() const {
+  std::ostringstream os;
+  os << "Triangle {";
+  os << " p1: " << p1();
+  os << ", p2: " << p2();
+  os << ", p3: " << p3();
+  if (m_smooth) {
+    os << ", n1: " << n1();
+    os << ", n2: " << n2();
+    os << ", n3: " << n3();
+  }
+  os << ", transform: " << transform();
+  os << ", material: " << material();
+  os << "}";
+  return os.str();
+}
+
+// TriangleMesh.
+// =============
+namespace {
+std::vector<BoundingBox> getFaceBounds(const std::vector<Tuple> &vertices,
+                                       const std::vector<unsigned> &indices) {
+  std::vector<BoundingBox> boxes;
+  boxes.reserve(indices.size() / 3);
+  for (unsigned i = 0; i + 2 < indices.size(); i += 3) {
+    BoundingBox box;
+    boxes.push_back(box.add(vertices[indices[i]])
+                        .add(vertices[indices[i + 1]])
+                        .add(vertices[indices[i + 2]]));
+  }
+  return boxes;
+}
+} // namespace
+
+TriangleMesh::TriangleMesh(std::vector<Tuple> vertices,
+                           std::vector<unsigned> indices,
+                           std::vector<Tuple> normals, unsigned threads)
+    : Shape(), m_vertices(std::move(vertices)), m_indices(std::move(indices)),
+      m_normals(std::move(normals)),
+      m_bvh(getFaceBounds(m_vertices, m_indices), threads) {
+  assert(m_indices.size() % 3 == 0 && "Faces must have 3 vertices");
+  assert((m_normals.empty() || m_normals.size() == m_vertices.size()) &&
+         "Expecting no normals, or one per vertex");
+  update();
+}
+
+TriangleMesh::TriangleMesh(std::vector<Tuple> vertices,
+                           std::vector<unsigned> indices,
+                           std::vector<Tuple> normals, BVH bvh)
+    : Shape(), m_vertices(std::move(vertices)), m_indices(std::move(indices)),
+      m_normals(std::move(normals)), m_bvh(std::move(bvh)) {
+  assert(m_indices.size() % 3 == 0 && "Faces must have 3 vertices");
+  assert((m_normals.empty() || m_normals.size() == m_vertices.size()) &&
+         "Expecting no normals, or one per vertex");
+  assert(m_bvh.size() == num_faces() && "The BVH must be over the faces");
+  update();
+}
+
+Tuple TriangleMesh::face_normal(unsigned face) const {
+  const Tuple &p1 = vertex(face, 0);
+  return normalize(cross(vertex(face, 2) - p1, vertex(face, 1) - p1));
+}
+
+Intersections TriangleMesh::local_intersect(const Ray &r) const {
+  // Intersect also returns the hits behind the ray origin.
+  Intersections xs;
+  m_bvh.traverse(r, -std::numeric_limits<RayTracerDataType>::infinity(),
+                 std::numeric_limits<RayTracerDataType>::infinity(),
+                 [&](unsigned face) {
+                   Tuple::DataType t, u, v;
+                   if (intersect_face(face, r, t, u, v))
+                     xs.add(Intersection(t, this, face, u, v));
+                   return false;
+                 });
+  return xs;
+}
+
+bool TriangleMesh::local_occludes(const Ray &r,
+                                  RayTracerDataType max_t) const {
+  bool occluded = false;
+  m_bvh.traverse(r, 0, max_t, [&](unsigned face) {
+    Tuple::DataType t, u, v;
+    occluded = intersect_face(face, r, t, u, v) && t >= 0.0 && t < max_t;
+    return occluded;
+  });
+  return occluded;
+}
+
+bool TriangleMesh::local_closest_hit(const Ray &r, Intersection &hit) const {
+  bool found = false;
+  m_bvh.traverse(r, 0, hit.t, [&](unsigned face) {
+    Tuple::DataType t, u, v;
+    if (intersect_face(face, r, t, u, v) && t >= 0.0 && t < hit.t) {
+      hit = Intersection(t, this, face, u, v);
+      found = true;
+    }
+    return false;
+  });
+  return found;
+}
+
+void TriangleMesh::local_closest_hit(const RayPacket &rays, unsigned mask,
+                                     PacketHits &hits) const {
+  typedef RayPacket::DataType DataType;
+  m_bvh.traverse(rays, 0, hits.t, mask, [&](unsigned face, unsigned lanes) {
+    // Same operations as intersect_triangle, for all the lanes at once.
+    const Tuple &p1 = vertex(face, 0);
+    const Tuple e1 = vertex(face, 1) - p1;
+    const Tuple e2 = vertex(face, 2) - p1;
+    DataType t[RayPacket::SIZE], u[RayPacket::SIZE], v[RayPacket::SIZE];
+    bool hit[RayPacket::SIZE];
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      const DataType d0 = rays.direction[0][i], d1 = rays.direction[1][i],
+                     d2 = rays.direction[2][i];
+      const DataType c0 = d1 * e2[2] - d2 * e2[1];
+      const DataType c1 = d2 * e2[0] - d0 * e2[2];
+      const DataType c2 = d0 * e2[1] - d1 * e2[0];
+      const DataType det = e1[0] * c0 + e1[1] * c1 + e1[2] * c2;
+      const DataType f = DataType(1) / det;
+      const DataType s0 = rays.origin[0][i] - p1[0],
+                     s1 = rays.origin[1][i] - p1[1],
+                     s2 = rays.origin[2][i] - p1[2];
+      u[i] = f * (s0 * c0 + s1 * c1 + s2 * c2);
+      const DataType q0 = s1 * e1[2] - s2 * e1[1];
+      const DataType q1 = s2 * e1[0] - s0 * e1[2];
+      const DataType q2 = s0 * e1[1] - s1 * e1[0];
+      v[i] = f * (d0 * q0 + d1 * q1 + d2 * q2);
+      t[i] = f * (e2[0] * q0 + e2[1] * q1 + e2[2] * q2);
+      hit[i] = det != 0 && u[i] >= 0 && u[i] <= 1 && v[i] >= 0 &&
+               u[i] + v[i] <= 1;
+    }
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      if (!(lanes & (1U << i)) || !hit[i])
+        continue;
+      if (t[i] < 0.0 || t[i] >= hits.t[i])
+        continue;
+      hits.set(i, Intersection(t[i], this, face, u[i], v[i]));
+    }
+  });
+}
+
+Tuple TriangleMesh::local_normal_at(const Tuple &local_point) const {
+  // Find the face local_point is the closest to, and its barycentric
+  // coordinates on it.
+  Intersection closest;
+  Tuple::DataType best = std::numeric_limits<Tuple::DataType>::infinity();
+  for (unsigned face = 0; face < num_faces(); face++) {
+    const Tuple &p1 = vertex(face, 0);
+    const Tuple e1 = vertex(face, 1) - p1;
+    const Tuple e2 = vertex(face, 2) - p1;
+    const Tuple w = local_point - p1;
+    const Tuple::DataType d11 = dot(e1, e1), d12 = dot(e1, e2),
+                          d22 = dot(e2, e2), dw1 = dot(w, e1),
+                          dw2 = dot(w, e2);
+    const Tuple::DataType denom = d11 * d22 - d12 * d12;
+    if (denom == 0)
+      continue;
+    Tuple::DataType u = (d22 * dw1 - d12 * dw2) / denom;
+    Tuple::DataType v = (d11 * dw2 - d12 * dw1) / denom;
+    u = std::min(std::max(u, Tuple::DataType()), Tuple::DataType(1));
+    v = std::min(std::max(v, Tuple::DataType()), Tuple::DataType(1) - u);
+    const Tuple::DataType distance = magnitude(w - e1 * u - e2 * v);
+    if (distance < best) {
+      best = distance;
+      closest = Intersection(0, this, face, u, v);
+    }
+  }
+  return local_normal_at(local_point, closest);
+}
+
+Tuple TriangleMesh::local_normal_at(const Tuple &local_point,
+                                    const Intersection &hit) const {
+  if (!smooth())
+    return face_normal(hit.face);
+  const unsigned *face = &m_indices[3 * hit.face];
+  return m_normals[face[1]] * hit.u + m_normals[face[2]] * hit.v +
+         m_normals[face[0]] * (1 - hit.u - hit.v);
+}
+
+TriangleMesh::operator std::string() const {
+  std::ostringstream os;
+  os << "TriangleMesh {";
+  os << " vertices: " << num_vertices();
+  os << ", faces: " << num_faces();
+  os << ", smooth: " << (smooth() ? "true" : "false");
+  os << ", transform: " << transform();
+  os << ", material: " << material();
+  os << "}";
+  return os.str();
+}
+
+} // namespace ratrac
@@ -0,0 +1,229 @@
+#include "ratrac/Wavefront.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/Light.h"
+#include "ratrac/Material.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ratrac {
+
+void RayQueue::reserve(size_t n) {
+  for (unsigned c = 0; c < 4; c++) {
+    m_origin[c].reserve(n);
+    m_direction[c].reserve(n);
+  }
+  m_tmax.reserve(n);
+  m_id.reserve(n);
+}
+
+void RayQueue::resize(size_t n) {
+  for (unsigned c = 0; c < 4; c++) {
+    m_origin[c].resize(n);
+    m_direction[c].resize(n);
+  }
+  m_tmax.resize(n);
+  m_id.resize(n);
+}
+
+RayPacket RayQueue::packet(size_t i, unsigned count) const {
+  assert(count >= 1 && count <= RayPacket::SIZE && i + count <= size() &&
+         "Out of bound access to RayQueue");
+  RayPacket rays;
+  for (unsigned c = 0; c < 4; c++)
+    for (unsigned l = 0; l < RayPacket::SIZE; l++) {
+      const size_t j = l < count ? i + l : i;
+      rays.origin[c][l] = m_origin[c][j];
+      rays.direction[c][l] = m_direction[c][j];
+    }
+  return rays;
+}
+
+namespace {
+/** Spread the 10 low bits of v, 2 zero bits apart. */
+uint32_t spread_bits(uint32_t v) {
+  v &= 0x3FF;
+  v = (v | (v << 16)) & 0x030000FF;
+  v = (v | (v << 8)) & 0x0300F00F;
+  v = (v | (v << 4)) & 0x030C30C3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+} // namespace
+
+void Wavefront::generate(unsigned x0, unsigned y0, unsigned x1,
+                         unsigned y1) {
+  const unsigned pw = m_camera.packet_width();
+  const unsigned ph = m_camera.packet_height();
+  const unsigned hsize = m_camera.hsize();
+  const size_t n = size_t(x1 - x0) * (y1 - y0);
+  m_x.resize(n);
+  m_y.resize(n);
+  m_primary.resize(n);
+
+  // The pixels, packet by packet, clipped to the block, so that the rays
+  // intersected together are those of the camera's packets.
+  unsigned *id = m_primary.id();
+  size_t r = 0;
+  for (unsigned y = y0; y < y1; y += ph)
+    for (unsigned x = x0; x < x1; x += pw) {
+      const unsigned w = std::min(pw, x1 - x);
+      const unsigned h = std::min(ph, y1 - y);
+      for (unsigned dy = 0; dy < h; dy++)
+        for (unsigned dx = 0; dx < w; dx++) {
+          m_x[r] = DataType(x + dx);
+          m_y[r] = DataType(y + dy);
+          id[r++] = (y + dy) * hsize + x + dx;
+        }
+    }
+
+  DataType *const direction[4] = {
+      m_primary.direction(0), m_primary.direction(1), m_primary.direction(2),
+      m_primary.direction(3)};
+  m_camera.directions_for_pixels(m_x.data(), m_y.data(), n, direction);
+  for (unsigned c = 0; c < 4; c++)
+    std::fill(m_primary.origin(c), m_primary.origin(c) + n,
+              m_camera.origin()[c]);
+  std::fill(m_primary.tmax(), m_primary.tmax() + n,
+            std::numeric_limits<DataType>::infinity());
+}
+
+void Wavefront::intersect() {
+  const size_t n = m_primary.size();
+  m_hits.resize(n);
+  if (m_camera.packet_width() * m_camera.packet_height() == 1) {
+    for (size_t r = 0; r < n; r++)
+      m_hits[r] = m_world.closest_hit(m_primary.ray(r));
+    return;
+  }
+
+  for (size_t r = 0; r < n; r += RayPacket::SIZE) {
+    const unsigned count = std::min<size_t>(RayPacket::SIZE, n - r);
+    const PacketHits hits = m_world.closest_hit(m_primary.packet(r, count),
+                                                RayPacket::mask(count));
+    for (unsigned l = 0; l < count; l++)
+      m_hits[r + l] = hits.hit(l);
+  }
+}
+
+void Wavefront::shade() {
+  m_surfaces.clear();
+  m_pixels.clear();
+  for (size_t r = 0; r < m_hits.size(); r++)
+    if (m_hits[r].object) {
+      m_surfaces.emplace_back(m_hits[r], m_primary.ray(r));
+      m_pixels.push_back(m_primary.id()[r]);
+    }
+
+  // The shadow rays of is_shadowed, with the Tuple operations spelled out in
+  // the same order, light by light.
+  const size_t n = m_surfaces.size();
+  const unsigned lights = m_world.lights().size();
+  m_shadow.resize(n * lights);
+  for (unsigned i = 0; i < lights; i++) {
+    const Tuple &light = m_world.light(i)->position();
+    DataType *origin[4], *direction[4];
+    for (unsigned c = 0; c < 4; c++) {
+      origin[c] = m_shadow.origin(c) + i * n;
+      direction[c] = m_shadow.direction(c) + i * n;
+    }
+    DataType *tmax = m_shadow.tmax() + i * n;
+    unsigned *id = m_shadow.id() + i * n;
+    for (size_t s = 0; s < n; s++) {
+      const Tuple &point = m_surfaces[s].over_point;
+      DataType v[4];
+      for (unsigned c = 0; c < 4; c++)
+        v[c] = light[c] - point[c];
+      DataType distance = DataType();
+      for (unsigned c = 0; c < 4; c++)
+        distance += v[c] * v[c];
+      distance = std::sqrt(distance);
+      for (unsigned c = 0; c < 4; c++) {
+        origin[c][s] = point[c];
+        direction[c][s] = v[c] / distance;
+      }
+      tmax[s] = distance;
+      id[s] = s;
+    }
+  }
+}
+
+void Wavefront::shadow_test() {
+  const size_t n = m_surfaces.size();
+  const size_t count = m_shadow.size();
+  m_order.resize(count);
+  m_shadowed.resize(count);
+  if (count == 0)
+    return;
+
+  // The cells are those of a 1024^3 grid over the surfaces, which are the
+  // origins of each light's shadow rays.
+  DataType min[3], scale[3];
+  for (unsigned a = 0; a < 3; a++) {
+    const DataType *origin = m_shadow.origin(a);
+    DataType max = origin[0];
+    min[a] = origin[0];
+    for (size_t s = 1; s < n; s++) {
+      min[a] = std::min(min[a], origin[s]);
+      max = std::max(max, origin[s]);
+    }
+    scale[a] = max > min[a] ? DataType(1023) / (max - min[a]) : DataType();
+  }
+
+  // Sort each light's shadow rays by direction octant, then by the Morton
+  // code of their origin's cell, and trace them in that order. They are
+  // traced one by one: packets of 8 consecutive rays through the BVH's packet
+  // traversal were 10 to 15% slower on the particles benchmark. The rays of
+  // a sparse scene still part ways below the top levels, and each node test
+  // then costs all 8 lanes for the few which still need it.
+  for (size_t k = 0; k < count; k++) {
+    uint32_t octant = 0, morton = 0;
+    for (unsigned a = 0; a < 3; a++) {
+      octant |= uint32_t(m_shadow.direction(a)[k] < 0) << a;
+      const DataType c = (m_shadow.origin(a)[k] - min[a]) * scale[a];
+      const uint32_t cell =
+          c > 0 ? uint32_t(std::min(c, DataType(1023))) : 0;
+      morton |= spread_bits(cell) << a;
+    }
+    m_order[k] = {octant << 30 | morton, unsigned(k)};
+  }
+  for (size_t first = 0; first < count; first += n) {
+    std::sort(m_order.begin() + first, m_order.begin() + first + n);
+    for (size_t k = first; k < first + n; k++) {
+      const unsigned ray = m_order[k].second;
+      m_shadowed[ray] =
+          m_world.occluded(m_shadow.ray(ray), m_shadow.tmax()[ray]);
+    }
+  }
+}
+
+void Wavefront::accumulate(Canvas &image) {
+  const unsigned hsize = m_camera.hsize();
+  for (size_t r = 0; r < m_hits.size(); r++)
+    if (!m_hits[r].object) {
+      const unsigned pixel = m_primary.id()[r];
+      image.at(pixel % hsize, pixel / hsize) = Color::BLACK();
+    }
+
+  // Sum the lights' contributions light by light, in shade_hit's order, with
+  // the accumulation kernel.
+  const size_t n = m_surfaces.size();
+  const unsigned lights = m_world.lights().size();
+  m_colors.assign(n, Color());
+  m_contributions.resize(n);
+  for (unsigned i = 0; i < lights; i++) {
+    const LightPoint &light = *m_world.light(i);
+    for (size_t s = 0; s < n; s++) {
+      const Computations &comps = m_surfaces[s];
+      m_contributions[s] =
+          lighting(comps.object->material(), light, comps.over_point,
+                   comps.eyev, comps.normalv, m_shadowed[i * n + s]);
+    }
+    kernels().accumulate_colors(m_colors.data(), m_contributions.data(), n);
+  }
+  for (size_t s = 0; s < n; s++)
+    image.at(m_pixels[s] % hsize, m_pixels[s] / hsize) = m_colors[s];
+}
+
+} // namespace ratrac
@@ -0,0 +1,192 @@
+#include "ratrac/WideBVH.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace ratrac {
+
+WideBVH::WideBVH(const BVH &bvh)
+    : m_nodes(), m_indices(bvh.indices()), m_parents(), m_leaves() {
+  if (bvh.nodes().empty())
+    return;
+
+  // Each node but the root replaces at least 1 binary interior node.
+  m_nodes.reserve(bvh.nodes().size() / 2 + 1);
+  collapse(bvh, 0);
+}
+
+/** Add the node collapsing the binary subtree rooted at node, and its
+ * descendants. Returns its index. */
+unsigned WideBVH::collapse(const BVH &bvh, unsigned node) {
+  const std::vector<BVH::Node> &nodes = bvh.nodes();
+  unsigned children[WIDTH] = {node};
+  unsigned count = 1;
+  if (!nodes[node].is_leaf()) {
+    children[0] = node + 1;
+    children[1] = nodes[node].offset;
+    count = 2;
+  }
+  while (count < WIDTH) {
+    unsigned largest = WIDTH;
+    DataType largest_area = -1;
+    for (unsigned i = 0; i < count; i++) {
+      const BVH::Node &child = nodes[children[i]];
+      if (child.is_leaf())
+        continue;
+      const DataType area = child.box().surface_area();
+      if (area > largest_area) {
+        largest = i;
+        largest_area = area;
+      }
+    }
+    if (largest == WIDTH)
+      break;
+    const unsigned opened = children[largest];
+    children[largest] = opened + 1;
+    children[count++] = nodes[opened].offset;
+  }
+
+  const unsigned index = m_nodes.size();
+  Node wide;
+  for (unsigned i = 0; i < WIDTH; i++) {
+    for (unsigned a = 0; a < 3; a++) {
+      wide.min[a][i] = std::numeric_limits<float>::infinity();
+      wide.max[a][i] = -std::numeric_limits<float>::infinity();
+    }
+    wide.child[i] = NO_CHILD;
+    wide.count[i] = 0;
+  }
+  for (unsigned i = 0; i < count; i++) {
+    const BVH::Node &child = nodes[children[i]];
+    for (unsigned a = 0; a < 3; a++) {
+      wide.min[a][i] = child.min[a];
+      wide.max[a][i] = child.max[a];
+    }
+    if (child.is_leaf()) {
+      wide.child[i] = child.offset;
+      wide.count[i] = child.count;
+    }
+  }
+  m_nodes.push_back(wide);
+
+  // The interior children are added depth first, after their parent.
+  for (unsigned i = 0; i < count; i++)
+    if (!nodes[children[i]].is_leaf()) {
+      const unsigned child = collapse(bvh, children[i]);
+      m_nodes[index].child[i] = child;
+    }
+  return index;
+}
+
+BoundingBox WideBVH::bounds() const {
+  BoundingBox box;
+  if (m_nodes.empty())
+    return box;
+
+  const Node &root = m_nodes[0];
+  for (unsigned i = 0; i < WIDTH; i++)
+    if (root.child[i] != NO_CHILD)
+      box.add(BoundingBox(
+          Point(root.min[0][i], root.min[1][i], root.min[2][i]),
+          Point(root.max[0][i], root.max[1][i], root.max[2][i])));
+  return box;
+}
+
+/** Set the box of slot in node from the boxes of its primitives for a leaf,
+ * or from the boxes of its child's slots. Returns whether the box changed. */
+bool WideBVH::fit(unsigned node, unsigned slot,
+                  const std::vector<BoundingBox> &boxes) {
+  Node &n = m_nodes[node];
+  float min[3], max[3];
+  if (n.count[slot]) {
+    BoundingBox box;
+    for (unsigned i = n.child[slot]; i < n.child[slot] + n.count[slot]; i++)
+      box.add(boxes[m_indices[i]]);
+    // Rounded outwards to single precision, as the binary leaves are.
+    const BVH::Node leaf(box, 0, n.count[slot]);
+    for (unsigned a = 0; a < 3; a++) {
+      min[a] = leaf.min[a];
+      max[a] = leaf.max[a];
+    }
+  } else {
+    // The unused slots' empty boxes leave the union unchanged.
+    const Node &child = m_nodes[n.child[slot]];
+    for (unsigned a = 0; a < 3; a++) {
+      min[a] = *std::min_element(child.min[a], child.min[a] + WIDTH);
+      max[a] = *std::max_element(child.max[a], child.max[a] + WIDTH);
+    }
+  }
+
+  bool changed = false;
+  for (unsigned a = 0; a < 3; a++) {
+    changed |= n.min[a][slot] != min[a] || n.max[a][slot] != max[a];
+    n.min[a][slot] = min[a];
+    n.max[a][slot] = max[a];
+  }
+  return changed;
+}
+
+void WideBVH::refit(const std::vector<BoundingBox> &boxes,
+                    const std::vector<unsigned> &moved) {
+  assert(boxes.size() == size() && "Refitting to a different primitive set");
+  if (m_nodes.empty())
+    return;
+
+  if (m_parents.size() != m_nodes.size()) {
+    m_parents.assign(m_nodes.size(), 0);
+    m_leaves.assign(size(), 0);
+    for (unsigned i = 0; i < m_nodes.size(); i++) {
+      const Node &node = m_nodes[i];
+      for (unsigned j = 0; j < WIDTH; j++)
+        if (node.count[j]) {
+          for (unsigned k = node.child[j]; k < node.child[j] + node.count[j];
+               k++)
+            m_leaves[m_indices[k]] = i * WIDTH + j;
+        } else if (node.child[j] != NO_CHILD)
+          m_parents[node.child[j]] = i;
+    }
+  }
+
+  // Walk up from each moved primitive's leaf slot, up to the first slot whose
+  // box does not change: the slots above it already enclose it.
+  for (unsigned prim : moved) {
+    assert(prim < size() && "Out of bounds primitive");
+    unsigned node = m_leaves[prim] / WIDTH;
+    unsigned slot = m_leaves[prim] % WIDTH;
+    while (fit(node, slot, boxes) && node != 0) {
+      const unsigned child = node;
+      node = m_parents[child];
+      slot = 0;
+      while (m_nodes[node].count[slot] || m_nodes[node].child[slot] != child)
+        slot++;
+    }
+  }
+}
+
+unsigned WideBVH::depth() const {
+  if (m_nodes.empty())
+    return 0;
+
+  unsigned max_depth = 0;
+  std::vector<std::pair<unsigned, unsigned>> stack = {{0, 1}};
+  while (!stack.empty()) {
+    auto p = stack.back();
+    stack.pop_back();
+    max_depth = std::max(max_depth, p.second);
+    const Node &node = m_nodes[p.first];
+    for (unsigned i = 0; i < WIDTH; i++)
+      if (node.child[i] != NO_CHILD && node.count[i] == 0)
+        stack.push_back({node.child[i], p.second + 1});
+  }
+  return max_depth;
+}
+
+} // namespace ratrac
+
+std::ostream &operator<<(std::ostream &os, const ratrac::WideBVH &bvh) {
+  os << "WideBVH { primitives: " << bvh.size()
+     << ", nodes: " << bvh.nodes().size() << ", depth: " << bvh.depth()
+     << ", bounds: " << bvh.bounds() << "}";
+  return os;
+}
@@ -7,6 +7,8 @@
 #include "ratrac/Shapes.h"
 #include "ratrac/Tuple.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 
 using std::ostream;
@@ -38,15 +40,273 @@ std::ostream &operator<<(ostream &os, const ratrac::World &world) {
 }
 
 namespace ratrac {
-Intersections World::intersect(const Ray &r) const {
-  Intersections xs;
+// The acceleration structure only refers to the objects, which are not moved
+// themselves: it moves along with them.
+World::World(World &&other)
+    : m_lights(std::move(other.m_lights)),
+      m_objects(std::move(other.m_objects)),
+      m_accelerator(other.m_accelerator), m_accel(std::move(other.m_accel)),
+      m_accel_ready(other.m_accel_ready.load()),
+      m_accel_lock(new std::mutex()) {
+  other.invalidate();
+}
+
+World &World::operator=(World &&rhs) {
+  m_lights = std::move(rhs.m_lights);
+  m_objects = std::move(rhs.m_objects);
+  m_accelerator = rhs.m_accelerator;
+  m_accel = std::move(rhs.m_accel);
+  m_accel_ready.store(rhs.m_accel_ready.load());
+  rhs.invalidate();
+  return *this;
+}
+
+const World::Acceleration *World::acceleration() const {
+  const Acceleration *accel = m_accel_ready.load(std::memory_order_acquire);
+  if (accel && accel->num_objects == m_objects.size())
+    return accel;
+
+  std::lock_guard<std::mutex> guard(*m_accel_lock);
+  accel = m_accel_ready.load(std::memory_order_acquire);
+  if (accel && accel->num_objects == m_objects.size())
+    return accel;
+
+  m_accel = build_acceleration(nullptr);
+  m_accel_ready.store(m_accel.get(), std::memory_order_release);
+  return m_accel.get();
+}
+
+/** Build the acceleration structure, with bvh as its BVH if it is not null,
+ * or with threads workers otherwise. Returns nullptr if bvh does not match
+ * the objects, or is not used. */
+std::unique_ptr<World::Acceleration>
+World::build_acceleration(BVH *bvh, unsigned threads) const {
+  std::unique_ptr<Acceleration> A(new Acceleration());
+  A->num_objects = m_objects.size();
+  const bool accelerated = m_objects.size() >= BVH_THRESHOLD;
+  A->has_bvh = accelerated && m_accelerator != Accelerator::GRID;
+  A->has_wide_bvh = accelerated && m_accelerator == Accelerator::WIDE_BVH;
+  A->has_grid = accelerated && m_accelerator == Accelerator::GRID;
+  std::vector<const Shape *> all, bounded, unbounded;
+  for (const auto &o : m_objects) {
+    all.push_back(o.get());
+    if (o->world_bounds().is_finite())
+      bounded.push_back(o.get());
+    else
+      unbounded.push_back(o.get());
+  }
+  std::vector<unsigned> bounded_prims, unbounded_prims;
+  if (accelerated) {
+    A->shapes = ShapeArrays(unbounded, &unbounded_prims);
+    A->bounded = ShapeArrays(bounded, &bounded_prims);
+    if (A->has_grid) {
+      if (bvh)
+        return nullptr;
+      A->grid = Grid(A->bounded.bounds());
+    } else if (!bvh)
+      A->bvh = BVH(A->bounded.bounds(), threads);
+    else if (bvh->size() == bounded.size())
+      A->bvh = std::move(*bvh);
+    else
+      return nullptr;
+    if (A->has_wide_bvh)
+      A->wide_bvh = WideBVH(A->bvh);
+  } else if (bvh)
+    return nullptr;
+  else
+    A->shapes = ShapeArrays(all, &unbounded_prims);
 
+  A->slots.reserve(m_objects.size());
+  unsigned next_bounded = 0, next_unbounded = 0;
   for (const auto &o : m_objects)
-    xs.add(o->intersect(r));
+    if (accelerated && o->world_bounds().is_finite())
+      A->slots.push_back({bounded_prims[next_bounded++], true});
+    else
+      A->slots.push_back({unbounded_prims[next_unbounded++], false});
+  return A;
+}
+
+void World::prepare(unsigned threads) const {
+  std::lock_guard<std::mutex> guard(*m_accel_lock);
+  const Acceleration *accel = m_accel_ready.load(std::memory_order_acquire);
+  if (accel && accel->num_objects == m_objects.size())
+    return;
+
+  m_accel = build_acceleration(nullptr, threads);
+  m_accel_ready.store(m_accel.get(), std::memory_order_release);
+}
+
+bool World::accelerate(BVH bvh) {
+  std::unique_ptr<Acceleration> A = build_acceleration(&bvh);
+  if (!A)
+    return false;
+
+  std::lock_guard<std::mutex> guard(*m_accel_lock);
+  m_accel = std::move(A);
+  m_accel_ready.store(m_accel.get(), std::memory_order_release);
+  return true;
+}
+
+void World::refit(const std::vector<unsigned> &moved) {
+  // There is nothing to refit when the structure is to be rebuilt anyway.
+  Acceleration *accel = m_accel.get();
+  if (!accel || m_accel_ready.load() != accel ||
+      accel->num_objects != m_objects.size())
+    return;
+
+  std::vector<unsigned> prims;
+  for (unsigned i : moved) {
+    assert(i < m_objects.size() && "Out of bounds object");
+    const Slot &slot = accel->slots[i];
+    if ((slot.bounded && accel->has_grid) ||
+        ((accel->has_bvh || accel->has_grid) &&
+         slot.bounded != m_objects[i]->world_bounds().is_finite())) {
+      invalidate();
+      return;
+    }
+    if (slot.bounded) {
+      accel->bounded.update(slot.prim);
+      prims.push_back(slot.prim);
+    } else
+      accel->shapes.update(slot.prim);
+  }
+  if (!prims.empty()) {
+    accel->bvh.refit(accel->bounded.bounds(), prims);
+    if (accel->has_wide_bvh)
+      accel->wide_bvh.refit(accel->bounded.bounds(), prims);
+  }
+}
+
+const BVH *World::bvh() const {
+  const Acceleration *accel = acceleration();
+  return accel->has_bvh ? &accel->bvh : nullptr;
+}
+
+const WideBVH *World::wide_bvh() const {
+  const Acceleration *accel = acceleration();
+  return accel->has_wide_bvh ? &accel->wide_bvh : nullptr;
+}
+
+const Grid *World::grid() const {
+  const Acceleration *accel = acceleration();
+  return accel->has_grid ? &accel->grid : nullptr;
+}
+
+Intersections World::intersect(const Ray &r) const {
+  Intersections xs;
 
+  const Acceleration *accel = acceleration();
+  accel->shapes.intersect(r, xs);
+  // Intersect also returns the hits behind the ray origin, so all boxes or
+  // cells along the ray's line are visited.
+  if (accel->has_wide_bvh)
+    accel->wide_bvh.traverse(
+        r, -std::numeric_limits<RayTracerDataType>::infinity(),
+        std::numeric_limits<RayTracerDataType>::infinity(),
+        [&](unsigned prim) {
+          xs.add(accel->bounded.shape(prim)->intersect(r));
+          return false;
+        });
+  else if (accel->has_bvh)
+    accel->bvh.traverse(
+        r, -std::numeric_limits<RayTracerDataType>::infinity(),
+        std::numeric_limits<RayTracerDataType>::infinity(),
+        [&](unsigned prim) {
+          xs.add(accel->bounded.shape(prim)->intersect(r));
+          return false;
+        });
+  else if (accel->has_grid) {
+    // The grid visits the objects overlapping several cells several times:
+    // they are only intersected once.
+    std::vector<unsigned> prims;
+    accel->grid.traverse(
+        r, -std::numeric_limits<RayTracerDataType>::infinity(),
+        std::numeric_limits<RayTracerDataType>::infinity(),
+        [&](unsigned prim) {
+          prims.push_back(prim);
+          return false;
+        });
+    std::sort(prims.begin(), prims.end());
+    prims.erase(std::unique(prims.begin(), prims.end()), prims.end());
+    for (unsigned prim : prims)
+      xs.add(accel->bounded.shape(prim)->intersect(r));
+  }
   return xs;
 }
 
+Intersection World::closest_hit(const Ray &r) const {
+  Intersection hit(std::numeric_limits<RayTracerDataType>::infinity(),
+                   nullptr);
+
+  const Acceleration *accel = acceleration();
+  accel->shapes.closest_hit(r, hit);
+  if (accel->has_wide_bvh)
+    accel->wide_bvh.traverse(r, 0, hit.t, [&](unsigned prim) {
+      accel->bounded.closest_hit(prim, r, hit);
+      return false;
+    });
+  else if (accel->has_bvh)
+    accel->bvh.traverse(r, 0, hit.t, [&](unsigned prim) {
+      accel->bounded.closest_hit(prim, r, hit);
+      return false;
+    });
+  else if (accel->has_grid)
+    accel->grid.traverse(r, 0, hit.t, [&](unsigned prim) {
+      accel->bounded.closest_hit(prim, r, hit);
+      return false;
+    });
+  return hit;
+}
+
+PacketHits World::closest_hit(const RayPacket &rays, unsigned mask) const {
+  PacketHits hits;
+
+  const Acceleration *accel = acceleration();
+  accel->shapes.closest_hit(rays, mask, hits);
+  if (accel->has_wide_bvh) {
+    // The wide BVH orders the children by distance, which differs per lane.
+    for (unsigned i = 0; i < RayPacket::SIZE; i++)
+      if (mask & (1U << i))
+        accel->wide_bvh.traverse(
+            rays.ray(i), 0, hits.t[i], [&](unsigned prim) {
+              accel->bounded.closest_hit(prim, rays, 1U << i, hits);
+              return false;
+            });
+  } else if (accel->has_bvh)
+    accel->bvh.traverse(rays, 0, hits.t, mask,
+                        [&](unsigned prim, unsigned lanes) {
+                          accel->bounded.closest_hit(prim, rays, lanes, hits);
+                        });
+  else if (accel->has_grid)
+    // The lanes go through different cells: they are traversed one by one.
+    for (unsigned i = 0; i < RayPacket::SIZE; i++)
+      if (mask & (1U << i))
+        accel->grid.traverse(rays.ray(i), 0, hits.t[i], [&](unsigned prim) {
+          accel->bounded.closest_hit(prim, rays, 1U << i, hits);
+          return false;
+        });
+  return hits;
+}
+
+bool World::occluded(const Ray &r, RayTracerDataType max_t) const {
+  const Acceleration *accel = acceleration();
+  if (accel->shapes.occluded(r, max_t))
+    return true;
+
+  bool occluded = false;
+  auto visit = [&](unsigned prim) {
+    occluded = accel->bounded.occludes(prim, r, max_t);
+    return occluded;
+  };
+  if (accel->has_wide_bvh)
+    accel->wide_bvh.traverse(r, 0, max_t, visit);
+  else if (accel->has_bvh)
+    accel->bvh.traverse(r, 0, max_t, visit);
+  else if (accel->has_grid)
+    accel->grid.traverse(r, 0, max_t, visit);
+  return occluded;
+}
+
 World World::get_default() {
   World w;
   w.lights().push_back(LightPoint(Point(-10, 10, -10), Color::WHITE()));
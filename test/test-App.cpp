@@ -18,7 +18,11 @@ TEST(App, defaults) {
       "message.\n  --verbose, -v: Increase program verbosity.\n  --width=W, -w "
       "W: Set canvas width to W\n  --height=H, -h H: Set canvas height to H\n  "
       "--output=F, -o F: Save output to filename F\n  --format=T, -f T: Save "
-      "output in image format T, PPM or PNG (if support built in)");
+      "output in image format T, PPM or PNG (if support built in)\n  "
+      "--threads=N, -j N: Render with N threads (0: one per hardware "
+      "thread)\n  --packet=WxH, -p WxH: Trace primary rays in packets of WxH "
+      "pixels (1x1: no packets)\n  --cache=F, -c F: Load the scene from the "
+      "binary cache F if it exists, or save it there");
 
   array<const char *, 0> args = {};
   EXPECT_TRUE(A.parse(args.size(), args.data()));
@@ -28,6 +32,10 @@ TEST(App, defaults) {
   EXPECT_EQ(A.verbosity(), 0);
   EXPECT_EQ(A.outputFormat(), App::PPM);
   EXPECT_EQ(A.outputFilename(), "myapp.ppm");
+  EXPECT_EQ(A.threads(), 1);
+  EXPECT_EQ(A.packet_width(), 4);
+  EXPECT_TRUE(A.cacheFilename().empty());
+  EXPECT_EQ(A.packet_height(), 2);
 }
 
 TEST(App, overrideDefaultCanvas) {
@@ -177,3 +185,67 @@ TEST(App, configureOutputFormat) {
     EXPECT_EQ(A.outputFormat(), App::PPM);
   }
 }
+
+TEST(App, configureThreads) {
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 2> args1 = {"-j", "4"};
+    EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+    EXPECT_EQ(A.threads(), 4);
+  }
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {"--threads=8"};
+    EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+    EXPECT_EQ(A.threads(), 8);
+  }
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {"--threads=0"};
+    EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+    EXPECT_GE(A.threads(), 1);
+  }
+  // Negative counts do not wrap around.
+  for (const char *arg : {"--threads=-1", "--threads=-4294967295",
+                          "--threads=4294967296", "--threads=two",
+                          "--threads=2x"}) {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {arg};
+    EXPECT_FALSE(A.parse(args1.size(), args1.data())) << arg;
+    EXPECT_EQ(A.threads(), 1);
+  }
+}
+
+TEST(App, configurePacket) {
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 2> args1 = {"-p", "2x2"};
+    EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+    EXPECT_EQ(A.packet_width(), 2);
+    EXPECT_EQ(A.packet_height(), 2);
+  }
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {"--packet=1x1"};
+    EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+    EXPECT_EQ(A.packet_width(), 1);
+    EXPECT_EQ(A.packet_height(), 1);
+  }
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {"--packet=3x3"};
+    EXPECT_FALSE(A.parse(args1.size(), args1.data()));
+  }
+  {
+    App A("myapp", "is wonderful.");
+    array<const char *, 1> args1 = {"--packet=4"};
+    EXPECT_FALSE(A.parse(args1.size(), args1.data()));
+  }
+}
+
+TEST(App, configureCache) {
+  App A("myapp", "is wonderful.");
+  array<const char *, 2> args1 = {"-c", "scene.cache"};
+  EXPECT_TRUE(A.parse(args1.size(), args1.data()));
+  EXPECT_EQ(A.cacheFilename(), "scene.cache");
+}
@@ -0,0 +1,298 @@
+#include <gtest/gtest.h>
+
+#include "ratrac/BVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::ostringstream;
+using std::vector;
+
+namespace {
+// Get the sorted list of primitives visited by a traversal.
+vector<unsigned> visited(const BVH &bvh, const Ray &r) {
+  vector<unsigned> prims;
+  bvh.traverse(r, 0, std::numeric_limits<RayTracerDataType>::infinity(),
+               [&](unsigned prim) {
+                 prims.push_back(prim);
+                 return false;
+               });
+  std::sort(prims.begin(), prims.end());
+  return prims;
+}
+
+// A row of unit boxes along the x axis, centered on x = 0, 2, 4, ...
+vector<BoundingBox> row_of_boxes(unsigned n) {
+  vector<BoundingBox> boxes;
+  for (unsigned i = 0; i < n; i++)
+    boxes.push_back(BoundingBox(Point(2 * i - 0.5, -0.5, -0.5),
+                                Point(2 * i + 0.5, 0.5, 0.5)));
+  return boxes;
+}
+} // namespace
+
+TEST(BVH, base) {
+  // An empty BVH.
+  BVH empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.depth(), 0);
+  EXPECT_TRUE(visited(empty, Ray(Point(0, 0, -5), Vector(0, 0, 1))).empty());
+
+  // A BVH over a single box.
+  BVH one(row_of_boxes(1));
+  EXPECT_EQ(one.size(), 1);
+  EXPECT_EQ(one.nodes().size(), 1);
+  EXPECT_EQ(one.depth(), 1);
+
+  // A BVH over many boxes.
+  BVH bvh(row_of_boxes(100));
+  EXPECT_EQ(bvh.size(), 100);
+  EXPECT_EQ(bvh.bounds().min(), Point(-0.5, -0.5, -0.5));
+  EXPECT_EQ(bvh.bounds().max(), Point(198.5, 0.5, 0.5));
+  EXPECT_LE(bvh.depth(), 16);
+  // All primitives are referenced exactly once.
+  vector<unsigned> indices = bvh.indices();
+  std::sort(indices.begin(), indices.end());
+  for (unsigned i = 0; i < indices.size(); i++)
+    EXPECT_EQ(indices[i], i);
+  // Each node box contains its children boxes.
+  for (unsigned n = 0; n < bvh.nodes().size(); n++) {
+    const BVH::Node &node = bvh.nodes()[n];
+    if (!node.is_leaf()) {
+      BoundingBox children = bvh.nodes()[n + 1].box();
+      children.add(bvh.nodes()[node.offset].box());
+      EXPECT_EQ(children, node.box());
+    } else {
+      EXPECT_LE(node.count, BVH::MAX_LEAF_SIZE);
+    }
+  }
+}
+
+TEST(BVH, traverse) {
+  BVH bvh(row_of_boxes(100));
+
+  // A ray crossing a single box.
+  EXPECT_EQ(visited(bvh, Ray(Point(20, 0, -5), Vector(0, 0, 1))),
+            vector<unsigned>({10}));
+
+  // A ray passing in between boxes.
+  EXPECT_TRUE(visited(bvh, Ray(Point(21, 0, -5), Vector(0, 0, 1))).empty());
+
+  // A ray going along the whole row.
+  EXPECT_EQ(visited(bvh, Ray(Point(-5, 0, 0), Vector(1, 0, 0))).size(), 100);
+
+  // Boxes behind the ray are not visited...
+  EXPECT_EQ(visited(bvh, Ray(Point(9, 0, 0), Vector(1, 0, 0))).size(), 95);
+  // ... unless the traversal range says so.
+  unsigned count = 0;
+  bvh.traverse(Ray(Point(9, 0, 0), Vector(1, 0, 0)),
+               -std::numeric_limits<RayTracerDataType>::infinity(),
+               std::numeric_limits<RayTracerDataType>::infinity(),
+               [&](unsigned) {
+                 count++;
+                 return false;
+               });
+  EXPECT_EQ(count, 100);
+
+  // The traversal stops when asked to.
+  count = 0;
+  bvh.traverse(Ray(Point(-5, 0, 0), Vector(1, 0, 0)), 0,
+               std::numeric_limits<RayTracerDataType>::infinity(),
+               [&](unsigned) { return ++count == 3; });
+  EXPECT_EQ(count, 3);
+}
+
+TEST(BVH, node) {
+  // Nodes store their box in single precision, rounded outwards.
+  EXPECT_EQ(sizeof(BVH::Node), 32);
+  const BoundingBox box(Point(-0.1, 1.0 / 3, -1e10), Point(0.7, 2, 1e-9));
+  const BVH::Node node(box, 12, 3);
+  EXPECT_TRUE(node.is_leaf());
+  EXPECT_EQ(node.offset, 12);
+  EXPECT_EQ(node.count, 3);
+  for (unsigned i = 0; i < 3; i++) {
+    EXPECT_LE(node.box().min()[i], box.min()[i]);
+    EXPECT_NEAR(node.box().min()[i], box.min()[i],
+                std::abs(box.min()[i]) * 1e-7);
+    EXPECT_GE(node.box().max()[i], box.max()[i]);
+    EXPECT_NEAR(node.box().max()[i], box.max()[i],
+                std::abs(box.max()[i]) * 1e-7);
+  }
+  EXPECT_EQ(BVH::Node(node.box(), 0, 0).box(), node.box());
+  EXPECT_TRUE(BVH::Node().box().empty());
+  EXPECT_FALSE(BVH::Node(BoundingBox::infinite(), 0, 1).box().is_finite());
+}
+
+TEST(BVH, traversal_order) {
+  // The nearer children are visited first: along the row, the boxes are
+  // visited in order, up to the order of the primitives in a leaf.
+  const BVH bvh(row_of_boxes(100));
+  vector<Ray> rays;
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    rays.push_back(Ray(Point(i % 2 ? 250 : -50, 0.05 * i, -0.05 * i),
+                       Vector(i % 2 ? -1 : 1, 0, 0)));
+  vector<vector<unsigned>> sequences;
+  for (const Ray &r : rays) {
+    vector<unsigned> prims;
+    bvh.traverse(r, 0, std::numeric_limits<RayTracerDataType>::infinity(),
+                 [&](unsigned prim) {
+                   prims.push_back(prim);
+                   return false;
+                 });
+    ASSERT_EQ(prims.size(), 100);
+    const bool backwards = r.direction().x() < 0;
+    for (unsigned i = 1; i < prims.size(); i++)
+      if (backwards)
+        EXPECT_LT(prims[i], prims[i - 1] + BVH::MAX_LEAF_SIZE);
+      else
+        EXPECT_GT(prims[i] + BVH::MAX_LEAF_SIZE, prims[i - 1]);
+    sequences.push_back(prims);
+  }
+
+  // Each lane of a packet sees the sequence its ray sees, whichever
+  // direction the other lanes go.
+  RayPacket packet;
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    packet.set(i, rays[i]);
+  RayTracerDataType tmax[RayPacket::SIZE];
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    tmax[i] = std::numeric_limits<RayTracerDataType>::infinity();
+  vector<vector<unsigned>> lanes(RayPacket::SIZE);
+  bvh.traverse(packet, 0, tmax, RayPacket::mask(RayPacket::SIZE),
+               [&](unsigned prim, unsigned hit) {
+                 for (unsigned i = 0; i < RayPacket::SIZE; i++)
+                   if (hit & (1U << i))
+                     lanes[i].push_back(prim);
+               });
+  EXPECT_EQ(lanes, sequences);
+}
+
+TEST(BVH, degenerate) {
+  // Many primitives with the same centroid can not be split by the SAH, but
+  // the leaves still have a bounded size.
+  vector<BoundingBox> boxes(50, BoundingBox(Point(-1, -1, -1), Point(1, 1, 1)));
+  BVH bvh(boxes);
+  EXPECT_EQ(bvh.size(), 50);
+  for (const auto &node : bvh.nodes())
+    EXPECT_LE(node.count, BVH::MAX_LEAF_SIZE);
+  EXPECT_EQ(visited(bvh, Ray(Point(0, 0, -5), Vector(0, 0, 1))).size(), 50);
+}
+
+TEST(BVH, parallel_build) {
+  // Big enough for the parallel splits of the top levels, with clusters of
+  // boxes sharing their centroid, which can not be split.
+  vector<BoundingBox> boxes;
+  for (unsigned i = 0; i < 50000; i++) {
+    const Tuple c = i % 5 == 0 ? Point(10, 10, 10)
+                               : Point((i * 37) % 101, (i * 13) % 97,
+                                       (i * 7) % 89 + 0.001 * i);
+    const RayTracerDataType h = 0.1 + 0.01 * (i % 11);
+    boxes.push_back(BoundingBox(c - Vector(h, h, h), c + Vector(h, h, h)));
+  }
+  const BVH bvh(boxes);
+  EXPECT_EQ(bvh.size(), boxes.size());
+  EXPECT_LT(bvh.depth(), BVH::MAX_DEPTH);
+  vector<unsigned> indices = bvh.indices();
+  std::sort(indices.begin(), indices.end());
+  for (unsigned i = 0; i < indices.size(); i++)
+    ASSERT_EQ(indices[i], i);
+  for (unsigned n = 0; n < bvh.nodes().size(); n++) {
+    const BVH::Node &node = bvh.nodes()[n];
+    BoundingBox box;
+    if (node.is_leaf()) {
+      EXPECT_LE(node.count, BVH::MAX_LEAF_SIZE);
+      for (unsigned i = node.offset; i < node.offset + node.count; i++)
+        box.add(boxes[bvh.indices()[i]]);
+    } else {
+      ASSERT_GT(node.offset, n + 1);
+      box.add(bvh.nodes()[n + 1].box());
+      box.add(bvh.nodes()[node.offset].box());
+    }
+    EXPECT_EQ(BVH::Node(box, 0, 0).box(), node.box());
+  }
+
+  // The tree is the same whatever the number of threads.
+  for (unsigned threads : {2, 5}) {
+    const BVH parallel(boxes, threads);
+    EXPECT_EQ(parallel.indices(), bvh.indices());
+    ASSERT_EQ(parallel.nodes().size(), bvh.nodes().size());
+    for (unsigned n = 0; n < bvh.nodes().size(); n++) {
+      EXPECT_EQ(parallel.nodes()[n].box(), bvh.nodes()[n].box());
+      EXPECT_EQ(parallel.nodes()[n].axis, bvh.nodes()[n].axis);
+      EXPECT_EQ(parallel.nodes()[n].offset, bvh.nodes()[n].offset);
+      EXPECT_EQ(parallel.nodes()[n].count, bvh.nodes()[n].count);
+    }
+  }
+
+  // And it finds the boxes hit by a ray.
+  const Ray r(Point(-5, 20.5, 10), normalize(Vector(1, 0.1, 0.3)));
+  const RayTracerDataType INF =
+      std::numeric_limits<RayTracerDataType>::infinity();
+  vector<unsigned> expected;
+  for (unsigned i = 0; i < boxes.size(); i++)
+    if (boxes[i].intersects(r, 0, INF))
+      expected.push_back(i);
+  EXPECT_FALSE(expected.empty());
+  EXPECT_EQ(visited(bvh, r), expected);
+}
+
+TEST(BVH, refit) {
+  // Swap a few boxes with boxes at the other end of the row, and move one up.
+  const vector<BoundingBox> row = row_of_boxes(100);
+  vector<BoundingBox> boxes = row;
+  BVH full(boxes), partial(boxes);
+  const std::vector<BVH::Node> built = full.nodes();
+  const BVH::DataType cost = full.cost();
+  const vector<unsigned> moved = {0, 99, 10, 60, 40};
+  std::swap(boxes[0], boxes[99]);
+  std::swap(boxes[10], boxes[60]);
+  boxes[40] = BoundingBox(Point(79.5, 4.5, -0.5), Point(80.5, 5.5, 0.5));
+  full.refit(boxes);
+  partial.refit(boxes, moved);
+
+  // The tree is kept, with boxes fitting the moved primitives.
+  ASSERT_EQ(full.nodes().size(), built.size());
+  ASSERT_EQ(partial.nodes().size(), built.size());
+  for (unsigned n = 0; n < built.size(); n++) {
+    EXPECT_EQ(full.nodes()[n].offset, built[n].offset);
+    EXPECT_EQ(full.nodes()[n].count, built[n].count);
+    EXPECT_EQ(partial.nodes()[n].box(), full.nodes()[n].box());
+  }
+  EXPECT_EQ(full.indices(), partial.indices());
+  EXPECT_EQ(full.bounds().max(), Point(198.5, 5.5, 0.5));
+  EXPECT_EQ(visited(partial, Ray(Point(0, 0, -5), Vector(0, 0, 1))),
+            vector<unsigned>({99}));
+  EXPECT_EQ(visited(partial, Ray(Point(120, 0, -5), Vector(0, 0, 1))),
+            vector<unsigned>({10}));
+  EXPECT_TRUE(visited(partial, Ray(Point(80, 0, -5), Vector(0, 0, 1))).empty());
+  EXPECT_EQ(visited(partial, Ray(Point(80, 5, -5), Vector(0, 0, 1))),
+            vector<unsigned>({40}));
+  // But it got worse than a rebuild.
+  EXPECT_GT(full.cost(), cost);
+  EXPECT_LT(BVH(boxes).cost(), full.cost());
+
+  // Moving them back restores the original boxes.
+  partial.refit(row, moved);
+  for (unsigned n = 0; n < built.size(); n++)
+    EXPECT_EQ(partial.nodes()[n].box(), built[n].box());
+  EXPECT_EQ(partial.cost(), cost);
+
+  BVH empty;
+  empty.refit(vector<BoundingBox>(), vector<unsigned>());
+  EXPECT_EQ(empty.cost(), 0);
+}
+
+TEST(BVH, output) {
+  BVH bvh(row_of_boxes(1));
+  ostringstream oss;
+  oss << bvh;
+  EXPECT_EQ(oss.str(), "BVH { primitives: 1, nodes: 1, depth: 1, cost: 1, "
+                       "bounds: BoundingBox { min: Tuple { -0.5, -0.5, -0.5, "
+                       "1}, max: Tuple { 0.5, 0.5, 0.5, 1}}}");
+}
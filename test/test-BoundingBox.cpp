@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "ratrac/BoundingBox.h"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::ostringstream;
+
+TEST(BoundingBox, base) {
+  // A default box is empty.
+  BoundingBox b;
+  EXPECT_TRUE(b.empty());
+  EXPECT_EQ(b.surface_area(), 0);
+
+  // Adding points to a box.
+  b.add(Point(-5, 2, 0)).add(Point(7, 0, -3));
+  EXPECT_FALSE(b.empty());
+  EXPECT_TRUE(b.is_finite());
+  EXPECT_EQ(b.min(), Point(-5, 0, -3));
+  EXPECT_EQ(b.max(), Point(7, 2, 0));
+  EXPECT_EQ(b.centroid(), Point(1, 1, -1.5));
+  EXPECT_EQ(b.extent(), Vector(12, 2, 3));
+  EXPECT_EQ(b.longest_axis(), 0);
+  EXPECT_EQ(b.surface_area(), 2 * (12 * 2 + 2 * 3 + 3 * 12));
+
+  // Adding a box to a box.
+  BoundingBox b2(Point(-5, -2, 0), Point(7, 4, 3));
+  b2.add(BoundingBox(Point(8, -7, -2), Point(14, 2, 8)));
+  EXPECT_EQ(b2.min(), Point(-5, -7, -2));
+  EXPECT_EQ(b2.max(), Point(14, 4, 8));
+  EXPECT_EQ(b2.longest_axis(), 0);
+
+  // Checking if a box contains a given point.
+  BoundingBox b3(Point(5, -2, 0), Point(11, 4, 7));
+  EXPECT_TRUE(b3.contains(Point(5, -2, 0)));
+  EXPECT_TRUE(b3.contains(Point(11, 4, 7)));
+  EXPECT_TRUE(b3.contains(Point(8, 1, 3)));
+  EXPECT_FALSE(b3.contains(Point(3, 0, 3)));
+  EXPECT_FALSE(b3.contains(Point(8, -4, 3)));
+  EXPECT_FALSE(b3.contains(Point(8, 1, 8)));
+
+  // An infinite box.
+  EXPECT_FALSE(BoundingBox::infinite().is_finite());
+  EXPECT_TRUE(BoundingBox::infinite().contains(Point(1e30, -1e30, 0)));
+}
+
+TEST(BoundingBox, transform) {
+  // Transforming a bounding box.
+  BoundingBox b(Point(-1, -1, -1), Point(1, 1, 1));
+  Matrix m = Matrix::rotation_x(M_PI / 4) * Matrix::rotation_y(M_PI / 4);
+  BoundingBox b2 = b.transform(m);
+  EXPECT_EQ(b2.min(), Point(-1.41421, -1.70711, -1.70711));
+  EXPECT_EQ(b2.max(), Point(1.41421, 1.70711, 1.70711));
+
+  b2 = b.transform(Matrix::translation(1, 2, 3) * Matrix::scaling(2, 2, 2));
+  EXPECT_EQ(b2.min(), Point(-1, 0, 1));
+  EXPECT_EQ(b2.max(), Point(3, 4, 5));
+
+  // Empty boxes stay empty, and infinite boxes infinite.
+  EXPECT_TRUE(BoundingBox().transform(m).empty());
+  EXPECT_FALSE(BoundingBox::infinite().transform(m).is_finite());
+}
+
+TEST(BoundingBox, intersects) {
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+
+  // Intersecting a ray with a bounding box at the origin.
+  BoundingBox b(Point(-1, -1, -1), Point(1, 1, 1));
+  struct {
+    Tuple origin;
+    Tuple direction;
+    bool result;
+  } cube_tests[] = {
+      {Point(5, 0.5, 0), Vector(-1, 0, 0), true},
+      {Point(-5, 0.5, 0), Vector(1, 0, 0), true},
+      {Point(0.5, 5, 0), Vector(0, -1, 0), true},
+      {Point(0.5, -5, 0), Vector(0, 1, 0), true},
+      {Point(0.5, 0, 5), Vector(0, 0, -1), true},
+      {Point(0.5, 0, -5), Vector(0, 0, 1), true},
+      {Point(0, 0.5, 0), Vector(0, 0, 1), true},
+      {Point(-2, 0, 0), Vector(2, 4, 6), false},
+      {Point(0, -2, 0), Vector(6, 2, 4), false},
+      {Point(0, 0, -2), Vector(4, 6, 2), false},
+      {Point(2, 0, 2), Vector(0, 0, -1), false},
+      {Point(0, 2, 2), Vector(0, -1, 0), false},
+      {Point(2, 2, 0), Vector(-1, 0, 0), false},
+  };
+  for (const auto &t : cube_tests)
+    EXPECT_EQ(b.intersects(Ray(t.origin, normalize(t.direction)), -inf, inf),
+              t.result);
+
+  // Intersecting a ray with a non-cubic bounding box.
+  BoundingBox b2(Point(5, -2, 0), Point(11, 4, 7));
+  struct {
+    Tuple origin;
+    Tuple direction;
+    bool result;
+  } box_tests[] = {
+      {Point(15, 1, 2), Vector(-1, 0, 0), true},
+      {Point(-5, -1, 4), Vector(1, 0, 0), true},
+      {Point(7, 6, 5), Vector(0, -1, 0), true},
+      {Point(9, -5, 6), Vector(0, 1, 0), true},
+      {Point(8, 2, 12), Vector(0, 0, -1), true},
+      {Point(6, 0, -5), Vector(0, 0, 1), true},
+      {Point(8, 1, 3.5), Vector(0, 0, 1), true},
+      {Point(9, -1, -8), Vector(2, 4, 6), false},
+      {Point(8, 3, -4), Vector(6, 2, 4), false},
+      {Point(9, -1, -2), Vector(4, 6, 2), false},
+      {Point(4, 0, 9), Vector(0, 0, -1), false},
+      {Point(8, 6, -1), Vector(0, -1, 0), false},
+      {Point(12, 5, 4), Vector(-1, 0, 0), false},
+  };
+  for (const auto &t : box_tests)
+    EXPECT_EQ(b2.intersects(Ray(t.origin, normalize(t.direction)), -inf, inf),
+              t.result);
+
+  // The [tmin:tmax] range is taken into account.
+  Ray r(Point(-5, 0.5, 0), Vector(1, 0, 0));
+  EXPECT_TRUE(b.intersects(r, 0, inf));
+  EXPECT_TRUE(b.intersects(r, 0, 4));
+  EXPECT_FALSE(b.intersects(r, 0, 3.5));
+  EXPECT_FALSE(b.intersects(r, 6.5, inf));
+  // A box behind the ray.
+  EXPECT_FALSE(b.intersects(Ray(Point(5, 0.5, 0), Vector(1, 0, 0)), 0, inf));
+  EXPECT_TRUE(b.intersects(Ray(Point(5, 0.5, 0), Vector(1, 0, 0)), -inf, inf));
+
+  // Infinite boxes are always hit.
+  EXPECT_TRUE(BoundingBox::infinite().intersects(r, 0, inf));
+  EXPECT_TRUE(BoundingBox(Point(-inf, 0, -inf), Point(inf, 0, inf))
+                  .intersects(Ray(Point(0, 1, 0), Vector(0, -1, 0)), 0, inf));
+}
+
+TEST(BoundingBox, output) {
+  ostringstream oss;
+  oss << BoundingBox(Point(-1, -2, -3), Point(1, 2, 3));
+  EXPECT_EQ(oss.str(), "BoundingBox { min: Tuple { -1, -2, -3, 1}, max: Tuple "
+                       "{ 1, 2, 3, 1}}");
+}
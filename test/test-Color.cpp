@@ -46,6 +46,14 @@ TEST(Color, base) {
   EXPECT_EQ(c1 * c2, Color(0.9, 0.2, 0.04));
 
   // Multiplying colors/Hadamard product/Schur product
+
+  // Comparing colors with a tolerance.
+  c1 = Color(0.5, 0.25, 0.75);
+  c2 = Color(0.5005, 0.2495, 0.75);
+  EXPECT_NE(c1, c2);
+  EXPECT_TRUE(c1.close_to(c2, 0.001f));
+  EXPECT_FALSE(c1.close_to(c2, 0.0001f));
+  EXPECT_FALSE(c1.close_to(Color(0.5, 0.25, 0.75, 0.5), 0.001f));
 }
 
 TEST(Color, output) {
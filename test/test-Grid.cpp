@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "test-ratrac.h"
+
+#include "ratrac/Grid.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::ostringstream;
+using std::vector;
+
+namespace {
+const RayTracerDataType INF =
+    std::numeric_limits<RayTracerDataType>::infinity();
+
+// Get the sorted list of the distinct primitives visited by a traversal.
+vector<unsigned> visited(const Grid &grid, const Ray &r,
+                         RayTracerDataType tmin = 0) {
+  vector<unsigned> prims;
+  grid.traverse(r, tmin, INF, [&](unsigned prim) {
+    prims.push_back(prim);
+    return false;
+  });
+  std::sort(prims.begin(), prims.end());
+  prims.erase(std::unique(prims.begin(), prims.end()), prims.end());
+  return prims;
+}
+
+// Get the sorted list of the primitives whose box is hit by r.
+vector<unsigned> hit(const vector<BoundingBox> &boxes, const Ray &r,
+                     RayTracerDataType tmin = 0) {
+  vector<unsigned> prims;
+  for (unsigned i = 0; i < boxes.size(); i++)
+    if (boxes[i].intersects(r, tmin, INF))
+      prims.push_back(i);
+  return prims;
+}
+} // namespace
+
+TEST(Grid, base) {
+  Grid empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.num_cells(), 0);
+  EXPECT_TRUE(visited(empty, Ray(Point(0, 0, -5), Vector(0, 0, 1))).empty());
+
+  // A grid over a single box.
+  const Grid one({BoundingBox(Point(-1, -1, -1), Point(1, 1, 1))});
+  EXPECT_EQ(one.size(), 1);
+  EXPECT_EQ(one.num_cells(), 1);
+  EXPECT_EQ(visited(one, Ray(Point(0, 0, -5), Vector(0, 0, 1))),
+            vector<unsigned>({0}));
+  EXPECT_TRUE(visited(one, Ray(Point(2, 0, -5), Vector(0, 0, 1))).empty());
+
+  // The cells are cubes, about DENSITY times as many as the primitives.
+  const vector<BoundingBox> boxes = lattice();
+  const Grid grid(boxes);
+  EXPECT_EQ(grid.size(), 1000);
+  EXPECT_EQ(grid.bounds().min(), Point(-0.4, -0.4, -0.4));
+  EXPECT_EQ(grid.resolution(0), grid.resolution(1));
+  EXPECT_EQ(grid.resolution(0), grid.resolution(2));
+  EXPECT_NEAR(grid.num_cells(), Grid::DENSITY * 1000, 500);
+  EXPECT_GE(grid.num_references(), 1000);
+
+  // Flat sets of primitives get a single cell across.
+  vector<BoundingBox> flat;
+  for (unsigned i = 0; i < 100; i++)
+    flat.push_back(BoundingBox(Point(i % 10, 0, i / 10),
+                               Point(i % 10 + 0.5, 0, i / 10 + 0.5)));
+  const Grid flat_grid(flat);
+  EXPECT_EQ(flat_grid.resolution(1), 1);
+  EXPECT_GT(flat_grid.resolution(0), 1);
+  EXPECT_EQ(visited(flat_grid, Ray(Point(3.25, 5, 7.25), Vector(0, -1, 0))),
+            vector<unsigned>({73}));
+
+  // The resolution is bounded.
+  vector<BoundingBox> line;
+  for (unsigned i = 0; i < 1000; i++)
+    line.push_back(BoundingBox(Point(i, 0, 0), Point(i + 0.5, 1, 1)));
+  EXPECT_EQ(Grid(line).resolution(0), Grid::MAX_RESOLUTION);
+}
+
+TEST(Grid, traverse) {
+  // The traversal visits at least all primitives whose box is hit, and not
+  // many more.
+  const vector<BoundingBox> boxes = lattice();
+  const Grid grid(boxes);
+  unsigned found = 0, extra = 0;
+  for (const Ray &r : latticeRays()) {
+    const vector<unsigned> expected = hit(boxes, r);
+    const vector<unsigned> prims = visited(grid, r);
+    EXPECT_TRUE(std::includes(prims.begin(), prims.end(), expected.begin(),
+                              expected.end()));
+    found += expected.size();
+    extra += prims.size() - expected.size();
+
+    // The same, along the ray's whole line.
+    const vector<unsigned> line = visited(grid, r, -INF);
+    const vector<unsigned> expected_line = hit(boxes, r, -INF);
+    EXPECT_TRUE(std::includes(line.begin(), line.end(),
+                              expected_line.begin(), expected_line.end()));
+  }
+  EXPECT_GT(found, 500);
+  EXPECT_LT(extra, 20 * found);
+
+  // The traversal goes through the cells in order, and stops when asked to
+  // or at the first cell beyond tmax.
+  const Ray r(Point(-5, 0, 0), Vector(1, 0, 0));
+  vector<unsigned> prims;
+  grid.traverse(r, 0, INF, [&](unsigned prim) {
+    prims.push_back(prim);
+    return prims.size() == 3;
+  });
+  ASSERT_EQ(prims.size(), 3);
+  EXPECT_TRUE(std::is_sorted(prims.begin(), prims.end()));
+
+  prims.clear();
+  RayTracerDataType tmax = INF;
+  grid.traverse(r, 0, tmax, [&](unsigned prim) {
+    prims.push_back(prim);
+    tmax = 7.5;
+    return false;
+  });
+  EXPECT_TRUE(std::is_sorted(prims.begin(), prims.end()));
+  EXPECT_GE(prims.back(), 2);
+  EXPECT_LE(prims.back(), 4);
+}
+
+TEST(Grid, output) {
+  const Grid grid({BoundingBox(Point(-1, -1, -1), Point(1, 1, 1))});
+  ostringstream oss;
+  oss << grid;
+  EXPECT_EQ(oss.str(),
+            "Grid { primitives: 1, resolution: 1x1x1, references: 1, bounds: "
+            "BoundingBox { min: Tuple { -1, -1, -1, 1}, max: Tuple { 1, 1, 1, "
+            "1}}}");
+}
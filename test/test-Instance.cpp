@@ -0,0 +1,248 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/Instance.h"
+#include "ratrac/Intersections.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/World.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::make_shared;
+using std::ostringstream;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+// A bumpy n x n grid of quads in the XZ plane, over [0:n]x[0:n], each quad
+// being split in 2 faces, with vertex normals.
+shared_ptr<TriangleMesh> getGrid(unsigned n) {
+  vector<Tuple> vertices, normals;
+  for (unsigned j = 0; j <= n; j++)
+    for (unsigned i = 0; i <= n; i++) {
+      vertices.push_back(Point(i, 0.25 * ((i + 2 * j) % 3), j));
+      normals.push_back(normalize(Vector(0.1 * (i % 2), 1, 0.1 * (j % 3))));
+    }
+  vector<unsigned> indices;
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned i = 0; i < n; i++) {
+      const unsigned v = j * (n + 1) + i;
+      indices.insert(indices.end(), {v, v + 1, v + n + 2});
+      indices.insert(indices.end(), {v, v + n + 2, v + n + 1});
+    }
+  return make_shared<TriangleMesh>(vertices, indices, normals);
+}
+
+vector<Ray> getRays() {
+  vector<Ray> rays;
+  for (unsigned j = 0; j < 16; j++)
+    for (unsigned i = 0; i < 16; i++)
+      rays.push_back(Ray(Point(0.4 * i - 2, 5, 0.4 * j - 2),
+                         normalize(Vector(0.1, -1, 0.05 * (i % 3)))));
+  return rays;
+}
+
+const RayTracerDataType INF =
+    std::numeric_limits<RayTracerDataType>::infinity();
+} // namespace
+
+TEST(Instance, construction) {
+  shared_ptr<Sphere> sphere = make_shared<Sphere>();
+  sphere->transform(Matrix::scaling(2, 2, 2));
+  sphere->material().color(Color(1, 0, 0)).diffuse(0.5);
+
+  const Instance a(sphere);
+  const Instance b(sphere, Matrix::translation(5, 0, 0));
+  EXPECT_EQ(&a.prototype(), sphere.get());
+  EXPECT_EQ(b.shared_prototype(), sphere);
+  EXPECT_EQ(sphere.use_count(), 3);
+
+  // The instances shade with their prototype's material, until they get one
+  // of their own.
+  EXPECT_FALSE(a.has_own_material());
+  EXPECT_EQ(&a.material(), &sphere->material());
+  Instance c(sphere);
+  c.material(Material().color(Color(0, 1, 0)));
+  EXPECT_TRUE(c.has_own_material());
+  EXPECT_EQ(c.material().color(), Color(0, 1, 0));
+  EXPECT_EQ(sphere->material().color(), Color(1, 0, 0));
+  // Modifying it starts from a copy of the prototype's.
+  Instance d(sphere);
+  d.material().ambient(0.5);
+  EXPECT_TRUE(d.has_own_material());
+  EXPECT_EQ(d.material().color(), Color(1, 0, 0));
+  EXPECT_NE(&d.material(), &sphere->material());
+  EXPECT_EQ(a.transform(), Matrix::identity());
+  EXPECT_EQ(b.transform(), Matrix::translation(5, 0, 0));
+
+  // Their object space is the prototype's world space.
+  EXPECT_EQ(a.bounds(), BoundingBox(Point(-2, -2, -2), Point(2, 2, 2)));
+  EXPECT_EQ(b.world_bounds(), BoundingBox(Point(3, -2, -2), Point(7, 2, 2)));
+  EXPECT_FALSE(Instance(make_shared<Plane>()).world_bounds().is_finite());
+
+  ostringstream os;
+  os << b;
+  EXPECT_EQ(os.str().substr(0, 30), "Instance { prototype: Sphere {");
+}
+
+TEST(Instance, queries) {
+  // An instance is intersected as its prototype with the instance's
+  // transform applied on top of the prototype's, and its intersections refer
+  // to it.
+  shared_ptr<Sphere> sphere = make_shared<Sphere>();
+  sphere->transform(Matrix::scaling(1, 0.5, 1));
+  const Matrix T = Matrix::translation(0.5, 0, -0.25) * Matrix::rotation_z(0.4);
+  const Instance instance(sphere, T);
+  Sphere expected_sphere;
+  expected_sphere.transform(T * sphere->transform());
+
+  unsigned found = 0;
+  for (const Ray &r : getRays()) {
+    Intersection expected(INF, nullptr);
+    const bool hit_expected = expected_sphere.closest_hit(r, expected);
+    Intersection hit(INF, nullptr);
+    ASSERT_EQ(instance.closest_hit(r, hit), hit_expected);
+    EXPECT_EQ(instance.occludes(r, INF), hit_expected);
+    const Intersections xs = instance.intersect(r);
+    const Intersections expected_xs = expected_sphere.intersect(r);
+    ASSERT_EQ(xs.count(), expected_xs.count());
+    for (unsigned i = 0; i < xs.count(); i++) {
+      EXPECT_NEAR(xs[i].t, expected_xs[i].t, 1e-4);
+      EXPECT_EQ(xs[i].object, &instance);
+    }
+    if (!hit_expected)
+      continue;
+
+    found++;
+    EXPECT_EQ(hit.object, &instance);
+    EXPECT_NEAR(hit.t, expected.t, 1e-4);
+    EXPECT_FALSE(instance.occludes(r, hit.t - 1e-3));
+    const Tuple point = position(r, hit.t);
+    EXPECT_EQ(instance.normal_at(point, hit),
+              expected_sphere.normal_at(point));
+  }
+  EXPECT_GT(found, 10);
+}
+
+TEST(Instance, mesh) {
+  // Instances of a smooth mesh get their normals from the faces they hit.
+  shared_ptr<TriangleMesh> grid = getGrid(3);
+  grid->transform(Matrix::translation(-1.5, 0, -1.5));
+  const Matrix T = Matrix::rotation_y(M_PI / 5) * Matrix::scaling(1, 1.5, 1);
+  const Instance instance(grid, T);
+  TriangleMesh expected_mesh(grid->vertices(), grid->indices(),
+                             grid->normals());
+  expected_mesh.transform(T * grid->transform());
+
+  unsigned found = 0;
+  for (const Ray &r : getRays()) {
+    Intersection expected(INF, nullptr);
+    Intersection hit(INF, nullptr);
+    ASSERT_EQ(instance.closest_hit(r, hit),
+              expected_mesh.closest_hit(r, expected));
+    if (!expected.object)
+      continue;
+    found++;
+    EXPECT_EQ(hit.object, &instance);
+    EXPECT_EQ(hit.face, expected.face);
+    EXPECT_NEAR(hit.t, expected.t, 1e-4);
+    const Tuple point = position(r, hit.t);
+    EXPECT_EQ(instance.normal_at(point, hit),
+              expected_mesh.normal_at(point, expected));
+  }
+  EXPECT_GT(found, 50);
+}
+
+TEST(Instance, packet_queries) {
+  // Packet queries give each active lane the single ray query result, and
+  // only the lanes the instance hits refer to it, even when its prototype is
+  // intersected too.
+  shared_ptr<TriangleMesh> grid = getGrid(4);
+  const Instance instance(grid, Matrix::translation(-1, 0.75, -1));
+  const vector<Ray> rays = getRays();
+  const unsigned mask = 0xBD;
+  unsigned found = 0, prototype = 0;
+  for (unsigned first = 0; first + RayPacket::SIZE <= rays.size();
+       first += RayPacket::SIZE) {
+    RayPacket packet;
+    for (unsigned i = 0; i < RayPacket::SIZE; i++)
+      packet.set(i, rays[first + i]);
+
+    PacketHits hits;
+    grid->closest_hit(packet, mask, hits);
+    instance.closest_hit(packet, mask, hits);
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      Intersection expected(INF, nullptr);
+      if (mask & (1U << i)) {
+        grid->closest_hit(packet.ray(i), expected);
+        found += instance.closest_hit(packet.ray(i), expected);
+      }
+      const Intersection hit = hits.hit(i);
+      EXPECT_EQ(hit, expected);
+      prototype += hit.object == grid.get();
+      if (expected.object) {
+        EXPECT_EQ(hit.face, expected.face);
+        EXPECT_EQ(hit.u, expected.u);
+        EXPECT_EQ(hit.v, expected.v);
+      }
+    }
+  }
+  EXPECT_GT(found, 20);
+  EXPECT_GT(prototype, 0);
+}
+
+TEST(Instance, nested) {
+  shared_ptr<Sphere> sphere = make_shared<Sphere>();
+  shared_ptr<Instance> inner =
+      make_shared<Instance>(sphere, Matrix::scaling(0.5, 0.5, 0.5));
+  const Instance outer(inner, Matrix::translation(0, 0, 3));
+  EXPECT_EQ(outer.world_bounds(),
+            BoundingBox(Point(-0.5, -0.5, 2.5), Point(0.5, 0.5, 3.5)));
+  Intersection hit(INF, nullptr);
+  ASSERT_TRUE(outer.closest_hit(Ray(Point(0, 0, -5), Vector(0, 0, 1)), hit));
+  EXPECT_EQ(hit.object, &outer);
+  EXPECT_NEAR(hit.t, 7.5, 1e-5);
+}
+
+TEST(Instance, world) {
+  // A world of instances, big enough for a BVH, renders as the world of the
+  // equivalent shapes.
+  shared_ptr<Sphere> sphere = make_shared<Sphere>();
+  sphere->transform(Matrix::scaling(0.4, 0.3, 0.4));
+  World instances, spheres;
+  for (World *w : {&instances, &spheres})
+    w->lights().push_back(LightPoint(Point(-10, 10, -10), Color::WHITE()));
+  for (unsigned i = 0; i < 25; i++) {
+    const Matrix T = Matrix::translation(i % 5 - 2, 0, i / 5 - 2) *
+                     Matrix::rotation_x(0.1 * i);
+    Material m;
+    m.color(Color(0.1 * (i % 10), 0.5, 0.2));
+    Instance *instance = new Instance(sphere, T);
+    instance->material(m);
+    instances.append(instance);
+    Sphere *s = new Sphere();
+    s->transform(T * sphere->transform());
+    s->material(m);
+    spheres.append(s);
+  }
+  ASSERT_NE(instances.bvh(), nullptr);
+
+  for (const Ray &r : getRays()) {
+    const Intersection hit = instances.closest_hit(r);
+    const Intersection expected = spheres.closest_hit(r);
+    ASSERT_EQ(hit.object != nullptr, expected.object != nullptr);
+    EXPECT_EQ(instances.occluded(r, INF), spheres.occluded(r, INF));
+    if (!hit.object)
+      continue;
+    EXPECT_NEAR(hit.t, expected.t, 1e-4);
+    EXPECT_EQ(color_at(instances, r), color_at(spheres, r));
+  }
+}
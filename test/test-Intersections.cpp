@@ -2,6 +2,7 @@
 
 #include "ratrac/Intersections.h"
 #include "ratrac/Shapes.h"
+#include "ratrac/World.h"
 
 #include <memory>
 
@@ -66,6 +67,35 @@ TEST(Intersections, hit) {
   EXPECT_GT(comps.point.z(), comps.over_point.z());
 }
 
+TEST(Intersections, no_acne) {
+  // Points moved off the surface must not be shadowed by the surface they
+  // come from, including far from the origin where the rounding errors of
+  // the hit points are larger.
+  World w;
+  w.lights().push_back(LightPoint(Point(-100, 100, -100), Color::WHITE()));
+  Sphere *s = new Sphere();
+  s->transform(Matrix::translation(200, -100, 1000) * Matrix::scaling(300, 300, 300));
+  w.append(s);
+
+  unsigned lit = 0, acne = 0;
+  for (int y = -20; y <= 20; y++)
+    for (int x = -20; x <= 20; x++) {
+      Ray r(Point(0, 0, 0), normalize(Vector(20 + x, -10 + y, 100)));
+      Intersection hit = w.closest_hit(r);
+      if (!hit.object)
+        continue;
+      Computations comps(hit, r);
+      const Tuple lightv = w.light(0)->position() - comps.over_point;
+      if (dot(comps.normalv, lightv) <= 0)
+        continue;
+      lit++;
+      if (is_shadowed(w, comps.over_point, 0))
+        acne++;
+    }
+  EXPECT_GT(lit, 100u);
+  EXPECT_EQ(acne, 0u);
+}
+
 TEST(Intersections, computations) {
   Ray r(Point(0, 0, -5), Vector(0, 0, 1));
   unique_ptr<Sphere> s(new Sphere());
@@ -0,0 +1,197 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Color.h"
+#include "ratrac/Kernels.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+#include "ratrac/SIMD.h"
+#include "ratrac/Tuple.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+namespace {
+const ISA all_isas[] = {ISA::SCALAR, ISA::SSE2, ISA::AVX2, ISA::AVX512};
+
+bool same_bits(const Tuple &a, const Tuple &b) {
+  return std::memcmp(a.data(), b.data(), 4 * sizeof(Tuple::DataType)) == 0;
+}
+
+bool same_bits(const Color &a, const Color &b) {
+  return std::memcmp(a.data(), b.data(), 4 * sizeof(Color::ColorType)) == 0;
+}
+
+std::vector<Ray> getRays() {
+  std::vector<Ray> rays;
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < 8; j++)
+      rays.push_back(Ray(Point(0.25 * i - 1, -0.0, -5 + 0.1 * j),
+                         normalize(Vector(0.01 * j - 0.03, 0.2 * i - 0.7, 1))));
+  return rays;
+}
+} // namespace
+
+TEST(Kernels, base) {
+  EXPECT_STREQ(name(ISA::SCALAR), "scalar");
+  EXPECT_STREQ(name(ISA::SSE2), "sse2");
+  EXPECT_STREQ(name(ISA::AVX2), "avx2");
+  EXPECT_STREQ(name(ISA::AVX512), "avx512");
+
+  // The active kernels are the widest ones, and the narrower ones are all
+  // available.
+  EXPECT_EQ(kernels().isa, detect_isa());
+  EXPECT_EQ(get_kernels(detect_isa()), &kernels());
+  for (ISA isa : all_isas) {
+    if (static_cast<unsigned>(isa) > static_cast<unsigned>(detect_isa())) {
+      EXPECT_EQ(get_kernels(isa), nullptr);
+    }
+  }
+  ASSERT_NE(get_kernels(ISA::SCALAR), nullptr);
+  EXPECT_EQ(get_kernels(ISA::SCALAR)->isa, ISA::SCALAR);
+}
+
+TEST(Kernels, transform_ray) {
+  const Kernels &ref = *get_kernels(ISA::SCALAR);
+  const Matrix transforms[] = {
+      Matrix::identity(), Matrix::translation(3, 4, 5),
+      inverse(Matrix::scaling(2, 0.5, 3).rotate_y(0.3).translate(0.1, 0, 1)),
+      {{-5, 2, 6, -8}, {1, -5, 1, 8}, {7, 7, -6, -7}, {1, -3, 7, 4}}};
+  for (ISA isa : all_isas) {
+    const Kernels *k = get_kernels(isa);
+    if (!k)
+      continue;
+    EXPECT_EQ(k->isa, isa);
+    for (const Matrix &M : transforms)
+      for (const Ray &r : getRays()) {
+        Ray expected = ref.transform_ray(r, M);
+        Ray result = k->transform_ray(r, M);
+        EXPECT_TRUE(same_bits(expected.origin(), result.origin()));
+        EXPECT_TRUE(same_bits(expected.direction(), result.direction()));
+        EXPECT_EQ(expected.origin(), M * r.origin());
+        EXPECT_EQ(expected.direction(), M * r.direction());
+      }
+  }
+}
+
+TEST(Kernels, accumulate_colors) {
+  // Check all counts around the vector widths, so that the loop tails get
+  // exercised.
+  for (ISA isa : all_isas) {
+    const Kernels *k = get_kernels(isa);
+    if (!k)
+      continue;
+    for (unsigned count = 0; count < 11; count++) {
+      std::vector<Color> src, dst, expected;
+      for (unsigned i = 0; i < count; i++) {
+        src.push_back(Color(0.1f * i, -0.5f, 1.0f / (i + 1), 0.5f));
+        dst.push_back(Color(0.3f, 0.7f * i, -0.0f, 0.25f * i));
+        expected.push_back(dst.back());
+        expected.back() += src.back();
+      }
+      // One more color, which must be left untouched.
+      dst.push_back(Color(1, 2, 3, 4));
+      k->accumulate_colors(dst.data(), src.data(), count);
+      for (unsigned i = 0; i < count; i++)
+        EXPECT_TRUE(same_bits(dst[i], expected[i]));
+      EXPECT_TRUE(same_bits(dst[count], Color(1, 2, 3, 4)));
+    }
+  }
+}
+
+TEST(Kernels, packets) {
+  // The packet kernels give, for each lane, the exact same results as their
+  // single ray counterparts.
+  const Kernels &ref = *get_kernels(ISA::SCALAR);
+  const Matrix transforms[] = {
+      Matrix::identity(),
+      inverse(Matrix::scaling(2, 0.5, 3).rotate_y(0.3).translate(0.1, 0, 1)),
+      {{-5, 2, 6, -8}, {1, -5, 1, 8}, {7, 7, -6, -7}, {1, -3, 7, 4}}};
+  const Tuple centers[] = {Point(0, 0, 0), Point(0.5, -0.25, 1)};
+  const std::vector<Ray> rays = getRays();
+  ASSERT_EQ(rays.size() % RayPacket::SIZE, 0);
+  for (ISA isa : all_isas) {
+    const Kernels *k = get_kernels(isa);
+    if (!k)
+      continue;
+    for (unsigned p = 0; p < rays.size(); p += RayPacket::SIZE) {
+      RayPacket packet;
+      for (unsigned i = 0; i < RayPacket::SIZE; i++)
+        packet.set(i, rays[p + i]);
+
+      for (const Matrix &M : transforms) {
+        RayPacket result = k->transform_packet(packet, M);
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          Ray expected = ref.transform_ray(rays[p + i], M);
+          EXPECT_TRUE(same_bits(expected.origin(), result.ray(i).origin()));
+          EXPECT_TRUE(
+              same_bits(expected.direction(), result.ray(i).direction()));
+        }
+      }
+
+      for (const Tuple &center : centers) {
+        RayTracerDataType t1[RayPacket::SIZE], t2[RayPacket::SIZE];
+        const RayTracerDataType radius = 1.5;
+        k->intersect_sphere_packet(packet, center, radius, t1, t2);
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          RayTracerDataType et1, et2;
+          if (!simd::scalar::intersect_sphere(
+                  rays[p + i].origin().data(), rays[p + i].direction().data(),
+                  center.data(), radius, et1, et2)) {
+            EXPECT_EQ(t1[i], -1.0);
+            EXPECT_EQ(t2[i], -1.0);
+            continue;
+          }
+          EXPECT_EQ(std::memcmp(&t1[i], &et1, sizeof(et1)), 0);
+          EXPECT_EQ(std::memcmp(&t2[i], &et2, sizeof(et2)), 0);
+        }
+      }
+    }
+  }
+}
+
+TEST(Kernels, slab4) {
+  // All versions clip the same intervals, bit for bit, including for the
+  // rays along the axes and the empty box.
+  typedef RayTracerDataType DataType;
+  const float inf = std::numeric_limits<float>::infinity();
+  const float min[3][4] = {
+      {-1, 0.5f, 2, inf}, {-1, -0.1f, 0, inf}, {-1, 0, -3, inf}};
+  const float max[3][4] = {
+      {1, 1.5f, 3, -inf}, {1, 0.1f, 1e-3f, -inf}, {1, 2, 4, -inf}};
+  const Kernels &ref = *get_kernels(ISA::SCALAR);
+  std::vector<Ray> rays = getRays();
+  rays.push_back(Ray(Point(0, 0, -5), Vector(0, 0, 1)));
+  rays.push_back(Ray(Point(-1, 0.5, 1), Vector(1, 0, 0)));
+  unsigned hits = 0;
+  for (ISA isa : all_isas) {
+    const Kernels *k = get_kernels(isa);
+    if (!k)
+      continue;
+    for (const Ray &r : rays) {
+      const SlabRay sr(r);
+      const DataType origin[3] = {sr.origin[0], sr.origin[1], sr.origin[2]};
+      const DataType inv_direction[3] = {
+          sr.inv_direction[0], sr.inv_direction[1], sr.inv_direction[2]};
+      const float *near[3], *far[3];
+      for (unsigned a = 0; a < 3; a++) {
+        near[a] = sr.sign[a] ? max[a] : min[a];
+        far[a] = sr.sign[a] ? min[a] : max[a];
+      }
+      DataType t0[4] = {0, 0, 0, 0}, t1[4] = {100, 100, 6, 100};
+      DataType et0[4] = {0, 0, 0, 0}, et1[4] = {100, 100, 6, 100};
+      const unsigned mask = k->slab4(near, far, origin, inv_direction, t0, t1);
+      EXPECT_EQ(mask, ref.slab4(near, far, origin, inv_direction, et0, et1));
+      EXPECT_EQ(std::memcmp(t0, et0, sizeof(t0)), 0);
+      EXPECT_EQ(std::memcmp(t1, et1, sizeof(t1)), 0);
+      EXPECT_EQ(mask & 8, 0);
+      hits += mask != 0;
+    }
+  }
+  EXPECT_GT(hits, 10);
+}
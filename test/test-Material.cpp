@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include "test-ratrac.h"
 
 #include "ratrac/Material.h"
 
@@ -105,9 +106,9 @@ TEST(Material, lighting) {
   normalv = Vector(0, 0, -1);
   light = LightPoint(Point(0, 10, -10), Color::WHITE());
   result = m.lighting(light, position, eyev, normalv, in_shadow);
-  EXPECT_EQ(result, Color(1.6364, 1.6364, 1.6364));
+  EXPECT_COLOR_EQ(result, Color(1.6364, 1.6364, 1.6364));
   result = lighting(m, light, position, eyev, normalv, in_shadow);
-  EXPECT_EQ(result, Color(1.6364, 1.6364, 1.6364));
+  EXPECT_COLOR_EQ(result, Color(1.6364, 1.6364, 1.6364));
 
   // Lighting with the light behind the surface.
   eyev = Vector(0, 0, -1);
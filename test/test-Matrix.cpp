@@ -5,6 +5,7 @@
 #include <string>
 #include <sstream>
 #include <tuple>
+#include <type_traits>
 
 using namespace ratrac;
 using namespace testing;
@@ -58,6 +59,37 @@ TEST(Matrix, init) {
   EXPECT_EQ(M.rows(), 2);
 }
 
+TEST(Matrix, storage) {
+  // Matrices have inline storage: they are trivially copyable, and can be
+  // computed at compile time.
+  EXPECT_TRUE(std::is_trivially_copyable<Matrix>::value);
+  EXPECT_EQ(sizeof(Matrix), 16 * sizeof(Matrix::DataType) + 2 * sizeof(unsigned));
+
+  constexpr Matrix I = Matrix::identity();
+  static_assert(I(0, 0) == 1 && I(0, 1) == 0 && I(3, 3) == 1,
+                "constexpr identity");
+  constexpr Matrix T =
+      Matrix::translation(1, 2, 3) * Matrix::scaling(2, 4, 8);
+  static_assert(T(0, 0) == 2 && T(1, 1) == 4 && T(2, 2) == 8,
+                "constexpr scaling");
+  static_assert(T(0, 3) == 1 && T(1, 3) == 2 && T(2, 3) == 3,
+                "constexpr translation");
+  constexpr Matrix M({{1, 2}, {3, 4}});
+  static_assert(M.rows() == 2 && M.columns() == 2 && M(1, 0) == 3,
+                "constexpr initializer list");
+  EXPECT_EQ(T, Matrix({{2, 0, 0, 1}, {0, 4, 0, 2}, {0, 0, 8, 3}, {0, 0, 0, 1}}));
+
+  // Copies are independent.
+  Matrix A = Matrix::identity();
+  Matrix B = A;
+  B.set(0, 0, 5);
+  EXPECT_EQ(A(0, 0), 1);
+  EXPECT_EQ(B(0, 0), 5);
+  A = B;
+  B.set(0, 0, 6);
+  EXPECT_EQ(A(0, 0), 5);
+}
+
 TEST(Matrix, output) {
   Matrix M({{1.0f, 1.0f, 1.0f, 1.0f},
              {1.0f, 1.0f, 1.0f, 1.0f},
@@ -264,6 +296,68 @@ TEST(Matrix, other_stuff) {
   EXPECT_TRUE((M3 * M2.inverse()).approximatly_equal(M));
 }
 
+TEST(Matrix, inverse_variants) {
+  const Matrix general[] = {
+      {{-5, 2, 6, -8}, {1, -5, 1, 8}, {7, 7, -6, -7}, {1, -3, 7, 4}},
+      {{8, -5, 9, 2}, {7, 5, 6, 1}, {-6, 0, 9, 6}, {-3, 0, -9, -4}},
+      {{9, 3, 0, 9}, {-5, -2, -6, -3}, {-4, 9, 6, 4}, {-7, 6, 6, 2}},
+      {{3, -9, 7, 3}, {3, -8, 2, -9}, {-4, 4, 4, 1}, {-6, 5, -1, 1}}};
+  for (const Matrix &M : general) {
+    EXPECT_FALSE(M.is_affine());
+    Matrix A = M;
+    Matrix B = M;
+    EXPECT_TRUE(A.inverse_4x4().approximatly_equal(B.inverse_cofactors()));
+    EXPECT_TRUE((M * inverse(M)).approximatly_equal(Matrix::identity()));
+  }
+
+  const Matrix affine[] = {
+      Matrix::identity(),
+      Matrix::translation(5, -3, 2),
+      Matrix::scaling(2, 3, 4).rotate_x(M_PI / 3).translate(1, 2, 3),
+      Matrix::shearing(1, 0, 0.5, 0, 0, 2).rotate_y(M_PI / 5).scale(1, 2, 3),
+      {{2, 0.5, 0, 3}, {1, 3, -1, -2}, {0, 1, 4, 5}, {0, 0, 0, 1}}};
+  for (const Matrix &M : affine) {
+    EXPECT_TRUE(M.is_affine());
+    Matrix A = M;
+    Matrix B = M;
+    Matrix C = M;
+    Matrix Inv = A.inverse_affine();
+    EXPECT_TRUE(Inv.approximatly_equal(B.inverse_cofactors()));
+    EXPECT_TRUE(Inv.approximatly_equal(C.inverse_4x4()));
+    EXPECT_TRUE(Inv.is_affine());
+    EXPECT_TRUE((M * Inv).approximatly_equal(Matrix::identity()));
+  }
+
+  // Only 4x4 matrices can be affine transformations.
+  EXPECT_FALSE(Matrix({{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}).is_affine());
+
+  // Uniform scalings followed by translations.
+  Matrix::DataType scale = 0;
+  EXPECT_TRUE(Matrix::identity().is_uniform_scaling_translation(scale));
+  EXPECT_EQ(scale, 1);
+  EXPECT_TRUE(Matrix::scaling(0.5, 0.5, 0.5)
+                  .translate(1, 2, 3)
+                  .is_uniform_scaling_translation(scale));
+  EXPECT_EQ(scale, 0.5);
+  EXPECT_TRUE(
+      Matrix::scaling(-2, -2, -2).is_uniform_scaling_translation(scale));
+  EXPECT_EQ(scale, -2);
+  EXPECT_FALSE(Matrix::scaling(1, 2, 1).is_uniform_scaling_translation(scale));
+  EXPECT_FALSE(Matrix::scaling(0, 0, 0).is_uniform_scaling_translation(scale));
+  EXPECT_FALSE(
+      Matrix::rotation_y(M_PI / 5).is_uniform_scaling_translation(scale));
+  EXPECT_FALSE(Matrix::shearing(1, 0, 0, 0, 0, 0)
+                   .is_uniform_scaling_translation(scale));
+  EXPECT_FALSE(general[0].is_uniform_scaling_translation(scale));
+  EXPECT_EQ(scale, -2);
+  // The closed form determinant matches the one from the cofactors.
+  const Matrix M = {{-2, -8, 3, 5}, {-3, 1, 7, 3}, {1, 2, -9, 6}, {-6, 7, 7, -9}};
+  Matrix::DataType det = 0;
+  for (unsigned col = 0; col < 4; col++)
+    det += M.at(0, col) * M.cofactor(0, col);
+  EXPECT_EQ(M.determinant(), det);
+}
+
 TEST(Matrix, transformations) {
   // Translation matrix
   // ==================
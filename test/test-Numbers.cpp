@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/Numbers.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::string;
+
+namespace {
+bool parse(const string &text, double &value) {
+  return parse_number(text.data(), text.data() + text.size(), value) ==
+         text.data() + text.size();
+}
+} // namespace
+
+TEST(Numbers, parse_number) {
+  double v;
+  EXPECT_TRUE(parse("0", v));
+  EXPECT_EQ(v, 0);
+  EXPECT_TRUE(parse("-12", v));
+  EXPECT_EQ(v, -12);
+  EXPECT_TRUE(parse("+.5", v));
+  EXPECT_EQ(v, 0.5);
+  EXPECT_TRUE(parse("3.", v));
+  EXPECT_EQ(v, 3);
+  EXPECT_TRUE(parse("-2.5e-3", v));
+  EXPECT_EQ(v, -0.0025);
+  EXPECT_TRUE(parse("1E+2", v));
+  EXPECT_EQ(v, 100);
+  EXPECT_TRUE(parse("1e400", v));
+  EXPECT_TRUE(std::isinf(v));
+
+  // Not numbers.
+  for (const char *text : {"", "-", ".", "e5", "x1", "1e", "1e+"}) {
+    const string s(text);
+    EXPECT_EQ(parse_number(s.data(), s.data() + s.size(), v), nullptr) << s;
+  }
+
+  // The number ends where the text stops being one.
+  const string s = "1.5,2";
+  EXPECT_EQ(parse_number(s.data(), s.data() + s.size(), v), s.data() + 3);
+  EXPECT_EQ(v, 1.5);
+}
+
+TEST(Numbers, rounding) {
+  // The numbers are read exactly as strtod reads them, in particular the
+  // doubles printed with all their digits.
+  std::mt19937_64 random(42);
+  for (unsigned i = 0; i < 10000; i++) {
+    double expected;
+    const uint64_t bits = random();
+    std::memcpy(&expected, &bits, sizeof(expected));
+    if (!std::isfinite(expected))
+      continue;
+    char text[64];
+    std::snprintf(text, sizeof(text), i % 2 ? "%.17g" : "%.9g", expected);
+    double v;
+    ASSERT_TRUE(parse(text, v)) << text;
+    EXPECT_EQ(v, std::strtod(text, nullptr)) << text;
+  }
+  for (const char *text :
+       {"1.5707963267948966", "-0.39269908169872414", "123456789012345678901",
+        "0.30000000000000004", "2.2250738585072014e-308", "4.9e-324"}) {
+    double v;
+    ASSERT_TRUE(parse(text, v)) << text;
+    EXPECT_EQ(v, std::strtod(text, nullptr)) << text;
+  }
+}
@@ -0,0 +1,216 @@
+#include "gtest/gtest.h"
+#include "test-ratrac.h"
+
+#include "ratrac/OBJ.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/World.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::string;
+using std::vector;
+
+namespace {
+bool parse(const string &text, OBJMesh &mesh, unsigned threads = 1,
+           string *error = nullptr) {
+  return parse_obj(text.data(), text.data() + text.size(), mesh, threads,
+                   error);
+}
+} // namespace
+
+TEST(OBJ, vertices) {
+  // Comments, unknown statements and blank lines are ignored.
+  OBJMesh mesh;
+  ASSERT_TRUE(parse("# A comment\n"
+                    "mtllib scene.mtl\n"
+                    "\n"
+                    "v -1 1 0\n"
+                    "  v\t-1.0000 0.5000 0.0000\r\n"
+                    "vt 0.5 0.5\n"
+                    "v 1 0 0 1.0\n"
+                    "v 1e1 -2.5E-1 +.5",
+                    mesh));
+  ASSERT_EQ(mesh.vertices.size(), 4);
+  EXPECT_EQ(mesh.vertices[0], Point(-1, 1, 0));
+  EXPECT_EQ(mesh.vertices[1], Point(-1, 0.5, 0));
+  EXPECT_EQ(mesh.vertices[2], Point(1, 0, 0));
+  EXPECT_EQ(mesh.vertices[3], Point(10, -0.25, 0.5));
+  EXPECT_EQ(mesh.num_faces(), 0);
+  EXPECT_TRUE(mesh.normals.empty());
+
+  // The numbers are read exactly as strtod would.
+  for (const char *number :
+       {"0.1", "-3.14159265358979", "123456.789e-3", "6.02214076e23", "0.000001"}) {
+    ASSERT_TRUE(parse(string("v ") + number + " 0 0\n", mesh));
+    EXPECT_EQ(mesh.vertices[0].x(),
+              Tuple::DataType(std::strtod(number, nullptr)));
+  }
+}
+
+TEST(OBJ, faces) {
+  // Polygons are triangulated as fans, and negative indices refer to the
+  // last vertices.
+  OBJMesh mesh;
+  ASSERT_TRUE(parse("v -1 1 0\n"
+                    "v -1 0 0\n"
+                    "v 1 0 0\n"
+                    "v 1 1 0\n"
+                    "v 0 2 0\n"
+                    "g polygon\n"
+                    "f 1 2 3 4 5\n"
+                    "f -3 -2 -1\n"
+                    "f 1/1 2/2 3/3\n",
+                    mesh));
+  EXPECT_EQ(mesh.num_faces(), 5);
+  EXPECT_EQ(mesh.indices, vector<unsigned>({0, 1, 2, 0, 2, 3, 0, 3, 4, 2, 3,
+                                            4, 0, 1, 2}));
+  EXPECT_TRUE(mesh.normals.empty());
+}
+
+TEST(OBJ, normals) {
+  // Vertices have the normal their faces give them.
+  OBJMesh mesh;
+  ASSERT_TRUE(parse("v 0 1 0\n"
+                    "v -1 0 0\n"
+                    "v 1 0 0\n"
+                    "vn -1 0 0\n"
+                    "vn 1 0 0\n"
+                    "vn 0 1 0\n"
+                    "f 1//3 2//1 3//2\n",
+                    mesh));
+  EXPECT_EQ(mesh.vertices.size(), 3);
+  EXPECT_EQ(mesh.indices, vector<unsigned>({0, 1, 2}));
+  EXPECT_EQ(mesh.normals, vector<Tuple>({Vector(0, 1, 0), Vector(-1, 0, 0),
+                                         Vector(1, 0, 0)}));
+
+  // Vertices used with different normals are duplicated.
+  ASSERT_TRUE(parse("v 0 0 0\n"
+                    "v 1 0 0\n"
+                    "v 0 1 0\n"
+                    "v 0 0 1\n"
+                    "vn 0 0 1\n"
+                    "vn 1 0 0\n"
+                    "f 1/1/1 2/2/1 3/3/1\n"
+                    "f 1//2 3//2 4//2\n",
+                    mesh));
+  EXPECT_EQ(mesh.vertices.size(), 6);
+  EXPECT_EQ(mesh.normals.size(), 6);
+  EXPECT_EQ(mesh.indices, vector<unsigned>({0, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(mesh.vertices[3], Point(0, 0, 0));
+  EXPECT_EQ(mesh.normals[0], Vector(0, 0, 1));
+  EXPECT_EQ(mesh.normals[3], Vector(1, 0, 0));
+
+  // Normals are dropped if some faces do not have them.
+  ASSERT_TRUE(parse("v 0 0 0\n"
+                    "v 1 0 0\n"
+                    "v 0 1 0\n"
+                    "vn 0 0 1\n"
+                    "f 1//1 2//1 3//1\n"
+                    "f 1 3 2\n",
+                    mesh));
+  EXPECT_EQ(mesh.vertices.size(), 3);
+  EXPECT_TRUE(mesh.normals.empty());
+}
+
+TEST(OBJ, errors) {
+  OBJMesh mesh;
+  string error;
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 x 0\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 2: expecting a number");
+  EXPECT_FALSE(parse("v 0 0\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 1: expecting a number");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1 2\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 3: faces need at least 3 vertices");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\n\nf 1 2 4\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 4: vertex index out of range");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1 2 -3\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 3: vertex index out of range");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1 2 0\n", mesh, 1, &error));
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1 2 2a\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 3: malformed face vertex");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1//1 2 1\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 3: normal index out of range");
+  EXPECT_FALSE(parse("v 0 0 0\nv 1 0 0\nf 1/ 2 1\n", mesh, 1, &error));
+  EXPECT_EQ(error, "line 3: expecting a texture index");
+  EXPECT_TRUE(mesh.vertices.empty());
+
+  // An empty file is an empty mesh.
+  EXPECT_TRUE(parse("", mesh));
+  EXPECT_TRUE(mesh.vertices.empty());
+}
+
+TEST(OBJ, parallel) {
+  // A large file parsed in chunks gives the same mesh as sequentially, with
+  // relative indices crossing chunk boundaries.
+  std::ostringstream os;
+  const unsigned n = 200;
+  for (unsigned j = 0; j <= n; j++) {
+    for (unsigned i = 0; i <= n; i++)
+      os << "v " << i << " 0." << (i * j) % 10 << ' ' << j << '\n';
+    os << "vn 0 1 " << j << '\n';
+    if (j == 0)
+      continue;
+    for (unsigned i = 0; i < n; i++)
+      os << "f " << (j - 1) * (n + 1) + i + 1 << "//-2 -" << n + 1 - i
+         << "//-1 -" << n - i << "//-1 " << (j - 1) * (n + 1) + i + 2
+         << "//-2\n";
+  }
+  const string text = os.str();
+  ASSERT_GT(text.size(), 1024 * 1024);
+
+  OBJMesh expected, mesh;
+  ASSERT_TRUE(parse(text, expected));
+  EXPECT_EQ(expected.vertices.size(), (n + 1) * (n + 1));
+  EXPECT_EQ(expected.num_faces(), 2 * n * n);
+  EXPECT_EQ(expected.normals.size(), expected.vertices.size());
+  EXPECT_EQ(expected.vertices[n + 2], Point(1, 0.1, 1));
+  EXPECT_EQ(expected.normals[n + 2], Vector(0, 1, 1));
+  for (unsigned threads : {2, 3, 8}) {
+    ASSERT_TRUE(parse(text, mesh, threads));
+    EXPECT_EQ(mesh.vertices, expected.vertices);
+    EXPECT_EQ(mesh.indices, expected.indices);
+    EXPECT_EQ(mesh.normals, expected.normals);
+  }
+
+  // And errors are reported with their line.
+  string error;
+  EXPECT_FALSE(parse(text + "f 1 2 x\n", mesh, 4, &error));
+  std::ostringstream line;
+  line << "line " << (n + 1) * (n + 2) + n * n + 1
+       << ": expecting a vertex index";
+  EXPECT_EQ(error, line.str());
+}
+
+TEST(OBJ, files) {
+  const string filename = getTempFile("ratrac-test-OBJ.obj", "v 0 1 0\n"
+                                                             "v -1 0 0\n"
+                                                             "v 1 0 0\n"
+                                                             "f 1 2 3\n");
+  OBJMesh mesh;
+  string error;
+  ASSERT_TRUE(read_obj(filename, mesh, 2, &error));
+  EXPECT_EQ(mesh.vertices.size(), 3);
+  EXPECT_EQ(mesh.num_faces(), 1);
+
+  // The mesh is appended to the world.
+  World world;
+  TriangleMesh *shape = load_obj(world, filename);
+  ASSERT_NE(shape, nullptr);
+  EXPECT_EQ(world.objects().size(), 1);
+  EXPECT_EQ(world.object(0), shape);
+  EXPECT_EQ(shape->num_faces(), 1);
+  EXPECT_EQ(shape->vertex(0, 0), Point(0, 1, 0));
+  std::remove(filename.c_str());
+
+  // Missing files can not be read.
+  EXPECT_FALSE(read_obj(filename, mesh, 1, &error));
+  EXPECT_EQ(error, "can not read " + filename);
+  EXPECT_EQ(load_obj(world, filename), nullptr);
+  EXPECT_EQ(world.objects().size(), 1);
+}
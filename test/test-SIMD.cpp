@@ -0,0 +1,162 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/Matrix.h"
+#include "ratrac/SIMD.h"
+#include "ratrac/Tuple.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+namespace {
+// Values exercising the rounding and the signed zeros, which must be
+// preserved exactly by all the kernel flavors.
+const RayTracerDataType values[] = {
+    0.0, -0.0, 1.0, -1.0, 0.1, -0.3, 1e-8, 3.7e5, -2.5e-3, 7.0 / 3.0};
+const unsigned num_values = sizeof(values) / sizeof(values[0]);
+
+std::vector<Tuple> getTuples() {
+  std::vector<Tuple> tuples;
+  for (unsigned i = 0; i < num_values; i++)
+    for (unsigned j = 0; j < num_values; j += 3)
+      tuples.push_back(Tuple(values[i], values[j], values[(i + j) % num_values],
+                             values[(3 * i + j) % num_values]));
+  return tuples;
+}
+
+bool same_bits(const Tuple &a, const Tuple &b) {
+  return std::memcmp(a.data(), b.data(), 4 * sizeof(Tuple::DataType)) == 0;
+}
+
+bool same_bits(Tuple::DataType a, Tuple::DataType b) {
+  return std::memcmp(&a, &b, sizeof(Tuple::DataType)) == 0;
+}
+} // namespace
+
+TEST(SIMD, constexpr) {
+  constexpr Tuple T = Point(1, 2, 3) + Vector(1, 1, 1) * 2 - Vector(0, 1, 0);
+  static_assert(T.x() == 3 && T.y() == 3 && T.z() == 5 && T.w() == 1,
+                "Tuple arithmetic must be usable in constant expressions");
+  static_assert(dot(Vector(1, 2, 3), Vector(4, 5, 6)) == 32,
+                "Tuple arithmetic must be usable in constant expressions");
+  EXPECT_STRNE(simd::native::name(), "");
+}
+
+TEST(SIMD, tuple_kernels) {
+  const std::vector<Tuple> tuples = getTuples();
+  for (const Tuple &a : tuples)
+    for (const Tuple &b : tuples) {
+      Tuple native = a, scalar = a;
+      native += b;
+      simd::scalar::add4(scalar.data(), b.data());
+      EXPECT_TRUE(same_bits(native, scalar));
+
+      native = a, scalar = a;
+      native -= b;
+      simd::scalar::sub4(scalar.data(), b.data());
+      EXPECT_TRUE(same_bits(native, scalar));
+
+      native = a, scalar = a;
+      native *= b.x();
+      simd::scalar::mul4(scalar.data(), b.x());
+      EXPECT_TRUE(same_bits(native, scalar));
+
+      native = a, scalar = a;
+      native /= b.y();
+      simd::scalar::div4(scalar.data(), b.y());
+      EXPECT_TRUE(same_bits(native, scalar));
+
+      EXPECT_TRUE(
+          same_bits(a.dot(b), simd::scalar::dot4(a.data(), b.data())));
+    }
+}
+
+TEST(SIMD, matrix_kernels) {
+  const std::vector<Tuple> tuples = getTuples();
+  const Matrix matrices[] = {
+      Matrix::identity(),
+      Matrix::translation(0.1, -0.3, 7.0 / 3.0),
+      Matrix::rotation_x(0.3).rotate_y(1.1).scale(0.5, 2, -3),
+      {{-5, 2, 6, -8}, {1, -5, 1, 8}, {7, 7, -6, -7}, {1, -3, 7, 4}},
+      {{-0.0, 0.1, 1e-8, 3.7e5},
+       {-2.5e-3, -0.0, 0.0, -1.0},
+       {0.3, 0.7, -0.0, 1.0},
+       {0.0, 0.0, -0.0, 1.0}}};
+  for (const Matrix &M : matrices)
+    for (const Tuple &T : tuples) {
+      Tuple scalar;
+      simd::scalar::matvec4(M.data(), T.data(), scalar.data());
+      EXPECT_TRUE(same_bits(M * T, scalar));
+    }
+}
+
+TEST(SIMD, slab_kernels) {
+  // 4 boxes, the last one being empty, against rays along the axes or not,
+  // starting inside, outside or on the boxes' planes.
+  typedef RayTracerDataType DataType;
+  const float inf = std::numeric_limits<float>::infinity();
+  const float min[3][4] = {
+      {-1, 0.5f, 2, inf}, {-1, -0.1f, 0, inf}, {-1, 0, -3, inf}};
+  const float max[3][4] = {
+      {1, 1.5f, 3, -inf}, {1, 0.1f, 1e-3f, -inf}, {1, 2, 4, -inf}};
+  const DataType inf_t = std::numeric_limits<DataType>::infinity();
+  unsigned hits = 0;
+  for (unsigned i = 0; i < num_values; i++)
+    for (unsigned j = 0; j < num_values; j++) {
+      const DataType origin[3] = {values[i], values[j] * 2, -values[i] * 3};
+      const DataType direction[3] = {values[j], values[(i + j) % num_values],
+                                     values[(3 * i + 1) % num_values]};
+      DataType inv_direction[3];
+      const float *near[3], *far[3];
+      for (unsigned a = 0; a < 3; a++) {
+        inv_direction[a] = DataType(1) / direction[a];
+        near[a] = inv_direction[a] < 0 ? max[a] : min[a];
+        far[a] = inv_direction[a] < 0 ? min[a] : max[a];
+      }
+      for (DataType tmin : {DataType(0), -inf_t}) {
+        DataType t0[4] = {tmin, tmin, tmin, tmin};
+        DataType t1[4] = {inf_t, inf_t, 10, inf_t};
+        DataType scalar_t0[4], scalar_t1[4];
+        std::memcpy(scalar_t0, t0, sizeof(t0));
+        std::memcpy(scalar_t1, t1, sizeof(t1));
+        const unsigned mask = simd::native::slab4(near, far, origin,
+                                                  inv_direction, t0, t1);
+        EXPECT_EQ(mask, simd::scalar::slab4(near, far, origin, inv_direction,
+                                            scalar_t0, scalar_t1));
+        for (unsigned b = 0; b < 4; b++) {
+          EXPECT_TRUE(same_bits(t0[b], scalar_t0[b]));
+          EXPECT_TRUE(same_bits(t1[b], scalar_t1[b]));
+        }
+        EXPECT_EQ(mask & 8, 0);
+        for (unsigned b = 0; b < 4; b++)
+          hits += (mask >> b) & 1;
+      }
+    }
+  EXPECT_GT(hits, 50);
+}
+
+TEST(SIMD, intersect_sphere) {
+  typedef RayTracerDataType DataType;
+  // A ray going through the center of the unit sphere.
+  const DataType origin[4] = {0, 0, -5, 1}, direction[4] = {0, 0, 1, 0};
+  const DataType center[4] = {0, 0, 0, 1};
+  const DataType one = 1, two = 2;
+  DataType t1, t2;
+  EXPECT_TRUE(
+      simd::scalar::intersect_sphere(origin, direction, center, one, t1, t2));
+  EXPECT_EQ(t1, 4.0);
+  EXPECT_EQ(t2, 6.0);
+  // Missing it.
+  const DataType above[4] = {0, 2, -5, 1};
+  EXPECT_FALSE(
+      simd::scalar::intersect_sphere(above, direction, center, one, t1, t2));
+  // And through the center of a sphere of radius 2.
+  const DataType center2[4] = {0, 2, 0, 1};
+  EXPECT_TRUE(
+      simd::scalar::intersect_sphere(above, direction, center2, two, t1, t2));
+  EXPECT_EQ(t1, 3.0);
+  EXPECT_EQ(t2, 7.0);
+}
@@ -0,0 +1,494 @@
+#include "gtest/gtest.h"
+#include "test-ratrac.h"
+
+#include "ratrac/Instance.h"
+#include "ratrac/Patterns.h"
+#include "ratrac/Scene.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::string;
+
+namespace {
+bool parse(const string &text, Scene &scene, string *error = nullptr) {
+  return parse_scene(text.data(), text.data() + text.size(), scene, error);
+}
+
+string parseError(const string &text) {
+  Scene scene;
+  string error;
+  EXPECT_FALSE(parse(text, scene, &error)) << text;
+  return error;
+}
+
+// Materials compare equal whatever their patterns are.
+bool samePattern(const Material &m, const Pattern &expected) {
+  return m.pattern() && typeid(*m.pattern()) == typeid(expected) &&
+         std::string(*m.pattern()) == std::string(expected);
+}
+} // namespace
+
+TEST(Scene, camera_and_lights) {
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("- add: camera\n"
+                    "  width: 100\n"
+                    "  height: 50\n"
+                    "  field-of-view: 0.785\n"
+                    "  from: [ -6, 6, -10 ]\n"
+                    "  to: [ 6, 0, 6 ]\n"
+                    "  up: [ -0.45, 1, 0 ]\n"
+                    "- add: light\n"
+                    "  at: [ 50, 100, -50 ]\n"
+                    "  intensity: [ 1, 1, 1 ]\n"
+                    "- add: light\n"
+                    "  at: [ -400, 50, -10 ]\n"
+                    "  intensity: [ 0.2, 0.2, 0.2 ]\n",
+                    scene, &error))
+      << error;
+  ASSERT_NE(scene.camera, nullptr);
+  EXPECT_EQ(scene.camera->hsize(), 100);
+  EXPECT_EQ(scene.camera->vsize(), 50);
+  EXPECT_EQ(scene.camera->field_of_view(), RayTracerDataType(0.785));
+  EXPECT_TRUE(sameMatrix(scene.camera->transform(),
+                         view_transform(Point(-6, 6, -10), Point(6, 0, 6),
+                                        Vector(-0.45, 1, 0))));
+  ASSERT_EQ(scene.world.lights().size(), 2);
+  EXPECT_EQ(scene.world.lights()[0],
+            LightPoint(Point(50, 100, -50), Color(1, 1, 1)));
+  EXPECT_EQ(scene.world.lights()[1],
+            LightPoint(Point(-400, 50, -10), Color(0.2, 0.2, 0.2)));
+  EXPECT_TRUE(scene.world.objects().empty());
+
+  // Empty descriptions are empty scenes.
+  Scene empty;
+  EXPECT_TRUE(parse("", empty));
+  EXPECT_TRUE(parse("# Nothing yet.\n\n", empty));
+  EXPECT_EQ(empty.camera, nullptr);
+}
+
+TEST(Scene, shapes) {
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("- add: sphere\n"
+                    "- add: plane\n"
+                    "  transform:\n"
+                    "    - [ translate, 0, -1, 0 ]\n"
+                    "- add: triangle\n"
+                    "  p1: [0, 1, 0]\n"
+                    "  p2: [-1, 0, 0]\n"
+                    "  p3: [1, 0, 0]\n",
+                    scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.objects().size(), 3);
+  EXPECT_EQ(*scene.world.object(0), Sphere());
+  EXPECT_EQ(typeid(*scene.world.object(1)), typeid(Plane));
+  EXPECT_TRUE(sameMatrix(scene.world.object(1)->transform(),
+                         Matrix::translation(0, -1, 0)));
+  const Triangle *t = dynamic_cast<const Triangle *>(scene.world.object(2));
+  ASSERT_NE(t, nullptr);
+  EXPECT_EQ(t->p1(), Point(0, 1, 0));
+  EXPECT_EQ(t->p2(), Point(-1, 0, 0));
+  EXPECT_EQ(t->p3(), Point(1, 0, 0));
+}
+
+TEST(Scene, transforms) {
+  // The transforms apply in the order they are listed, and their product is
+  // evaluated as in C++.
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("- define: standard-transform\n"
+                    "  value:\n"
+                    "    - [ translate, 1, -1, 1 ]\n"
+                    "    - [ scale, 0.5, 0.5, 0.5 ]\n"
+                    "- define: large-object\n"
+                    "  value:\n"
+                    "    - standard-transform\n"
+                    "    - [ scale, 3.5, 3.5, 3.5 ]\n"
+                    "- add: sphere\n"
+                    "  transform:\n"
+                    "    - [ scale, 0.2, 0.3, 0.4 ]\n"
+                    "    - [ rotate-z, 0.5 ]\n"
+                    "    - [ rotate-y, 0.6 ]\n"
+                    "    - [ rotate-x, 0.7 ]\n"
+                    "    - [ shear, 1, 2, 3, 4, 5, 6 ]\n"
+                    "    - [ translate, 7, 8, 9 ]\n"
+                    "- add: sphere\n"
+                    "  transform:\n"
+                    "    - large-object\n"
+                    "    - [ translate, 4, 0, 0 ]\n",
+                    scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.objects().size(), 2);
+  EXPECT_TRUE(sameMatrix(
+      scene.world.object(0)->transform(),
+      Matrix::translation(7, 8, 9) * Matrix::shearing(1, 2, 3, 4, 5, 6) *
+          Matrix::rotation_x(0.7) * Matrix::rotation_y(0.6) *
+          Matrix::rotation_z(0.5) * Matrix::scaling(0.2, 0.3, 0.4)));
+  EXPECT_TRUE(sameMatrix(scene.world.object(1)->transform(),
+                         Matrix::translation(4, 0, 0) *
+                             (Matrix::scaling(3.5, 3.5, 3.5) *
+                              (Matrix::scaling(0.5, 0.5, 0.5) *
+                               Matrix::translation(1, -1, 1)))));
+}
+
+TEST(Scene, materials) {
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("- define: white-material\n"
+                    "  value:\n"
+                    "    color: [ 1, 1, 1 ]\n"
+                    "    diffuse: 0.7\n"
+                    "    ambient: 0.1\n"
+                    "    specular: 0.0\n"
+                    "    reflective: 0.1\n"
+                    "- define: blue-material\n"
+                    "  extend: white-material\n"
+                    "  value:\n"
+                    "    color: [ 0.537, 0.831, 0.914 ]\n"
+                    "- add: sphere\n"
+                    "  material: blue-material\n"
+                    "- add: sphere\n"
+                    "  material:\n"
+                    "    color: [ 0.373, 0.404, 0.550 ]\n"
+                    "    shininess: 50\n"
+                    "- add: sphere\n"
+                    "  material: white-material\n",
+                    scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.objects().size(), 3);
+  EXPECT_EQ(scene.world.object(0)->material(),
+            Material()
+                .color(Color(0.537, 0.831, 0.914))
+                .diffuse(0.7)
+                .ambient(0.1)
+                .specular(0));
+  EXPECT_EQ(scene.world.object(1)->material(),
+            Material().color(Color(0.373, 0.404, 0.550)).shininess(50));
+  EXPECT_EQ(scene.world.object(2)->material(),
+            Material()
+                .color(Color::WHITE())
+                .diffuse(0.7)
+                .ambient(0.1)
+                .specular(0));
+}
+
+TEST(Scene, patterns) {
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse(
+      "- add: plane\n"
+      "  material:\n"
+      "    pattern:\n"
+      "      type: stripes\n"
+      "      colors: [[1, 0, 0], [0, 1, 0]]\n"
+      "      transform: [[scale, 0.2, 1, 1]]\n"
+      "- add: plane\n"
+      "  material:\n"
+      "    pattern: {type: gradient, colors: [[1, 0, 0], [0, 0, 1]]}\n"
+      "- add: plane\n"
+      "  material: {pattern: {type: rings, colors: [[1, 0, 0], [0, 0, 1]]}}\n"
+      "- add: plane\n"
+      "  material: {pattern: {type: checkers,\n"
+      "                       colors: [[1, 1, 1], [0, 0, 0]]}}\n"
+      "- add: plane\n"
+      "  material:\n"
+      "    pattern: {type: radial-gradient,\n"
+      "              colors: [[1, 1, 1], [0, 0, 0]]}\n"
+      "- add: plane\n"
+      "  material:\n"
+      "    pattern:\n"
+      "      type: checkers\n"
+      "      transform: [[rotate-y, 0.3]]\n"
+      "      patterns:\n"
+      "        - type: stripes\n"
+      "          colors: [[1, 0, 0], [0, 1, 0]]\n"
+      "          transform: [[scale, 0.2, 1, 1]]\n"
+      "        - type: blend\n"
+      "          patterns:\n"
+      "          - {type: rings, colors: [[1, 1, 1], [0, 0, 0]]}\n"
+      "          - {type: gradient, colors: [[0, 0, 1], [1, 1, 0]]}\n",
+      scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.objects().size(), 6);
+  const Color red(1, 0, 0), green(0, 1, 0), blue(0, 0, 1);
+  EXPECT_TRUE(samePattern(scene.world.object(0)->material(),
+                          Stripes(red, green, Matrix::scaling(0.2, 1, 1))));
+  EXPECT_TRUE(samePattern(scene.world.object(1)->material(),
+                          Gradient(red, blue)));
+  EXPECT_TRUE(
+      samePattern(scene.world.object(2)->material(), Ring(red, blue)));
+  EXPECT_TRUE(samePattern(scene.world.object(3)->material(),
+                          ColorCheckers(Color::WHITE(), Color::BLACK())));
+  EXPECT_TRUE(samePattern(scene.world.object(4)->material(),
+                          RadialGradient(Color::WHITE(), Color::BLACK())));
+
+  const PatternCheckers expected(
+      new Stripes(red, green, Matrix::scaling(0.2, 1, 1)),
+      new PatternBlender(new Ring(Color::WHITE(), Color::BLACK()),
+                         new Gradient(blue, Color(1, 1, 0))),
+      Matrix::rotation_y(0.3));
+  const Material &m5 = scene.world.object(5)->material();
+  EXPECT_TRUE(samePattern(m5, expected));
+  for (int i = -5; i < 5; i++) {
+    const Tuple p = Point(0.3 * i, 0.1 * i, 0.7 * i);
+    EXPECT_EQ(m5.at(p), expected.at(p));
+  }
+}
+
+TEST(Scene, instances) {
+  // Adding a defined shape adds an instance of it.
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("- define: ball\n"
+                    "  value:\n"
+                    "    add: sphere\n"
+                    "    transform: [[scale, 0.5, 0.5, 0.5]]\n"
+                    "    material: {color: [1, 0, 0]}\n"
+                    "- define: balls\n"
+                    "  value:\n"
+                    "    add: ball\n"
+                    "    transform: [[translate, 0, 1, 0]]\n"
+                    "- add: ball\n"
+                    "  transform: [[translate, 1, 0, 0]]\n"
+                    "- add: ball\n"
+                    "  material: {color: [0, 0, 1]}\n"
+                    "- add: balls\n",
+                    scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.objects().size(), 3);
+  const Instance *a = dynamic_cast<const Instance *>(scene.world.object(0));
+  const Instance *b = dynamic_cast<const Instance *>(scene.world.object(1));
+  const Instance *c = dynamic_cast<const Instance *>(scene.world.object(2));
+  ASSERT_TRUE(a && b && c);
+  EXPECT_EQ(&a->prototype(), &b->prototype());
+  EXPECT_TRUE(sameMatrix(a->prototype().transform(),
+                         Matrix::scaling(0.5, 0.5, 0.5)));
+  EXPECT_TRUE(sameMatrix(a->transform(), Matrix::translation(1, 0, 0)));
+  EXPECT_EQ(a->material().color(), Color(1, 0, 0));
+  EXPECT_EQ(b->material().color(), Color(0, 0, 1));
+  const Instance *balls = dynamic_cast<const Instance *>(&c->prototype());
+  ASSERT_NE(balls, nullptr);
+  EXPECT_EQ(&balls->prototype(), &a->prototype());
+  EXPECT_TRUE(sameMatrix(balls->transform(), Matrix::translation(0, 1, 0)));
+
+  EXPECT_EQ(parseError("- define: ball\n"
+                       "  extend: ball\n"
+                       "  value: {add: sphere}\n"),
+            "line 2: only materials can be extended");
+  EXPECT_EQ(parseError("- define: ball\n"
+                       "  value: {add: sphere, file: ball.obj}\n"),
+            "line 2: unknown key 'file'");
+}
+
+TEST(Scene, syntax) {
+  // Comments, document markers, quoted scalars, flow nodes over several lines
+  // and sequences indented as their key are supported.
+  Scene scene;
+  string error;
+  ASSERT_TRUE(parse("---\n"
+                    "# The lights.\n"
+                    "  - add: light   # The key light.\n"
+                    "    at: [ 1, 2,  # Over\n"
+                    "          3 ]    # several lines.\n"
+                    "    intensity: [\n"
+                    "      1, 1, 1\n"
+                    "      ]\r\n"
+                    "\n",
+                    scene, &error))
+      << error;
+  ASSERT_EQ(scene.world.lights().size(), 1);
+  EXPECT_EQ(scene.world.lights()[0],
+            LightPoint(Point(1, 2, 3), Color::WHITE()));
+
+  Scene scene2;
+  ASSERT_TRUE(parse("---\n"
+                    "# The shapes.\r\n"
+                    "  - add: 'sphere'\r\n"
+                    "    transform:\n"
+                    "    - [ \"translate\", 1, 2, 3 ]\n"
+                    "    -\n"
+                    "      - scale\n"
+                    "      - 2\n"
+                    "      - 2\n"
+                    "      - 2\n"
+                    "    material: { color: [1, 0.5, 0.25],\n"
+                    "                diffuse: 0.5 }\n"
+                    "\t\n"
+                    "  -   add: sphere\n"
+                    "...\n",
+                    scene2, &error))
+      << error;
+  ASSERT_EQ(scene2.world.objects().size(), 2);
+  EXPECT_TRUE(sameMatrix(scene2.world.object(0)->transform(),
+                         Matrix::scaling(2, 2, 2) *
+                             Matrix::translation(1, 2, 3)));
+  EXPECT_EQ(scene2.world.object(0)->material(),
+            Material().color(Color(1, 0.5, 0.25)).diffuse(0.5));
+}
+
+TEST(Scene, errors) {
+  // YAML errors.
+  EXPECT_EQ(parseError("add: sphere\n"),
+            "line 1: expecting a sequence of items");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "   material: {}\n"),
+            "line 2: bad indentation");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "\ttransform: []\n"),
+            "line 2: tabs can not indent");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: [[scale, 1, 2, 3]\n"),
+            "line 3: unterminated flow sequence");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: [[scale, 1, 2, 3] [scale, 1, 2, 3]]\n"),
+            "line 2: expecting ',' or ']'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material: {color}\n"),
+            "line 2: expecting a key");
+  EXPECT_EQ(parseError("- add: 'sphere\n"), "line 1: unterminated string");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material: color: [1, 1, 1]\n"),
+            "line 2: mappings must start on their own line");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "-\n"),
+            "line 2: expecting a value");
+
+  // Scene errors.
+  EXPECT_EQ(parseError("- [ add, sphere ]\n"), "line 1: expecting a mapping");
+  EXPECT_EQ(parseError("- material: sphere\n"),
+            "line 1: expecting 'add' or 'define'");
+  EXPECT_EQ(parseError("- add: cube\n"), "line 1: unknown item 'cube'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  shadow: false\n"),
+            "line 2: unknown key 'shadow'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  p1: [0, 0, 0]\n"),
+            "line 2: unknown key 'p1'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: []\n"
+                       "  transform: []\n"),
+            "line 3: duplicate key 'transform'");
+  EXPECT_EQ(parseError("- add: light\n"
+                       "  at: [0, 0, 0]\n"),
+            "line 1: missing key 'intensity'");
+  EXPECT_EQ(parseError("- add: light\n"
+                       "  at: [0, 0]\n"
+                       "  intensity: [1, 1, 1]\n"),
+            "line 2: expecting [x, y, z]");
+  EXPECT_EQ(parseError("- add: light\n"
+                       "  at: [0, zero, 0]\n"
+                       "  intensity: [1, 1, 1]\n"),
+            "line 2: expecting a number");
+  EXPECT_EQ(parseError("- add: camera\n"
+                       "  width: 100.5\n"
+                       "  height: 50\n"
+                       "  field-of-view: 0.785\n"
+                       "  from: [0, 0, -5]\n"
+                       "  to: [0, 0, 0]\n"
+                       "  up: [0, 1, 0]\n"),
+            "line 2: expecting an image size");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: [[translate, 1, 2]]\n"),
+            "line 2: 'translate' expects 3 arguments");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: [[rotate, 1]]\n"),
+            "line 2: unknown transform 'rotate'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  transform: [large-object]\n"),
+            "line 2: unknown transform 'large-object'");
+  EXPECT_EQ(parseError("- define: m\n"
+                       "  value: {diffuse: 0.5}\n"
+                       "- add: sphere\n"
+                       "  transform: [m]\n"),
+            "line 4: unknown transform 'm'");
+  EXPECT_EQ(parseError("- define: m\n"
+                       "  value: {diffuse: 0.5}\n"
+                       "- define: m\n"
+                       "  value: {diffuse: 0.7}\n"),
+            "line 3: 'm' is already defined");
+  EXPECT_EQ(parseError("- define: m\n"
+                       "  extend: base\n"
+                       "  value: {diffuse: 0.5}\n"),
+            "line 2: unknown material 'base'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material: {glow: 1}\n"),
+            "line 2: unknown key 'glow'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material:\n"
+                       "    pattern: {type: waves, colors: [[0, 0, 0], [1, "
+                       "1, 1]]}\n"),
+            "line 3: unknown pattern type 'waves'");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material:\n"
+                       "    pattern: {type: stripes, colors: [[0, 0, 0]]}\n"),
+            "line 3: expecting 2 colors");
+  EXPECT_EQ(parseError("- add: sphere\n"
+                       "  material:\n"
+                       "    pattern: {type: blend}\n"),
+            "line 3: missing key 'patterns'");
+  EXPECT_EQ(parseError("- add: camera\n"
+                       "  width: 100\n"
+                       "  height: 50\n"
+                       "  field-of-view: 0.785\n"
+                       "  from: [0, 0, -5]\n"
+                       "  to: [0, 0, 0]\n"
+                       "  up: [0, 1, 0]\n"
+                       "- add: camera\n"
+                       "  width: 100\n"
+                       "  height: 50\n"
+                       "  field-of-view: 0.785\n"
+                       "  from: [0, 0, -5]\n"
+                       "  to: [0, 0, 0]\n"
+                       "  up: [0, 1, 0]\n"),
+            "line 8: the scene already has a camera");
+}
+
+TEST(Scene, files) {
+  const string obj = getTempFile("ratrac-test-Scene.obj", "v 0 0 0\n"
+                                                          "v 1 0 0\n"
+                                                          "v 0 1 0\n"
+                                                          "f 1 2 3\n");
+  const string filename = getTempFile(
+      "ratrac-test-Scene.yml",
+      "- add: obj\n"
+      "  file: " +
+          std::filesystem::path(obj).filename().string() +
+          "\n"
+          "  transform: [[translate, 0, 0, 5]]\n"
+          "  material: {color: [1, 0, 0]}\n");
+
+  // OBJ files are relative to the scene description.
+  Scene scene;
+  string error;
+  ASSERT_TRUE(read_scene(filename, scene, &error)) << error;
+  ASSERT_EQ(scene.world.objects().size(), 1);
+  const TriangleMesh *mesh =
+      dynamic_cast<const TriangleMesh *>(scene.world.object(0));
+  ASSERT_NE(mesh, nullptr);
+  EXPECT_EQ(mesh->num_faces(), 1);
+  EXPECT_TRUE(
+      sameMatrix(mesh->transform(), Matrix::translation(0, 0, 5)));
+  EXPECT_EQ(mesh->material().color(), Color(1, 0, 0));
+
+  std::remove(obj.c_str());
+  Scene missing_obj;
+  EXPECT_FALSE(read_scene(filename, missing_obj, &error));
+  EXPECT_EQ(error, filename + ": line 2: can not read " +
+                       (std::filesystem::path(filename).parent_path() /
+                        std::filesystem::path(obj).filename())
+                           .string());
+
+  std::remove(filename.c_str());
+  Scene missing;
+  EXPECT_FALSE(read_scene(filename, missing, &error));
+  EXPECT_EQ(error, "can not read " + filename);
+}
@@ -0,0 +1,252 @@
+#include "gtest/gtest.h"
+#include "test-ratrac.h"
+
+#include "ratrac/Instance.h"
+#include "ratrac/Patterns.h"
+#include "ratrac/SceneCache.h"
+#include "ratrac/Shapes.h"
+#include "ratrac/Triangles.h"
+#include "ratrac/World.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::string;
+using std::vector;
+
+namespace {
+string readFile(const string &filename) {
+  std::ifstream is(filename, std::ios::binary);
+  return string(std::istreambuf_iterator<char>(is),
+                std::istreambuf_iterator<char>());
+}
+
+// A world with all the shape and pattern types, and enough objects to have a
+// BVH.
+World getWorld() {
+  World world;
+  world.lights().push_back(LightPoint(Point(-10, 10, -10), Color::WHITE()));
+  world.lights().push_back(LightPoint(Point(5, 8, -3), Color(0.2, 0.3, 0.4)));
+
+  Plane *floor = new Plane();
+  floor->material().pattern(PatternCheckers(
+      new Stripes(Color(1, 0, 0), Color(0, 1, 0), Matrix::scaling(0.2, 1, 1)),
+      new PatternBlender(new Ring(Color::WHITE(), Color::BLACK()),
+                         new Gradient(Color(0, 0, 1), Color(1, 1, 0))),
+      Matrix::rotation_y(0.3)));
+  world.append(floor);
+
+  for (unsigned i = 0; i < 20; i++) {
+    Sphere *s = new Sphere();
+    s->transform(Matrix::translation(i % 5 - 2, 1 + i / 5, 0.5 * i) *
+                 Matrix::rotation_z(0.1 * i) *
+                 Matrix::scaling(0.3, 0.3 + 0.01 * i, 0.3));
+    s->material().color(Color(0.1 * (i % 10), 0.5, 0.2)).shininess(50 + i);
+    if (i % 3 == 0)
+      s->material().pattern(ColorCheckers(Color::WHITE(), Color(0, 0.5, 0)));
+    if (i % 4 == 0)
+      s->material().pattern(RadialGradient(Color::BLACK(), Color::WHITE(),
+                                           Matrix::scaling(2, 2, 2)));
+    world.append(s);
+  }
+
+  world.append(new Triangle(Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0)));
+  Triangle *smooth = new Triangle(Point(0, 2, 1), Point(-1, 0, 1),
+                                  Point(1, 0, 1), Vector(0, 1, 0),
+                                  Vector(-1, 0, 0), Vector(1, 0, 0));
+  smooth->transform(Matrix::rotation_x(0.2));
+  world.append(smooth);
+
+  // Instances of a sphere, and of an instance of it.
+  std::shared_ptr<Sphere> prototype = std::make_shared<Sphere>();
+  prototype->transform(Matrix::scaling(0.5, 0.25, 0.5));
+  prototype->material().pattern(Stripes(Color::WHITE(), Color(1, 0, 0)));
+  std::shared_ptr<Instance> nested =
+      std::make_shared<Instance>(prototype, Matrix::rotation_x(0.5));
+  for (unsigned i = 0; i < 3; i++) {
+    Instance *instance = new Instance(prototype, Matrix::translation(i, 4, 2));
+    if (i == 2)
+      instance->material().color(Color(0.2, 0.3, 0.9));
+    world.append(instance);
+  }
+  world.append(new Instance(nested, Matrix::translation(-2, 4, 2)));
+
+  vector<Tuple> vertices, normals;
+  vector<unsigned> indices;
+  const unsigned n = 10;
+  for (unsigned j = 0; j <= n; j++)
+    for (unsigned i = 0; i <= n; i++) {
+      vertices.push_back(Point(i, 0.1 * ((i + j) % 3), j));
+      normals.push_back(normalize(Vector(0.1 * (i % 2), 1, 0)));
+    }
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned i = 0; i < n; i++) {
+      const unsigned v = j * (n + 1) + i;
+      indices.insert(indices.end(), {v, v + 1, v + n + 2, v, v + n + 2,
+                                     v + n + 1});
+    }
+  TriangleMesh *mesh = new TriangleMesh(vertices, indices, normals);
+  mesh->transform(Matrix::translation(-5, 0.5, -5) *
+                  Matrix::scaling(0.5, 1, 1));
+  world.append(mesh);
+
+  return world;
+}
+} // namespace
+
+TEST(SceneCache, round_trip) {
+  const string filename = getTempFilename("ratrac-test-SceneCache.cache");
+  const World expected = getWorld();
+  string error;
+  ASSERT_TRUE(save_scene(expected, filename, &error)) << error;
+
+  World world;
+  world.append(new Sphere());
+  ASSERT_TRUE(load_scene(world, filename, &error)) << error;
+  std::remove(filename.c_str());
+
+  EXPECT_EQ(world.lights(), expected.lights());
+  ASSERT_EQ(world.objects().size(), expected.objects().size());
+  for (unsigned i = 0; i < world.objects().size(); i++) {
+    const Shape *s = world.object(i);
+    const Shape *e = expected.object(i);
+    EXPECT_EQ(typeid(*s), typeid(*e));
+    EXPECT_EQ(std::string(*s), std::string(*e));
+    EXPECT_TRUE(sameMatrix(s->transform(), e->transform()));
+    EXPECT_TRUE(sameMatrix(s->inverse_transform(), e->inverse_transform()));
+    if (e->world_bounds().is_finite()) {
+      EXPECT_EQ(s->world_bounds(), e->world_bounds());
+    }
+  }
+  const TriangleMesh *mesh =
+      static_cast<const TriangleMesh *>(world.objects().back().get());
+  EXPECT_TRUE(mesh->smooth());
+  EXPECT_EQ(mesh->num_faces(), 200);
+  EXPECT_EQ(mesh->bvh().nodes().size(),
+            static_cast<const TriangleMesh *>(expected.objects().back().get())
+                ->bvh()
+                .nodes()
+                .size());
+
+  // The prototypes are shared again.
+  const Instance *instances[4];
+  for (unsigned i = 0; i < 4; i++) {
+    instances[i] = dynamic_cast<const Instance *>(
+        world.object(world.objects().size() - 5 + i));
+    ASSERT_NE(instances[i], nullptr);
+  }
+  EXPECT_EQ(&instances[0]->prototype(), &instances[1]->prototype());
+  EXPECT_EQ(&instances[0]->prototype(), &instances[2]->prototype());
+  EXPECT_EQ(instances[0]->shared_prototype().use_count(), 4);
+  const Instance &nested =
+      dynamic_cast<const Instance &>(instances[3]->prototype());
+  EXPECT_EQ(&nested.prototype(), &instances[0]->prototype());
+  // As are their materials, except for the instance with its own.
+  EXPECT_EQ(&instances[0]->material(), &instances[0]->prototype().material());
+  EXPECT_TRUE(instances[2]->has_own_material());
+  EXPECT_EQ(instances[2]->material().color(), Color(0.2, 0.3, 0.9));
+
+  // The world's BVH is the saved one.
+  ASSERT_NE(world.bvh(), nullptr);
+  EXPECT_EQ(world.bvh()->indices(), expected.bvh()->indices());
+
+  // And the loaded world renders like the original one.
+  for (unsigned j = 0; j < 20; j++)
+    for (unsigned i = 0; i < 20; i++) {
+      const Ray r(Point(0, 5, -10),
+                  normalize(Vector(0.05 * i - 0.5, 0.04 * j - 0.6, 1)));
+      const Intersection hit = world.closest_hit(r);
+      const Intersection expected_hit = expected.closest_hit(r);
+      EXPECT_EQ(hit.t, expected_hit.t);
+      if (!hit.object || !expected_hit.object) {
+        EXPECT_EQ(hit.object, expected_hit.object);
+        continue;
+      }
+      const Tuple p = position(r, hit.t);
+      EXPECT_EQ(hit.object->at(p), expected_hit.object->at(p));
+      EXPECT_EQ(hit.object->normal_at(p, hit),
+                expected_hit.object->normal_at(p, expected_hit));
+    }
+}
+
+TEST(SceneCache, small_world) {
+  // Worlds without a BVH are saved too.
+  const string filename = getTempFilename("ratrac-test-SceneCache.cache");
+  const World expected = World::get_default();
+  ASSERT_EQ(expected.bvh(), nullptr);
+  ASSERT_TRUE(save_scene(expected, filename));
+  World world;
+  ASSERT_TRUE(load_scene(world, filename));
+  std::remove(filename.c_str());
+  EXPECT_EQ(world.lights(), expected.lights());
+  ASSERT_EQ(world.objects().size(), 2);
+  EXPECT_EQ(*world.object(0), *expected.object(0));
+  EXPECT_EQ(*world.object(1), *expected.object(1));
+  EXPECT_EQ(world.bvh(), nullptr);
+}
+
+TEST(SceneCache, errors) {
+  const string filename = getTempFilename("ratrac-test-SceneCache.cache");
+  std::remove(filename.c_str());
+  World world = World::get_default();
+  string error;
+
+  // Missing files.
+  EXPECT_FALSE(load_scene(world, filename, &error));
+  EXPECT_EQ(error, "can not read " + filename);
+  EXPECT_EQ(world.objects().size(), 2);
+
+  // Shapes this library does not know can not be saved.
+  class MySphere : public Sphere {};
+  World unsupported;
+  unsupported.append(new MySphere());
+  EXPECT_FALSE(save_scene(unsupported, filename, &error));
+  EXPECT_EQ(error.substr(0, filename.size() + 15),
+            filename + ": can not save ");
+  EXPECT_FALSE(std::filesystem::exists(filename));
+
+  // Files which are not caches, or not caches for this build.
+  writeFile(filename, "v 0 0 0\n");
+  EXPECT_FALSE(load_scene(world, filename, &error));
+  EXPECT_EQ(error, filename + ": not a scene cache");
+
+  ASSERT_TRUE(save_scene(getWorld(), filename));
+  const string cache = readFile(filename);
+  string other_version = cache;
+  const uint32_t version = SCENE_CACHE_VERSION + 1;
+  std::memcpy(&other_version[8], &version, sizeof(version));
+  writeFile(filename, other_version);
+  EXPECT_FALSE(load_scene(world, filename, &error));
+  EXPECT_EQ(error, filename + ": unsupported scene cache version " +
+                       std::to_string(version));
+
+  string other_precision = cache;
+  other_precision[12] ^= 12;
+  writeFile(filename, other_precision);
+  EXPECT_FALSE(load_scene(world, filename, &error));
+  EXPECT_EQ(error, filename + ": scene cache saved with a different precision "
+                              "or byte order");
+
+  // Truncated or damaged caches are detected.
+  for (size_t size : {size_t(30), cache.size() / 2, cache.size() - 1}) {
+    writeFile(filename, cache.substr(0, size));
+    EXPECT_FALSE(load_scene(world, filename, &error));
+    EXPECT_EQ(error, filename + ": corrupted scene cache");
+  }
+  writeFile(filename, cache + "x");
+  EXPECT_FALSE(load_scene(world, filename, &error));
+  EXPECT_EQ(error, filename + ": corrupted scene cache");
+
+  // The world was left untouched.
+  EXPECT_EQ(world.objects().size(), 2);
+  std::remove(filename.c_str());
+}
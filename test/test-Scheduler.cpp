@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "ratrac/Scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::atomic;
+using std::ostringstream;
+using std::vector;
+
+TEST(Scheduler, base) {
+  // All tasks are executed exactly once.
+  TaskScheduler S(4);
+  EXPECT_EQ(S.workers(), 4);
+  vector<atomic<unsigned>> executed(100);
+  for (unsigned i = 0; i < executed.size(); i++)
+    S.push(i % S.workers(), [&executed, i](unsigned) { executed[i]++; });
+  S.run();
+  size_t tasks = 0;
+  for (unsigned w = 0; w < S.workers(); w++)
+    tasks += S.stats(w).tasks;
+  EXPECT_EQ(tasks, executed.size());
+  for (const auto &e : executed)
+    EXPECT_EQ(e, 1);
+
+  // A scheduler with a single worker runs everything on the calling thread.
+  TaskScheduler S1(1);
+  unsigned count = 0;
+  for (unsigned i = 0; i < 10; i++)
+    S1.push(0, [&count](unsigned worker) {
+      EXPECT_EQ(worker, 0);
+      count++;
+    });
+  S1.run();
+  EXPECT_EQ(count, 10);
+  EXPECT_EQ(S1.stats(0).tasks, 10);
+  EXPECT_EQ(S1.total_steals(), 0);
+}
+
+TEST(Scheduler, nested) {
+  // Tasks can push more tasks while the scheduler is running.
+  TaskScheduler S(3);
+  atomic<unsigned> count(0);
+  for (unsigned i = 0; i < 8; i++)
+    S.push(0, [&](unsigned worker) {
+      count++;
+      for (unsigned j = 0; j < 4; j++)
+        S.push(worker, [&](unsigned) { count++; });
+    });
+  S.run();
+  EXPECT_EQ(count, 8 * 5);
+}
+
+TEST(Scheduler, stealing) {
+  // All the work is given to worker 0: the other workers have to steal it.
+  TaskScheduler S(2);
+  for (unsigned i = 0; i < 50; i++)
+    S.push(0, [](unsigned) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+  S.run();
+  EXPECT_EQ(S.stats(0).tasks + S.stats(1).tasks, 50);
+  EXPECT_EQ(S.stats(1).steals, S.stats(1).tasks);
+  EXPECT_EQ(S.stats(0).steals, 0);
+  EXPECT_GT(S.total_steals(), 0);
+  EXPECT_GT(S.stats(0).busy, 0.0);
+
+  ostringstream oss;
+  oss << S;
+  EXPECT_NE(oss.str().find("worker 1: "), std::string::npos);
+}
@@ -0,0 +1,224 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/ShapeArrays.h"
+#include "ratrac/Shapes.h"
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+// A shape without a dedicated array: a slab of thickness 1 along x.
+struct Slab : public Shape {
+  Slab() : Shape() { update(); }
+
+  virtual Intersections local_intersect(const Ray &r) const override {
+    if (r.direction().x() == 0)
+      return Intersections();
+    return Intersections(
+        Intersection((-0.5 - r.origin().x()) / r.direction().x(), this),
+        Intersection((0.5 - r.origin().x()) / r.direction().x(), this));
+  }
+
+  virtual Tuple local_normal_at(const Tuple &local_point) const override {
+    return Vector(local_point.x(), 0, 0);
+  }
+};
+
+// A sphere which is not one for the arrays: it is intersected through the
+// default Shape queries.
+struct OddSphere : public Sphere {
+  virtual bool local_closest_hit(const Ray &r,
+                                 Intersection &hit) const override {
+    return Shape::local_closest_hit(r, hit);
+  }
+  virtual void local_closest_hit(const RayPacket &rays, unsigned mask,
+                                 PacketHits &hits) const override {
+    Shape::local_closest_hit(rays, mask, hits);
+  }
+  virtual bool local_occludes(const Ray &r,
+                              RayTracerDataType max_t) const override {
+    return Shape::local_occludes(r, max_t);
+  }
+};
+
+// Boxes can be infinite, which BoundingBox::operator== does not handle.
+bool same_box(const BoundingBox &a, const BoundingBox &b) {
+  for (unsigned i = 0; i < 3; i++)
+    if (a.min()[i] != b.min()[i] || a.max()[i] != b.max()[i])
+      return false;
+  return true;
+}
+
+vector<unique_ptr<Shape>> getShapes() {
+  vector<unique_ptr<Shape>> shapes;
+  shapes.emplace_back(new Plane());
+  shapes.back()->transform(Matrix::translation(0, -1, 0));
+  shapes.emplace_back(new Sphere());
+  shapes.back()->transform(Matrix::translation(-1, 0, 2));
+  shapes.emplace_back(new Slab());
+  shapes.back()->transform(Matrix::translation(3, 0, 0));
+  shapes.emplace_back(new Sphere());
+  shapes.back()->transform(Matrix::translation(1, 0.5, 4) *
+                           Matrix::scaling(1, 2, 1));
+  shapes.emplace_back(new OddSphere());
+  shapes.back()->transform(Matrix::translation(0, 3, 0));
+  shapes.emplace_back(new Plane());
+  shapes.back()->transform(Matrix::translation(0, 5, 0));
+  return shapes;
+}
+
+vector<const Shape *> getPointers(const vector<unique_ptr<Shape>> &shapes) {
+  vector<const Shape *> pointers;
+  for (const auto &s : shapes)
+    pointers.push_back(s.get());
+  return pointers;
+}
+
+vector<Ray> getRays() {
+  vector<Ray> rays;
+  for (int y = -2; y <= 6; y++)
+    for (int x = -4; x <= 4; x++)
+      rays.push_back(Ray(Point(0, 1, -5), normalize(Vector(x, y - 1, 5))));
+  rays.push_back(Ray(Point(-5, 0, 2), Vector(1, 0, 0)));
+  rays.push_back(Ray(Point(0, 0, 0), Vector(0, 1, 0)));
+  return rays;
+}
+} // namespace
+
+TEST(ShapeArrays, base) {
+  ShapeArrays empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.size(), 0);
+
+  // Shapes are grouped by type, planes first, keeping their order within each
+  // type. Shapes derived from Sphere or Plane are not handled as such.
+  const vector<unique_ptr<Shape>> shapes = getShapes();
+  ShapeArrays arrays(getPointers(shapes));
+  EXPECT_FALSE(arrays.empty());
+  ASSERT_EQ(arrays.size(), 6);
+  EXPECT_EQ(arrays.num_spheres(), 2);
+  EXPECT_EQ(arrays.num_planes(), 2);
+  EXPECT_EQ(arrays.num_others(), 2);
+  const unsigned order[] = {0, 5, 1, 3, 2, 4};
+  for (unsigned i = 0; i < arrays.size(); i++) {
+    EXPECT_EQ(arrays.shape(i), shapes[order[i]].get());
+    EXPECT_TRUE(same_box(arrays.bounds(i), shapes[order[i]]->world_bounds()));
+  }
+}
+
+TEST(ShapeArrays, update) {
+  // The arrays tell where each shape went, and take a new snapshot of a
+  // shape's geometry when asked to.
+  vector<unique_ptr<Shape>> shapes = getShapes();
+  vector<unsigned> primitives;
+  ShapeArrays arrays(getPointers(shapes), &primitives);
+  ASSERT_EQ(primitives.size(), shapes.size());
+  for (unsigned i = 0; i < shapes.size(); i++)
+    EXPECT_EQ(arrays.shape(primitives[i]), shapes[i].get());
+
+  for (unsigned i = 0; i < shapes.size(); i++) {
+    shapes[i]->transform(Matrix::translation(0.5, 0.25, 0) *
+                         shapes[i]->transform());
+    arrays.update(primitives[i]);
+  }
+  const ShapeArrays expected(getPointers(shapes));
+  for (unsigned i = 0; i < arrays.size(); i++)
+    EXPECT_TRUE(same_box(arrays.bounds(i), expected.bounds(i)));
+  const RayTracerDataType inf =
+      std::numeric_limits<RayTracerDataType>::infinity();
+  unsigned found = 0;
+  for (const Ray &r : getRays()) {
+    Intersection hit(inf, nullptr), expected_hit(inf, nullptr);
+    arrays.closest_hit(r, hit);
+    expected.closest_hit(r, expected_hit);
+    EXPECT_EQ(hit, expected_hit);
+    found += hit.object != nullptr;
+  }
+  EXPECT_GT(found, 10);
+}
+
+TEST(ShapeArrays, queries) {
+  // The queries give the same results as the shapes' own.
+  const vector<unique_ptr<Shape>> shapes = getShapes();
+  ShapeArrays arrays(getPointers(shapes));
+  const RayTracerDataType inf =
+      std::numeric_limits<RayTracerDataType>::infinity();
+  unsigned found = 0;
+  for (const Ray &r : getRays()) {
+    Intersection all(inf, nullptr);
+    Intersections xs;
+    bool occluded = false;
+    for (unsigned i = 0; i < arrays.size(); i++) {
+      const Shape *s = arrays.shape(i);
+      Intersection expected(2.5, nullptr), hit(2.5, nullptr);
+      s->closest_hit(r, expected);
+      arrays.closest_hit(i, r, hit);
+      EXPECT_EQ(hit, expected);
+      EXPECT_EQ(arrays.occludes(i, r, 6), s->occludes(r, 6));
+
+      s->closest_hit(r, all);
+      xs.add(s->intersect(r));
+      occluded |= s->occludes(r, 6);
+    }
+
+    Intersection hit(inf, nullptr);
+    arrays.closest_hit(r, hit);
+    EXPECT_EQ(hit, all);
+    found += hit.object != nullptr;
+
+    Intersections arrays_xs;
+    arrays.intersect(r, arrays_xs);
+    ASSERT_EQ(arrays_xs.count(), xs.count());
+    for (unsigned i = 0; i < xs.count(); i++)
+      EXPECT_EQ(arrays_xs[i].t, xs[i].t);
+
+    EXPECT_EQ(arrays.occluded(r, 6), occluded);
+  }
+  EXPECT_GT(found, 40);
+}
+
+TEST(ShapeArrays, packet_queries) {
+  // Packet queries give each active lane the single ray query result.
+  const vector<unique_ptr<Shape>> shapes = getShapes();
+  ShapeArrays arrays(getPointers(shapes));
+  const vector<Ray> rays = getRays();
+  const unsigned mask = 0xB7;
+  for (unsigned first = 0; first + RayPacket::SIZE <= rays.size();
+       first += RayPacket::SIZE) {
+    RayPacket packet;
+    for (unsigned i = 0; i < RayPacket::SIZE; i++)
+      packet.set(i, rays[first + i]);
+
+    PacketHits hits;
+    arrays.closest_hit(packet, mask, hits);
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      if (!(mask & (1U << i))) {
+        EXPECT_EQ(hits.object[i], nullptr);
+        continue;
+      }
+      Intersection expected(std::numeric_limits<RayTracerDataType>::infinity(),
+                            nullptr);
+      arrays.closest_hit(packet.ray(i), expected);
+      EXPECT_EQ(hits.hit(i), expected);
+    }
+
+    for (unsigned prim = 0; prim < arrays.size(); prim++) {
+      PacketHits prim_hits;
+      arrays.closest_hit(prim, packet, mask, prim_hits);
+      for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+        Intersection expected(
+            std::numeric_limits<RayTracerDataType>::infinity(), nullptr);
+        if (mask & (1U << i))
+          arrays.shape(prim)->closest_hit(packet.ray(i), expected);
+        EXPECT_EQ(prim_hits.hit(i), expected);
+      }
+    }
+  }
+}
@@ -2,6 +2,7 @@
 
 #include "ratrac/Shapes.h"
 
+#include <limits>
 #include <memory>
 #include <sstream>
 
@@ -296,3 +297,223 @@ TEST(Shapes, normal) {
   EXPECT_EQ(n2, Vector(0, 1, 0));
   EXPECT_EQ(n3, Vector(0, 1, 0));
 }
+
+TEST(Shapes, bounds) {
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+
+  // Shapes are unbounded by default.
+  TestShape t;
+  EXPECT_FALSE(t.bounds().is_finite());
+  EXPECT_FALSE(t.world_bounds().is_finite());
+
+  // A sphere has a bounding box.
+  Sphere s;
+  EXPECT_EQ(s.bounds(), BoundingBox(Point(-1, -1, -1), Point(1, 1, 1)));
+  EXPECT_EQ(s.world_bounds(), s.bounds());
+
+  // The world bounds follow the sphere's transformations.
+  s.transform(Matrix::translation(1, -3, 5) * Matrix::scaling(0.5, 2, 4));
+  EXPECT_EQ(s.bounds(), BoundingBox(Point(-1, -1, -1), Point(1, 1, 1)));
+  EXPECT_EQ(s.world_bounds(), BoundingBox(Point(0.5, -5, 1), Point(1.5, -1, 9)));
+  Sphere s2(s);
+  EXPECT_EQ(s2.world_bounds(), s.world_bounds());
+
+  // A plane has an infinite, flat, bounding box.
+  Plane p;
+  EXPECT_EQ(p.bounds().min().y(), 0);
+  EXPECT_EQ(p.bounds().max().y(), 0);
+  EXPECT_EQ(p.bounds().min().x(), -inf);
+  EXPECT_EQ(p.bounds().max().z(), inf);
+  EXPECT_FALSE(p.world_bounds().is_finite());
+}
+
+TEST(Shapes, occludes) {
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+
+  // A ray through a sphere.
+  Sphere s;
+  Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+  EXPECT_TRUE(s.occludes(r, inf));
+  EXPECT_TRUE(s.occludes(r, 4.5));
+  EXPECT_FALSE(s.occludes(r, 4));
+
+  // A ray originating inside a sphere.
+  r = Ray(Point(0, 0, 0), Vector(0, 0, 1));
+  EXPECT_TRUE(s.occludes(r, inf));
+  EXPECT_FALSE(s.occludes(r, 1));
+
+  // A sphere behind a ray, and a ray missing a sphere.
+  EXPECT_FALSE(s.occludes(Ray(Point(0, 0, 5), Vector(0, 0, 1)), inf));
+  EXPECT_FALSE(s.occludes(Ray(Point(0, 2, -5), Vector(0, 0, 1)), inf));
+
+  // The shape's transformation is taken into account.
+  s.transform(Matrix::translation(5, 0, 0));
+  EXPECT_FALSE(s.occludes(Ray(Point(0, 0, -5), Vector(0, 0, 1)), inf));
+  EXPECT_TRUE(s.occludes(Ray(Point(5, 0, -5), Vector(0, 0, 1)), inf));
+
+  // A plane.
+  Plane p;
+  EXPECT_TRUE(p.occludes(Ray(Point(0, 1, 0), Vector(0, -1, 0)), 2));
+  EXPECT_FALSE(p.occludes(Ray(Point(0, 1, 0), Vector(0, -1, 0)), 1));
+  EXPECT_FALSE(p.occludes(Ray(Point(0, 1, 0), Vector(0, 1, 0)), inf));
+  EXPECT_FALSE(p.occludes(Ray(Point(0, 1, 0), Vector(0, 0, 1)), inf));
+
+  // Shapes without a dedicated occlusion test use their intersections.
+  struct TwoHits : public TestShape {
+    virtual Intersections local_intersect(const Ray &r) const override {
+      return Intersections(Intersection(-1, this), Intersection(2, this));
+    }
+  } t;
+  EXPECT_TRUE(t.occludes(r, 3));
+  EXPECT_FALSE(t.occludes(r, 2));
+}
+
+TEST(Shapes, closest_hit) {
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+
+  // A ray through a sphere hits it at its first intersection.
+  Sphere s;
+  Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+  Intersection hit(inf, nullptr);
+  EXPECT_TRUE(s.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(4, s));
+
+  // Hits further than the current one are ignored.
+  hit = Intersection(3, nullptr);
+  EXPECT_FALSE(s.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(3, nullptr));
+
+  // A ray originating inside a sphere hits it on the way out.
+  r = Ray(Point(0, 0, 0), Vector(0, 0, 1));
+  hit = Intersection(inf, nullptr);
+  EXPECT_TRUE(s.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(1, s));
+
+  // A sphere behind a ray.
+  r = Ray(Point(0, 0, 5), Vector(0, 0, 1));
+  hit = Intersection(inf, nullptr);
+  EXPECT_FALSE(s.closest_hit(r, hit));
+  EXPECT_EQ(hit.object, nullptr);
+
+  // The shape's transformation is taken into account.
+  s.transform(Matrix::scaling(2, 2, 2));
+  r = Ray(Point(0, 0, -5), Vector(0, 0, 1));
+  EXPECT_TRUE(s.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(3, s));
+
+  // A plane.
+  Plane p;
+  r = Ray(Point(0, 1, 0), Vector(0, -1, 0));
+  hit = Intersection(inf, nullptr);
+  EXPECT_TRUE(p.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(1, p));
+  r = Ray(Point(0, 1, 0), Vector(0, 1, 0));
+  hit = Intersection(inf, nullptr);
+  EXPECT_FALSE(p.closest_hit(r, hit));
+
+  // Shapes without a dedicated closest hit use their intersections.
+  struct Hits : public TestShape {
+    virtual Intersections local_intersect(const Ray &r) const override {
+      Intersections xs(Intersection(-1, this), Intersection(5, this));
+      xs.add(Intersection(2, this));
+      return xs;
+    }
+  } t;
+  hit = Intersection(inf, nullptr);
+  EXPECT_TRUE(t.closest_hit(r, hit));
+  EXPECT_EQ(hit, Intersection(2, t));
+}
+
+TEST(Shapes, sphere_world_space) {
+  // Spheres only scaled uniformly and translated are intersected in world
+  // space.
+  Sphere s;
+  EXPECT_TRUE(s.world_space());
+  EXPECT_EQ(s.world_center(), Point(0, 0, 0));
+  EXPECT_EQ(s.world_radius(), 1);
+  s.transform(Matrix::translation(1, 2, 3) * Matrix::scaling(2, 2, 2));
+  EXPECT_TRUE(s.world_space());
+  EXPECT_EQ(s.world_center(), Point(1, 2, 3));
+  EXPECT_EQ(s.world_radius(), 2);
+  s.transform(Matrix::scaling(-0.5, -0.5, -0.5));
+  EXPECT_TRUE(s.world_space());
+  EXPECT_EQ(s.world_radius(), 0.5);
+  s.transform(Matrix::scaling(1, 2, 1));
+  EXPECT_FALSE(s.world_space());
+  s.transform(Matrix::rotation_x(M_PI / 4));
+  EXPECT_FALSE(s.world_space());
+
+  // And give the same results as in object space.
+  s.transform(Matrix::translation(0.5, -1, 2) * Matrix::scaling(1.5, 1.5, 1.5));
+  ASSERT_TRUE(s.world_space());
+  RayPacket packet;
+  unsigned found = 0;
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    const Ray r(Point(0.1 * i, 0.3 * i - 1, -5),
+                normalize(Vector(0.2, -0.05 * i, 1)));
+    packet.set(i, r);
+    const Ray local_ray = transform(r, s.inverse_transform());
+    const Intersections xs = s.intersect(r);
+    const Intersections local_xs = s.local_intersect(local_ray);
+    ASSERT_EQ(xs.count(), local_xs.count());
+    for (unsigned j = 0; j < xs.count(); j++)
+      EXPECT_NEAR(xs[j].t, local_xs[j].t, EPSILON<RayTracerDataType>());
+    found += xs.count() > 0;
+
+    Intersection hit(100, nullptr), local_hit(100, nullptr);
+    EXPECT_EQ(s.closest_hit(r, hit), s.local_closest_hit(local_ray, local_hit));
+    EXPECT_NEAR(hit.t, local_hit.t, EPSILON<RayTracerDataType>());
+    EXPECT_EQ(hit.object, local_hit.object);
+    EXPECT_EQ(s.occludes(r, 6), s.local_occludes(local_ray, 6));
+  }
+  EXPECT_GT(found, 3);
+
+  PacketHits hits, local_hits;
+  s.closest_hit(packet, 0xFF, hits);
+  s.local_closest_hit(transform(packet, s.inverse_transform()), 0xFF,
+                      local_hits);
+  for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+    EXPECT_EQ(hits.object[i], local_hits.object[i]);
+    if (hits.object[i]) {
+      EXPECT_NEAR(hits.t[i], local_hits.t[i], EPSILON<RayTracerDataType>());
+    }
+  }
+}
+
+TEST(Shapes, packet_closest_hit) {
+  // Packet queries update each active lane exactly as the single ray query
+  // does, and leave the other lanes alone.
+  Sphere s;
+  s.transform(Matrix::translation(0.5, 0, 0) * Matrix::scaling(2, 1, 1));
+  Sphere ws;
+  ws.transform(Matrix::translation(-1, 1, 0) * Matrix::scaling(2, 2, 2));
+  Plane p;
+  p.transform(Matrix::translation(0, -1, 0));
+  struct Hits : public TestShape {
+    virtual Intersections local_intersect(const Ray &r) const override {
+      return Intersections(Intersection(-r.origin().y(), this),
+                           Intersection(3 - r.origin().y(), this));
+    }
+  } t;
+  const Shape *shapes[] = {&s, &ws, &p, &t};
+
+  RayPacket rays;
+  for (unsigned i = 0; i < RayPacket::SIZE; i++)
+    rays.set(i, Ray(Point(0.5 * i - 2, 2 - 0.5 * i, -5),
+                    normalize(Vector(0, -0.1 * i, 1))));
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+  const unsigned mask = 0xDB;
+  unsigned found = 0;
+  for (const Shape *shape : shapes) {
+    PacketHits hits;
+    hits.t[1] = 4.5;
+    shape->closest_hit(rays, mask, hits);
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      Intersection expected(i == 1 ? 4.5 : inf, nullptr);
+      if (mask & (1U << i))
+        found += shape->closest_hit(rays.ray(i), expected);
+      EXPECT_EQ(hits.hit(i), expected);
+    }
+  }
+  EXPECT_GT(found, 9);
+}
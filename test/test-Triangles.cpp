@@ -0,0 +1,240 @@
+#include "gtest/gtest.h"
+
+#include "ratrac/Intersections.h"
+#include "ratrac/Triangles.h"
+
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::ostringstream;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+// A wavy n x n grid of quads in the XZ plane, over [0:n]x[0:n], each quad
+// being split in 2 faces.
+unique_ptr<TriangleMesh> getGrid(unsigned n, bool smooth) {
+  vector<Tuple> vertices, normals;
+  for (unsigned j = 0; j <= n; j++)
+    for (unsigned i = 0; i <= n; i++) {
+      vertices.push_back(Point(i, 0.25 * ((i + 2 * j) % 3), j));
+      normals.push_back(normalize(Vector(0.1 * (i % 2), 1, 0.1 * (j % 3))));
+    }
+  vector<unsigned> indices;
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned i = 0; i < n; i++) {
+      const unsigned v = j * (n + 1) + i;
+      indices.insert(indices.end(), {v, v + 1, v + n + 2});
+      indices.insert(indices.end(), {v, v + n + 2, v + n + 1});
+    }
+  return unique_ptr<TriangleMesh>(
+      new TriangleMesh(vertices, indices, smooth ? normals : vector<Tuple>()));
+}
+
+vector<Ray> getRays(unsigned n) {
+  vector<Ray> rays;
+  for (unsigned j = 0; j < 4 * n; j++)
+    for (unsigned i = 0; i < 4 * n; i++)
+      rays.push_back(Ray(Point(0.3 * i - 0.5, 2, 0.27 * j - 0.4),
+                         normalize(Vector(0.1, -1, 0.05 * (i % 3)))));
+  // Parallel to the grid, and going through it from below.
+  rays.push_back(Ray(Point(-1, 0.1, 0.5), Vector(1, 0, 0)));
+  rays.push_back(Ray(Point(0.6, -1, 0.3), Vector(0, 1, 0)));
+  return rays;
+}
+} // namespace
+
+TEST(Triangles, triangle) {
+  // Constructing a triangle.
+  const Tuple p1 = Point(0, 1, 0);
+  const Tuple p2 = Point(-1, 0, 0);
+  const Tuple p3 = Point(1, 0, 0);
+  Triangle t(p1, p2, p3);
+  EXPECT_EQ(t.p1(), p1);
+  EXPECT_EQ(t.p2(), p2);
+  EXPECT_EQ(t.p3(), p3);
+  EXPECT_EQ(t.e1(), Vector(-1, -1, 0));
+  EXPECT_EQ(t.e2(), Vector(1, -1, 0));
+  EXPECT_EQ(t.normal(), Vector(0, 0, -1));
+  EXPECT_FALSE(t.smooth());
+
+  // Its normal is the same everywhere.
+  EXPECT_EQ(t.local_normal_at(Point(0, 0.5, 0)), t.normal());
+  EXPECT_EQ(t.local_normal_at(Point(-0.5, 0.75, 0)), t.normal());
+  EXPECT_EQ(t.local_normal_at(Point(0.5, 0.25, 0)), t.normal());
+
+  EXPECT_EQ(t.bounds(), BoundingBox(Point(-1, 0, 0), Point(1, 1, 0)));
+
+  ostringstream os;
+  os << t;
+  EXPECT_EQ(os.str().substr(0, 10), "Triangle {");
+}
+
+TEST(Triangles, triangle_intersect) {
+  Triangle t(Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0));
+  // A ray parallel to the triangle.
+  EXPECT_TRUE(
+      t.local_intersect(Ray(Point(0, -1, -2), Vector(0, 1, 0))).empty());
+  // A ray missing the p1-p3 edge, the p1-p2 edge and the p2-p3 edge.
+  EXPECT_TRUE(
+      t.local_intersect(Ray(Point(1, 1, -2), Vector(0, 0, 1))).empty());
+  EXPECT_TRUE(
+      t.local_intersect(Ray(Point(-1, 1, -2), Vector(0, 0, 1))).empty());
+  EXPECT_TRUE(
+      t.local_intersect(Ray(Point(0, -1, -2), Vector(0, 0, 1))).empty());
+
+  // A ray striking the triangle.
+  const Ray r(Point(0, 0.5, -2), Vector(0, 0, 1));
+  Intersections xs = t.local_intersect(r);
+  ASSERT_EQ(xs.count(), 1);
+  EXPECT_EQ(xs[0].t, 2);
+  EXPECT_EQ(xs[0].object, &t);
+
+  Intersection hit(std::numeric_limits<RayTracerDataType>::infinity(),
+                   nullptr);
+  EXPECT_TRUE(t.local_closest_hit(r, hit));
+  EXPECT_EQ(hit, xs[0]);
+  EXPECT_TRUE(t.local_occludes(r, 3));
+  EXPECT_FALSE(t.local_occludes(r, 2));
+}
+
+TEST(Triangles, smooth_triangle) {
+  Triangle t(Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0), Vector(0, 1, 0),
+             Vector(-1, 0, 0), Vector(1, 0, 0));
+  EXPECT_TRUE(t.smooth());
+  EXPECT_EQ(t.n1(), Vector(0, 1, 0));
+  EXPECT_EQ(t.n2(), Vector(-1, 0, 0));
+  EXPECT_EQ(t.n3(), Vector(1, 0, 0));
+
+  // An intersection with a smooth triangle stores u and v.
+  Intersections xs =
+      t.local_intersect(Ray(Point(-0.2, 0.3, -2), Vector(0, 0, 1)));
+  ASSERT_EQ(xs.count(), 1);
+  EXPECT_TRUE(close_to_equal<RayTracerDataType>(xs[0].u, 0.45));
+  EXPECT_TRUE(close_to_equal<RayTracerDataType>(xs[0].v, 0.25));
+
+  // A smooth triangle uses u and v to interpolate the normal.
+  const Intersection i(1, &t, 0, 0.45, 0.25);
+  EXPECT_EQ(t.normal_at(Point(0, 0, 0), i), Vector(-0.5547, 0.83205, 0));
+
+  // And so do the precomputations.
+  const Ray r(Point(-0.2, 0.3, -2), Vector(0, 0, 1));
+  Computations comps(i, r);
+  EXPECT_EQ(comps.normalv, Vector(-0.5547, 0.83205, 0));
+}
+
+TEST(Triangles, mesh) {
+  unique_ptr<TriangleMesh> mesh = getGrid(3, false);
+  EXPECT_EQ(mesh->num_vertices(), 16);
+  EXPECT_EQ(mesh->num_faces(), 18);
+  EXPECT_FALSE(mesh->smooth());
+  EXPECT_EQ(mesh->bvh().size(), 18);
+  EXPECT_EQ(mesh->bounds(), BoundingBox(Point(0, 0, 0), Point(3, 0.5, 3)));
+  EXPECT_EQ(mesh->vertex(1, 2), Point(0, 0.5, 1));
+
+  // Flat normals are the face normals, which face up here.
+  for (unsigned face = 0; face < mesh->num_faces(); face++) {
+    const Intersection hit(1, mesh.get(), face, 0.2, 0.3);
+    EXPECT_EQ(mesh->local_normal_at(Point(0, 0, 0), hit),
+              mesh->face_normal(face));
+    EXPECT_GT(mesh->face_normal(face).y(), 0);
+  }
+
+  ostringstream os;
+  os << *mesh;
+  EXPECT_EQ(os.str().substr(0, 39), "TriangleMesh { vertices: 16, faces: 18,");
+}
+
+TEST(Triangles, mesh_queries) {
+  // The mesh queries give the same results as its faces as separate
+  // triangles.
+  for (bool smooth : {false, true}) {
+    unique_ptr<TriangleMesh> mesh = getGrid(3, smooth);
+    mesh->transform(Matrix::translation(1, -1, 0.5) *
+                    Matrix::rotation_y(M_PI / 7) * Matrix::scaling(1, 2, 1));
+    vector<unique_ptr<Triangle>> faces;
+    for (unsigned f = 0; f < mesh->num_faces(); f++) {
+      faces.emplace_back(new Triangle(mesh->vertex(f, 0), mesh->vertex(f, 1),
+                                      mesh->vertex(f, 2)));
+      faces.back()->transform(mesh->transform());
+    }
+
+    unsigned found = 0;
+    for (const Ray &r : getRays(3)) {
+      const RayTracerDataType inf =
+          std::numeric_limits<RayTracerDataType>::infinity();
+      Intersection expected(inf, nullptr);
+      Intersections expected_xs;
+      unsigned expected_face = 0;
+      for (unsigned f = 0; f < faces.size(); f++) {
+        if (faces[f]->closest_hit(r, expected))
+          expected_face = f;
+        expected_xs.add(faces[f]->intersect(r));
+      }
+
+      Intersection hit(inf, nullptr);
+      ASSERT_EQ(mesh->closest_hit(r, hit), expected.object != nullptr);
+      EXPECT_EQ(mesh->occludes(r, 100), expected.object != nullptr);
+      Intersections xs = mesh->intersect(r);
+      ASSERT_EQ(xs.count(), expected_xs.count());
+      for (unsigned i = 0; i < xs.count(); i++)
+        EXPECT_EQ(xs[i].t, expected_xs[i].t);
+      if (!expected.object)
+        continue;
+
+      found++;
+      EXPECT_EQ(hit.t, expected.t);
+      EXPECT_EQ(hit.face, expected_face);
+      EXPECT_EQ(hit.u, expected.u);
+      EXPECT_EQ(hit.v, expected.v);
+      EXPECT_FALSE(mesh->occludes(r, hit.t));
+
+      // The normal found without the hit is the normal at the hit.
+      const Tuple point = position(r, hit.t);
+      const Tuple normal = mesh->normal_at(point, hit);
+      EXPECT_EQ(mesh->normal_at(point), normal);
+      if (!smooth) {
+        EXPECT_EQ(normal, faces[expected_face]->normal_at(point));
+      }
+    }
+    EXPECT_GT(found, 50);
+  }
+}
+
+TEST(Triangles, mesh_packet_queries) {
+  // Packet queries give each active lane the single ray query result.
+  unique_ptr<TriangleMesh> mesh = getGrid(5, true);
+  const vector<Ray> rays = getRays(2);
+  const unsigned mask = 0x7D;
+  unsigned found = 0;
+  for (unsigned first = 0; first + RayPacket::SIZE <= rays.size();
+       first += RayPacket::SIZE) {
+    RayPacket packet;
+    for (unsigned i = 0; i < RayPacket::SIZE; i++)
+      packet.set(i, rays[first + i]);
+
+    PacketHits hits;
+    hits.t[2] = 1.5;
+    mesh->closest_hit(packet, mask, hits);
+    for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+      Intersection expected(
+          i == 2 ? 1.5 : std::numeric_limits<RayTracerDataType>::infinity(),
+          nullptr);
+      if (mask & (1U << i))
+        found += mesh->closest_hit(packet.ray(i), expected);
+      const Intersection hit = hits.hit(i);
+      EXPECT_EQ(hit, expected);
+      if (expected.object) {
+        EXPECT_EQ(hit.face, expected.face);
+        EXPECT_EQ(hit.u, expected.u);
+        EXPECT_EQ(hit.v, expected.v);
+      }
+    }
+  }
+  EXPECT_GT(found, 20);
+}
@@ -12,17 +12,17 @@ using std::ostringstream;
 TEST(Tuple, init) {
   // Tuple initialisation.
   Tuple rtt(4.3, -4.2, 3.1, 1.0);
-  EXPECT_EQ(rtt.x(), 4.3);
-  EXPECT_EQ(rtt.y(), -4.2);
-  EXPECT_EQ(rtt.z(), 3.1);
+  EXPECT_EQ(rtt.x(), Tuple::DataType(4.3));
+  EXPECT_EQ(rtt.y(), Tuple::DataType(-4.2));
+  EXPECT_EQ(rtt.z(), Tuple::DataType(3.1));
   EXPECT_EQ(rtt.w(), 1.0);
   EXPECT_TRUE(rtt.isPoint());
   EXPECT_FALSE(rtt.isVector());
 
   rtt = Tuple(4.3, -4.2, 3.1, 0.0);
-  EXPECT_EQ(rtt.x(), 4.3);
-  EXPECT_EQ(rtt.y(), -4.2);
-  EXPECT_EQ(rtt.z(), 3.1);
+  EXPECT_EQ(rtt.x(), Tuple::DataType(4.3));
+  EXPECT_EQ(rtt.y(), Tuple::DataType(-4.2));
+  EXPECT_EQ(rtt.z(), Tuple::DataType(3.1));
   EXPECT_EQ(rtt.w(), 0.0);
   EXPECT_TRUE(rtt.isVector());
   EXPECT_FALSE(rtt.isPoint());
@@ -148,10 +148,10 @@ TEST(Tuple, operations) {
 
   // Advanced tests.
   v = Vector(1.0, 2.0, 3.0);
-  EXPECT_EQ(v.magnitude(), std::sqrt(14));
+  EXPECT_EQ(v.magnitude(), std::sqrt(Tuple::DataType(14)));
   v = Vector(-1.0, -2.0, -3.0);
-  EXPECT_EQ(v.magnitude(), std::sqrt(14));
-  EXPECT_EQ(magnitude(v), std::sqrt(14));
+  EXPECT_EQ(v.magnitude(), std::sqrt(Tuple::DataType(14)));
+  EXPECT_EQ(magnitude(v), std::sqrt(Tuple::DataType(14)));
 
   // Normalizing.
   // ============
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include "ratrac/Wavefront.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace ratrac;
+using namespace testing;
+
+namespace {
+// The default world over a floor, lit by a second light.
+World getWorld() {
+  World w = World::get_default();
+  w.append(new Plane());
+  w.object(2)->transform(Matrix::translation(0, -1, 0));
+  w.lights().push_back(LightPoint(Point(5, 10, -3), Color(0.3, 0.3, 0.5)));
+  return w;
+}
+
+Camera getCamera() {
+  Camera c(23, 19, M_PI / 2.0);
+  c.transform(view_transform(Point(0, 1, -5), Point(0, 0, 0), Vector(0, 1, 0)));
+  return c;
+}
+
+void expect_same(const Ray &actual, const Ray &expected) {
+  for (unsigned c = 0; c < 4; c++) {
+    EXPECT_EQ(actual.origin()[c], expected.origin()[c]);
+    EXPECT_EQ(actual.direction()[c], expected.direction()[c]);
+  }
+}
+} // namespace
+
+TEST(RayQueue, base) {
+  RayQueue q;
+  EXPECT_TRUE(q.empty());
+  const Ray r0(Point(1, 2, 3), Vector(0, 1, 0));
+  const Ray r1(Point(-1, 0, 5), Vector(1, 0, 0));
+  q.push(r0, 10, 3);
+  q.push(r1, 20, 7);
+  ASSERT_EQ(q.size(), 2);
+  expect_same(q.ray(0), r0);
+  expect_same(q.ray(1), r1);
+  EXPECT_EQ(q.origin(2)[1], 5);
+  EXPECT_EQ(q.direction(0)[1], 1);
+  EXPECT_EQ(q.tmax()[1], 20);
+  EXPECT_EQ(q.id()[0], 3);
+
+  // The lanes past the rays get the first one.
+  const RayPacket p = q.packet(1, 1);
+  for (unsigned l = 0; l < RayPacket::SIZE; l++)
+    expect_same(p.ray(l), r1);
+
+  q.resize(3);
+  q.origin(0)[2] = 4;
+  EXPECT_EQ(q.ray(2).origin()[0], 4);
+  q.clear();
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(Wavefront, stages) {
+  const World w = getWorld();
+  Camera c = getCamera();
+  c.packet_size(3, 2);
+  Wavefront wavefront(c, w);
+
+  // The primary rays are those of the camera, packet by packet, clipped to
+  // the block.
+  wavefront.generate(6, 5, 17, 16);
+  const RayQueue &primary = wavefront.primary_rays();
+  ASSERT_EQ(primary.size(), 11 * 11);
+  EXPECT_EQ(primary.id()[0], 5 * 23 + 6);
+  EXPECT_EQ(primary.id()[3], 6 * 23 + 6);
+  EXPECT_EQ(primary.id()[6], 5 * 23 + 9);
+  for (unsigned r = 0; r < primary.size(); r++) {
+    const unsigned x = primary.id()[r] % 23, y = primary.id()[r] / 23;
+    expect_same(primary.ray(r), c.ray_for_pixel(x, y));
+    EXPECT_EQ(primary.tmax()[r],
+              std::numeric_limits<RayTracerDataType>::infinity());
+  }
+
+  // Their hits are the closest ones.
+  wavefront.intersect();
+  ASSERT_EQ(wavefront.hits().size(), primary.size());
+  for (unsigned r = 0; r < primary.size(); r++) {
+    const Intersection hit = w.closest_hit(primary.ray(r));
+    EXPECT_EQ(wavefront.hits()[r].object, hit.object);
+    EXPECT_EQ(wavefront.hits()[r].t, hit.t);
+  }
+
+  // The shadow rays, light by light, are the rays of is_shadowed.
+  wavefront.shade();
+  const size_t n = wavefront.surfaces().size();
+  EXPECT_GT(n, 20);
+  EXPECT_LT(n, primary.size());
+  ASSERT_EQ(wavefront.pixels().size(), n);
+  const RayQueue &shadow = wavefront.shadow_rays();
+  ASSERT_EQ(shadow.size(), 2 * n);
+  for (unsigned i = 0; i < 2; i++)
+    for (unsigned s = 0; s < n; s++) {
+      const Tuple &point = wavefront.surfaces()[s].over_point;
+      const Tuple v = w.light(i)->position() - point;
+      expect_same(shadow.ray(i * n + s), Ray(point, normalize(v)));
+      EXPECT_EQ(shadow.tmax()[i * n + s], magnitude(v));
+      EXPECT_EQ(shadow.id()[i * n + s], s);
+    }
+
+  // Some surfaces are in the shadows, of one light or the other.
+  wavefront.shadow_test();
+  ASSERT_EQ(wavefront.shadowed().size(), 2 * n);
+  unsigned shadowed[2] = {0, 0};
+  for (unsigned i = 0; i < 2; i++)
+    for (unsigned s = 0; s < n; s++) {
+      const Tuple &point = wavefront.surfaces()[s].over_point;
+      EXPECT_EQ(bool(wavefront.shadowed()[i * n + s]),
+                is_shadowed(w, point, i));
+      shadowed[i] += wavefront.shadowed()[i * n + s];
+    }
+  EXPECT_GT(shadowed[0], 0);
+  EXPECT_GT(shadowed[1], 0);
+
+  // The pixels get the colors of color_at, and the other pixels are left
+  // untouched.
+  Canvas image(23, 19);
+  image.at(0, 0) = Color::WHITE();
+  wavefront.accumulate(image);
+  EXPECT_EQ(image.at(0, 0), Color::WHITE());
+  for (unsigned r = 0; r < primary.size(); r++) {
+    const unsigned x = primary.id()[r] % 23, y = primary.id()[r] / 23;
+    const Color expected = color_at(w, c.ray_for_pixel(x, y));
+    EXPECT_EQ(image.at(x, y).red(), expected.red());
+    EXPECT_EQ(image.at(x, y).green(), expected.green());
+    EXPECT_EQ(image.at(x, y).blue(), expected.blue());
+  }
+}
+
+TEST(Wavefront, render) {
+  // The pipeline renders the same image as the camera, bit for bit, whatever
+  // the packet size, reusing its queues from one block to the next.
+  const World w = getWorld();
+  Camera c = getCamera();
+  const Canvas reference = c.render(w, /* verbose: */ false);
+  const unsigned sizes[][2] = {{1, 1}, {4, 2}, {3, 1}};
+  for (const auto &size : sizes) {
+    c.packet_size(size[0], size[1]);
+    Wavefront wavefront(c, w);
+    Canvas image(23, 19);
+    for (unsigned y = 0; y < 19; y += 5)
+      wavefront.render(image, 0, y, 23, std::min(y + 5, 19U));
+    for (unsigned y = 0; y < image.height(); y++)
+      for (unsigned x = 0; x < image.width(); x++) {
+        EXPECT_EQ(image.at(x, y).red(), reference.at(x, y).red());
+        EXPECT_EQ(image.at(x, y).green(), reference.at(x, y).green());
+        EXPECT_EQ(image.at(x, y).blue(), reference.at(x, y).blue());
+      }
+  }
+
+  // A world without lights is all black.
+  World dark = World::get_default();
+  dark.lights().clear();
+  Canvas image(23, 19);
+  image.at(11, 9) = Color::WHITE();
+  Wavefront(c, dark).render(image, 0, 0, 23, 19);
+  EXPECT_EQ(image.at(11, 9), Color::BLACK());
+}
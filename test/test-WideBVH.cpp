@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "test-ratrac.h"
+
+#include "ratrac/WideBVH.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace ratrac;
+using namespace testing;
+
+using std::ostringstream;
+using std::vector;
+
+namespace {
+const RayTracerDataType INF =
+    std::numeric_limits<RayTracerDataType>::infinity();
+
+// Get the list of primitives visited by a traversal, in the visit order.
+template <class BVHTy>
+vector<unsigned> visited(const BVHTy &bvh, const Ray &r,
+                         RayTracerDataType tmin = 0) {
+  vector<unsigned> prims;
+  bvh.traverse(r, tmin, INF, [&](unsigned prim) {
+    prims.push_back(prim);
+    return false;
+  });
+  return prims;
+}
+
+vector<unsigned> sorted(vector<unsigned> prims) {
+  std::sort(prims.begin(), prims.end());
+  return prims;
+}
+} // namespace
+
+TEST(WideBVH, base) {
+  WideBVH empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.depth(), 0);
+  EXPECT_TRUE(visited(empty, Ray(Point(0, 0, -5), Vector(0, 0, 1))).empty());
+  EXPECT_TRUE(WideBVH(BVH()).empty());
+
+  // A single primitive is a leaf of the root.
+  const WideBVH one(BVH({BoundingBox(Point(-1, -1, -1), Point(1, 1, 1))}));
+  EXPECT_EQ(one.size(), 1);
+  ASSERT_EQ(one.nodes().size(), 1);
+  EXPECT_EQ(one.nodes()[0].count[0], 1);
+  EXPECT_EQ(one.nodes()[0].child[1], WideBVH::NO_CHILD);
+  EXPECT_EQ(one.bounds(), BoundingBox(Point(-1, -1, -1), Point(1, 1, 1)));
+  EXPECT_EQ(visited(one, Ray(Point(0, 0, -5), Vector(0, 0, 1))),
+            vector<unsigned>({0}));
+  EXPECT_TRUE(visited(one, Ray(Point(2, 0, -5), Vector(0, 0, 1))).empty());
+
+  // The nodes are 2 cache lines, and there are about 3 times fewer than in
+  // the binary BVH, with the same leaves.
+  const BVH bvh(lattice());
+  const WideBVH wide(bvh);
+  EXPECT_EQ(sizeof(WideBVH::Node), 128);
+  EXPECT_EQ(wide.size(), 1000);
+  EXPECT_EQ(wide.indices(), bvh.indices());
+  EXPECT_EQ(wide.bounds(), bvh.bounds());
+  EXPECT_LT(wide.nodes().size(), bvh.nodes().size() / 2);
+  EXPECT_LT(wide.depth(), bvh.depth());
+  unsigned leaves = 0, primitives = 0;
+  for (const WideBVH::Node &node : wide.nodes())
+    for (unsigned i = 0; i < WideBVH::WIDTH; i++)
+      if (node.count[i]) {
+        leaves++;
+        primitives += node.count[i];
+      } else if (node.child[i] != WideBVH::NO_CHILD) {
+        EXPECT_GT(node.child[i], &node - &wide.nodes()[0]);
+        EXPECT_LT(node.child[i], wide.nodes().size());
+      }
+  EXPECT_EQ(primitives, 1000);
+  unsigned binary_leaves = 0;
+  for (const BVH::Node &node : bvh.nodes())
+    binary_leaves += node.is_leaf();
+  EXPECT_EQ(leaves, binary_leaves);
+}
+
+TEST(WideBVH, traverse) {
+  // The traversal visits the primitives the binary BVH visits.
+  const vector<BoundingBox> boxes = lattice();
+  const BVH bvh(boxes);
+  const WideBVH wide(bvh);
+  unsigned found = 0;
+  for (const Ray &r : latticeRays()) {
+    const vector<unsigned> expected = sorted(visited(bvh, r));
+    EXPECT_EQ(sorted(visited(wide, r)), expected);
+    EXPECT_EQ(sorted(visited(wide, r, -INF)), sorted(visited(bvh, r, -INF)));
+    found += expected.size();
+  }
+  EXPECT_GT(found, 500);
+
+  // The nearer children are visited first, and the traversal stops when
+  // asked to.
+  const Ray r(Point(-5, 0, 0), Vector(1, 0, 0));
+  const vector<unsigned> prims = visited(wide, r);
+  ASSERT_GE(prims.size(), 10);
+  EXPECT_LT(boxes[prims.front()].centroid().x(), 3);
+  EXPECT_GT(boxes[prims.back()].centroid().x(), 6);
+  unsigned count = 0;
+  wide.traverse(r, 0, INF, [&](unsigned) { return ++count == 3; });
+  EXPECT_EQ(count, 3);
+
+  // The children beyond tmax are skipped as it shrinks.
+  vector<unsigned> closest;
+  RayTracerDataType tmax = INF;
+  wide.traverse(r, 0, tmax, [&](unsigned prim) {
+    closest.push_back(prim);
+    tmax = 5;
+    return false;
+  });
+  EXPECT_LT(closest.size(), 5);
+}
+
+TEST(WideBVH, output) {
+  const WideBVH bvh(BVH({BoundingBox(Point(-1, -1, -1), Point(1, 1, 1))}));
+  ostringstream oss;
+  oss << bvh;
+  EXPECT_EQ(oss.str(),
+            "WideBVH { primitives: 1, nodes: 1, depth: 1, bounds: "
+            "BoundingBox { min: Tuple { -1, -1, -1, 1}, max: Tuple { 1, 1, 1, "
+            "1}}}");
+}
@@ -2,12 +2,16 @@
 
 #include "ratrac/World.h"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
+#include <vector>
 
 using namespace ratrac;
 using namespace testing;
 
 using std::ostringstream;
+using std::vector;
 
 TEST(World, base) {
   // Creating an (empty) world.
@@ -66,6 +70,16 @@ TEST(World, intersection) {
 }
 
 TEST(World, shading) {
+  // The shading points are SURFACE_OFFSET off the spheres, which is 100 times
+  // farther in single precision: the light is seen at another angle there.
+#if defined(RATRAC_USES_FLOAT)
+  const Color outside(0.380637, 0.475797, 0.285478);
+  const Color inside(0.904662, 0.904662, 0.904662);
+#else
+  const Color outside(0.380661, 0.475826, 0.285496);
+  const Color inside(0.904984, 0.904984, 0.904984);
+#endif
+
   // Shading an intersection.
   World w = World::get_default();
   Ray r(Point(0, 0, -5), Vector(0, 0, 1));
@@ -73,7 +87,7 @@ TEST(World, shading) {
   Intersection i(4, s);
   Computations comps(i, r);
   Color c = shade_hit(w, comps);
-  EXPECT_EQ(c, Color(0.380661, 0.475826, 0.285496));
+  EXPECT_EQ(c, outside);
 
   // Shading an intersection from the inside..
   w = World::get_default();
@@ -83,7 +97,7 @@ TEST(World, shading) {
   i = Intersection(0.5, s);
   comps = Computations(i, r);
   c = shade_hit(w, comps);
-  EXPECT_EQ(c, Color(0.904984, 0.904984, 0.904984));
+  EXPECT_EQ(c, inside);
 
   // The color when a ray misses.
   w = World::get_default();
@@ -95,7 +109,7 @@ TEST(World, shading) {
   w = World::get_default();
   r = Ray(Point(0, 0, -5), Vector(0, 0, 1));
   c = color_at(w, r);
-  EXPECT_EQ(c, Color(0.380661, 0.475826, 0.285496));
+  EXPECT_EQ(c, outside);
 
   // The color with an intersection behind the ray.
   w = World::get_default();
@@ -143,3 +157,373 @@ TEST(World, shadow) {
   point = Tuple::Point(-2, 2, -2);
   EXPECT_FALSE(is_shadowed(world, point, 0));
 }
+
+TEST(World, occlusion) {
+  const RayTracerDataType inf = std::numeric_limits<RayTracerDataType>::infinity();
+  World w = World::get_default();
+
+  // Occlusion is checked up to a maximum distance.
+  Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+  EXPECT_TRUE(w.occluded(r, inf));
+  EXPECT_TRUE(w.occluded(r, 4.1));
+  EXPECT_FALSE(w.occluded(r, 4));
+
+  // Objects behind the ray do not occlude.
+  r = Ray(Point(0, 0, 5), Vector(0, 0, 1));
+  EXPECT_FALSE(w.occluded(r, inf));
+
+  // Rays starting inside objects are occluded.
+  r = Ray(Point(0, 0, 0), Vector(0, 1, 0));
+  EXPECT_TRUE(w.occluded(r, inf));
+  EXPECT_FALSE(w.occluded(r, 0.5));
+
+  // A ray missing all objects.
+  r = Ray(Point(0, 0, -5), Vector(0, 1, 0));
+  EXPECT_FALSE(w.occluded(r, inf));
+}
+
+TEST(World, closest_hit) {
+  World w = World::get_default();
+
+  // The closest hit is the first intersection in front of the ray.
+  Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+  EXPECT_EQ(w.closest_hit(r), Intersection(4, w.object(0)));
+
+  // Hits behind the ray origin are ignored.
+  r = Ray(Point(0, 0, 0.75), Vector(0, 0, -1));
+  EXPECT_EQ(w.closest_hit(r), Intersection(0.25, w.object(1)));
+
+  // A ray missing all objects.
+  r = Ray(Point(0, 0, -5), Vector(0, 1, 0));
+  EXPECT_EQ(w.closest_hit(r).object, nullptr);
+}
+
+TEST(World, bvh) {
+  // Small worlds do not use a BVH.
+  World w = World::get_default();
+  EXPECT_EQ(w.bvh(), nullptr);
+
+  // Bigger worlds use one, built over the bounded shapes only, and it gives
+  // the same intersections as testing all objects.
+  World big;
+  World small;
+  for (unsigned i = 0; i < 5; i++)
+    for (unsigned j = 0; j < 5; j++) {
+      Sphere *s = new Sphere();
+      s->transform(Matrix::translation(3 * i, 0, 3 * j) *
+                   Matrix::scaling(1, 0.5, 1));
+      big.append(s);
+      if (i == 2)
+        small.append(new Sphere(*s));
+    }
+  Plane *p = new Plane();
+  p->transform(Matrix::translation(0, -1, 0));
+  big.append(p);
+  small.append(new Plane(*p));
+  ASSERT_NE(big.bvh(), nullptr);
+  EXPECT_EQ(big.bvh()->size(), 25);
+  EXPECT_EQ(small.bvh(), nullptr);
+
+  Ray r(Point(6, 0, -5), Vector(0, 0, 1));
+  Intersections xs = big.intersect(r);
+  Intersections expected = small.intersect(r);
+  ASSERT_EQ(xs.count(), 10);
+  ASSERT_EQ(xs.count(), expected.count());
+  for (unsigned i = 0; i < xs.count(); i++)
+    EXPECT_EQ(xs[i].t, expected[i].t);
+
+  // Intersections behind the ray origin are reported too.
+  r = Ray(Point(6, 0, 20), Vector(0, 0, 1));
+  EXPECT_EQ(big.intersect(r).count(), 10);
+
+  // Shadows use the BVH too.
+  big.lights().push_back(LightPoint(Point(6, 10, 6), Color::WHITE()));
+  EXPECT_TRUE(is_shadowed(big, Point(6, -0.9, 6), 0));
+  EXPECT_FALSE(is_shadowed(big, Point(7.5, -0.9, 7.5), 0));
+
+  // And so do the closest hit and occlusion queries.
+  EXPECT_EQ(big.closest_hit(Ray(Point(6, 0, -5), Vector(0, 0, 1))).t,
+            expected.hit()->t);
+  EXPECT_EQ(big.closest_hit(Ray(Point(6, 10, 6), Vector(0, -1, 0))).t, 9.5);
+  EXPECT_EQ(big.closest_hit(Ray(Point(7.5, 10, 7.5), Vector(0, -1, 0))).object,
+            big.object(25));
+  EXPECT_TRUE(big.occluded(Ray(Point(6, 0, -5), Vector(0, 0, 1)), 5));
+  EXPECT_FALSE(big.occluded(Ray(Point(6, 0, -5), Vector(0, 0, 1)), 4));
+  EXPECT_TRUE(big.occluded(Ray(Point(6, 10, 6), Vector(0, -1, 0)), 10));
+  EXPECT_FALSE(big.occluded(Ray(Point(7.5, 10, 7.5), Vector(0, -1, 0)), 10.5));
+  EXPECT_TRUE(big.occluded(Ray(Point(7.5, 10, 7.5), Vector(0, -1, 0)), 11.5));
+
+  // Adding objects rebuilds the BVH.
+  big.append(new Sphere());
+  EXPECT_EQ(big.bvh()->size(), 26);
+}
+
+TEST(World, refit) {
+  // A world where some objects move gets the same hits after a refit as a
+  // world built with the objects where they are.
+  World world;
+  vector<Sphere *> spheres;
+  for (unsigned i = 0; i < 36; i++) {
+    Sphere *s = new Sphere();
+    s->transform(Matrix::translation(3 * (i % 6), 0, 3 * (i / 6)) *
+                 Matrix::scaling(1, 0.5, 1));
+    spheres.push_back(s);
+    world.append(s);
+  }
+  Plane *floor = new Plane();
+  floor->transform(Matrix::translation(0, -1, 0));
+  world.append(floor);
+  ASSERT_NE(world.bvh(), nullptr);
+  const BVH *bvh = world.bvh();
+
+  vector<Ray> rays;
+  for (unsigned i = 0; i < 20; i++)
+    for (unsigned j = 0; j < 20; j++)
+      rays.push_back(Ray(Point(i, 10, j), normalize(Vector(0.1, -1, 0.2))));
+
+  for (unsigned frame = 1; frame <= 3; frame++) {
+    vector<unsigned> moved;
+    for (unsigned i = frame; i < 36; i += 7) {
+      spheres[i]->transform(Matrix::translation(0.5, 0, 0.75) *
+                            spheres[i]->transform());
+      moved.push_back(i);
+    }
+    floor->transform(Matrix::translation(0, -0.5, 0) * floor->transform());
+    moved.push_back(36);
+    world.refit(moved);
+    // The BVH was refitted, not rebuilt.
+    ASSERT_EQ(world.bvh(), bvh);
+
+    World expected;
+    for (const Sphere *s : spheres)
+      expected.append(new Sphere(*s));
+    expected.append(new Plane(*floor));
+    for (const Ray &r : rays) {
+      const Intersection hit = world.closest_hit(r);
+      const Intersection expected_hit = expected.closest_hit(r);
+      EXPECT_EQ(hit.t, expected_hit.t);
+      EXPECT_EQ(hit.object == floor,
+                expected_hit.object == expected.object(36));
+      EXPECT_EQ(world.occluded(r, 9), expected.occluded(r, 9));
+    }
+  }
+
+  // Worlds which will be rebuilt anyway are not refitted.
+  world.append(new Sphere());
+  world.refit({0});
+  EXPECT_EQ(world.bvh()->size(), 37);
+}
+
+TEST(World, packet_closest_hit) {
+  // A packet query gives each lane the hit of the single ray query, with and
+  // without a BVH.
+  World small = World::get_default();
+  small.append(new Plane());
+  small.object(2)->transform(Matrix::translation(0, -1, 0));
+  World big;
+  for (unsigned i = 0; i < 5; i++)
+    for (unsigned j = 0; j < 5; j++) {
+      Sphere *s = new Sphere();
+      s->transform(Matrix::translation(3 * i - 6, 0, 3 * j) *
+                   Matrix::scaling(1, 0.5, 1));
+      big.append(s);
+    }
+  big.append(new Plane());
+  big.object(25)->transform(Matrix::translation(0, -1, 0));
+  ASSERT_EQ(small.bvh(), nullptr);
+  ASSERT_NE(big.bvh(), nullptr);
+
+  for (const World *w : {&small, &big}) {
+    unsigned hits_found = 0;
+    for (unsigned y = 0; y < 8; y++)
+      for (unsigned x = 0; x < 8; x += RayPacket::SIZE / 2) {
+        RayPacket rays;
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          Tuple to = Point(x + i % 4 - 4.0, y - 4.0 + i / 4, 0);
+          rays.set(i, Ray(Point(0, 1, -5), normalize(to - Point(0, 1, -5))));
+        }
+        const unsigned mask = y == 7 ? 0x3C : RayPacket::mask(RayPacket::SIZE);
+        PacketHits hits = w->closest_hit(rays, mask);
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          if (!(mask & (1U << i))) {
+            EXPECT_EQ(hits.object[i], nullptr);
+            continue;
+          }
+          Intersection expected = w->closest_hit(rays.ray(i));
+          EXPECT_EQ(hits.hit(i), expected);
+          hits_found += expected.object != nullptr;
+        }
+      }
+    EXPECT_GT(hits_found, 16);
+  }
+}
+
+TEST(World, grid) {
+  // A world using a grid gives the same intersections as with a BVH.
+  World bvh, grid;
+  grid.accelerator(Accelerator::GRID);
+  EXPECT_EQ(grid.accelerator(), Accelerator::GRID);
+  for (World *w : {&bvh, &grid}) {
+    for (unsigned i = 0; i < 64; i++) {
+      Sphere *s = new Sphere();
+      const RayTracerDataType r = 0.3 + 0.1 * (i % 4);
+      s->transform(Matrix::translation(2 * (i % 4), 2 * ((i / 4) % 4),
+                                       2 * (i / 16)) *
+                   Matrix::scaling(r, r, r));
+      w->append(s);
+    }
+    w->append(new Plane());
+    w->object(64)->transform(Matrix::translation(0, -1, 0));
+  }
+  ASSERT_NE(bvh.bvh(), nullptr);
+  EXPECT_EQ(bvh.grid(), nullptr);
+  ASSERT_NE(grid.grid(), nullptr);
+  EXPECT_EQ(grid.bvh(), nullptr);
+  EXPECT_EQ(grid.grid()->size(), 64);
+
+  unsigned found = 0;
+  for (unsigned y = 0; y < 8; y++)
+    for (unsigned x = 0; x < 8; x++) {
+      RayPacket rays;
+      for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+        const Tuple from = Point(3 + 0.1 * i, 12, -5);
+        const Tuple to = Point(x - 1.0, y - 1.0, 0.8 * i);
+        rays.set(i, Ray(from, normalize(to - from)));
+      }
+      const PacketHits hits = grid.closest_hit(rays, 0xF7);
+      for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+        const Ray r = rays.ray(i);
+        const Intersection expected = bvh.closest_hit(r);
+        const Intersection hit = grid.closest_hit(r);
+        EXPECT_EQ(hit.t, expected.t);
+        found += expected.object != nullptr;
+        if (i != 3) {
+          EXPECT_EQ(hits.hit(i), hit);
+        }
+        EXPECT_EQ(grid.occluded(r, 10), bvh.occluded(r, 10));
+        const Intersections xs = grid.intersect(r);
+        const Intersections expected_xs = bvh.intersect(r);
+        ASSERT_EQ(xs.count(), expected_xs.count());
+        for (unsigned j = 0; j < xs.count(); j++)
+          EXPECT_EQ(xs[j].t, expected_xs[j].t);
+      }
+    }
+  EXPECT_GT(found, 100);
+
+  // Switching back to a BVH rebuilds the acceleration structure.
+  grid.accelerator(Accelerator::BVH);
+  EXPECT_NE(grid.bvh(), nullptr);
+  EXPECT_EQ(grid.grid(), nullptr);
+}
+
+TEST(World, wide_bvh) {
+  // A world using a wide BVH gives the same hits as with a BVH, with single
+  // rays and with packets, and after refits.
+  World bvh, wide;
+  wide.accelerator(Accelerator::WIDE_BVH);
+  EXPECT_EQ(wide.accelerator(), Accelerator::WIDE_BVH);
+  vector<Sphere *> spheres;
+  for (World *w : {&bvh, &wide}) {
+    for (unsigned i = 0; i < 64; i++) {
+      Sphere *s = new Sphere();
+      const RayTracerDataType r = 0.3 + 0.1 * (i % 4);
+      s->transform(Matrix::translation(2 * (i % 4), 2 * ((i / 4) % 4),
+                                       2 * (i / 16)) *
+                   Matrix::scaling(r, r, r));
+      w->append(s);
+      spheres.push_back(s);
+    }
+    w->append(new Plane());
+    w->object(64)->transform(Matrix::translation(0, -1, 0));
+  }
+  ASSERT_NE(wide.wide_bvh(), nullptr);
+  ASSERT_NE(wide.bvh(), nullptr);
+  EXPECT_EQ(bvh.wide_bvh(), nullptr);
+  EXPECT_EQ(wide.grid(), nullptr);
+  EXPECT_EQ(wide.wide_bvh()->size(), 64);
+  EXPECT_EQ(wide.wide_bvh()->indices(), wide.bvh()->indices());
+  const WideBVH::Node *nodes = wide.wide_bvh()->nodes().data();
+  vector<Matrix> transforms;
+  for (const Sphere *s : spheres)
+    transforms.push_back(s->transform());
+
+  for (unsigned frame = 0; frame < 3; frame++) {
+    if (frame) {
+      // Move a few spheres in both worlds, and then back where they were.
+      const Matrix move = frame == 1 ? Matrix::translation(0.5, 1, -0.25)
+                                     : Matrix::identity();
+      vector<unsigned> moved;
+      for (unsigned i = 3; i < 64; i += 9) {
+        for (unsigned j : {i, 64 + i})
+          spheres[j]->transform(move * transforms[j]);
+        moved.push_back(i);
+      }
+      bvh.refit(moved);
+      wide.refit(moved);
+      EXPECT_EQ(wide.wide_bvh()->bounds(), wide.bvh()->bounds());
+
+      // The wide BVH was refitted in place, each interior slot to its
+      // child's slots.
+      const vector<WideBVH::Node> &refitted = wide.wide_bvh()->nodes();
+      ASSERT_EQ(refitted.data(), nodes);
+      for (const WideBVH::Node &node : refitted)
+        for (unsigned i = 0; i < WideBVH::WIDTH; i++) {
+          if (node.count[i] || node.child[i] == WideBVH::NO_CHILD)
+            continue;
+          const WideBVH::Node &child = refitted[node.child[i]];
+          const unsigned width = WideBVH::WIDTH;
+          for (unsigned a = 0; a < 3; a++) {
+            EXPECT_EQ(node.min[a][i],
+                      *std::min_element(child.min[a], child.min[a] + width));
+            EXPECT_EQ(node.max[a][i],
+                      *std::max_element(child.max[a], child.max[a] + width));
+          }
+        }
+    }
+    if (frame == 2) {
+      // With the spheres back, it has the boxes of a fresh collapse.
+      const WideBVH expected(*wide.bvh());
+      ASSERT_EQ(wide.wide_bvh()->nodes().size(), expected.nodes().size());
+      for (unsigned n = 0; n < expected.nodes().size(); n++)
+        for (unsigned i = 0; i < WideBVH::WIDTH; i++) {
+          const WideBVH::Node &node = wide.wide_bvh()->nodes()[n];
+          const WideBVH::Node &expected_node = expected.nodes()[n];
+          EXPECT_EQ(node.child[i], expected_node.child[i]);
+          EXPECT_EQ(node.count[i], expected_node.count[i]);
+          for (unsigned a = 0; a < 3; a++) {
+            EXPECT_EQ(node.min[a][i], expected_node.min[a][i]);
+            EXPECT_EQ(node.max[a][i], expected_node.max[a][i]);
+          }
+        }
+    }
+
+    unsigned found = 0;
+    for (unsigned y = 0; y < 8; y++)
+      for (unsigned x = 0; x < 8; x++) {
+        RayPacket rays;
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          const Tuple from = Point(3 + 0.1 * i, 12, -5);
+          const Tuple to = Point(x - 1.0, y - 1.0, 0.8 * i);
+          rays.set(i, Ray(from, normalize(to - from)));
+        }
+        const PacketHits hits = wide.closest_hit(rays, 0xF7);
+        for (unsigned i = 0; i < RayPacket::SIZE; i++) {
+          const Ray r = rays.ray(i);
+          const Intersection expected = bvh.closest_hit(r);
+          const Intersection hit = wide.closest_hit(r);
+          EXPECT_EQ(hit.t, expected.t);
+          found += expected.object != nullptr;
+          if (i != 3) {
+            EXPECT_EQ(hits.hit(i), hit);
+          }
+          EXPECT_EQ(wide.occluded(r, 10), bvh.occluded(r, 10));
+          const Intersections xs = wide.intersect(r);
+          const Intersections expected_xs = bvh.intersect(r);
+          ASSERT_EQ(xs.count(), expected_xs.count());
+          for (unsigned j = 0; j < xs.count(); j++)
+            EXPECT_EQ(xs[j].t, expected_xs[j].t);
+        }
+      }
+    EXPECT_GT(found, 100);
+  }
+}
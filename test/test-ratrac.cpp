@@ -1,7 +1,81 @@
+#include "test-ratrac.h"
+
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
 using namespace testing;
 
+namespace ratrac {
+#if defined(RATRAC_USES_FLOAT)
+AssertionResult closeColors(const char *actual_expr, const char *expected_expr,
+                            const Color &actual, const Color &expected) {
+  if (actual.close_to(expected, FLOAT_COLOR_TOLERANCE))
+    return AssertionSuccess();
+  Color::ColorType difference = 0;
+  for (unsigned c = 0; c < 4; c++)
+    difference = std::max(difference,
+                          std::fabs(actual.data()[c] - expected.data()[c]));
+  return AssertionFailure()
+         << actual_expr << " is " << std::string(actual) << ", "
+         << difference << " away from " << expected_expr << ", "
+         << std::string(expected) << ", beyond " << FLOAT_COLOR_TOLERANCE;
+}
+#endif
+
+std::string getTempFilename(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void writeFile(const std::string &filename, const std::string &content) {
+  std::ofstream os(filename, std::ios::binary);
+  os << content;
+}
+
+std::string getTempFile(const std::string &name, const std::string &content) {
+  const std::string filename = getTempFilename(name);
+  writeFile(filename, content);
+  return filename;
+}
+
+bool sameMatrix(const Matrix &A, const Matrix &B) {
+  for (unsigned row = 0; row < 4; row++)
+    for (unsigned col = 0; col < 4; col++)
+      if (A.at(row, col) != B.at(row, col))
+        return false;
+  return true;
+}
+
+std::vector<BoundingBox> lattice() {
+  std::vector<BoundingBox> boxes;
+  for (unsigned i = 0; i < 1000; i++) {
+    const Tuple c = Point(i % 10, (i / 10) % 10, i / 100);
+    const RayTracerDataType h = 0.1 + 0.05 * (i % 7);
+    boxes.push_back(BoundingBox(c - Vector(h, h, h), c + Vector(h, h, h)));
+  }
+  return boxes;
+}
+
+std::vector<Ray> latticeRays() {
+  std::vector<Ray> rays;
+  for (int i = 0; i < 12; i++)
+    for (int j = 0; j < 12; j++) {
+      const Tuple from = Point(-3 + 0.3 * i, 12, -4 + 0.5 * j);
+      const Tuple to = Point(1.1 * j - 1, -2, 0.9 * i);
+      rays.push_back(Ray(from, normalize(to - from)));
+    }
+  rays.push_back(Ray(Point(-5, 0, 0), Vector(1, 0, 0)));
+  rays.push_back(Ray(Point(3, 4, 20), Vector(0, 0, -1)));
+  rays.push_back(Ray(Point(3, 4.25, 20), Vector(0, 0, -1)));
+  rays.push_back(Ray(Point(4.5, 4.5, 4.5), normalize(Vector(-1, 2, 0.5))));
+  rays.push_back(Ray(Point(5, 5, 5), normalize(Vector(1, 1, 1))));
+  return rays;
+}
+} // namespace ratrac
+
 int main(int argc, char **argv) {
   InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gtest/gtest.h"
+
+#include "ratrac/BoundingBox.h"
+#include "ratrac/Color.h"
+#include "ratrac/Matrix.h"
+#include "ratrac/Ray.h"
+
+#include <string>
+#include <vector>
+
+/** Expects the shaded color actual to be expected, which the tests compute
+ * in double precision. Single precision rounds the light and eye vectors to
+ * 24 bits, and the specular term raises their dot product to the material's
+ * shininess, which scales its relative error by as much: with the usual
+ * shininess of 200, this takes the colors beyond Color::operator==, and the
+ * float builds compare within FLOAT_COLOR_TOLERANCE instead. */
+#if defined(RATRAC_USES_FLOAT)
+#define EXPECT_COLOR_EQ(actual, expected)                                      \
+  EXPECT_PRED_FORMAT2(::ratrac::closeColors, actual, expected)
+#else
+#define EXPECT_COLOR_EQ(actual, expected) EXPECT_EQ(actual, expected)
+#endif
+
+namespace ratrac {
+#if defined(RATRAC_USES_FLOAT)
+constexpr Color::ColorType FLOAT_COLOR_TOLERANCE = 5e-5f;
+
+/** The predicate of EXPECT_COLOR_EQ in the float builds. */
+testing::AssertionResult closeColors(const char *actual_expr,
+                                     const char *expected_expr,
+                                     const Color &actual,
+                                     const Color &expected);
+#endif
+
+/** Returns the path of the file name in the temporary directory. */
+std::string getTempFilename(const std::string &name);
+
+/** Writes content to filename, replacing it if it exists. */
+void writeFile(const std::string &filename, const std::string &content);
+
+/** Writes content to the file name in the temporary directory, and returns
+ * its path. */
+std::string getTempFile(const std::string &name, const std::string &content);
+
+/** Returns true if the 4x4 matrices A and B have the same elements. */
+bool sameMatrix(const Matrix &A, const Matrix &B);
+
+/** Returns a 10x10x10 lattice of small cubes of various sizes, 1 unit apart,
+ * for the acceleration structures tests. */
+std::vector<BoundingBox> lattice();
+
+/** Returns rays crossing lattice() in all directions, including rays along
+ * the axes, on the cubes' planes and on the cells' boundaries, and from
+ * inside the lattice. */
+std::vector<Ray> latticeRays();
+} // namespace ratrac